@@ -0,0 +1,12 @@
+#ifdef GL_ES
+precision mediump float;
+#endif
+
+uniform sampler2D diffuseMap;
+
+varying vec2 oUv0;
+varying vec4 oColour;
+
+void main() {
+    gl_FragColor = texture2D(diffuseMap, oUv0) * oColour;
+}
@@ -0,0 +1,38 @@
+uniform mat4 viewProjMatrix;
+uniform vec4 ambientLight;
+uniform vec4 surfaceAmbient;
+uniform vec4 surfaceDiffuse;
+uniform vec4 surfaceEmissive;
+uniform vec4 lightPosition;
+uniform vec4 lightDiffuse;
+
+attribute vec4 vertex;
+attribute vec3 normal;
+attribute vec4 uv0;
+attribute vec4 uv1;
+attribute vec4 uv2;
+attribute vec4 uv3;
+
+varying vec2 oUv0;
+varying vec4 oColour;
+
+void main() {
+    mat4 worldMatrix;
+    worldMatrix[0] = uv1;
+    worldMatrix[1] = uv2;
+    worldMatrix[2] = uv3;
+    worldMatrix[3] = vec4(0.0, 0.0, 0.0, 1.0);
+
+    vec4 worldPos = vertex * worldMatrix;
+    vec3 worldNorm = normalize(normal * mat3(worldMatrix));
+    gl_Position = viewProjMatrix * worldPos;
+
+    vec3 lightDir = normalize(lightPosition.xyz - 
+                              (worldPos.xyz * lightPosition.w));
+    float diffuse = max(dot(worldNorm, lightDir), 0.0);
+
+    oColour = (ambientLight * surfaceAmbient) + surfaceEmissive +
+              (lightDiffuse * surfaceDiffuse * diffuse);
+    oColour.a = surfaceDiffuse.a;
+    oUv0 = uv0.xy;
+}
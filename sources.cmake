@@ -88,11 +88,17 @@ src/engine/goals.cpp
 src/engine/field.cpp
 src/engine/fobject.cpp
 src/engine/goalkeeper.cpp
+src/engine/interpolation.cpp
+src/engine/matchrecord.cpp
+src/engine/matchsimulator.cpp
+src/engine/matchfarm.cpp
+src/engine/threadlog.cpp
 src/engine/options.cpp
 src/engine/core.cpp
 src/engine/replay.cpp
 src/engine/rules.cpp
 src/engine/savefile.cpp
+src/engine/soundeffects.cpp
 src/engine/team.cpp
 src/engine/teams.cpp
 src/engine/teamplayer.cpp
@@ -106,11 +112,17 @@ src/engine/goals.h
 src/engine/field.h
 src/engine/fobject.h
 src/engine/goalkeeper.h
+src/engine/interpolation.h
+src/engine/matchrecord.h
+src/engine/matchsimulator.h
+src/engine/matchfarm.h
+src/engine/threadlog.h
 src/engine/options.h
 src/engine/core.h
 src/engine/replay.h
 src/engine/rules.h
 src/engine/savefile.h
+src/engine/soundeffects.h
 src/engine/team.h
 src/engine/teams.h
 src/engine/teamplayer.h
@@ -144,16 +156,26 @@ src/gui/guisocket.h
 set(PHYSICS_SOURCES
 src/physics/bulletlink.cpp
 src/physics/collision.cpp
+src/physics/collisionevent.cpp
+src/physics/diskspace.cpp
 src/physics/disttable.cpp
 src/physics/forceio.cpp
 src/physics/ogremotionstate.cpp
+src/physics/physicscontext.cpp
+src/physics/turnresult.cpp
+src/physics/worldsnapshot.cpp
 )
 set(PHYSICS_HEADERS
 src/physics/bulletlink.h
 src/physics/collision.h
+src/physics/collisionevent.h
+src/physics/diskspace.h
 src/physics/disttable.h
 src/physics/forceio.h
 src/physics/ogremotionstate.h
+src/physics/physicscontext.h
+src/physics/turnresult.h
+src/physics/worldsnapshot.h
 )
 set(NET_SOURCES
 src/net/protocol.cpp
@@ -168,12 +190,14 @@ src/ai/baseai.cpp
 src/ai/decourtai.cpp
 src/ai/dummyai.cpp
 src/ai/fuzzyai.cpp
+src/ai/searchai.cpp
 )
 set(AI_HEADERS
 src/ai/baseai.h
 src/ai/decourtai.h
 src/ai/dummyai.h
 src/ai/fuzzyai.h
+src/ai/searchai.h
 )
 
 set(DEBUG_HEADERS
@@ -229,6 +253,11 @@ src/distcalc.cpp
 ${WIN_SOURCES}
 )
 
+set(BTSOCCER_SIMULATOR
+src/simulator/main.cpp
+${WIN_SOURCES}
+)
+
 set(BTSOCCER_TEST
 src/unit_tests/testcase.h
 src/unit_tests/testcase.cpp
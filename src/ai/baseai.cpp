@@ -18,14 +18,13 @@
   along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <OGRE/OgreLogManager.h>
-
 #include "baseai.h"
 #include "../engine/ball.h"
 #include "../engine/field.h"
 #include "../engine/teamplayer.h"
 #include "../engine/goalkeeper.h"
 #include "../engine/rules.h"
+#include "../engine/threadlog.h"
 
 namespace BtSoccer
 {
@@ -158,6 +157,16 @@ float BaseAI::getLengthToSendBallToDistanceWithDisk(float distanceToBall,
    return DistTable::getDiskInputVectorLength(distanceToBall, ballDistance);
 }
 
+/***********************************************************************
+ *               getForceToSendBallToDistanceWithDisk                  *
+ ***********************************************************************/  
+float BaseAI::getLengthToSendBallToDistanceWithDisk(float distanceToBall,
+      float contactAngle, float ballDistance)
+{
+   return DistTable::getDiskInputVectorLength(distanceToBall, contactAngle,
+         ballDistance);
+}
+
 /***********************************************************************
  *                          calculateForce                             *
  ***********************************************************************/
@@ -207,8 +216,26 @@ void BaseAI::calculateForce(TeamPlayer* tp, Ball* ball,
    float ballDistDisk = (ball->getPosition() - tp->getPosition()).length() - 
       tp->getSphereRadius() - ball->getSphereRadius(); 
    bool ballTooNear = ballDistDisk < 3.0f;
-   float length = getLengthToSendBallToDistanceWithDisk(dist, ballDist);
-   length *= 1.14f;
+   float length;
+   if(DistTable::hasAngleTable())
+   {
+      /* The table already has the whole shot at the contact angle, near
+       * touches included. */
+      Ogre::Vector2 toBall(ballPos.x - diskPos[0], ballPos.z - diskPos[1]);
+      toBall.normalise();
+      Ogre::Radian angle = Ogre::Math::ACos(-direction.dotProduct(toBall));
+      length = getLengthToSendBallToDistanceWithDisk(dist, 
+            angle.valueDegrees(), ballDist);
+   }
+   else
+   {
+      length = getLengthToSendBallToDistanceWithDisk(dist, ballDist);
+      length *= 1.14f;
+      if(ballTooNear)
+      {
+         length *= 2.8f;
+      }
+   }
 
    printf("toonear: %d ballDist: %.3f\n", ballTooNear, ballDistDisk);
    if(!mustStop)
@@ -216,11 +243,7 @@ void BaseAI::calculateForce(TeamPlayer* tp, Ball* ball,
       /* Touch a bit harder */
       length *= 1.4f;
    }
-   if(ballTooNear)
-   {
-      length *= 2.8f;
-   }
-   Ogre::LogManager::getSingleton().stream(Ogre::LML_NORMAL) 
+   ThreadLog::getLog()->stream(Ogre::LML_NORMAL) 
       << "Length: " << length 
       << ", dir: (" << direction[0]
       << "," << direction[1] << ")";
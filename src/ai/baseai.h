@@ -128,6 +128,15 @@ class BaseAI
        *                      ball to. */
       float getLengthToSendBallToDistanceWithDisk(float distanceToBall,
             float ballDistance);
+      /*! Get the needed vector length to send the ball to a distance,
+       * touching it with a disk at an angle.
+       * \param distanceToBall distance the disk travels before the touch.
+       * \param contactAngle angle (in degrees) between the disk movement
+       *        and the direction to the ball center, at the touch.
+       * \param ballDistance target distance (from the ball) to send the 
+       *                      ball to. */
+      float getLengthToSendBallToDistanceWithDisk(float distanceToBall,
+            float contactAngle, float ballDistance);
 
       /*! Calculate and set force vector to disk tp send ball to position 
        * (target).
@@ -22,14 +22,15 @@
 
 #include "../engine/ball.h"
 #include "../engine/field.h"
+#include "../engine/goalkeeper.h"
 #include "../engine/rules.h"
 #include "../engine/team.h"
 #include "../engine/teamplayer.h"
 #include "../gui/guimessage.h"
+#include "../engine/threadlog.h"
 
 #include <iostream>
 #include <OGRE/OgreMath.h>
-#include <OGRE/OgreLogManager.h>
 
 using namespace BtSoccer;
 
@@ -44,6 +45,9 @@ using namespace BtSoccer;
 
 #define UNDEFINED_POSITION -1234567.0f
 
+/*! Number of lanes, along the goal mouth, to check for a free goal shoot */
+#define GOAL_SHOOT_LANES   12
+
 /***************************************************************************
  *                                Constructor                              *
  ***************************************************************************/
@@ -55,8 +59,6 @@ DecourtAI::DecourtAI(BtSoccer::Team* t, Field* f)
    {
       electedDisk[i] = NULL;
    }
-
-   query = t->getSceneManager()->createRayQuery(Ogre::Ray());
 }
 
 /***************************************************************************
@@ -64,7 +66,6 @@ DecourtAI::DecourtAI(BtSoccer::Team* t, Field* f)
  ***************************************************************************/
 DecourtAI::~DecourtAI()
 {
-   curTeam->getSceneManager()->destroyQuery(query);
 }
 
 /***************************************************************************
@@ -168,7 +169,7 @@ void DecourtAI::calculateForceVector(ActionInfo* action)
    Ball* gameBall = Rules::getBall();
 
 #if BTSOCCER_DEBUG_AI
-   Ogre::Log::Stream stream = Ogre::LogManager::getSingleton().stream(
+   Ogre::Log::Stream stream = ThreadLog::getLog()->stream(
          Ogre::LML_NORMAL);
 
    stream << "\n*****************************\n";
@@ -323,6 +324,9 @@ void DecourtAI::calculateStep()
       break;
       case STEP_SELECT_POTENTIAL_DISKS:
       {
+         /* Take current players positions, for free way checks */
+         diskSpace.set(Rules::getTeamA(), Rules::getTeamB());
+
          /* Choose disks to set potential actions */
          selectPotentialDisks();
          for(int i = 0; i < MAX_ELEGIBLE_DISKS; i++)
@@ -376,7 +380,7 @@ void DecourtAI::calculateStep()
             lastAction.set(ACTION_NONE, NULL, Ogre::Vector3(0.0f, 0.0f, 0.0f),
                   NULL);
 
-            Ogre::LogManager::getSingleton().logMessage(
+            ThreadLog::getLog()->logMessage(
                   "TODO: do something dumb!", Ogre::LML_CRITICAL);
          }
          else
@@ -604,7 +608,7 @@ bool DecourtAI::shouldAdvanceWithBall(BtSoccer::TeamPlayer* tp,
    Ogre::Vector2 targetBallPos = ballPos + 
       BALL_ADVANCE_DISTANCE * directionToBall;
 #if BTSOCCER_DEBUG_AI
-   Ogre::Log::Stream stream = Ogre::LogManager::getSingleton().stream(
+   Ogre::Log::Stream stream = ThreadLog::getLog()->stream(
          Ogre::LML_NORMAL);
    stream << "\n\nPlayer: " << tp->getPosition().x << ", " 
           <<  tp->getPosition().z << " Ball: " <<  ballPos[0] << ", " 
@@ -628,7 +632,7 @@ bool DecourtAI::shouldAdvanceWithBall(BtSoccer::TeamPlayer* tp,
    tp->pointTarget(Ogre::Vector3(targetBallPos[0], 1.0f, targetBallPos[1]));
 
    /* Check if have free area ahead the ball to its target position */
-   if(!Rules::getBall()->hasFreeWayTo(query, 
+   if(!Rules::getBall()->hasFreeWayTo(&diskSpace, 
             targetBallPos[0], targetBallPos[1]))
    {
       return false;
@@ -649,7 +653,8 @@ bool DecourtAI::checkFreeAreaToBall(BtSoccer::TeamPlayer* tp,
    if(!calculatedCurrentDiskFreeAreaToBall)
    {
       calculatedCurrentDiskFreeAreaToBall = true;
-      hasFreeAreaToBall = tp->hasFreeWayTo(query, ballPos[0], ballPos[1]);
+      hasFreeAreaToBall = tp->hasFreeWayTo(&diskSpace, ballPos[0], 
+            ballPos[1]);
    }
 
 #if BTSOCCER_DEBUG_AI
@@ -670,7 +675,7 @@ bool DecourtAI::shouldTryGoalShoot(BtSoccer::TeamPlayer* tp,
       ActionInfo& info)
 {
 #if BTSOCCER_DEBUG_AI
-   Ogre::Log::Stream stream = Ogre::LogManager::getSingleton().stream(
+   Ogre::Log::Stream stream = ThreadLog::getLog()->stream(
          Ogre::LML_NORMAL);
 #endif
 
@@ -725,11 +730,55 @@ bool DecourtAI::shouldTryGoalShoot(BtSoccer::TeamPlayer* tp,
       return false;
    }
 
+   /* Check if there's any free lane from ball to the goal */
+   if(!hasFreeGoalLane(ballPos, isUpper))
+   {
+#if BTSOCCER_DEBUG_AI
+      stream << "Shouldn't goal shoot: all lanes to goal are blocked.\n";
+#endif
+      return false;
+   }
+
    /* Seems like it's a good moment to shoot! */
    info.set(ACTION_SHOOT_TO_GOAL, tp, Ogre::Vector3(0.0f, 0.0f, 0.0f), NULL); 
    return true;
 }
 
+/***************************************************************************
+ *                             hasFreeGoalLane                             *
+ ***************************************************************************/
+bool DecourtAI::hasFreeGoalLane(Ogre::Vector2 ballPos, bool isUpper)
+{
+   Ogre::Real tgtX[GOAL_SHOOT_LANES];
+   Ogre::Real tgtZ[GOAL_SHOOT_LANES];
+   bool freeWay[GOAL_SHOOT_LANES];
+
+   /* Both goals have the same width */
+   Ogre::AxisAlignedBox box = Rules::getField()->getUpGoalBox();
+   if(!box.isFinite())
+   {
+      /* No goal definition to check lanes. */
+      return true;
+   }
+   Ogre::Real radius = Rules::getBall()->getSphereRadius();
+   Ogre::Real minZ = box.getMinimum().z + radius;
+   Ogre::Real maxZ = box.getMaximum().z - radius;
+   Ogre::Real x = Rules::getField()->getByline(isUpper);
+
+   /* Spread the lanes targets along the goal mouth */
+   for(int i = 0; i < GOAL_SHOOT_LANES; i++)
+   {
+      tgtX[i] = x;
+      tgtZ[i] = minZ + ((maxZ - minZ) * i) / (GOAL_SHOOT_LANES - 1);
+   }
+
+   /* Note: opponent's goal keeper isn't a blocker, as it will be 
+    * positioned just before the shoot. */
+   return diskSpace.getFreeWays(ballPos[0], ballPos[1], radius, tgtX, tgtZ,
+         GOAL_SHOOT_LANES, freeWay, 
+         Rules::getOtherTeam(curTeam)->getGoalKeeper()) > 0;
+}
+
 /***************************************************************************
  *                            getMostAdvancedX                             *
  ***************************************************************************/
@@ -802,7 +851,7 @@ bool DecourtAI::shouldSideOpening(BtSoccer::TeamPlayer* tp,
                    ballPos.x, curDisk->getPosition().x, isUpper) + 
                    m * (curDisk->getSphereRadius() + BALL_ADVANCE_DISTANCE);
                 Ogre::Real tgtZ = curDisk->getPosition().z;
-                if(curDisk->hasFreeWayTo(query, tgtX, tgtZ))
+                if(curDisk->hasFreeWayTo(&diskSpace, tgtX, tgtZ))
                 {
                    /* Should do a side opening to this disk. */
                    //TODO: set target disk and act with it next turn.
@@ -836,9 +885,15 @@ bool DecourtAI::shouldPass(BtSoccer::TeamPlayer* tp, Ogre::Vector2 ballPos,
    std::vector<TeamPlayer*> disks = tp->getTeam()->getPlayersNearestFirst(
          pos.x, pos.z);
 
-   /* Check potential pass to those ahead. */
+   /* Define potential pass targets to those ahead. */
+   Ogre::Real tgtX[TEAM_MAX_DISKS];
+   Ogre::Real tgtZ[TEAM_MAX_DISKS];
+   FieldObject* targetDisk[TEAM_MAX_DISKS];
+   bool freeWay[TEAM_MAX_DISKS];
+   int totalTargets = 0;
+
    std::vector<TeamPlayer*>::iterator it = disks.begin();
-   while(it != disks.end())
+   while((it != disks.end()) && (totalTargets < TEAM_MAX_DISKS))
    {
       TeamPlayer* curDisk = *it;
       if(curDisk != tp)
@@ -861,26 +916,43 @@ bool DecourtAI::shouldPass(BtSoccer::TeamPlayer* tp, Ogre::Vector2 ballPos,
              * directionToBall touch will not send the ball too far away
              * from the disk at the z=curDisk.z line. */
             Ogre::Real n = curDisk->getPosition().z / directionToBall[1];
-            Ogre::Real tgtX = directionToBall[0] * n;
+            Ogre::Real x = directionToBall[0] * n;
             if( (n >= 0) && 
-                (Ogre::Math::Abs(tgtX - curDisk->getPosition().x) <= 
+                (Ogre::Math::Abs(x - curDisk->getPosition().x) <= 
                  BALL_MIN_VALID_Z_DISTANCE) )
             {
-               /* Check if ball target area is free */
-               Ball* ball = Rules::getBall();
-               if(ball->hasFreeWayTo(query, tgtX, curDisk->getPosition().z))
-               {
-                  /* TODO: Act with target disk on next turn! */
-                  info.set(ACTION_PASS, tp, 
-                        Ogre::Vector3(tgtX, 0.0f, curDisk->getPosition().z),
-                        curDisk);
-                  return true;
-               }
+               tgtX[totalTargets] = x;
+               tgtZ[totalTargets] = curDisk->getPosition().z;
+               targetDisk[totalTargets] = curDisk;
+               totalTargets++;
             }
          }
       }
       it++;
    }
+
+   if(totalTargets == 0)
+   {
+      return false;
+   }
+
+   /* Check, at once, which ball target areas are free (note: the target
+    * disk itself isn't a blocker) */
+   diskSpace.getFreeWays(ballPos[0], ballPos[1], 
+         Rules::getBall()->getSphereRadius(), tgtX, tgtZ, totalTargets, 
+         freeWay, NULL, targetDisk);
+
+   /* And pass to the nearest one with free way */
+   for(int i = 0; i < totalTargets; i++)
+   {
+      if(freeWay[i])
+      {
+         /* TODO: Act with target disk on next turn! */
+         info.set(ACTION_PASS, tp, Ogre::Vector3(tgtX[i], 0.0f, tgtZ[i]),
+               (TeamPlayer*) targetDisk[i]);
+         return true;
+      }
+   }
    
    return false;
 }
@@ -22,6 +22,7 @@
 #define _btsoccer_decourt_ai_h
 
 #include "baseai.h"
+#include "../physics/diskspace.h"
 
 namespace BtSoccer
 {
@@ -217,6 +218,13 @@ class DecourtAI : public BaseAI
       /*! Calculate the force vector to do with the action. */
       void calculateForceVector(ActionInfo* action);
 
+      /*! Check, with a batch of lanes along the goal mouth, if the ball 
+       * could be shot to the goal without hitting any disk.
+       * \param ballPos current ball position
+       * \param isUpper if current team is the upper one
+       * \return true if at least one lane is free */
+      bool hasFreeGoalLane(Ogre::Vector2 ballPos, bool isUpper);
+
       /*! \return nearest to opponent's goal X position, from three ones. */
       Ogre::Real getMostAdvancedX(Ogre::Real x1, Ogre::Real x2,
             Ogre::Real x3, bool isUpper); 
@@ -232,7 +240,7 @@ class DecourtAI : public BaseAI
 
       ActionInfo lastAction; /**< Last taken action */
 
-      Ogre::RaySceneQuery* query; /**< Query used for ray casts. */
+      DiskSpace diskSpace; /**< Players at the field, for free way checks */
 
       /*! If the value at #hasFreeAreaToBall is up-to-date for the 
        * current in check disk. */
@@ -152,7 +152,7 @@ void FuzzyDisk::clear()
 /***********************************************************************
  *                       calculateBallPosition                         *
  ***********************************************************************/
-void FuzzyDisk::calculateBallPosition(Ogre::RaySceneQuery* query)
+void FuzzyDisk::calculateBallPosition(DiskSpace* space)
 {
    Ogre::Vector3 diskPos = disk->getPosition();
 
@@ -171,40 +171,14 @@ void FuzzyDisk::calculateBallPosition(Ogre::RaySceneQuery* query)
    ballPosition = b->getRelativePositionToDisk(pos, upperTeam);
 
    /* Must verify now if the path to ball is blocked or not */
-   Ogre::Vector3 origin(diskPos.x, 1.0, diskPos.z);
-   Ogre::Vector3 dir(ballPos.x - diskPos.x, 0.0, ballPos.z - diskPos.z);
-   dir.normalise();
-
-   Ogre::Ray ray(origin, dir);
-   query->setRay(ray);
-   query->setSortByDistance(true);
-
-   Ogre::RaySceneQueryResult &result = query->execute();
-   Ogre::RaySceneQueryResult::iterator itr;
-
-   bool done = false;
-   for( itr = result.begin(); ((itr != result.end()) && (!done)); itr++ )
+   FieldObject* blocker = space->getFirstBlocker(diskPos.x, diskPos.z, 
+         disk->getSphereRadius(), ballPos.x, ballPos.z, disk);
+   if(blocker != NULL)
    {
-      if(itr->movable)
-      {
-         if(itr->movable->getName() == b->getName())
-         {
-            /* Found ball, must end */
-            done = true;
-         }
-         else if(itr->movable->getName() != disk->getName())
-         {
-            /* Set first collided, if none */
-            if(firstCollide.empty())
-            {
-               firstCollide = itr->movable->getName();
+      firstCollide = blocker->getName();
 
-               /* Change ball position as blocked */
-               ballBlocked = true;
-               done = true;
-            }
-         }
-      }
+      /* Change ball position as blocked */
+      ballBlocked = true;
    }
 }
 
@@ -220,7 +194,7 @@ void FuzzyDisk::calculateNearGoal(Field* field)
 /***********************************************************************
  *                         calculateActions                            *
  ***********************************************************************/
-void FuzzyDisk::calculateActions(Ogre::RaySceneQuery* query)
+void FuzzyDisk::calculateActions(DiskSpace* space)
 {
    int i;
 
@@ -235,7 +209,7 @@ void FuzzyDisk::calculateActions(Ogre::RaySceneQuery* query)
       switch(i)
       {
          case ACTION_PASS:
-            calculatePassFactor(query);
+            calculatePassFactor(space);
          break;
          case ACTION_SHOOT:
             calculateShootFactor();
@@ -348,7 +322,7 @@ void FuzzyDisk::calculateShootFactor()
 /***********************************************************************
  *                       calculatePassFactor                           *
  ***********************************************************************/
-void FuzzyDisk::calculatePassFactor(Ogre::RaySceneQuery* query)
+void FuzzyDisk::calculatePassFactor(DiskSpace* space)
 {
    int i;
    Ball* b = Rules::getBall();
@@ -379,9 +353,13 @@ void FuzzyDisk::calculatePassFactor(Ogre::RaySceneQuery* query)
                (disk->getPosition()[0] + SEND_BALL_TO_DISK_DELTA > 
                 disks[i].disk->getPosition()[0]);
 
-         /* Also, no need to pass to itself! */
+         /* Also, no need to pass to itself! Nor to pass if other disks
+          * are at the ball way to the target. */
          if( (disks[i].disk != disk) && (!ballAheadAndDiskBehind) && 
-             (!ballBehindAndDiskAhead) )
+             (!ballBehindAndDiskAhead) &&
+             (b->hasFreeWayTo(space, disks[i].disk->getPosition().x,
+                              disks[i].disk->getPosition().z, 
+                              disks[i].disk)) )
          {
             /* Not the same, probably can pass the ball to */
 
@@ -572,8 +550,6 @@ FuzzyAI::FuzzyAI(BtSoccer::Team* t, Field* f):BaseAI(t, f)
    
    defined = true;
 
-   query = t->getSceneManager()->createRayQuery(Ogre::Ray());
-
    /* Set pointers */
    for(i=0 ; i<10; i++)
    {
@@ -591,7 +567,6 @@ FuzzyAI::FuzzyAI(BtSoccer::Team* t, Field* f):BaseAI(t, f)
  ***********************************************************************/
 FuzzyAI::~FuzzyAI()
 {
-   curTeam->getSceneManager()->destroyQuery(query);
 }
 
 /***********************************************************************
@@ -610,6 +585,7 @@ void FuzzyAI::calculateStep()
       /* Must clear, as called on a new turn */
       defined = false;
       curDisk = 0;
+      diskSpace.set(curTeam, enemy);
       for(i=0; i < totalDisks; i++)
       {
          disk[i].clear();
@@ -617,13 +593,13 @@ void FuzzyAI::calculateStep()
          disk[i].upperTeam = (curTeam == Rules::getUpperTeam());
          /* Pre-calculate each disk "nearess" on field */
          disk[i].calculateNearGoal(field);
-         disk[i].calculateBallPosition(query);
+         disk[i].calculateBallPosition(&diskSpace);
 
          enemyDisk[i].clear();
          enemyDisk[i].disk = enemy->getDisk(i);
          enemyDisk[i].upperTeam = (curTeam != Rules::getUpperTeam());
          enemyDisk[i].calculateNearGoal(field);
-         enemyDisk[i].calculateBallPosition(query);
+         enemyDisk[i].calculateBallPosition(&diskSpace);
       }
       /* Do the forced physics step */
       BulletLink::forcedStep();
@@ -636,7 +612,7 @@ void FuzzyAI::calculateStep()
    if(Rules::getRemainingTouches(disk[curDisk].disk) > 0)
    {
       /* Can act, calculate action percentuals */
-      disk[curDisk].calculateActions(query);
+      disk[curDisk].calculateActions(&diskSpace);
    } 
    else
    {
@@ -23,6 +23,7 @@
 
 #include "baseai.h"
 #include "../physics/disttable.h"
+#include "../physics/diskspace.h"
 
 namespace BtSoccer
 {
@@ -92,8 +93,9 @@ class FuzzyDisk
       void setFuzzyAI(FuzzyAI* fuzzyAI);
 
       /*! Calculate ball position
-       * \param upper -> if own team is upper team */
-      void calculateBallPosition(Ogre::RaySceneQuery* query);
+       * \param space -> players at field, to check if path to ball 
+       *                 is blocked. */
+      void calculateBallPosition(DiskSpace* space);
 
       /*! Calculate current near goal factor
        * \param field -> pointer to the current field in use
@@ -105,8 +107,9 @@ class FuzzyDisk
        * \return angle factor value */
       float calculateAngleFactor(float angle);
 
-      /*! Calculate actions percentuals */
-      void calculateActions(Ogre::RaySceneQuery* query);
+      /*! Calculate actions percentuals
+       * \param space -> players at field, for free way checks */
+      void calculateActions(DiskSpace* space);
 
       /*! Get the best action to do
        * \return int with action Id, 
@@ -120,7 +123,7 @@ class FuzzyDisk
       float angleToBall;         /**< Angle value to the ball */
       float ballDistance;        /**< Distance to ball */
       Ogre::String firstCollide; /**< element the disk will first collide
-                                      at the disk-ball ray. */
+                                      at the disk-ball way. */
       float nearGoal;            /**< The Near goal factor */
       bool upperTeam;            /**< If upper team or not */
 
@@ -138,7 +141,7 @@ class FuzzyDisk
       /*! Calculate factor for ACTION_SHOOT */
       void calculateShootFactor();
       /*! Calculate factor for ACTION_PASS */
-      void calculatePassFactor(Ogre::RaySceneQuery* query);
+      void calculatePassFactor(DiskSpace* space);
       /*! Calculate factor for ACTION_THROW_AWAY */
       void calculateThrowAwayFactor();
       /*! Calculate factor for ACTION_BLOCK */
@@ -184,7 +187,7 @@ class FuzzyAI: public BaseAI
       FuzzyDisk enemyDisk[10]; /**< Each enemy disk */
       FuzzyDisk disk[10]; /**< Each potential disk to act */
       bool defined;       /**< When things are defined */
-      Ogre::RaySceneQuery* query; /**< needed query */
+      DiskSpace diskSpace; /**< Players at field, for free way checks */
 
       int curDisk; /**< Current checking disk */
 
@@ -0,0 +1,698 @@
+/*
+  btsoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of btsoccer.
+
+  btsoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  btsoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with btsoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "searchai.h"
+
+#include "../engine/ball.h"
+#include "../engine/field.h"
+#include "../engine/goalkeeper.h"
+#include "../engine/rules.h"
+#include "../engine/team.h"
+#include "../engine/teamplayer.h"
+#include "../physics/bulletlink.h"
+#include "../physics/forceio.h"
+#include "../engine/threadlog.h"
+
+#include <sys/time.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace BtSoccer
+{
+
+/*! A SearchAI worker: a thread with its own isolated world (physics,
+ * rules, teams, ball and field) where the candidates are simulated. */
+class SearchAIWorker
+{
+   public:
+      SearchAI* ai;             /**< AI the worker belongs to */
+      pthread_t thread;         /**< Worker thread */
+      bool running;             /**< If thread is running */
+      int generation;           /**< Last search generation done */
+      PhysicsContext* physics;  /**< Worker's own bullet world */
+      RulesContext rules;       /**< Worker's own rules state */
+      Team* teamA;              /**< Worker's teamA */
+      Team* teamB;              /**< Worker's teamB */
+      Ball* ball;               /**< Worker's ball */
+      Field* field;             /**< Worker's field */
+      ForceInput force;         /**< Force calculator */
+      TurnResult result;        /**< Result of last simulated candidate */
+};
+
+/***********************************************************************
+ *                             searchRandom                            *
+ ***********************************************************************/
+static float searchRandom(unsigned int* seed)
+{
+   return rand_r(seed) / (RAND_MAX + 1.0f);
+}
+
+/***********************************************************************
+ *                              Constructor                            *
+ ***********************************************************************/
+SearchAI::SearchAI(BtSoccer::Team* t, Field* f, int threads, 
+      unsigned long budget):DecourtAI(t, f)
+{
+   this->budget = budget;
+   gameField = f;
+   totalThreads = (threads < 1) ? 1 : threads;
+   waitSlice = 0;
+   seed = 1;
+   workers = NULL;
+   searchStep = SEARCH_STEP_INITIAL;
+   delegated = false;
+   ownIsTeamA = true;
+   upperIsTeamA = true;
+   totalDisks = 0;
+   totalCandidates = 0;
+   nextCandidate = 0;
+   stopped = false;
+   activeWorkers = 0;
+   generation = 0;
+   quit = false;
+
+   pthread_mutex_init(&mutex, NULL);
+   pthread_cond_init(&searchCond, NULL);
+   pthread_cond_init(&doneCond, NULL);
+}
+
+/***********************************************************************
+ *                               Destructor                            *
+ ***********************************************************************/
+SearchAI::~SearchAI()
+{
+   deleteWorkers();
+
+   pthread_cond_destroy(&doneCond);
+   pthread_cond_destroy(&searchCond);
+   pthread_mutex_destroy(&mutex);
+}
+
+/***********************************************************************
+ *                             createWorkers                           *
+ ***********************************************************************/
+void SearchAI::createWorkers()
+{
+   int threads = totalThreads;
+
+   workers = new SearchAIWorker[threads];
+   totalThreads = 0;
+   for(int i = 0; i < threads; i++)
+   {
+      /* Keep the running ones at the first positions */
+      SearchAIWorker* worker = &workers[totalThreads];
+      worker->ai = this;
+      worker->generation = generation;
+      worker->physics = NULL;
+      worker->running = (pthread_create(&worker->thread, NULL,
+               workerProc, worker) == 0);
+      if(worker->running)
+      {
+         totalThreads++;
+      }
+      else
+      {
+         ThreadLog::getLog()->stream(Ogre::LML_CRITICAL)
+            << "Couldn't create SearchAI thread!";
+      }
+   }
+}
+
+/***********************************************************************
+ *                             deleteWorkers                           *
+ ***********************************************************************/
+void SearchAI::deleteWorkers()
+{
+   if(workers == NULL)
+   {
+      return;
+   }
+
+   /* Stop any search and tell the workers to finish */
+   pthread_mutex_lock(&mutex);
+   stopped = true;
+   quit = true;
+   pthread_cond_broadcast(&searchCond);
+   pthread_mutex_unlock(&mutex);
+
+   for(int i = 0; i < totalThreads; i++)
+   {
+      if(workers[i].running)
+      {
+         pthread_join(workers[i].thread, NULL);
+      }
+   }
+
+   delete [] workers;
+   workers = NULL;
+}
+
+/***********************************************************************
+ *                              workerProc                             *
+ ***********************************************************************/
+void* SearchAI::workerProc(void* arg)
+{
+   SearchAIWorker* worker = (SearchAIWorker*) arg;
+   SearchAI* ai = worker->ai;
+
+   /* Create the worker's isolated world: every object created from now
+    * on by this thread will live on it. */
+   worker->physics = new PhysicsContext(false);
+   worker->physics->setPlaySounds(false);
+   BulletLink::setThreadContext(worker->physics);
+   Rules::setThreadContext(&worker->rules);
+
+   worker->teamA = new Team("searchTeamA");
+   worker->teamB = new Team("searchTeamB");
+   worker->ball = new Ball();
+   /* With the same dimensions of the game field */
+   worker->field = new Field();
+   if(ai->gameField != NULL)
+   {
+      worker->field->createFieldLike(ai->gameField, true);
+   }
+   else
+   {
+      worker->field->createFieldForTestCases(true);
+   }
+   worker->physics->setPointers(worker->teamA, worker->teamB, worker->ball,
+         worker->field, false);
+
+   Rules::setTeamA(worker->teamA);
+   Rules::setTeamB(worker->teamB);
+   Rules::setBall(worker->ball);
+   Rules::setField(worker->field);
+
+   while(true)
+   {
+      /* Wait for a new search (or to finish) */
+      pthread_mutex_lock(&ai->mutex);
+      while( (!ai->quit) && (ai->generation == worker->generation) )
+      {
+         pthread_cond_wait(&ai->searchCond, &ai->mutex);
+      }
+      if(ai->quit)
+      {
+         pthread_mutex_unlock(&ai->mutex);
+         break;
+      }
+      worker->generation = ai->generation;
+      pthread_mutex_unlock(&ai->mutex);
+
+      ai->evaluateCandidates(worker);
+
+      /* Done with this search */
+      pthread_mutex_lock(&ai->mutex);
+      ai->activeWorkers--;
+      if(ai->activeWorkers == 0)
+      {
+         pthread_cond_broadcast(&ai->doneCond);
+      }
+      pthread_mutex_unlock(&ai->mutex);
+   }
+
+   /* Delete the isolated world */
+   worker->physics->setPointers(NULL, NULL, NULL, NULL, false);
+   delete worker->teamA;
+   delete worker->teamB;
+   delete worker->ball;
+   worker->field->deleteField();
+   delete worker->field;
+   BulletLink::setThreadContext(NULL);
+   Rules::setThreadContext(NULL);
+   delete worker->physics;
+
+   return NULL;
+}
+
+/***********************************************************************
+ *                          evaluateCandidates                         *
+ ***********************************************************************/
+void SearchAI::evaluateCandidates(SearchAIWorker* worker)
+{
+   float value=0.0f, dX=0.0f, dZ=0.0f;
+
+   Rules::setUpperTeam((upperIsTeamA) ? worker->teamA : worker->teamB);
+
+   while(!isStopped())
+   {
+      int i = __sync_fetch_and_add(&nextCandidate, 1);
+      if(i >= totalCandidates)
+      {
+         break;
+      }
+      SearchAICandidate& candidate = candidates[i];
+
+      /* Get the force as the shoot would do */
+      worker->force.setInitial(candidate.initialForce[0], 
+            candidate.initialForce[1]);
+      worker->force.setFinal(candidate.finalForce[0], 
+            candidate.finalForce[1]);
+      FieldObject* actor = WorldSnapshot::getObject(candidate.actor,
+            worker->teamA, worker->teamB, worker->ball);
+      if( (actor == NULL) || (!worker->force.getForce(value, dX, dZ)) )
+      {
+         continue;
+      }
+
+      /* Simulate it from the current state, and score the result */
+      snapshot.restore(worker->teamA, worker->teamB, worker->ball);
+      worker->physics->resolveTurn(actor, value*dX, value*dZ, 
+            worker->result);
+      candidate.score = scoreResult(worker, worker->result, candidate.goal);
+      candidate.evaluated = true;
+   }
+}
+
+/***********************************************************************
+ *                             scoreResult                             *
+ ***********************************************************************/
+float SearchAI::scoreResult(SearchAIWorker* worker, TurnResult& result,
+      bool& goal)
+{
+   bool isUpper = (ownIsTeamA == upperIsTeamA);
+   Team* ownTeam = (ownIsTeamA) ? worker->teamA : worker->teamB;
+   bool touched = false, foul = false, exited = false, ownGoal = false;
+   goal = false;
+
+   /* Check the rule events, in the order they happened. Note: the foul
+    * check is an approximation, as any disk of different teams colliding
+    * before our first ball touch is taken as one. */
+   int totalEvents = result.getTotalEvents();
+   for(int i = 0; i < totalEvents; i++)
+   {
+      TurnEvent* ev = result.getEvent(i);
+      switch(ev->type)
+      {
+         case TurnEvent::EVENT_BALL_COLLIDE_DISK:
+            touched |= (ev->team == ownTeam);
+         break;
+         case TurnEvent::EVENT_DISK_COLLIDE_DISK:
+            foul |= ( (!touched) && (ev->team != ev->other) );
+         break;
+         case TurnEvent::EVENT_BALL_ENTER_GOAL:
+            /* The upper team defends the upper goal */
+            if(ev->upper != isUpper)
+            {
+               goal = true;
+            }
+            else
+            {
+               ownGoal = true;
+            }
+         break;
+         case TurnEvent::EVENT_BALL_EXIT_SIDE:
+         case TurnEvent::EVENT_BALL_EXIT_BYLINE:
+            exited = true;
+         break;
+      }
+   }
+   goal &= !foul;
+
+   /* How much the ball advanced to the opponent's goal */
+   Ogre::Vector3 ballInit = snapshot.getPosition(0);
+   Ogre::Vector3 ballFinal = result.getPosition(0);
+   float dirX = (isUpper) ? -1.0f : 1.0f;
+   float score = dirX * (ballFinal.x - ballInit.x) * SEARCH_AI_SCORE_ADVANCE;
+
+   /* Who is nearer the ball for the next turn */
+   float nearest[2] = {-1.0f, -1.0f};
+   for(int t = 0; t < 2; t++)
+   {
+      int base = 1 + t * (TEAM_MAX_DISKS + 1);
+      for(int i = 0; i < totalDisks; i++)
+      {
+         Ogre::Vector3 pos = result.getPosition(base + 1 + i);
+         float dist = Ogre::Math::Sqrt(Ogre::Math::Sqr(pos.x - ballFinal.x) +
+               Ogre::Math::Sqr(pos.z - ballFinal.z));
+         if((nearest[t] < 0.0f) || (dist < nearest[t]))
+         {
+            nearest[t] = dist;
+         }
+      }
+   }
+   float own = (ownIsTeamA) ? nearest[0] : nearest[1];
+   float opponent = (ownIsTeamA) ? nearest[1] : nearest[0];
+   score += Ogre::Math::Clamp(opponent - own, -10.0f, 10.0f) * 
+            SEARCH_AI_SCORE_POSSESSION;
+
+   if(goal)
+   {
+      score += SEARCH_AI_SCORE_GOAL;
+   }
+   if(ownGoal)
+   {
+      score += SEARCH_AI_SCORE_OWN_GOAL;
+   }
+   if(foul)
+   {
+      score += SEARCH_AI_SCORE_FOUL;
+   }
+   if( (exited) && (!goal) && (!ownGoal) )
+   {
+      score += SEARCH_AI_SCORE_BALL_EXIT;
+   }
+   if(!touched)
+   {
+      score += SEARCH_AI_SCORE_NO_TOUCH;
+   }
+
+   return score;
+}
+
+/***********************************************************************
+ *                             addCandidate                            *
+ ***********************************************************************/
+void SearchAI::addCandidate(TeamPlayer* disk, Ogre::Vector2 direction,
+      float length)
+{
+   if(totalCandidates >= SEARCH_AI_MAX_CANDIDATES)
+   {
+      return;
+   }
+
+   /* The force is applied at the opposite direction of the vector */
+   Ogre::Vector3 diskPos = disk->getPosition();
+   SearchAICandidate& candidate = candidates[totalCandidates];
+   candidate.actor = WorldSnapshot::getObjectIndex(disk, Rules::getTeamA(),
+         Rules::getTeamB(), Rules::getBall());
+   candidate.initialForce = Ogre::Vector2(diskPos.x, diskPos.z);
+   candidate.finalForce = candidate.initialForce - direction * length;
+   candidate.evaluated = false;
+   candidate.goal = false;
+   candidate.score = 0.0f;
+   totalCandidates++;
+}
+
+/***********************************************************************
+ *                           createCandidates                          *
+ ***********************************************************************/
+void SearchAI::createCandidates(TeamPlayer* onlyDisk)
+{
+   Ball* ball = Rules::getBall();
+   Ogre::Vector3 ballPos = ball->getPosition();
+   Ogre::Vector2 ball2(ballPos.x, ballPos.z);
+   bool isUpper = (curTeam == Rules::getUpperTeam());
+   Ogre::Real fieldX = Rules::getField()->getHalfSize().x;
+
+   totalCandidates = 0;
+
+   if(onlyDisk != NULL)
+   {
+      /* Refine the current shoot: keep it, and try some around it */
+      Ogre::Vector2 current = initialForce - finalForce;
+      float length = current.normalise();
+      addCandidate(onlyDisk, current, length);
+      for(int s = 1; s < SEARCH_AI_GOAL_SHOOT_SAMPLES; s++)
+      {
+         Ogre::Radian angle = Ogre::Degree(
+               (searchRandom(&seed) * 2.0f - 1.0f) * 4.0f);
+         float factor = 0.85f + searchRandom(&seed) * 0.4f;
+         Ogre::Vector2 dir(
+               current.x * Ogre::Math::Cos(angle) - 
+               current.y * Ogre::Math::Sin(angle),
+               current.x * Ogre::Math::Sin(angle) + 
+               current.y * Ogre::Math::Cos(angle));
+         addCandidate(onlyDisk, dir, length * factor);
+      }
+      return;
+   }
+
+   /* Where the disk should touch the ball to send it to the goal */
+   Ogre::Vector2 goalDir((isUpper) ? -fieldX - ball2.x : fieldX - ball2.x,
+         -ball2.y);
+   goalDir.normalise();
+
+   /* Elegible disks, nearest to the ball first */
+   std::vector<TeamPlayer*> disks = curTeam->getPlayersNearestFirst(
+         ballPos.x, ballPos.z);
+   int selected = 0;
+   for(unsigned int d = 0; (d < disks.size()) && 
+                           (selected < SEARCH_AI_MAX_DISKS); d++)
+   {
+      TeamPlayer* tp = disks[d];
+      if( (curTeam->getDiskIndex(tp) >= totalDisks) ||
+          (Rules::getRemainingTouches(tp) <= 0) )
+      {
+         continue;
+      }
+      selected++;
+
+      Ogre::Vector3 pos = tp->getPosition();
+      Ogre::Vector2 diskPos(pos.x, pos.z);
+      Ogre::Vector2 contact = ball2 - goalDir * 
+         (ball->getSphereRadius() + tp->getSphereRadius());
+
+      for(int s = 0; s < SEARCH_AI_SAMPLES_PER_DISK; s++)
+      {
+         /* Half aiming the contact point to send the ball to the goal,
+          * half just aiming the ball, with a wider spread. */
+         Ogre::Vector2 target = (s % 2 == 0) ? contact : ball2;
+         float spread = (s % 2 == 0) ? 10.0f : 35.0f;
+         Ogre::Vector2 toTarget = target - diskPos;
+         float dist = toTarget.normalise();
+         float length = getLengthToSendDiskToDistance(dist) * 
+                        (0.9f + searchRandom(&seed) * 2.1f);
+         Ogre::Radian angle = Ogre::Degree(
+               (searchRandom(&seed) * 2.0f - 1.0f) * spread);
+         Ogre::Vector2 dir(
+               toTarget.x * Ogre::Math::Cos(angle) - 
+               toTarget.y * Ogre::Math::Sin(angle),
+               toTarget.x * Ogre::Math::Sin(angle) + 
+               toTarget.y * Ogre::Math::Cos(angle));
+         addCandidate(tp, dir, length);
+      }
+   }
+}
+
+/***********************************************************************
+ *                             startSearch                             *
+ ***********************************************************************/
+void SearchAI::startSearch()
+{
+   /* Define the state to search from */
+   snapshot.capture(Rules::getTeamA(), Rules::getTeamB(), Rules::getBall());
+   ownIsTeamA = (curTeam == Rules::getTeamA());
+   upperIsTeamA = (Rules::getUpperTeam() == Rules::getTeamA());
+
+   /* Wake the workers */
+   pthread_mutex_lock(&mutex);
+   nextCandidate = 0;
+   stopped = false;
+   activeWorkers = totalThreads;
+   generation++;
+   pthread_cond_broadcast(&searchCond);
+   pthread_mutex_unlock(&mutex);
+
+   searchTimer.reset();
+}
+
+/***********************************************************************
+ *                              waitSearch                             *
+ ***********************************************************************/
+bool SearchAI::waitSearch(unsigned long ms)
+{
+   pthread_mutex_lock(&mutex);
+   if( (ms > 0) && (activeWorkers > 0) )
+   {
+      struct timeval now;
+      struct timespec timeout;
+      gettimeofday(&now, NULL);
+      unsigned long long usec = (unsigned long long)now.tv_usec + 
+                                ms * 1000ULL;
+      timeout.tv_sec = now.tv_sec + (time_t)(usec / 1000000ULL);
+      timeout.tv_nsec = (long)((usec % 1000000ULL) * 1000ULL);
+      while(activeWorkers > 0)
+      {
+         if(pthread_cond_timedwait(&doneCond, &mutex, &timeout) == ETIMEDOUT)
+         {
+            break;
+         }
+      }
+   }
+   bool done = (activeWorkers == 0);
+   pthread_mutex_unlock(&mutex);
+
+   return done;
+}
+
+/***********************************************************************
+ *                              stopSearch                             *
+ ***********************************************************************/
+void SearchAI::stopSearch()
+{
+   pthread_mutex_lock(&mutex);
+   stopped = true;
+   while(activeWorkers > 0)
+   {
+      pthread_cond_wait(&doneCond, &mutex);
+   }
+   pthread_mutex_unlock(&mutex);
+}
+
+/***********************************************************************
+ *                              isStopped                              *
+ ***********************************************************************/
+bool SearchAI::isStopped()
+{
+   pthread_mutex_lock(&mutex);
+   bool stop = stopped;
+   pthread_mutex_unlock(&mutex);
+   return stop;
+}
+
+/***********************************************************************
+ *                           getBestCandidate                          *
+ ***********************************************************************/
+SearchAICandidate* SearchAI::getBestCandidate()
+{
+   SearchAICandidate* best = NULL;
+   for(int i = 0; i < totalCandidates; i++)
+   {
+      if( (candidates[i].evaluated) && 
+          ((best == NULL) || (candidates[i].score > best->score)) )
+      {
+         best = &candidates[i];
+      }
+   }
+   return best;
+}
+
+/***********************************************************************
+ *                            calculateStep                            *
+ ***********************************************************************/
+void SearchAI::calculateStep()
+{
+   switch(searchStep)
+   {
+      case SEARCH_STEP_INITIAL:
+      {
+         bool isUpper = (curTeam == Rules::getUpperTeam());
+         Ball* gameBall = Rules::getBall();
+         delegated = false;
+         totalDisks = Rules::getField()->getNumberOfDisks();
+
+         totalCandidates = 0;
+         if(!Rules::getField()->isInnerPenaltyArea(gameBall->getPosition().x,
+                  gameBall->getPosition().z, isUpper, !isUpper))
+         {
+            if(workers == NULL)
+            {
+               createWorkers();
+            }
+            if(totalThreads > 0)
+            {
+               createCandidates(NULL);
+            }
+         }
+
+         /* The direct ball acts (ball inner own area) and the cases
+          * without any candidate are left to the heuristics. */
+         if(totalCandidates == 0)
+         {
+            delegated = true;
+            searchStep = SEARCH_STEP_DELEGATED;
+            DecourtAI::calculateStep();
+            if(hasAction())
+            {
+               searchStep = SEARCH_STEP_INITIAL;
+            }
+            return;
+         }
+
+         /* Note that we do no break here, to already check the search
+          * (when allowed to wait for it). */
+         startSearch();
+         searchStep = SEARCH_STEP_SEARCHING;
+      }
+      case SEARCH_STEP_SEARCHING:
+      {
+         bool done = waitSearch(waitSlice);
+         if( (!done) && (searchTimer.getMilliseconds() >= budget) )
+         {
+            /* No more time: use the best found until now */
+            stopSearch();
+            done = true;
+         }
+         if(!done)
+         {
+            /* Still searching: check again on next call */
+            return;
+         }
+
+         SearchAICandidate* best = getBestCandidate();
+         if(best == NULL)
+         {
+            delegated = true;
+            searchStep = SEARCH_STEP_DELEGATED;
+            return;
+         }
+         
+         curTeamPlayer = (TeamPlayer*) WorldSnapshot::getObject(best->actor,
+               Rules::getTeamA(), Rules::getTeamB(), Rules::getBall());
+         initialForce = best->initialForce;
+         finalForce = best->finalForce;
+         tryGoalShoot = best->goal;
+         searchStep = SEARCH_STEP_INITIAL;
+      }
+      break;
+      case SEARCH_STEP_DELEGATED:
+      {
+         DecourtAI::calculateStep();
+         if(hasAction())
+         {
+            searchStep = SEARCH_STEP_INITIAL;
+         }
+      }
+      break;
+   }
+}
+
+/***********************************************************************
+ *                         calculateGoalShoot                          *
+ ***********************************************************************/
+void SearchAI::calculateGoalShoot()
+{
+   if( (delegated) || (curTeamPlayer == NULL) || (totalThreads == 0) )
+   {
+      DecourtAI::calculateGoalShoot();
+      return;
+   }
+
+   /* The opponent's goal keeper was positioned: search again around the
+    * selected shoot, from the new state. */
+   createCandidates(curTeamPlayer);
+   startSearch();
+   if(!waitSearch(SEARCH_AI_GOAL_SHOOT_BUDGET))
+   {
+      stopSearch();
+   }
+
+   SearchAICandidate* best = getBestCandidate();
+   if(best != NULL)
+   {
+      initialForce = best->initialForce;
+      finalForce = best->finalForce;
+   }
+}
+
+}
+
@@ -0,0 +1,212 @@
+/*
+  btsoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of btsoccer.
+
+  btsoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  btsoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with btsoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _btsoccer_search_ai_h
+#define _btsoccer_search_ai_h
+
+#include "decourtai.h"
+#include "../physics/worldsnapshot.h"
+#include "../physics/turnresult.h"
+
+#include <kobold/timer.h>
+#include <pthread.h>
+
+namespace BtSoccer
+{
+
+/*! Elegible disks (the nearest to the ball) to sample shoots for */
+#define SEARCH_AI_MAX_DISKS               4
+/*! Sampled shoots for each elegible disk */
+#define SEARCH_AI_SAMPLES_PER_DISK       48
+/*! Sampled shoots when refining a goal shoot */
+#define SEARCH_AI_GOAL_SHOOT_SAMPLES     24
+/*! Max candidates evaluated at a single search */
+#define SEARCH_AI_MAX_CANDIDATES \
+   (SEARCH_AI_MAX_DISKS * SEARCH_AI_SAMPLES_PER_DISK)
+/*! Default time budget (in ms) to select an action */
+#define SEARCH_AI_TIME_BUDGET          1500
+/*! Time budget (in ms) to refine a goal shoot, after the goal keeper
+ * is positioned (the only time the search blocks the caller) */
+#define SEARCH_AI_GOAL_SHOOT_BUDGET     250
+/*! Default number of worker threads */
+#define SEARCH_AI_DEFAULT_THREADS         2
+
+/*! Score for a goal at the opponent's goal */
+#define SEARCH_AI_SCORE_GOAL         1000.0f
+/*! Score for an own goal */
+#define SEARCH_AI_SCORE_OWN_GOAL    -1000.0f
+/*! Score for a foul (an opponent's disk touched before the ball) */
+#define SEARCH_AI_SCORE_FOUL         -300.0f
+/*! Score for the ball leaving the field */
+#define SEARCH_AI_SCORE_BALL_EXIT    -200.0f
+/*! Score for not touching the ball at all */
+#define SEARCH_AI_SCORE_NO_TOUCH     -100.0f
+/*! Score per field unit the ball advanced to the opponent's goal */
+#define SEARCH_AI_SCORE_ADVANCE         4.0f
+/*! Score per field unit own disks are nearer the ball than opponent's */
+#define SEARCH_AI_SCORE_POSSESSION      6.0f
+
+class SearchAIWorker;
+
+/*! A shoot to evaluate by the SearchAI */
+class SearchAICandidate
+{
+   public:
+      int actor;                 /**< Disk index at WorldSnapshot order */
+      Ogre::Vector2 initialForce; /**< Initial force vector position */
+      Ogre::Vector2 finalForce;   /**< Final force vector position */
+      bool evaluated;            /**< If already simulated */
+      bool goal;                 /**< If resulted on a goal */
+      float score;               /**< Score of the resulting state */
+};
+
+/*! An AI that, instead of choosing its actions by heuristics, samples
+ * lots of shoots for its elegible disks, simulating each one from a
+ * snapshot of the current world at isolated physics worlds, and selects
+ * the one resulting at the best scored state (a Monte-Carlo search of
+ * the shoot outcome).
+ * The simulations are spread over a pool of worker threads, each with
+ * its own world, while #calculateStep just polls them (thus never
+ * stalling the render loop) until all candidates are evaluated or the
+ * time budget expires.
+ * \note the positioning (free kicks and goal keeper) and the direct ball
+ *       acts are still done by the DecourtAI heuristics. */
+class SearchAI : public DecourtAI
+{
+   public:
+      /*! Constructor
+       * \param t -> team the AI will controll
+       * \param f -> current game field
+       * \param threads -> number of worker threads to use
+       * \param budget -> time budget (in ms) to select each action */
+      SearchAI(BtSoccer::Team* t, Field* f, 
+            int threads=SEARCH_AI_DEFAULT_THREADS,
+            unsigned long budget=SEARCH_AI_TIME_BUDGET);
+      /*! Destructor */
+      ~SearchAI();
+
+      /*! Refine the goal shoot, after the enemy goal keeper position
+       * is set. */
+      void calculateGoalShoot();
+
+      /*! Define the time each #calculateStep could wait for the workers
+       * before returning. Zero (default) to never wait: usually only
+       * headless simulations (that call it without any pause) should
+       * define it. */
+      void setWaitSlice(unsigned long ms) { waitSlice = ms; };
+
+   protected:
+      enum SearchAISteps
+      {
+         SEARCH_STEP_INITIAL = 0,
+         SEARCH_STEP_SEARCHING,
+         SEARCH_STEP_DELEGATED
+      };
+
+      /*! Calculate an AI step: start the search or poll it. */
+      void calculateStep();
+
+      /*! Create the candidates to evaluate
+       * \param onlyDisk if not NULL, create only for this disk, around 
+       *        the current force vectors. */
+      void createCandidates(TeamPlayer* onlyDisk);
+
+      /*! Add a candidate shoot of a disk
+       * \param disk disk to shoot
+       * \param direction normalised direction the disk should go to
+       * \param length force input vector length */
+      void addCandidate(TeamPlayer* disk, Ogre::Vector2 direction, 
+            float length);
+
+      /*! Start the search of the current candidates by the workers */
+      void startSearch();
+
+      /*! Wait the workers to finish the current search
+       * \param ms max time to wait, in ms.
+       * \return if finished */
+      bool waitSearch(unsigned long ms);
+
+      /*! Stop the current search (the workers finish their current
+       * candidate and stop), waiting them. */
+      void stopSearch();
+
+      /*! \return best evaluated candidate or NULL if none */
+      SearchAICandidate* getBestCandidate();
+
+      /*! Evaluate the current search candidates, until none remains or
+       * the search is stopped. Called by each worker thread.
+       * \param worker the calling worker */
+      void evaluateCandidates(SearchAIWorker* worker);
+
+      /*! Score the resulting state of a simulated candidate
+       * \param worker the worker that simulated it
+       * \param result the simulation result
+       * \param goal will receive if the result is a goal
+       * \return its score (greater is better) */
+      float scoreResult(SearchAIWorker* worker, TurnResult& result,
+            bool& goal);
+
+      /*! Create the worker threads */
+      void createWorkers();
+      /*! Tell the worker threads to finish, and wait them */
+      void deleteWorkers();
+
+      /*! \return if the current search should stop (guarded by the 
+       *          mutex, as called from the worker threads) */
+      bool isStopped();
+
+      /*! Worker threads entry point */
+      static void* workerProc(void* arg);
+
+   private:
+      Field* gameField;         /**< The game field (to copy) */
+      int searchStep;           /**< Current SearchAISteps */
+      bool delegated;           /**< If action is left to DecourtAI */
+      int totalThreads;         /**< Total worker threads */
+      unsigned long budget;     /**< Time budget for each action */
+      unsigned long waitSlice;  /**< Max time each step could wait */
+      unsigned int seed;        /**< Random seed for candidates */
+
+      SearchAIWorker* workers;  /**< The worker threads */
+
+      WorldSnapshot snapshot;   /**< Current world state to search from */
+      bool ownIsTeamA;          /**< If the AI team is the teamA */
+      bool upperIsTeamA;        /**< If the upper team is the teamA */
+      int totalDisks;           /**< Disks per team at the field */
+
+      SearchAICandidate candidates[SEARCH_AI_MAX_CANDIDATES];
+      int totalCandidates;      /**< Candidates to evaluate */
+      int nextCandidate;        /**< Next candidate to evaluate (atomic) */
+      bool stopped;             /**< If the search should stop (mutex) */
+      int activeWorkers;        /**< Workers still at current search */
+      int generation;           /**< Current search generation */
+      bool quit;                /**< If workers should finish */
+
+      Kobold::Timer searchTimer; /**< Time since the search started */
+
+      pthread_mutex_t mutex;     /**< Mutex for the search state */
+      pthread_cond_t searchCond; /**< Signaled when a search starts */
+      pthread_cond_t doneCond;   /**< Signaled when a search finishes */
+};
+
+}
+
+#endif
+
@@ -37,6 +37,19 @@ namespace BtSoccer
 /*! If will enable the use of AI and single player games */
 #define BTSOCCER_HAS_AI
 
+/*! If will render team disks with hardware instancing, when supported */
+#define BTSOCCER_USE_DISK_INSTANCING
+
+/*! If will negotiate the lockstep online mode: only turn inputs are sent,
+ * each side simulating them (instead of the acting side sending the 
+ * positions while simulating). */
+#define BTSOCCER_USE_NET_LOCKSTEP
+
+/*! If will put resting bodies to sleep, only simulating the ones a shot
+ * reached, and ending the turn as soon as all of them are sleeping.
+ * \note calibration contexts (DistTable) never sleep, whatever it. */
+#define BTSOCCER_USE_PHYSICS_SLEEPING
+
 /*! Constant to multiply to convert from Bullet world to Ogre world */
 #define BULLET_TO_OGRE_FACTOR 1.0f
 /*! Constant to multiply to convert from Ogre world to Bullet world */
@@ -44,6 +57,20 @@ namespace BtSoccer
 
 /*! Internal bullet frequency used */
 #define BULLET_FREQUENCY (1.0f / 320.0f)
+/*! Number of BULLET_FREQUENCY steps done at each physics frame. The
+ * simulation only advances by whole frames, thus being deterministic
+ * (independent of the rendering frame rate). */
+#define BTSOCCER_PHYSICS_STEPS_PER_FRAME  10
+/*! Duration of each physics frame, in ms */
+#define BTSOCCER_PHYSICS_FRAME_TIME \
+   (BTSOCCER_PHYSICS_STEPS_PER_FRAME * BULLET_FREQUENCY * 1000.0f)
+/*! Linear velocity bellow which a body could sleep (about the minimun
+ * one that still changes its position at a physics frame) */
+#define BTSOCCER_PHYSICS_SLEEP_LINEAR   0.03f
+/*! Angular velocity bellow which a body could sleep */
+#define BTSOCCER_PHYSICS_SLEEP_ANGULAR  0.3f
+/*! Time (in seconds) a body must be bellow the thresholds to sleep */
+#define BTSOCCER_PHYSICS_SLEEP_TIME     0.1f
 
 /***********************************************************************
  *                       Screen update related                         *
@@ -54,6 +81,10 @@ namespace BtSoccer
    #define BTSOCCER_NORMAL_FPS          30
 #endif
 #define BTSOCCER_UPDATE_RATE            (1000.0f / BTSOCCER_NORMAL_FPS)
+/*! Interval (in ms) between the intermediate position updates sent to 
+ * the other side while simulating a turn online (it interpolates between
+ * them, see InterpolationBuffer). */
+#define BTSOCCER_NET_UPDATE_INTERVAL    50
    
 /***********************************************************************
  *                        Size and Position related                    *
@@ -120,6 +151,11 @@ namespace BtSoccer
 
 /*! Time without collision to mark detected ones as new */
 #define BTSOCCER_MIN_NEW_COLLISION_TIME   50 
+/*! BTSOCCER_MIN_NEW_COLLISION_TIME as physics ticks (of BULLET_FREQUENCY),
+ * to not depend on the wall clock. */
+#define BTSOCCER_MIN_NEW_COLLISION_TICKS \
+   ((unsigned long)((BTSOCCER_MIN_NEW_COLLISION_TIME / \
+                     (BULLET_FREQUENCY * 1000.0f)) + 0.5f))
 
 /*! Minimun distance to keep between disks, to avoid some undesired "stops"
  * collisions. */
@@ -130,6 +166,7 @@ namespace BtSoccer
  ***********************************************************************/
 class Ball;
 class Collision;
+class DiskSpace;
 class Field;
 class FieldObject;
 class ForceInput;
@@ -159,12 +196,14 @@ class GuiSaves;
 
 class ReplayData;
 class Replay;
+class MatchRecord;
 
 class Stats;
 
 class Tutorial;
 
 class BulletLink;
+class PhysicsContext;
 class OgreMotionState;
 
 }
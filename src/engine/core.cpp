@@ -23,6 +23,7 @@
 
 #include "core.h"
 #include "replay.h"
+#include "matchrecord.h"
 
    //#include "../btsoccerconfig.h"
 #include "../soundfiles.h"
@@ -31,6 +32,7 @@
 #include "field.h"
 #include "team.h"
 #include "savefile.h"
+#include "soundeffects.h"
 
 #include "../ai/dummyai.h"
 #include "../ai/fuzzyai.h"
@@ -82,8 +84,11 @@ Core::Core(Goblin::CameraConfig& config)
    server = NULL;
    client = NULL;
    onlineGame = false;
+   lockstepSimulating = false;
+   lockstepResync = false;
 
    replayer = NULL;
+   matchRecord = NULL;
    guiMain = NULL;
    guiInitial = NULL;
    guiPause = NULL;
@@ -118,6 +123,10 @@ Core::~Core()
    {
       delete replayer;
    }
+   if(matchRecord)
+   {
+      delete matchRecord;
+   }
    if(btsoccerField)
    {
       btsoccerField->deleteField();
@@ -472,6 +481,7 @@ bool Core::doCycleInit(int callCount, bool& shouldAbort)
 
    /* Create and set the replayer */
    replayer = new Replay(btsoccerField);
+   matchRecord = new MatchRecord();
 
    /* Set ambient light */
    ogreSceneManager->setAmbientLight(Ogre::ColourValue(0.72f, 0.72f, 0.72f));
@@ -964,6 +974,10 @@ void Core::doAfterRender()
       }
       break;
    }
+
+   /* Play the sound effects queued at this cycle: the local collisions
+    * and the ones received from the other side. */
+   SoundEffects::flush();
 }
 
 /***********************************************************************
@@ -1089,7 +1103,9 @@ bool Core::gameCycle()
    //Uncomment to debug function hasFreeWayTo
    if((teamPlayerUnder) && (gameBall))
    {
-      teamPlayerUnder->hasFreeWayTo(ogreRaySceneQuery, 
+      BtSoccer::DiskSpace space;
+      space.set(teamA, teamB);
+      teamPlayerUnder->hasFreeWayTo(&space, 
             gameBall->getPosition().x, gameBall->getPosition().z);
       bulletDebugDraw->update();
    }
@@ -1157,17 +1173,26 @@ bool Core::gameCycle()
       if(verifyCollisions)
       {
          if( (!onlineGame) || 
-             (Rules::getActiveTeam()->isControlledByHuman()) )
+             (Rules::getActiveTeam()->isControlledByHuman()) ||
+             (lockstepSimulating) )
          {
             /* Do the bullet step */
             /* FIXME: Must set timeElapsed, and ignore subSteps! */
             BulletLink::step(timeElapsed, 10);
-            if(onlineGame)
+            if( (onlineGame) && (!protocol.isUsingLockstep()) )
             {
-               /* Must queue all updates or, if physics is stable,
-                * must queue all positions, to make sure they are ok
-                * at the other side (with ack). */
-               BulletLink::queueUpdatesToProtocol(BulletLink::isWorldStable());
+               /* Must queue all updates (at most each 
+                * BTSOCCER_NET_UPDATE_INTERVAL, as the other side 
+                * interpolates them) or, if physics is stable, must queue
+                * all positions, to make sure they are ok at the other 
+                * side (with ack). */
+               bool stable = BulletLink::isWorldStable();
+               if( (stable) || (netUpdateTimer.getMilliseconds() >= 
+                                BTSOCCER_NET_UPDATE_INTERVAL) )
+               {
+                  netUpdateTimer.reset();
+                  BulletLink::queueUpdatesToProtocol(stable);
+               }
             }
 
             //FIXME: Follow ball and gui hide/show on ONLINE mode!
@@ -1176,9 +1201,16 @@ bool Core::gameCycle()
                if( (state == BTSOCCER_STATE_NORMAL) &&
                      (!initedTurn) )
                {
+                  matchRecord->endTurn(BulletLink::getContext()->getFrames());
                   guiMain->show();
-                  verifyRulesResult();
+                  if(!lockstepSimulating)
+                  {
+                     verifyRulesResult();
+                  }
+                  /* else: the rules result will be received from the 
+                   * other side. */
                }
+               lockstepSimulating = false;
                updateClock();
                verifyCollisions = false;
                enableIO = true;
@@ -1279,17 +1311,42 @@ void Core::doOnlineOnGameActions()
    bool updatedPositions = false;
    bool manualInput = false;
    ProtocolParsedMessage msg;
-   while(protocol.getNextReceivedMessage(&msg))
+   /* Note: while simulating a received turn, the messages after it (its
+    * results) must wait for the local simulation end. */
+   while( (!lockstepSimulating) && (protocol.getNextReceivedMessage(&msg)) )
    {
       switch(msg.msgType)
       {
          case MESSAGE_UPDATE_POSITIONS:
          {
             if( (!Rules::getActiveTeam()->isControlledByHuman()) ||
-               (state == BTSOCCER_STATE_GOAL_KEEPER_POSITION) )
+               (state == BTSOCCER_STATE_GOAL_KEEPER_POSITION) ||
+               (lockstepResync) )
             {
                /* Other side is active, must set update */
-               if(msg.msgInfo == UPDATE_TYPE_BALL)
+               if( (!lockstepResync) && 
+                   ( (msg.msgInfo == UPDATE_TYPE_BALL) ||
+                     (msg.msgInfo == UPDATE_TYPE_TEAM_A) ||
+                     (msg.msgInfo == UPDATE_TYPE_TEAM_B) ) )
+               {
+                  /* Physics defined: render it interpolated */
+                  FieldObject* obj = matchRecord->getObject(msg.msgInfo,
+                        msg.msgAditionalInfo);
+                  if(obj != NULL)
+                  {
+                     if(msg.hasSenderTime)
+                     {
+                        remotePositions.push(obj, msg.position, 
+                              msg.angles, msg.senderTime);
+                     }
+                     else
+                     {
+                        remotePositions.push(obj, msg.position, 
+                              msg.angles);
+                     }
+                  }
+               }
+               else if(msg.msgInfo == UPDATE_TYPE_BALL)
                {
                   /* Update ball position */
                   gameBall->setOrientation(msg.angles);
@@ -1319,6 +1376,12 @@ void Core::doOnlineOnGameActions()
          break;
          case MESSAGE_RULES_RESULT:
          {
+            /* Received positions are final: no more interpolation */
+            if(remotePositions.flush())
+            {
+               updatedPositions = true;
+               manualInput = false;
+            }
             /* Set the rules and do changes according to it. */
             Rules::set(msg);
             Rules::showStateMessage();
@@ -1328,6 +1391,26 @@ void Core::doOnlineOnGameActions()
             enableIO = true;
          }
          break;
+         case MESSAGE_TURN_INPUT:
+         {
+            doLockstepTurnInput(msg);
+         }
+         break;
+         case MESSAGE_TURN_HASH:
+         {
+            verifyLockstepHash(msg);
+         }
+         break;
+         case MESSAGE_RESYNC_REQUEST:
+         {
+            /* Other side differs from us: send all positions, followed
+             * by the hash for it to check again. */
+            Ogre::LogManager::getSingleton().stream(Ogre::LML_NORMAL)
+               << "Lockstep: resync requested at turn " << msg.turn;
+            BulletLink::queueUpdatesToProtocol(true);
+            protocol.queueTurnHash(msg.turn, matchRecord->getStateHash());
+         }
+         break;
          case MESSAGE_GOAL:
          {
             /* A goal happened. Must set score. */
@@ -1362,7 +1445,7 @@ void Core::doOnlineOnGameActions()
          break;
          case MESSAGE_PLAY_SOUND:
          {
-            Ogre::String soundFile;
+            const char* soundFile;
             
             if(msg.msgInfo == SOUND_TYPE_DISK_ACT)
             {
@@ -1373,10 +1456,9 @@ void Core::doOnlineOnGameActions()
                soundFile = BTSOCCER_SOUND_DISK_COLLISION;
             }
             
-            /* Play a collision sound */
-            Kosound::Sound::addSoundEffect(msg.position.x,
-                  msg.position.y, msg.position.z, SOUND_NO_LOOP, soundFile,
-                  new Kobold::OgreFileReader());
+            /* Play it with the local ones (a burst of collisions could
+             * be received at once) */
+            SoundEffects::queue(soundFile, msg.position);
          }
          break;
          case MESSAGE_PAUSE:
@@ -1393,6 +1475,11 @@ void Core::doOnlineOnGameActions()
          break;
          case MESSAGE_END_HALF:
          {
+            if(remotePositions.flush())
+            {
+               updatedPositions = true;
+               manualInput = false;
+            }
             /* Received Time Over */
             Stats::show();
             guiMain->hide();
@@ -1419,6 +1506,11 @@ void Core::doOnlineOnGameActions()
          break;
       }
    }
+   if(remotePositions.update())
+   {
+      updatedPositions = true;
+      manualInput = false;
+   }
    if(updatedPositions)
    {
       BulletLink::forcedStep();
@@ -1467,6 +1559,116 @@ void Core::doOnlineOnGameActions()
    }
 }
 
+/********************************************************************
+ *                      queueLockstepTurnInput                      *
+ ********************************************************************/
+void Core::queueLockstepTurnInput(FieldObject* actor, float forceX,
+      float forceZ)
+{
+   if( (!onlineGame) || (!protocol.isUsingLockstep()) )
+   {
+      return;
+   }
+
+   int updateType = UPDATE_TYPE_BALL;
+   int diskNumber = 0;
+   if(actor != gameBall)
+   {
+      TeamPlayer* tp = (TeamPlayer*)actor;
+      updateType = (tp->getTeam() == teamA) ? UPDATE_TYPE_TEAM_A : 
+                                              UPDATE_TYPE_TEAM_B;
+      diskNumber = tp->getTeam()->getDiskIndex(tp);
+      if(diskNumber < 0)
+      {
+         diskNumber = UPDATE_GK_INDEX;
+      }
+   }
+
+   /* The turn was just recorded, thus its number is the last one. */
+   protocol.queueTurnInput(matchRecord->getTotalTurns() - 1, updateType,
+         diskNumber, forceX, forceZ);
+}
+
+/********************************************************************
+ *                       doLockstepTurnInput                        *
+ ********************************************************************/
+void Core::doLockstepTurnInput(ProtocolParsedMessage& msg)
+{
+   FieldObject* actor = matchRecord->getObject(msg.msgInfo, 
+         msg.msgAditionalInfo);
+   if(actor == NULL)
+   {
+      Ogre::LogManager::getSingleton().stream(Ogre::LML_CRITICAL)
+         << "Lockstep: received input for unknown object " 
+         << (int)msg.msgInfo << ":" << (int)msg.msgAditionalInfo;
+      return;
+   }
+   if(msg.turn != (matchRecord->getTotalTurns() & 0xFFFF))
+   {
+      Ogre::LogManager::getSingleton().stream(Ogre::LML_NORMAL)
+         << "Lockstep: received turn " << msg.turn << " but expected "
+         << matchRecord->getTotalTurns();
+   }
+
+   /* Do the same as the other side did at its doTheShoot */
+   Rules::clearFlags();
+   matchRecord->recordTurn(actor, msg.position.x, msg.position.z);
+   actor->applyForce(msg.position.x, 0.0f, msg.position.z);
+   if(actor == gameBall)
+   {
+      Rules::ballCollideDisk(Rules::getActiveTeam());
+   }
+   else
+   {
+      Ogre::Vector3 actorPos = actor->getPosition();
+      Kosound::Sound::addSoundEffect(actorPos.x, 0, actorPos.z,
+            SOUND_NO_LOOP, BTSOCCER_SOUND_DISK_SHOOT, 
+            new Kobold::OgreFileReader());
+   }
+
+   /* Simulate it locally */
+   initedTurn = false;
+   verifyCollisions = true;
+   lockstepSimulating = true;
+   replayer->updateData();
+}
+
+/********************************************************************
+ *                        verifyLockstepHash                        *
+ ********************************************************************/
+void Core::verifyLockstepHash(ProtocolParsedMessage& msg)
+{
+   if(msg.hash == matchRecord->getStateHash())
+   {
+      if(lockstepResync)
+      {
+         /* Got all positions: back in sync */
+         lockstepResync = false;
+         enableIO = true;
+      }
+      return;
+   }
+
+   if(lockstepResync)
+   {
+      /* Even after receiving all positions, something (usually below
+       * the positions quantization) differs. Nothing more to do. */
+      Ogre::LogManager::getSingleton().stream(Ogre::LML_NORMAL)
+         << "Lockstep: world state still differs after resync at turn "
+         << msg.turn;
+      lockstepResync = false;
+      enableIO = true;
+      return;
+   }
+
+   Ogre::LogManager::getSingleton().stream(Ogre::LML_NORMAL)
+      << "Lockstep: world state differs at turn " << msg.turn 
+      << ". Requesting resync.";
+   lockstepResync = true;
+   enableIO = false;
+   protocol.queueResyncRequest(msg.turn);
+}
+
 /********************************************************************
  *                        normalGameIO                              *
  ********************************************************************/
@@ -1954,13 +2156,15 @@ bool Core::doTheShoot()
       if(selectedPlayer != NULL)
       {
          /* Act with disk */
+         matchRecord->recordTurn(selectedPlayer, value*dX, value*dZ);
+         queueLockstepTurnInput(selectedPlayer, value*dX, value*dZ);
          selectedPlayer->applyForce(value*dX, 0.0f, value*dZ);
          /* init a contact sound */
          Ogre::Vector3 playerPos = selectedPlayer->getPosition();
          Kosound::Sound::addSoundEffect(playerPos.x, 0, playerPos.z,
                SOUND_NO_LOOP, BTSOCCER_SOUND_DISK_SHOOT, 
                new Kobold::OgreFileReader());
-         if(onlineGame)
+         if( (onlineGame) && (!protocol.isUsingLockstep()) )
          {
             protocol.queueSoundEffect(SOUND_TYPE_DISK_ACT, playerPos);
          }
@@ -1969,6 +2173,8 @@ bool Core::doTheShoot()
       {
          /* Act with ball */
          value /= BTSOCCER_BALL_FORCE_DIVIDER;
+         matchRecord->recordTurn(gameBall, value*dX, value*dZ);
+         queueLockstepTurnInput(gameBall, value*dX, value*dZ);
          gameBall->applyForce(value*dX, 0.0f, value*dZ);
          /* And emulate to rules as a team disk collided with it */
          Rules::ballCollideDisk(Rules::getActiveTeam());
@@ -2104,6 +2310,10 @@ void Core::defineCamera()
  *********************************************************************/
 void Core::verifyRulesResult(bool stateAlreadySet)
 {
+   bool lockstep = (onlineGame) && (protocol.isUsingLockstep());
+   /* At lockstep, positions aren't received, but defined by each side */
+   bool definePositions = (!stateAlreadySet) || (lockstep);
+
    if(!stateAlreadySet)
    {
       /* Verify Rules Result  */
@@ -2117,7 +2327,7 @@ void Core::verifyRulesResult(bool stateAlreadySet)
          /* A goal happened, so call the goal sound effect */
          Kosound::Sound::addSoundEffect(SOUND_NO_LOOP, BTSOCCER_SOUND_GOAL,
                new Kobold::OgreFileReader());
-         if(!stateAlreadySet)
+         if(definePositions)
          {
             /* and reset the teams and put ball at middle */
             Rules::setPositions();
@@ -2154,11 +2364,14 @@ void Core::verifyRulesResult(bool stateAlreadySet)
       case Rules::STATE_FREE_KICK:
       case Rules::STATE_PENALTY_KICK:
       {
-         if(!stateAlreadySet)
+         if(definePositions)
          {
             /* Remove disks from penalty areas */
             coldet.removeFromPenaltyAreas();
-            BulletLink::queueUpdatesToProtocol(true);
+            if(!lockstep)
+            {
+               BulletLink::queueUpdatesToProtocol(true);
+            }
          }
       }
       case Rules::STATE_CORNER_KICK:
@@ -2168,13 +2381,17 @@ void Core::verifyRulesResult(bool stateAlreadySet)
          Kosound::Sound::addSoundEffect(SOUND_NO_LOOP, BTSOCCER_SOUND_SIFF,
                new Kobold::OgreFileReader());
          
-         if(!stateAlreadySet)
+         if(definePositions)
          {
             /* Set The Position */
             Rules::setPositions();
 
             /* Remove all contacts, isolating the ball */
-            coldet.removeContacts(true, btsoccerField);
+            if(!coldet.removeContacts(true, btsoccerField))
+            {
+               Ogre::LogManager::getSingleton().stream(Ogre::LML_CRITICAL)
+                  << "Warning: couldn't remove all contacts!";
+            }
             //FIXME: contact with disk and goal keeper.
             //FIXME: remove disks from area when ball owner changed or a 
             //free-kick happened.
@@ -2196,10 +2413,14 @@ void Core::verifyRulesResult(bool stateAlreadySet)
       case Rules::STATE_NORMAL:
       default:
       {
-         if(!stateAlreadySet)
+         if(definePositions)
          {
             /* Remove all contacts */
-            coldet.removeContacts(false, btsoccerField);
+            if(!coldet.removeContacts(false, btsoccerField))
+            {
+               Ogre::LogManager::getSingleton().stream(Ogre::LML_CRITICAL)
+                  << "Warning: couldn't remove all contacts!";
+            }
             /* Change the camera if ball owner changed,
              * or set the camera if the ball isn't visible! */
             Rules::setPositions();
@@ -2222,12 +2443,24 @@ void Core::verifyRulesResult(bool stateAlreadySet)
    /* Only need to send to other side, if the rules were verified here. */
    if(!stateAlreadySet)
    {
-      /* Send all team and ball positions, to make sure both connection
-       * sides are equal. */
-      BulletLink::queueUpdatesToProtocol(true);
-      /* Send the rules result */
-      protocol.queueRulesResult(Rules::getState(), 
-            (Rules::getActiveTeam() == teamA));
+      if(lockstep)
+      {
+         /* Send the rules result, followed by the hash of the world, 
+          * to the other side verify it is equal to its one. */
+         protocol.queueRulesResult(Rules::getState(), 
+               (Rules::getActiveTeam() == teamA));
+         protocol.queueTurnHash(matchRecord->getTotalTurns(), 
+               matchRecord->getStateHash());
+      }
+      else
+      {
+         /* Send all team and ball positions, to make sure both 
+          * connection sides are equal. */
+         BulletLink::queueUpdatesToProtocol(true);
+         /* Send the rules result */
+         protocol.queueRulesResult(Rules::getState(), 
+               (Rules::getActiveTeam() == teamA));
+      }
    }
 }
 
@@ -2242,6 +2475,9 @@ void Core::newMatch()
       case 0:
       {
          guiInitial->setLoadingPercentual(0.20f);
+         lockstepSimulating = false;
+         lockstepResync = false;
+         remotePositions.clear();
          /*! Delete things, if any */
          if(teamA)
          {
@@ -2448,6 +2684,8 @@ void Core::setPointers()
    replayer->setTeamA(teamA);
    replayer->setTeamB(teamB);
    replayer->setBall(gameBall);
+   matchRecord->clear();
+   matchRecord->setObjects(teamA, teamB, gameBall);
 
    selectedPlayer = NULL;
    teamPlayerUnder = NULL;
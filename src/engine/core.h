@@ -45,6 +45,7 @@
 #include "stats.h"
 #include "teams.h"
 #include "tutorial.h"
+#include "interpolation.h"
 #include "../ai/baseai.h"
 #include "../physics/bulletlink.h"
 #include "../debug/bulletdebugdraw.h"
@@ -91,6 +92,9 @@ class Core : public Goblin::BaseApp
    
       /*! Get the current ball */
       BtSoccer::Ball* getBall(){return(gameBall);};
+
+      /*! Get the event-sourced record of current match turns */
+      BtSoccer::MatchRecord* getMatchRecord(){return(matchRecord);};
    
 #if KOBOLD_PLATFORM == KOBOLD_PLATFORM_IOS
       /*! Tell the application that will play a game accepted 
@@ -211,6 +215,19 @@ class Core : public Goblin::BaseApp
       /*! Do all the online on-game related actions (receiveing and 
        * treating messages). */
       void doOnlineOnGameActions();
+      /*! Queue the input of the turn to the other side, if at lockstep
+       * online mode. Must be called after the turn was recorded.
+       * \param actor object which received the force
+       * \param forceX x component of the applied force
+       * \param forceZ z component of the applied force */
+      void queueLockstepTurnInput(FieldObject* actor, float forceX, 
+            float forceZ);
+      /*! Apply a turn input received from the other side, starting its
+       * local simulation (lockstep online mode). */
+      void doLockstepTurnInput(ProtocolParsedMessage& msg);
+      /*! Verify the received world state hash against the local one,
+       * requesting all positions if they differ (lockstep online mode). */
+      void verifyLockstepHash(ProtocolParsedMessage& msg);
    
       /*! End online client or server, if any. */
       void endOnline();
@@ -263,6 +280,7 @@ class Core : public Goblin::BaseApp
       BtSoccer::Tutorial* tutorial;          /**< Tutorial controller */
 
       BtSoccer::Replay* replayer;            /**< The Replayer */
+      BtSoccer::MatchRecord* matchRecord;    /**< Turns of the match */
 
       BulletDebugDraw* bulletDebugDraw;      /**< Debug draw for physics */
    
@@ -276,6 +294,14 @@ class Core : public Goblin::BaseApp
       BtSoccer::TcpClient* client;     /**< If online, acting as client. */
       BtSoccer::Protocol protocol;     /**< Online communication protocol. */
       bool onlineGame;                 /**< If doing an online game or not */
+      bool lockstepSimulating; /**< If simulating a turn received as input,
+                                    waiting its end to treat messages */
+      bool lockstepResync;     /**< If waiting all positions after the 
+                                    local world state differed */
+      /*! Positions received while the other side simulates a turn */
+      BtSoccer::InterpolationBuffer remotePositions;
+      /*! Time since last intermediate positions sent */
+      Kobold::Timer netUpdateTimer;
 };
 
 };
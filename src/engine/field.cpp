@@ -238,6 +238,28 @@ void Field::createFieldForTestCases(bool createSideShapes)
    goals = new Goals(this);
 }
 
+/*********************************************************************
+ *                          createFieldLike                          *
+ *********************************************************************/
+void Field::createFieldLike(Field* model, bool createSideShapes)
+{
+   /* Same dimensions of the model field */
+   scale = model->scale;
+   halfSize = model->halfSize;
+   goalPosition = model->goalPosition;
+   sideDelta = model->sideDelta;
+   border = model->border;
+   borderDelta = model->borderDelta;
+   littleAreaDelta = model->littleAreaDelta;
+   penaltyAreaDelta = model->penaltyAreaDelta;
+   penaltyMark = model->penaltyMark;
+   numberOfDisks = model->numberOfDisks;
+
+   /* define the shapes (without models) */
+   createCollisionShapes(createSideShapes);
+   goals = new Goals(this);
+}
+
 /*********************************************************************
  *                     createCollisionShapes                         *
  *********************************************************************/
@@ -254,7 +276,7 @@ void Field::createCollisionShapes(bool createSideShapes)
    groundRigidBody->setFriction(FIELD_FRICTION);
    groundRigidBody->setRollingFriction(FIELD_ROLLING_FRICTION);
    groundRigidBody->setSpinningFriction(FIELD_SPINNING_FRICTION);
-   BulletLink::addRigidBody(groundRigidBody);
+   BulletLink::addRigidBody(groundRigidBody, PHYSICS_GROUP_FIELD);
 
    if(!createSideShapes)
    {
@@ -282,7 +304,7 @@ void Field::createCollisionShapes(bool createSideShapes)
       sideRigidBody[i]->setRestitution(0.5f);
       sideRigidBody[i]->setFriction(0.2f);
       sideRigidBody[i]->setRollingFriction(0.2f);
-      BulletLink::addRigidBody(sideRigidBody[i]);
+      BulletLink::addRigidBody(sideRigidBody[i], PHYSICS_GROUP_FIELD);
       /* Redefine for next two sides */
       if(i==1)
       {
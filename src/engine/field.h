@@ -59,6 +59,14 @@ class Field
        *                            the field ground (floor). */
       void createFieldForTestCases(bool createSideShapes);
 
+      /*! Create a field with the same dimensions of another one, but 
+       * without any graphical element (usually for isolated simulation
+       * worlds of the current game).
+       * \param model -> field to copy the dimensions from
+       * \param createSideShapes -> if will create field borders, or just
+       *                            the field ground (floor). */
+      void createFieldLike(Field* model, bool createSideShapes);
+
       /*! Delete the created field */
       void deleteField();
    
@@ -21,6 +21,7 @@
 #include "fobject.h"
 #include "ball.h"
 #include "../physics/bulletlink.h"
+#include "../physics/diskspace.h"
 #include "../physics/ogremotionstate.h"
 using namespace BtSoccer;
 
@@ -33,14 +34,15 @@ FieldObject::FieldObject(int fType, Ogre::String name, Ogre::String fileName,
       Ogre::SceneManager* ogreSceneManager, Ogre::Real scale,
       Ogre::Real objMass, Ogre::Real colRestitution, 
       Ogre::Real objFriction, Ogre::Real objRollingFriction,
-      BulletDebugDraw* debugDraw)
+      BulletDebugDraw* debugDraw, Ogre::InstanceManager* instanceManager,
+      Ogre::String instancedMaterial)
 {
    Ogre::Vector3 diff;
    this->debugDraw = debugDraw;
    type = fType;
    pSceneManager = ogreSceneManager;
    mName = name;
-   lastCollision.reset();
+   lastCollisionTick = 0;
    floorPosition = UNDEFINED_POS;
    mass = objMass;
    restitution = colRestitution;
@@ -52,16 +54,31 @@ FieldObject::FieldObject(int fType, Ogre::String name, Ogre::String fileName,
    if(pSceneManager)
    {
       /* Get Model */
-      model = ogreSceneManager->createEntity(name, fileName, "game");
-      model->setRenderQueueGroup(Ogre::RENDER_QUEUE_MAIN);
+      Ogre::MovableObject* visible;
+      if(instanceManager)
+      {
+         /* Rendered by the instance manager batch. Its transform will
+          * be taken from the scene node, defined by our motion state. */
+         model = NULL;
+         instancedModel = instanceManager->createInstancedEntity(
+               instancedMaterial);
+         visible = instancedModel;
+      }
+      else
+      {
+         model = ogreSceneManager->createEntity(name, fileName, "game");
+         model->setRenderQueueGroup(Ogre::RENDER_QUEUE_MAIN);
+         instancedModel = NULL;
+         visible = model;
+      }
       /* Add it to the scene */
       sceneNode = ogreSceneManager->getRootSceneNode()->createChildSceneNode();
-      sceneNode->attachObject(model);
+      sceneNode->attachObject(visible);
       /* Set its scale */
       sceneNode->setScale(scale, scale, scale);
 
       /* Set sphere radius */
-      Ogre::AxisAlignedBox box = model->getBoundingBox();
+      Ogre::AxisAlignedBox box = visible->getBoundingBox();
       box.scale(Ogre::Vector3(scale, scale, scale));
       diff = box.getMaximum() - box.getMinimum();
       (diff[0] > diff[2])?setSphere(diff[0]/2.0f):setSphere(diff[2]/2.0f);
@@ -71,6 +88,7 @@ FieldObject::FieldObject(int fType, Ogre::String name, Ogre::String fileName,
    else
    {
       model = NULL;
+      instancedModel = NULL;
       sceneNode = NULL;
    }
 
@@ -87,12 +105,11 @@ FieldObject::FieldObject(int fType, Ogre::String name, Ogre::String fileName,
          if(floorPosition == UNDEFINED_POS)
          {
             /* Should only happen on unit tests */
-            floorPosition = 0.11f;
+            floorPosition = FOBJECT_BALL_RADIUS;
          }
          /* Ball radius is equal to half Y wich is floorPosition. */
          collisionShape = new btSphereShape(floorPosition * 
                                             OGRE_TO_BULLET_FACTOR);
-         //Actual ball radius is 0.11f in ogre units.
       }
       break;
       case TYPE_DISK:
@@ -100,8 +117,8 @@ FieldObject::FieldObject(int fType, Ogre::String name, Ogre::String fileName,
       {
          if(floorPosition == UNDEFINED_POS)
          {
-            floorPosition = 0.10335f;
-            height = 0.171f;
+            floorPosition = FOBJECT_DISK_FLOOR_POSITION;
+            height = FOBJECT_DISK_HEIGHT;
          }
          /* The disk is a compound shape of a cylinder and a "hat" cone. */
          btTransform transform;
@@ -110,8 +127,8 @@ FieldObject::FieldObject(int fType, Ogre::String name, Ogre::String fileName,
 
          float segY = 0.024f; // Y coordinate where ends the cylinder shape.
 
-         collisionShape = new btCylinderShape(btVector3(0.6f, segY, 0.6f)
-               * OGRE_TO_BULLET_FACTOR);
+         collisionShape = new btCylinderShape(btVector3(FOBJECT_DISK_RADIUS,
+                  segY, FOBJECT_DISK_RADIUS) * OGRE_TO_BULLET_FACTOR);
          transform.setIdentity();
          transform.setOrigin(btVector3(0.0f, -floorPosition + segY, 0.0f)
                * OGRE_TO_BULLET_FACTOR);
@@ -122,7 +139,8 @@ FieldObject::FieldObject(int fType, Ogre::String name, Ogre::String fileName,
          transform.setOrigin(btVector3(0.0f, 
                   (coneHeight / 2.0f) + (2 * segY) - floorPosition, 0.0f)
                * OGRE_TO_BULLET_FACTOR);
-         collisionShape = new btConeShape(0.6f * OGRE_TO_BULLET_FACTOR, 
+         collisionShape = new btConeShape(
+               FOBJECT_DISK_RADIUS * OGRE_TO_BULLET_FACTOR, 
                (coneHeight) * OGRE_TO_BULLET_FACTOR);
          compoundShape->addChildShape(transform, collisionShape);
          
@@ -134,9 +152,10 @@ FieldObject::FieldObject(int fType, Ogre::String name, Ogre::String fileName,
       {
          if(floorPosition == UNDEFINED_POS)
          {
-            floorPosition = 0.43055f;
+            floorPosition = FOBJECT_GK_FLOOR_POSITION;
          }
-         collisionShape = new btBoxShape(btVector3(1.0f, 0.435f, 0.145f)
+         collisionShape = new btBoxShape(btVector3(FOBJECT_GK_HALF_WIDTH,
+                  FOBJECT_GK_HALF_HEIGHT, FOBJECT_GK_HALF_DEPTH)
                * OGRE_TO_BULLET_FACTOR);
       }
       break;
@@ -145,6 +164,27 @@ FieldObject::FieldObject(int fType, Ogre::String name, Ogre::String fileName,
          collisionShape = new btSphereShape(0.05f);
       }
    }
+   if(!pSceneManager)
+   {
+      /* Without model, define the bounding sphere by the physical shape */
+      switch(type)
+      {
+         case TYPE_BALL:
+         case TYPE_BALL_AI:
+            setSphere(floorPosition);
+         break;
+         case TYPE_DISK:
+         case TYPE_DISK_AI:
+            setSphere(FOBJECT_DISK_RADIUS);
+         break;
+         case TYPE_GOAL_KEEPER:
+         case TYPE_GOAL_KEEPER_AI:
+            /* Enclose the box's extent on the XZ plane */
+            setSphere(sqrt(FOBJECT_GK_HALF_WIDTH * FOBJECT_GK_HALF_WIDTH +
+                     FOBJECT_GK_HALF_DEPTH * FOBJECT_GK_HALF_DEPTH));
+         break;
+      }
+   }
    collisionShape->calculateLocalInertia(mass, inertia);
    collisionShape->setUserPointer(this);
 
@@ -161,7 +201,8 @@ FieldObject::FieldObject(int fType, Ogre::String name, Ogre::String fileName,
    rigidBody->setRestitution(restitution);
    //rigidBody->setContactProcessingThreshold(1.0f);
 
-   BulletLink::addRigidBody(rigidBody);
+   physics = BulletLink::getContext();
+   physics->addRigidBody(rigidBody, PhysicsContext::getCollisionGroup(type));
 
    /* Default values */
    orientation = 0;
@@ -177,13 +218,21 @@ FieldObject::~FieldObject()
    if(pSceneManager)
    {
       /* Unload things */
-      sceneNode->detachObject(model);
+      if(instancedModel)
+      {
+         sceneNode->detachObject(instancedModel);
+         pSceneManager->destroyInstancedEntity(instancedModel);
+      }
+      else
+      {
+         sceneNode->detachObject(model);
+         pSceneManager->destroyEntity(model);
+      }
       pSceneManager->destroySceneNode(sceneNode);
-      pSceneManager->destroyEntity(model);
    }
    
    /* Delete bullet related things */
-   BulletLink::removeRigidBody(rigidBody);
+   physics->removeRigidBody(rigidBody);
    delete rigidBody;
    if( (type == TYPE_DISK) || (type == TYPE_DISK_AI) )
    {
@@ -231,8 +280,11 @@ void FieldObject::setPositionAsReplay(Ogre::Vector3& pos,
                                       Ogre::Quaternion& angles)
 {
    /* Only set the scene node for replay render */
-   sceneNode->setPosition(pos);
-   applyAngles(angles);
+   if(sceneNode)
+   {
+      sceneNode->setPosition(pos);
+      applyAngles(angles);
+   }
 }
 
 /***********************************************************************
@@ -273,6 +325,8 @@ void FieldObject::setPositionWithoutForcedPhysicsStep(Ogre::Vector3 pos)
    btTransform transform = rigidBody->getCenterOfMassTransform();
    transform.setOrigin(btVector3(pos.x,pos.y,pos.z) * OGRE_TO_BULLET_FACTOR);
    rigidBody->setCenterOfMassTransform(transform);
+   /* Wake it, to settle at the new position */
+   rigidBody->activate(true);
    
    /* Set model */
    if(sceneNode)
@@ -290,8 +344,15 @@ void FieldObject::setPosition(Ogre::Vector3 pos)
    /* Set the position */
    setPositionWithoutForcedPhysicsStep(pos);
 
+   if(physics->isPlacing())
+   {
+      /* Will be settled at the end of the placement batch */
+      physics->addPlacedObject(this);
+      return;
+   }
+
    /* Do the forced step */
-   BulletLink::forcedStep();
+   physics->forcedStep();
    motionState->clearMovedFlag();
 }
 
@@ -359,113 +420,26 @@ Ogre::Real FieldObject::getLastCalculatedDistance()
 /***********************************************************************
  *                             hasFreeWayTo                            *
  ***********************************************************************/
-bool FieldObject::hasFreeWayTo(Ogre::RaySceneQuery* query, 
-      Ogre::Real x, Ogre::Real z)
-{
-   /* To have free way to a point, the object's sphere representation
-    * (as this function is usually called for disks and ball), must have
-    * no colliders to other disks from 3 rays: the one from origin to point,
-    * and both two from perpendicular sphere limits to point relative
-    * position with same direction (as if we propagated all the circle
-    * projection from sphere from current position to target one). */
-
-   /* Calculate distance to target */
-   Ogre::Vector2 delta = Ogre::Vector2(x - getPosition().x,
-                                       z - getPosition().z);
-   Ogre::Real distance = Ogre::Math::Sqrt(delta[0]*delta[0] + 
-                                          delta[1]*delta[1] );
-   /* As will 'hit' the target whith its extremety, the distance
-    * must be decremented by the field object's radius */
-   distance -= getSphereRadius();
-
-   Ogre::Vector3 origin(getPosition().x, 0.0f, getPosition().z);
-
-   /* First check: no potential collider from origin to target. */
-   Ogre::Vector3 dir(delta[0], 0.0f, delta[1]);
-   dir.normalise();
-
-   query->setRay(Ogre::Ray(origin, dir));
-   query->setSortByDistance(true);
-#if BTSOCCER_RENDER_DEBUG
-   debugDraw->drawRay(origin, dir, distance, Ogre::Vector3(0.0f, 0.0f, 1.0f));
-#endif
-   if(!checkNoColliders(query, distance))
-   {
-      /* Collided. */
-      return false;
-   }
-
-   /* Being (xh,zh) the point at object's circle along direction to target,
-    * the two points to check are rotated along circle's origin by 90 and -90
-    * degrees. */
-    Ogre::Vector3 perpDir(-dir[2], 0.0f, dir[0]);
-    Ogre::Vector3 newOrigin = perpDir * getSphereRadius() + origin;
-
-    query->setRay(Ogre::Ray(newOrigin, dir));
-    query->setSortByDistance(true);
-#if BTSOCCER_RENDER_DEBUG
-   debugDraw->drawRay(newOrigin, dir, distance, 
-         Ogre::Vector3(0.0f, 1.0f, 1.0f));
-#endif
-    if(!checkNoColliders(query, distance))
-    {
-       return false;
-    }
-
-    /* Second perpendicular vector */
-    perpDir = Ogre::Vector3(dir[2], 0.0f, -dir[0]);
-    newOrigin = perpDir * getSphereRadius() + origin;
-    query->setRay(Ogre::Ray(newOrigin, dir));
-    query->setSortByDistance(true);
-#if BTSOCCER_RENDER_DEBUG
-   debugDraw->drawRay(newOrigin, dir, distance, 
-         Ogre::Vector3(1.0f, 0.0f, 1.0f));
-#endif
-    if(!checkNoColliders(query, distance))
-    {
-       return false;
-    }
-
-   return true;
-}
-
-/***********************************************************************
- *                           checkNoColliders                          *
- ***********************************************************************/
-bool FieldObject::checkNoColliders(Ogre::RaySceneQuery* query, 
-      Ogre::Real targetDistance)
+bool FieldObject::hasFreeWayTo(DiskSpace* space, Ogre::Real x, Ogre::Real z,
+      FieldObject* ignore)
 {
-   Ogre::RaySceneQueryResult &result = query->execute();
-   Ogre::RaySceneQueryResult::iterator itr;
+   /* To have free way to a point, the object's circle representation
+    * (as this function is usually called for disks and ball), swept 
+    * from current position to the point, must not touch other disks. */
+   Ogre::Vector3 pos = getPosition();
 
-   bool done = false;
-   for( itr = result.begin(); ((itr != result.end()) && (!done)); itr++ )
+#if BTSOCCER_RENDER_DEBUG
+   if(debugDraw)
    {
-      if(itr->movable)
-      {
-         if( (itr->movable->getName() != BALL_NAME) && 
-             (itr->movable->getName() != getName()) )
-         {
-            if(itr->distance > targetDistance)
-            {
-               /* Collider is after target, so no need to continue the 
-                * the query here (as sorted by distance), and no colliders
-                * to target found. */
-               break;
-            }
-            else
-            {
-               /* Not a ball neither itself and before target position:
-                *  a collider was found. */
-               printf("%s will collide with %s\n", getName().c_str(),
-                      itr->movable->getName().c_str());
-               return false;
-            }
-         }
-      }
+      Ogre::Vector3 dir(x - pos.x, 0.0f, z - pos.z);
+      Ogre::Real distance = dir.normalise() - getSphereRadius();
+      debugDraw->drawRay(Ogre::Vector3(pos.x, 0.0f, pos.z), dir, distance, 
+            Ogre::Vector3(0.0f, 0.0f, 1.0f));
    }
+#endif
 
-   return true;
+   return space->isFreeWay(pos.x, pos.z, getSphereRadius(), x, z, 
+         this, ignore);
 }
 
 /***********************************************************************
@@ -500,12 +474,48 @@ void FieldObject::setAngularVelocity(btVector3 vel)
    rigidBody->setAngularVelocity(vel);
 }
 
+/***********************************************************************
+ *                          getWorldTransform                          *
+ ***********************************************************************/
+btTransform FieldObject::getWorldTransform()
+{
+   return rigidBody->getCenterOfMassTransform();
+}
+
+/***********************************************************************
+ *                          setWorldTransform                          *
+ ***********************************************************************/
+void FieldObject::setWorldTransform(const btTransform& transform)
+{
+   rigidBody->setCenterOfMassTransform(transform);
+   rigidBody->setInterpolationWorldTransform(transform);
+
+   /* Sync model with the body */
+   motionState->setWorldTransform(transform);
+   motionState->clearMovedFlag();
+   if(sceneNode)
+   {
+      sphere.setCenter(sceneNode->getPosition());
+   }
+}
+
 /***********************************************************************
  *                           getBoundingBox                            *
  ***********************************************************************/
 Ogre::AxisAlignedBox FieldObject::getBoundingBox()
 {
-   return sceneNode->_getWorldAABB();
+   if(sceneNode != NULL)
+   {
+      return sceneNode->_getWorldAABB();
+   }
+
+   /* No graphics: get the box from bullet's shape */
+   btVector3 aabbMin, aabbMax;
+   rigidBody->getAabb(aabbMin, aabbMax);
+   aabbMin *= BULLET_TO_OGRE_FACTOR;
+   aabbMax *= BULLET_TO_OGRE_FACTOR;
+   return Ogre::AxisAlignedBox(aabbMin[0], aabbMin[1], aabbMin[2],
+         aabbMax[0], aabbMax[1], aabbMax[2]);
 }
 
 /***********************************************************************
@@ -522,8 +532,9 @@ bool FieldObject::checkValueDelta(Ogre::Real value, Ogre::Real target,
  ***********************************************************************/
 bool FieldObject::isFacingUp()
 {
-   Ogre::Real pitch = sceneNode->getOrientation().getPitch().valueDegrees();
-   Ogre::Real roll = sceneNode->getOrientation().getRoll().valueDegrees();
+   Ogre::Quaternion ori = getOrientation();
+   Ogre::Real pitch = ori.getPitch().valueDegrees();
+   Ogre::Real roll = ori.getRoll().valueDegrees();
 
    if( ( (checkValueDelta(pitch, 0.0f, 0.1f)) ||
          (checkValueDelta(pitch, 180.0f, 0.1f)) ||
@@ -596,7 +607,10 @@ void FieldObject::applyAngles(Ogre::Real aX, Ogre::Real aY, Ogre::Real aZ)
    Ogre::Quaternion qY(Ogre::Degree(aY), Ogre::Vector3::UNIT_Y);
    Ogre::Quaternion qZ(Ogre::Degree(aZ), Ogre::Vector3::UNIT_Z);
 
-   sceneNode->setOrientation(qX*qY*qZ);
+   if(sceneNode)
+   {
+      sceneNode->setOrientation(qX*qY*qZ);
+   }
 }
 
 /***********************************************************************
@@ -612,7 +626,14 @@ Ogre::Real FieldObject::getOrientationY()
  ***********************************************************************/
 Ogre::Quaternion FieldObject::getOrientation()
 {
-   return sceneNode->getOrientation();
+   if(sceneNode != NULL)
+   {
+      return sceneNode->getOrientation();
+   }
+
+   /* No graphics, let's direct use bullet. */
+   btQuaternion rot = rigidBody->getCenterOfMassTransform().getRotation();
+   return Ogre::Quaternion(rot.getW(), rot.getX(), rot.getY(), rot.getZ());
 }
 
 /***********************************************************************
@@ -650,22 +671,6 @@ bool FieldObject::update()
    return willMove;
 }
 
-/******************************************************************
- *                       getLastCollision                         *
- ******************************************************************/
-unsigned long FieldObject::getLastCollision()
-{
-   return lastCollision.getMilliseconds();
-}
-
-/******************************************************************
- *                       setLastCollision                         *
- ******************************************************************/
-void FieldObject::setLastCollision()
-{
-   lastCollision.reset();
-}
-
 /***********************************************************************
  *                           prePhysicStep                             *
  ***********************************************************************/
@@ -700,6 +705,14 @@ bool FieldObject::getMovedFlag()
    return motionState->getMovedFlag();
 }
 
+/***********************************************************************
+ *                           clearMovedFlag                            *
+ ***********************************************************************/
+void FieldObject::clearMovedFlag()
+{
+   motionState->clearMovedFlag();
+}
+
 /***********************************************************************
  *                        movedOnLastPhysicStep                        *
  ***********************************************************************/
@@ -22,6 +22,8 @@
 #define _btsoccer_field_object_h
 
 #include <OGRE/OgreEntity.h>
+#include <OGRE/OgreInstancedEntity.h>
+#include <OGRE/OgreInstanceManager.h>
 #include <OGRE/OgreSceneManager.h>
 #include <OGRE/OgreAxisAlignedBox.h>
 #include <OGRE/OgreManualObject.h>
@@ -36,6 +38,17 @@ namespace BtSoccer
    
 #define AI_FILTER_GROUP   256
 
+/* Physical shape dimensions, in ogre units (used when the model isn't
+ * loaded to define them). */
+#define FOBJECT_BALL_RADIUS         0.11f   /**< Ball sphere radius */
+#define FOBJECT_DISK_RADIUS         0.6f    /**< Disk cylinder radius */
+#define FOBJECT_DISK_FLOOR_POSITION 0.10335f /**< Disk center height */
+#define FOBJECT_DISK_HEIGHT         0.171f  /**< Disk total height */
+#define FOBJECT_GK_HALF_WIDTH       1.0f    /**< Keeper box half X */
+#define FOBJECT_GK_HALF_HEIGHT      0.435f  /**< Keeper box half Y */
+#define FOBJECT_GK_HALF_DEPTH       0.145f  /**< Keeper box half Z */
+#define FOBJECT_GK_FLOOR_POSITION   0.43055f /**< Keeper center height */
+
 /*! The fobject is the base abstraction of interactive objects at the
  * game, like the ball, goals, disks, goal-keepers, etc. */
 class FieldObject
@@ -63,12 +76,19 @@ class FieldObject
        * \param objMass mass of the object
        * \param colRestitution restitution factor of the object
        * \param objFriction default friction of the object
-       * \param objRollingFriction friction when the object is rolling */
+       * \param objRollingFriction friction when the object is rolling
+       * \param instanceManager if not NULL, the object will be rendered as
+       *        an instance of it (fileName must be its mesh), instead of
+       *        having its own Entity.
+       * \param instancedMaterial material to use for the instance. Only
+       *        used when instanceManager is defined. */
       FieldObject(int fType, Ogre::String name, Ogre::String fileName,
             Ogre::SceneManager* ogreSceneManager, Ogre::Real scale,
             Ogre::Real objMass, Ogre::Real colRestitution, 
             Ogre::Real objFriction, Ogre::Real objRollingFriction,
-            BulletDebugDraw* debugDraw);
+            BulletDebugDraw* debugDraw, 
+            Ogre::InstanceManager* instanceManager=NULL,
+            Ogre::String instancedMaterial="");
       /*! Destructor */
       ~FieldObject();
 
@@ -156,14 +176,16 @@ class FieldObject
 
       /*! Verify if the object has free way to a point. A 'free way' is
        * defined by no potential colisions with other disks (a colision with
-       * the ball is allowed).
-       * \note this function is somewhat expensive (three ray casts), so 
-       *       optimize its calls.
-       * \param query RaySceneQuery to use for each ray cast.
+       * the ball is allowed), as if the object's bounding circle were 
+       * swept from its position to the point.
+       * \param space DiskSpace with the disks and goal keepers to check
        * \param x -> point's x coordinate
        * \param z -> point's z coordinate
+       * \param ignore another object to ignore, besides itself 
+       *        (usually the disk at the target), or NULL.
        * \return if has free way  */
-      bool hasFreeWayTo(Ogre::RaySceneQuery* query, Ogre::Real x, Ogre::Real z);
+      bool hasFreeWayTo(DiskSpace* space, Ogre::Real x, Ogre::Real z,
+            FieldObject* ignore=NULL);
 
       /*! Get Model name
        * \return -> string with model internal name on Ogre */
@@ -178,12 +200,16 @@ class FieldObject
       /*! Apply a central force at the object */ 
       void applyForce(Ogre::Real x, Ogre::Real y, Ogre::Real z);
 
-      /*! Get the ammount of time after last collision with the object
-       * \return timer after last collision in ms */
-      unsigned long getLastCollision();
+      /*! \return physics tick of the last collision with the object
+       *          (zero if never collided) */
+      unsigned long getLastCollisionTick() { return lastCollisionTick; };
 
-      /*! Set the time the last collision with the object occurred */
-      void setLastCollision();
+      /*! Set the physics tick the last collision with the object
+       * occurred */
+      void setLastCollisionTick(unsigned long tick) 
+      { 
+         lastCollisionTick = tick; 
+      };
 
       /*! Do things before a call to the physics step,
        * like setting its status as not moved, etc. */
@@ -192,6 +218,8 @@ class FieldObject
       /*! Verify if the object moved at current happened physics step
        * \return true if moved */
       bool getMovedFlag();
+      /*! Clear the moved flag (usually after a forced physics step) */
+      void clearMovedFlag();
    
       /*! Verify if the object moved at physics step before the 
        * current happened one.
@@ -210,11 +238,25 @@ class FieldObject
        * \param vel angular velocity value */
       void setAngularVelocity(btVector3 vel);
 
+      /*! \return current world transform of the rigid body */
+      btTransform getWorldTransform();
+      /*! Set the world transform (position and orientation) of the rigid
+       * body, as is, syncing the model with it (but without any forced
+       * physics step or activation change).
+       * \param transform new world transform, at bullet's units. */
+      void setWorldTransform(const btTransform& transform);
+
+      /*! \return the rigid body of the object at its physics world */
+      btRigidBody* getRigidBody() { return rigidBody; };
+
       /*! Hide the model */
       void hide();
       /*!  Show the previously hidden model */
       void show();
 
+      /*! \return physics context where the object lives */
+      PhysicsContext* getPhysicsContext() { return physics; };
+
       /*! \return Bullet debug draw used */ 
       BulletDebugDraw* getDebugDraw() { return debugDraw; };
 
@@ -237,14 +279,12 @@ class FieldObject
       bool checkValueDelta(Ogre::Real value, Ogre::Real target, 
             Ogre::Real delta);
 
-      /*! Internal check for #hasFreeWayTo ray casts */
-      bool checkNoColliders(Ogre::RaySceneQuery* query, 
-            Ogre::Real targetDistance);
-
       int type;    /**< The fobject type */
 
       Ogre::SceneManager* pSceneManager; /**< Pointer to the scenemgr used */
       Ogre::Entity* model;        /**< Model used for object */
+      Ogre::InstancedEntity* instancedModel; /**< Model used for object, 
+                                                  when instanced */
       Ogre::SceneNode* sceneNode; /**< Scene node used for object */
 
       Ogre::String mName;         /**< Model Name */
@@ -259,11 +299,12 @@ class FieldObject
       Ogre::Real floorPosition;   /**< Y Position where the object is at 
                                        the floor*/
 
+      PhysicsContext* physics;       /**< Context where the object lives */
       OgreMotionState* motionState;  /**< Bullet motion state */ 
       btCollisionShape* collisionShape; /**< Shape for collision */
       btRigidBody* rigidBody;           /**< fobject in bullet world */
 
-      Ogre::Timer lastCollision;   /**< Last collision */
+      unsigned long lastCollisionTick; /**< Tick of last collision */
 
       Ogre::Real lastDistance;/**< last distance calculated by getDistanceTo */
       BulletDebugDraw* debugDraw; /**< use for draw debugs */
@@ -124,7 +124,7 @@ void Goal::createPole(int i, btVector3 halfSizes, btVector3 pos,
    poleRigidBody[i] = new btRigidBody(poleRigidBodyCI);
    poleRigidBody[i]->setRestitution(0.6f);
    poleRigidBody[i]->setFriction(0.2f);
-   BulletLink::addRigidBody(poleRigidBody[i]);
+   BulletLink::addRigidBody(poleRigidBody[i], PHYSICS_GROUP_GOAL);
 
    /* Set its position on table */
    btTransform transform = poleRigidBody[i]->getCenterOfMassTransform();
@@ -189,7 +189,7 @@ void Goal::createNet(int i, btVector3 halfSizes, btVector3 pos,
    netRigidBody[i] = new btRigidBody(poleRigidBodyCI);
    netRigidBody[i]->setRestitution(0.2f);
    netRigidBody[i]->setFriction(0.2f);
-   BulletLink::addRigidBody(netRigidBody[i]);
+   BulletLink::addRigidBody(netRigidBody[i], PHYSICS_GROUP_GOAL);
 
    /* Set its position on field table */
    btTransform transform = netRigidBody[i]->getCenterOfMassTransform();
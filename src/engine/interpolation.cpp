@@ -0,0 +1,292 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "interpolation.h"
+
+using namespace BtSoccer;
+
+/***********************************************************************
+ *                                clear                                *
+ ***********************************************************************/
+void InterpolationObject::clear()
+{
+   object = NULL;
+   first = 0;
+   total = 0;
+   applied = true;
+}
+
+/***********************************************************************
+ *                             Constructor                             *
+ ***********************************************************************/
+InterpolationBuffer::InterpolationBuffer()
+{
+   clear();
+}
+
+/***********************************************************************
+ *                              Destructor                             *
+ ***********************************************************************/
+InterpolationBuffer::~InterpolationBuffer()
+{
+}
+
+/***********************************************************************
+ *                                clear                                *
+ ***********************************************************************/
+void InterpolationBuffer::clear()
+{
+   for(int i = 0; i < INTERPOLATION_OBJECTS; i++)
+   {
+      objects[i].clear();
+   }
+   clockOffset = 0;
+   hasClockOffset = false;
+}
+
+/***********************************************************************
+ *                              getSample                              *
+ ***********************************************************************/
+InterpolationSample& InterpolationBuffer::getSample(InterpolationObject& obj,
+      int i)
+{
+   return obj.samples[(obj.first + i) % INTERPOLATION_SAMPLES];
+}
+
+/***********************************************************************
+ *                              getObject                              *
+ ***********************************************************************/
+InterpolationObject* InterpolationBuffer::getObject(FieldObject* obj)
+{
+   InterpolationObject* freeSlot = NULL;
+   for(int i = 0; i < INTERPOLATION_OBJECTS; i++)
+   {
+      if(objects[i].object == obj)
+      {
+         return &objects[i];
+      }
+      else if( (freeSlot == NULL) && (objects[i].object == NULL) )
+      {
+         freeSlot = &objects[i];
+      }
+   }
+
+   if(freeSlot != NULL)
+   {
+      freeSlot->clear();
+      freeSlot->object = obj;
+   }
+   return freeSlot;
+}
+
+/***********************************************************************
+ *                                 push                                *
+ ***********************************************************************/
+void InterpolationBuffer::push(FieldObject* obj, Ogre::Vector3 pos, 
+      Ogre::Quaternion ori)
+{
+   push(obj, pos, ori, timer.getMilliseconds());
+}
+
+/***********************************************************************
+ *                                 push                                *
+ ***********************************************************************/
+void InterpolationBuffer::push(FieldObject* obj, Ogre::Vector3 pos, 
+      Ogre::Quaternion ori, unsigned long senderTime)
+{
+   InterpolationObject* iobj = getObject(obj);
+   if(iobj == NULL)
+   {
+      /* No room: just apply it */
+      obj->setOrientation(ori);
+      obj->setPositionWithoutForcedPhysicsStep(pos);
+      return;
+   }
+
+   unsigned long time = senderTime;
+   if( (iobj->total > 0) && 
+       (getSample(*iobj, iobj->total - 1).time > time) )
+   {
+      /* Sender's clock went back (ie: its protocol was restarted): the
+       * buffered positions and the offset are no more comparable. */
+      iobj->first = 0;
+      iobj->total = 0;
+      hasClockOffset = false;
+   }
+
+   /* The update delivered faster defines the offset to our clock (the
+    * network jitter only delays the others). */
+   long offset = (long)timer.getMilliseconds() - (long)time;
+   if( (!hasClockOffset) || (offset < clockOffset) )
+   {
+      clockOffset = offset;
+      hasClockOffset = true;
+   }
+
+   InterpolationSample* sample;
+   if( (iobj->total > 0) && 
+       (getSample(*iobj, iobj->total - 1).time == time) )
+   {
+      /* Simulated at same time (ie: same snapshot): just the newest */
+      sample = &getSample(*iobj, iobj->total - 1);
+   }
+   else
+   {
+      if(iobj->total == INTERPOLATION_SAMPLES)
+      {
+         /* Full: discard the oldest */
+         iobj->first = (iobj->first + 1) % INTERPOLATION_SAMPLES;
+         iobj->total--;
+      }
+      sample = &getSample(*iobj, iobj->total);
+      iobj->total++;
+   }
+
+   sample->time = time;
+   sample->position = pos;
+   sample->orientation = ori;
+   iobj->applied = false;
+}
+
+/***********************************************************************
+ *                                update                               *
+ ***********************************************************************/
+bool InterpolationBuffer::update()
+{
+   bool updated = false;
+   if(!hasClockOffset)
+   {
+      /* Nothing received yet */
+      return false;
+   }
+
+   /* Render time at the sender's timeline */
+   long render = (long)timer.getMilliseconds() - clockOffset - 
+                 INTERPOLATION_DELAY_MS;
+   if(render < 0)
+   {
+      return false;
+   }
+   unsigned long renderTime = (unsigned long)render;
+
+   for(int i = 0; i < INTERPOLATION_OBJECTS; i++)
+   {
+      InterpolationObject& iobj = objects[i];
+      if( (iobj.object == NULL) || (iobj.applied) || (iobj.total == 0) )
+      {
+         continue;
+      }
+
+      /* Discard samples no more needed: the ones before the newest
+       * sample not after the render time. */
+      while( (iobj.total > 2) && (getSample(iobj, 1).time <= renderTime) )
+      {
+         iobj.first = (iobj.first + 1) % INTERPOLATION_SAMPLES;
+         iobj.total--;
+      }
+
+      InterpolationSample& a = getSample(iobj, 0);
+      if(renderTime < a.time)
+      {
+         /* Not yet time to show the oldest one. */
+         continue;
+      }
+
+      Ogre::Vector3 pos;
+      Ogre::Quaternion ori;
+      if( (iobj.total >= 2) && (getSample(iobj, 1).time > renderTime) )
+      {
+         /* Interpolate between the two around the render time */
+         InterpolationSample& b = getSample(iobj, 1);
+         Ogre::Real t = (Ogre::Real)(renderTime - a.time) / 
+                        (Ogre::Real)(b.time - a.time);
+         pos = a.position + (b.position - a.position) * t;
+         ori = Ogre::Quaternion::Slerp(t, a.orientation, b.orientation, 
+               true);
+      }
+      else
+      {
+         /* Newest received is older than the render time */
+         InterpolationSample& n = getSample(iobj, iobj.total - 1);
+         unsigned long late = renderTime - n.time;
+         if( (iobj.total >= 2) && (late <= INTERPOLATION_MAX_EXTRAPOLATION_MS) )
+         {
+            /* Extrapolate, with the last known velocity */
+            InterpolationSample& p = getSample(iobj, iobj.total - 2);
+            Ogre::Real t = 1.0f + (Ogre::Real)late / 
+                                  (Ogre::Real)(n.time - p.time);
+            pos = p.position + (n.position - p.position) * t;
+            ori = Ogre::Quaternion::Slerp(t, p.orientation, n.orientation,
+                  true);
+            ori.normalise();
+         }
+         else
+         {
+            /* Nothing newer for too long (usually stopped): keep it at
+             * its newest position. */
+            pos = n.position;
+            ori = n.orientation;
+            iobj.applied = true;
+         }
+      }
+
+      iobj.object->setOrientation(ori);
+      iobj.object->setPositionWithoutForcedPhysicsStep(pos);
+      updated = true;
+   }
+
+   return updated;
+}
+
+/***********************************************************************
+ *                                 flush                               *
+ ***********************************************************************/
+bool InterpolationBuffer::flush()
+{
+   bool updated = false;
+   for(int i = 0; i < INTERPOLATION_OBJECTS; i++)
+   {
+      InterpolationObject& iobj = objects[i];
+      if( (iobj.object != NULL) && (iobj.total > 0) && (!iobj.applied) )
+      {
+         InterpolationSample& n = getSample(iobj, iobj.total - 1);
+         iobj.object->setOrientation(n.orientation);
+         iobj.object->setPositionWithoutForcedPhysicsStep(n.position);
+         updated = true;
+      }
+      iobj.clear();
+   }
+   return updated;
+}
+
+/***********************************************************************
+ *                                isEmpty                              *
+ ***********************************************************************/
+bool InterpolationBuffer::isEmpty()
+{
+   for(int i = 0; i < INTERPOLATION_OBJECTS; i++)
+   {
+      if( (objects[i].object != NULL) && (!objects[i].applied) )
+      {
+         return false;
+      }
+   }
+   return true;
+}
@@ -0,0 +1,135 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _btsoccer_interpolation_h
+#define _btsoccer_interpolation_h
+
+#include "../btsoccer.h"
+#include "fobject.h"
+
+#include <kobold/timer.h>
+
+namespace BtSoccer
+{
+
+/*! Delay (in ms) the received positions are rendered with, to always
+ * have (at normal network conditions) a newer position to interpolate
+ * to. Must be greater than the sender's update interval. */
+#define INTERPOLATION_DELAY_MS             100
+/*! Max time (in ms) to extrapolate an object after its newest position,
+ * when no newer one was received in time. */
+#define INTERPOLATION_MAX_EXTRAPOLATION_MS 100
+/*! Positions kept for each object */
+#define INTERPOLATION_SAMPLES              16
+/*! Max objects at the buffer: ball and (TEAM_MAX_DISKS + goal keeper) 
+ * disks of each team. */
+#define INTERPOLATION_OBJECTS              23
+
+/*! A received position of an object, with the time it was simulated */
+class InterpolationSample
+{
+   public:
+      unsigned long time;           /**< Sender's time, in ms */
+      Ogre::Vector3 position;       /**< Received position */
+      Ogre::Quaternion orientation; /**< Received orientation */
+};
+
+/*! The received positions of a single object */
+class InterpolationObject
+{
+   public:
+      /*! Clear the object */
+      void clear();
+
+      FieldObject* object;  /**< The object, or NULL for a free slot */
+      /*! Ring of received positions, ordered by time */
+      InterpolationSample samples[INTERPOLATION_SAMPLES];
+      int first;            /**< Index of the oldest sample */
+      int total;            /**< Total samples at the ring */
+      bool applied;         /**< If the newest sample was applied */
+};
+
+/*! Buffer of positions received from the other side (while it simulates
+ * a turn), timestamped with the sender's clock. Instead of applying them
+ * as they arrive (thus at network rate and jitter), the objects are 
+ * rendered INTERPOLATION_DELAY_MS in the past of the sender's timeline
+ * (mapped to ours by the smallest transit offset seen, ie: the fastest
+ * delivered update), interpolating (with slerp for orientations) between
+ * the received positions around that time, or extrapolating a little 
+ * from the newest ones, if late. */
+class InterpolationBuffer
+{
+   public:
+      /*! Constructor */
+      InterpolationBuffer();
+      /*! Destructor */
+      ~InterpolationBuffer();
+
+      /*! Remove all objects and positions */
+      void clear();
+
+      /*! Add a received position of an object
+       * \param obj -> object the position is of
+       * \param pos -> received position
+       * \param ori -> received orientation
+       * \param senderTime -> sender's clock (ms) when the position was
+       *        simulated. Positions of the same object must be pushed in 
+       *        the sender's order. */
+      void push(FieldObject* obj, Ogre::Vector3 pos, Ogre::Quaternion ori,
+            unsigned long senderTime);
+
+      /*! Add a received position of an object, without the sender's time
+       * (ie: from peers without it), using the receive time instead.
+       * \param obj -> object the position is of
+       * \param pos -> received position
+       * \param ori -> received orientation */
+      void push(FieldObject* obj, Ogre::Vector3 pos, Ogre::Quaternion ori);
+
+      /*! Set the objects to their positions at the current render time
+       * \return true if some object was set */
+      bool update();
+
+      /*! Set each object at its newest received position, clearing 
+       * the buffer. Must be called when the received positions are 
+       * final (ie: before applying a rules result).
+       * \return true if some object was set */
+      bool flush();
+
+      /*! \return if there are no positions waiting to be applied */
+      bool isEmpty();
+
+   protected:
+      /*! \return the sample at a position of the object's ring */
+      InterpolationSample& getSample(InterpolationObject& obj, int i);
+      /*! \return the buffered object for a field object, creating it
+       * if not yet buffered (NULL if no more room). */
+      InterpolationObject* getObject(FieldObject* obj);
+
+      InterpolationObject objects[INTERPOLATION_OBJECTS]; /**< Objects */
+      Kobold::Timer timer; /**< Timer for receive and render times */
+      /*! Smallest (receive time - sender time) seen: our time of the 
+       * sender's clock is 'sender time + clockOffset'. */
+      long clockOffset;
+      bool hasClockOffset; /**< If clockOffset was defined */
+};
+
+}
+
+#endif
@@ -0,0 +1,509 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "matchfarm.h"
+#include "teams.h"
+#include "threadlog.h"
+
+#include <OGRE/OgreLogManager.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <deque>
+#include <algorithm>
+
+using namespace BtSoccer;
+
+namespace BtSoccer
+{
+
+/*! A MatchFarm worker: a thread with its own simulator and its own 
+ * queue of matches to play. */
+class MatchFarmWorker
+{
+   public:
+      /*! Constructor */
+      MatchFarmWorker(int index, int minutesPerHalf, int aiType)
+         :simulator(minutesPerHalf, aiType, aiType)
+      {
+         this->index = index;
+         running = false;
+         farm = NULL;
+         physicsFrames = 0;
+         played = 0;
+         stolen = 0;
+         pthread_mutex_init(&queueMutex, NULL);
+      };
+      /*! Destructor */
+      ~MatchFarmWorker()
+      {
+         pthread_mutex_destroy(&queueMutex);
+      };
+
+      /*! Pop a match from the back of its own queue.
+       * \return match index or -1 if empty */
+      int popBack()
+      {
+         int res = -1;
+         pthread_mutex_lock(&queueMutex);
+         if(!queue.empty())
+         {
+            res = queue.back();
+            queue.pop_back();
+         }
+         pthread_mutex_unlock(&queueMutex);
+         return res;
+      };
+
+      /*! Pop a match from the front of the queue (by a thief).
+       * \return match index or -1 if empty */
+      int popFront()
+      {
+         int res = -1;
+         pthread_mutex_lock(&queueMutex);
+         if(!queue.empty())
+         {
+            res = queue.front();
+            queue.pop_front();
+         }
+         pthread_mutex_unlock(&queueMutex);
+         return res;
+      };
+
+      int index;                   /**< Worker index at the farm */
+      pthread_t thread;            /**< Worker thread */
+      bool running;                /**< If thread is running */
+      MatchFarm* farm;             /**< Farm the worker belongs to */
+      MatchSimulator simulator;    /**< Worker's own simulator */
+      ThreadLog log;               /**< Messages logged by its thread */
+      std::deque<int> queue;       /**< Matches to play */
+      pthread_mutex_t queueMutex;  /**< Mutex for queue access */
+      unsigned long physicsFrames; /**< Physics frames done */
+      int played;                  /**< Matches played */
+      int stolen;                  /**< Matches stolen from others */
+};
+
+}
+
+/***********************************************************************
+ *                          standingCompare                            *
+ ***********************************************************************/
+static bool standingCompare(const MatchFarmStanding& a, 
+      const MatchFarmStanding& b)
+{
+   if(a.points != b.points)
+   {
+      return a.points > b.points;
+   }
+   if((a.goalsFor - a.goalsAgainst) != (b.goalsFor - b.goalsAgainst))
+   {
+      return (a.goalsFor - a.goalsAgainst) > (b.goalsFor - b.goalsAgainst);
+   }
+   if(a.goalsFor != b.goalsFor)
+   {
+      return a.goalsFor > b.goalsFor;
+   }
+   return a.name < b.name;
+}
+
+/***********************************************************************
+ *                             Constructor                             *
+ ***********************************************************************/
+MatchFarm::MatchFarm(int threads, int minutesPerHalf, int aiType)
+{
+   int i;
+
+   this->minutesPerHalf = minutesPerHalf;
+   this->aiType = aiType;
+
+   if(threads < 1)
+   {
+      threads = 1;
+   }
+   for(i = 0; i < threads; i++)
+   {
+      MatchFarmWorker* w = new MatchFarmWorker(i, minutesPerHalf, aiType);
+      w->farm = this;
+      workers.push_back(w);
+   }
+}
+
+/***********************************************************************
+ *                              Destructor                             *
+ ***********************************************************************/
+MatchFarm::~MatchFarm()
+{
+   unsigned int i;
+   for(i = 0; i < workers.size(); i++)
+   {
+      delete workers[i];
+   }
+   workers.clear();
+}
+
+/***********************************************************************
+ *                         getDefaultThreads                           *
+ ***********************************************************************/
+int MatchFarm::getDefaultThreads()
+{
+   long procs = sysconf(_SC_NPROCESSORS_ONLN);
+   if(procs < 1)
+   {
+      return 1;
+   }
+   return (int)procs;
+}
+
+/***********************************************************************
+ *                               addTeam                               *
+ ***********************************************************************/
+int MatchFarm::addTeam(Ogre::String name)
+{
+   teams.push_back(name);
+   return (int)teams.size() - 1;
+}
+
+/***********************************************************************
+ *                           addRegionTeams                            *
+ ***********************************************************************/
+void MatchFarm::addRegionTeams(int region)
+{
+   int i;
+   TeamInfo* t;
+
+   if(region >= 0)
+   {
+      /* Only the teams of the region */
+      Region* r = Regions::getRegion(region);
+      if(r == NULL)
+      {
+         Ogre::LogManager::getSingleton().stream(Ogre::LML_CRITICAL)
+            << "MatchFarm: unknown region " << region;
+         return;
+      }
+      t = (TeamInfo*) r->getFirst();
+      for(i = 0; i < r->getTotal(); i++)
+      {
+         addTeam(t->name);
+         t = (TeamInfo*) t->getNext();
+      }
+   }
+   else
+   {
+      /* All teams of all regions */
+      t = Regions::getFirstTeam();
+      for(i = 0; i < Regions::getTotalTeams(); i++)
+      {
+         addTeam(t->name);
+         t = Regions::getNextTeam(t);
+      }
+   }
+}
+
+/***********************************************************************
+ *                              addMatch                               *
+ ***********************************************************************/
+int MatchFarm::addMatch(int teamA, int teamB)
+{
+   MatchFarmMatch m;
+   m.teams[0] = teamA;
+   m.teams[1] = teamB;
+   m.played = false;
+   matches.push_back(m);
+   return (int)matches.size() - 1;
+}
+
+/***********************************************************************
+ *                          addLeagueMatches                           *
+ ***********************************************************************/
+void MatchFarm::addLeagueMatches(bool doubleRound)
+{
+   int i, j;
+   int total = getTotalTeams();
+
+   for(i = 0; i < total; i++)
+   {
+      for(j = i + 1; j < total; j++)
+      {
+         addMatch(i, j);
+         if(doubleRound)
+         {
+            addMatch(j, i);
+         }
+      }
+   }
+}
+
+/***********************************************************************
+ *                                 run                                 *
+ ***********************************************************************/
+void MatchFarm::run()
+{
+   unsigned int i;
+   int m, w;
+   int toPlay = 0;
+   int perWorker, extra;
+
+   for(i = 0; i < matches.size(); i++)
+   {
+      if(!matches[i].played)
+      {
+         toPlay++;
+      }
+   }
+
+   /* Split matches in contiguous blocks, one for each worker. The
+    * work stealing will take care of any imbalance (and matches
+    * have very different durations, so there'll be some). */
+   perWorker = toPlay / workers.size();
+   extra = toPlay % workers.size();
+   w = 0;
+   for(i = 0; i < workers.size(); i++)
+   {
+      workers[i]->queue.clear();
+      workers[i]->physicsFrames = 0;
+      workers[i]->played = 0;
+      workers[i]->stolen = 0;
+   }
+   m = 0;
+   for(i = 0; i < matches.size(); i++)
+   {
+      if(!matches[i].played)
+      {
+         if(m >= perWorker + ((w < extra) ? 1 : 0))
+         {
+            w++;
+            m = 0;
+         }
+         workers[w]->queue.push_back(i);
+         m++;
+      }
+   }
+
+   /* Start all worker threads. A worker whose thread couldn't be created
+    * keeps its queue: the running ones will steal all its matches. */
+   unsigned int started = 0;
+   for(i = 0; i < workers.size(); i++)
+   {
+      workers[i]->running = (pthread_create(&workers[i]->thread, NULL, 
+               workerProc, workers[i]) == 0);
+      if(workers[i]->running)
+      {
+         started++;
+      }
+      else
+      {
+         Ogre::LogManager::getSingleton().stream(Ogre::LML_CRITICAL)
+            << "MatchFarm: couldn't create thread for worker " << i
+            << ". Its matches will be stolen by the other workers.";
+      }
+   }
+
+   if(started == 0)
+   {
+      /* No thread at all: play everything serially at the calling thread,
+       * with the first worker stealing from all other queues. */
+      Ogre::LogManager::getSingleton().stream(Ogre::LML_CRITICAL)
+         << "MatchFarm: no worker thread could be created. "
+         << "Running all matches serially at the calling thread.";
+      work(workers[0]);
+   }
+   else if(started < workers.size())
+   {
+      Ogre::LogManager::getSingleton().stream(Ogre::LML_CRITICAL)
+         << "MatchFarm: running with " << started << " of "
+         << workers.size() << " worker threads.";
+   }
+
+   /* And wait them to finish */
+   for(i = 0; i < workers.size(); i++)
+   {
+      if(workers[i]->running)
+      {
+         pthread_join(workers[i]->thread, NULL);
+         workers[i]->running = false;
+      }
+   }
+
+   /* Now, at the calling thread, write what the workers logged */
+   for(i = 0; i < workers.size(); i++)
+   {
+      workers[i]->log.flush();
+   }
+}
+
+/***********************************************************************
+ *                             workerProc                              *
+ ***********************************************************************/
+void* MatchFarm::workerProc(void* arg)
+{
+   MatchFarmWorker* worker = (MatchFarmWorker*) arg;
+   worker->farm->work(worker);
+   return NULL;
+}
+
+/***********************************************************************
+ *                                 work                                *
+ ***********************************************************************/
+void MatchFarm::work(MatchFarmWorker* worker)
+{
+   int m;
+
+   /* Ogre's LogManager isn't safe from here: keep the messages to the
+    * calling thread of #run */
+   ThreadLog::setThreadLog(&worker->log);
+
+   while(true)
+   {
+      m = worker->popBack();
+      if(m < 0)
+      {
+         if(!steal(worker, m))
+         {
+            /* Nothing more to play */
+            ThreadLog::setThreadLog(NULL);
+            return;
+         }
+         worker->stolen++;
+      }
+
+      /* Note: each worker only writes at its own matches, so no need
+       * for locking the matches vector (which won't be resized while
+       * running). */
+      MatchFarmMatch& match = matches[m];
+      worker->simulator.setTeamNames(teams[match.teams[0]], 
+            teams[match.teams[1]]);
+      worker->simulator.simulate(match.result);
+      match.played = true;
+
+      worker->physicsFrames += match.result.physicsFrames;
+      worker->played++;
+   }
+}
+
+/***********************************************************************
+ *                                steal                                *
+ ***********************************************************************/
+bool MatchFarm::steal(MatchFarmWorker* thief, int& match)
+{
+   unsigned int i;
+   unsigned int total = workers.size();
+
+   /* Scan victims round-robin, starting from the next one */
+   for(i = 1; i < total; i++)
+   {
+      MatchFarmWorker* victim = workers[(thief->index + i) % total];
+      match = victim->popFront();
+      if(match >= 0)
+      {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+/***********************************************************************
+ *                           getLeagueTable                            *
+ ***********************************************************************/
+void MatchFarm::getLeagueTable(std::vector<MatchFarmStanding>& table)
+{
+   unsigned int i;
+   int t;
+
+   table.clear();
+   for(i = 0; i < teams.size(); i++)
+   {
+      MatchFarmStanding s;
+      s.team = i;
+      s.name = teams[i];
+      s.played = 0;
+      s.wins = 0;
+      s.draws = 0;
+      s.losses = 0;
+      s.goalsFor = 0;
+      s.goalsAgainst = 0;
+      s.points = 0;
+      table.push_back(s);
+   }
+
+   for(i = 0; i < matches.size(); i++)
+   {
+      if(!matches[i].played)
+      {
+         continue;
+      }
+      for(t = 0; t < 2; t++)
+      {
+         MatchFarmStanding& s = table[matches[i].teams[t]];
+         int own = matches[i].result.goals[t];
+         int other = matches[i].result.goals[1 - t];
+
+         s.played++;
+         s.goalsFor += own;
+         s.goalsAgainst += other;
+         if(own > other)
+         {
+            s.wins++;
+            s.points += MATCH_FARM_POINTS_PER_WIN;
+         }
+         else if(own == other)
+         {
+            s.draws++;
+            s.points += MATCH_FARM_POINTS_PER_DRAW;
+         }
+         else
+         {
+            s.losses++;
+         }
+      }
+   }
+
+   std::sort(table.begin(), table.end(), standingCompare);
+}
+
+/***********************************************************************
+ *                        getTotalPhysicsFrames                        *
+ ***********************************************************************/
+unsigned long MatchFarm::getTotalPhysicsFrames()
+{
+   unsigned int i;
+   unsigned long total = 0;
+   for(i = 0; i < workers.size(); i++)
+   {
+      total += workers[i]->physicsFrames;
+   }
+   return total;
+}
+
+/***********************************************************************
+ *                            getTotalSteals                           *
+ ***********************************************************************/
+int MatchFarm::getTotalSteals()
+{
+   unsigned int i;
+   int total = 0;
+   for(i = 0; i < workers.size(); i++)
+   {
+      total += workers[i]->stolen;
+   }
+   return total;
+}
+
@@ -0,0 +1,156 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _btsoccer_match_farm_h
+#define _btsoccer_match_farm_h
+
+#include "matchsimulator.h"
+
+#include <vector>
+
+namespace BtSoccer
+{
+
+/** Points a team gets for a win at the league table */
+#define MATCH_FARM_POINTS_PER_WIN    3
+/** Points a team gets for a draw at the league table */
+#define MATCH_FARM_POINTS_PER_DRAW   1
+
+class MatchFarmWorker;
+
+/*! A match to be (or already) played by the MatchFarm */
+class MatchFarmMatch
+{
+   public:
+      int teams[2];                /**< index of each team at the farm */
+      bool played;                 /**< if the match was already played */
+      MatchSimulatorResult result; /**< result, when played */
+};
+
+/*! A team line at the MatchFarm league table */
+class MatchFarmStanding
+{
+   public:
+      int team;           /**< index of the team at the farm */
+      Ogre::String name;  /**< team's name */
+      int played;         /**< matches played */
+      int wins;           /**< matches won */
+      int draws;          /**< matches drawn */
+      int losses;         /**< matches lost */
+      int goalsFor;       /**< goals scored */
+      int goalsAgainst;   /**< goals conceded */
+      int points;         /**< total points */
+};
+
+/*! The MatchFarm plays lots of headless matches (see MatchSimulator) 
+ * across worker threads. Each worker owns its simulator (and thus its
+ * physics world and rules state) and a queue of matches: it plays 
+ * from the back of its own queue and, when empty, steals from the front 
+ * of the others' queues, so no core idles while matches remain. */
+class MatchFarm
+{
+   public:
+      /*! Constructor
+       * \param threads number of worker threads to use
+       * \param minutesPerHalf duration of each half of the matches
+       * \param aiType MatchSimulator::MatchSimulatorAITypes for all teams */
+      MatchFarm(int threads, int minutesPerHalf, int aiType);
+      /*! Destructor */
+      ~MatchFarm();
+
+      /*! Add a team to the farm
+       * \param name team's name
+       * \return index of the team at the farm */
+      int addTeam(Ogre::String name);
+
+      /*! Add teams loaded at Regions (from teams.lst).
+       * \param region index of the region to add teams from, or -1 
+       *        to add all teams of all regions. */
+      void addRegionTeams(int region=-1);
+
+      /*! Add a match to be played
+       * \param teamA index of the home team
+       * \param teamB index of the away team
+       * \return index of the match */
+      int addMatch(int teamA, int teamB);
+
+      /*! Add a league of matches, each team playing against all others
+       * \param doubleRound true to each pair play twice (home and away) */
+      void addLeagueMatches(bool doubleRound);
+
+      /*! Play all added (and not yet played) matches, returning only
+       * when all of them are done. If some worker threads can't be
+       * created, the farm logs it and runs with the ones that started
+       * (falling back to the calling thread only if none did). 
+       * \note messages logged while playing are only written to Ogre's
+       *       log (by the calling thread) when all are done. */
+      void run();
+
+      /*! \return total matches added to the farm */
+      int getTotalMatches() { return (int)matches.size(); };
+      /*! \return match of index i */
+      MatchFarmMatch* getMatch(int i) { return &matches[i]; };
+
+      /*! \return total teams added to the farm */
+      int getTotalTeams() { return (int)teams.size(); };
+      /*! \return name of the team of index i */
+      Ogre::String getTeamName(int i) { return teams[i]; };
+
+      /*! Get the league table of the played matches
+       * \param table vector to receive the standings, sorted by 
+       *        points, goal difference and goals scored. */
+      void getLeagueTable(std::vector<MatchFarmStanding>& table);
+
+      /*! \return total physics frames done at the last #run */
+      unsigned long getTotalPhysicsFrames();
+      /*! \return total matches stolen between workers at the last #run */
+      int getTotalSteals();
+
+      /*! \return the number of online processors, as default number
+       *          of threads to use. */
+      static int getDefaultThreads();
+
+   protected:
+      /*! Thread function of each worker */
+      static void* workerProc(void* arg);
+
+      /*! Play matches until there's none left to play nor to steal
+       * \param worker worker playing */
+      void work(MatchFarmWorker* worker);
+
+      /*! Try to steal a match from other worker's queue
+       * \param thief the worker without matches at its queue
+       * \param match will receive the stolen match index
+       * \return true if stolen one */
+      bool steal(MatchFarmWorker* thief, int& match);
+
+   private:
+      int minutesPerHalf;   /**< Minutes per half of each match */
+      int aiType;           /**< AI used by teams */
+
+      std::vector<Ogre::String> teams;        /**< Teams at the farm */
+      std::vector<MatchFarmMatch> matches;    /**< Matches at the farm */
+      std::vector<MatchFarmWorker*> workers;  /**< The workers */
+};
+
+}
+
+#endif
+
@@ -0,0 +1,469 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "matchrecord.h"
+
+#include "ball.h"
+#include "goalkeeper.h"
+#include "team.h"
+#include "teamplayer.h"
+#include "threadlog.h"
+#include "../physics/bulletlink.h"
+#include "../physics/physicscontext.h"
+#include "../net/protocol.h"
+
+#include <string.h>
+#include <fstream>
+using namespace std;
+
+using namespace BtSoccer;
+
+/***********************************************************************
+ *                             Constructor                             *
+ ***********************************************************************/
+MatchRecord::MatchRecord()
+{
+   teamA = NULL;
+   teamB = NULL;
+   ball = NULL;
+   playingTurn = -1;
+   checkedRules = true;
+}
+
+/***********************************************************************
+ *                              Destructor                             *
+ ***********************************************************************/
+MatchRecord::~MatchRecord()
+{
+   stopTurnPlayback();
+}
+
+/***********************************************************************
+ *                              setObjects                             *
+ ***********************************************************************/
+void MatchRecord::setObjects(Team* tA, Team* tB, Ball* b)
+{
+   stopTurnPlayback();
+   teamA = tA;
+   teamB = tB;
+   ball = b;
+}
+
+/***********************************************************************
+ *                                clear                                *
+ ***********************************************************************/
+void MatchRecord::clear()
+{
+   stopTurnPlayback();
+   snapshots.clear();
+   turns.clear();
+}
+
+/***********************************************************************
+ *                              getObject                              *
+ ***********************************************************************/
+FieldObject* MatchRecord::getObject(int index)
+{
+   if(index == 0)
+   {
+      return ball;
+   }
+   Team* team = (index <= 11) ? teamA : teamB;
+   int teamIndex = (index <= 11) ? index - 1 : index - 12;
+   if( (team == NULL) || (teamIndex < 0) || (teamIndex > TEAM_MAX_DISKS) )
+   {
+      return NULL;
+   }
+   if(teamIndex == 0)
+   {
+      return team->getGoalKeeper();
+   }
+   return team->getDisk(teamIndex - 1);
+}
+
+/***********************************************************************
+ *                            getObjectIndex                           *
+ ***********************************************************************/
+int MatchRecord::getObjectIndex(FieldObject* obj)
+{
+   for(int i = 0; i < REPLAY_OBJECTS; i++)
+   {
+      if((obj != NULL) && (getObject(i) == obj))
+      {
+         return i;
+      }
+   }
+   return -1;
+}
+
+/***********************************************************************
+ *                              getObject                              *
+ ***********************************************************************/
+FieldObject* MatchRecord::getObject(int updateType, int diskNumber)
+{
+   int base;
+   if(updateType == UPDATE_TYPE_BALL)
+   {
+      return ball;
+   }
+   else if(updateType == UPDATE_TYPE_TEAM_A)
+   {
+      base = 1;
+   }
+   else if(updateType == UPDATE_TYPE_TEAM_B)
+   {
+      base = 12;
+   }
+   else
+   {
+      return NULL;
+   }
+
+   if(diskNumber == UPDATE_GK_INDEX)
+   {
+      return getObject(base);
+   }
+   if( (diskNumber < 0) || (diskNumber >= TEAM_MAX_DISKS) )
+   {
+      return NULL;
+   }
+   return getObject(base + 1 + diskNumber);
+}
+
+/***********************************************************************
+ *                             getStateHash                            *
+ ***********************************************************************/
+unsigned int MatchRecord::getStateHash()
+{
+   ReplayData data;
+   ReplayObjectState states[REPLAY_OBJECTS];
+   unsigned int hash = MATCH_RECORD_HASH_BASIS;
+
+   getPositions(&data);
+   snapshots.quantize(&data, states);
+
+   for(int i = 0; i < REPLAY_OBJECTS; i++)
+   {
+      int values[8];
+      int total = 0;
+      if(getObject(i) == NULL)
+      {
+         continue;
+      }
+      values[total++] = i;
+      for(int c = 0; c < 3; c++)
+      {
+         values[total++] = states[i].position[c];
+      }
+      int rotations = (states[i].rotationKind == 
+            ReplayObjectState::ROTATION_YAW) ? 1 : 4;
+      for(int c = 0; c < rotations; c++)
+      {
+         values[total++] = states[i].rotation[c];
+      }
+
+      /* Byte by byte, as little endian, to not depend on the platform */
+      for(int v = 0; v < total; v++)
+      {
+         unsigned int value = (unsigned int)values[v];
+         for(int b = 0; b < 4; b++)
+         {
+            hash ^= (value >> (8 * b)) & 0xFF;
+            hash *= MATCH_RECORD_HASH_PRIME;
+         }
+      }
+   }
+
+   return hash;
+}
+
+/***********************************************************************
+ *                             getPositions                            *
+ ***********************************************************************/
+void MatchRecord::getPositions(ReplayData* data)
+{
+   data->clear();
+   for(int i = 0; i < REPLAY_OBJECTS; i++)
+   {
+      FieldObject* obj = getObject(i);
+      if(obj != NULL)
+      {
+         data->getPosition(i) = obj->getPosition();
+         data->getAngle(i) = obj->getOrientation();
+      }
+   }
+}
+
+/***********************************************************************
+ *                             setPositions                            *
+ ***********************************************************************/
+void MatchRecord::setPositions(ReplayData* data)
+{
+   for(int i = 0; i < REPLAY_OBJECTS; i++)
+   {
+      FieldObject* obj = getObject(i);
+      if(obj != NULL)
+      {
+         obj->setPositionWithoutForcedPhysicsStep(data->getPosition(i));
+         obj->setOrientation(data->getAngle(i));
+      }
+   }
+   BulletLink::getContext()->resetSimulationState();
+}
+
+/***********************************************************************
+ *                              recordTurn                             *
+ ***********************************************************************/
+void MatchRecord::recordTurn(FieldObject* actor, float forceX, float forceZ)
+{
+   MatchRecordTurn turn;
+   ReplayData data;
+
+   turn.actor = getObjectIndex(actor);
+   if(turn.actor < 0)
+   {
+      /* Not an object of ours: nothing to record. */
+      return;
+   }
+   turn.forceX = forceX;
+   turn.forceZ = forceZ;
+   turn.frames = 0;
+
+   /* Store the current positions and put the objects at their stored 
+    * (quantized) values, resetting the simulation state, thus the live
+    * turn starts exactly as it will when played (the quantization offset,
+    * bellow 1/1000 of unit, isn't visible). */
+   getPositions(&data);
+   snapshots.addFrame(&data);
+   setPositions(snapshots.getFrame(snapshots.getEndFrame() - 1));
+
+   turns.push_back(turn);
+}
+
+/***********************************************************************
+ *                               endTurn                               *
+ ***********************************************************************/
+void MatchRecord::endTurn(int frames)
+{
+   if( (!turns.empty()) && (turns.back().frames == 0) )
+   {
+      turns.back().frames = frames;
+   }
+}
+
+/***********************************************************************
+ *                          startTurnPlayback                          *
+ ***********************************************************************/
+bool MatchRecord::startTurnPlayback(int turn)
+{
+   if( (turn < snapshots.getFirstFrame()) || (turn >= getTotalTurns()) ||
+       (turn >= snapshots.getEndFrame()) )
+   {
+      return false;
+   }
+   FieldObject* actor = getObject(turns[turn].actor);
+   if(actor == NULL)
+   {
+      return false;
+   }
+
+   /* Rules shouldn't known about the played collisions */
+   if(playingTurn < 0)
+   {
+      checkedRules = BulletLink::getContext()->getCheckRules();
+      BulletLink::getContext()->setCheckRules(false);
+   }
+   playingTurn = turn;
+
+   setPositions(snapshots.getFrame(turn));
+   actor->applyForce(turns[turn].forceX, 0.0f, turns[turn].forceZ);
+
+   return true;
+}
+
+/***********************************************************************
+ *                           stepTurnPlayback                          *
+ ***********************************************************************/
+bool MatchRecord::stepTurnPlayback()
+{
+   if(playingTurn < 0)
+   {
+      return false;
+   }
+
+   PhysicsContext* physics = BulletLink::getContext();
+   physics->stepFrame();
+
+   int frames = (int)physics->getFrames();
+   int expected = turns[playingTurn].frames;
+   bool done = (physics->isWorldStable()) || 
+               (frames >= MATCH_RECORD_MAX_FRAMES) ||
+               ((expected > 0) && (frames >= expected));
+   if(done)
+   {
+      if((expected > 0) && (frames != expected))
+      {
+         ThreadLog::getLog()->stream(Ogre::LML_NORMAL)
+            << "MatchRecord: turn " << playingTurn << " played with "
+            << frames << " frames, but recorded with " << expected;
+      }
+      stopTurnPlayback();
+   }
+
+   return !done;
+}
+
+/***********************************************************************
+ *                           stopTurnPlayback                          *
+ ***********************************************************************/
+void MatchRecord::stopTurnPlayback()
+{
+   if(playingTurn >= 0)
+   {
+      BulletLink::getContext()->setCheckRules(checkedRules);
+      playingTurn = -1;
+   }
+}
+
+/***********************************************************************
+ *                                 save                                *
+ ***********************************************************************/
+bool MatchRecord::save(Ogre::String fileName)
+{
+   std::vector<unsigned char> buffer;
+   unsigned int magic = MATCH_RECORD_MAGIC;
+
+   for(int i = 0; i < 4; i++)
+   {
+      buffer.push_back((magic >> (8 * i)) & 0xFF);
+   }
+   ReplayStore::writeInt(buffer, MATCH_RECORD_VERSION);
+
+   /* Turns inputs */
+   ReplayStore::writeInt(buffer, getTotalTurns());
+   for(int i = 0; i < getTotalTurns(); i++)
+   {
+      ReplayStore::writeInt(buffer, turns[i].actor);
+      ReplayStore::writeInt(buffer, turns[i].frames);
+      /* Forces as their exact bits, to keep determinism */
+      unsigned int bits[2];
+      memcpy(&bits[0], &turns[i].forceX, sizeof(float));
+      memcpy(&bits[1], &turns[i].forceZ, sizeof(float));
+      for(int f = 0; f < 2; f++)
+      {
+         for(int b = 0; b < 4; b++)
+         {
+            buffer.push_back((bits[f] >> (8 * b)) & 0xFF);
+         }
+      }
+   }
+
+   /* Turns initial positions */
+   snapshots.save(buffer);
+
+   ofstream file;
+   file.open(fileName.c_str(), ios::out | ios::binary);
+   if(!file)
+   {
+      return false;
+   }
+   file.write((const char*)&buffer[0], buffer.size());
+   file.close();
+
+   return true;
+}
+
+/***********************************************************************
+ *                                 load                                *
+ ***********************************************************************/
+bool MatchRecord::load(Ogre::String fileName)
+{
+   clear();
+
+   ifstream file;
+   file.open(fileName.c_str(), ios::in | ios::binary);
+   if(!file)
+   {
+      return false;
+   }
+   std::vector<unsigned char> buffer((istreambuf_iterator<char>(file)),
+                                     istreambuf_iterator<char>());
+   file.close();
+
+   /* Check header */
+   unsigned int magic = 0;
+   if(buffer.size() < 4)
+   {
+      return false;
+   }
+   for(int i = 0; i < 4; i++)
+   {
+      magic |= ((unsigned int)buffer[i]) << (8 * i);
+   }
+   int offset = 4;
+   if( (magic != MATCH_RECORD_MAGIC) || 
+       (ReplayStore::readInt(buffer, offset) != MATCH_RECORD_VERSION) )
+   {
+      ThreadLog::getLog()->stream(Ogre::LML_CRITICAL)
+         << "Invalid match record file: '" << fileName << "'";
+      return false;
+   }
+
+   /* Turns inputs */
+   int total = ReplayStore::readInt(buffer, offset);
+   if( (total < 0) || (total > (int)buffer.size()) )
+   {
+      return false;
+   }
+   for(int i = 0; i < total; i++)
+   {
+      MatchRecordTurn turn;
+      turn.actor = ReplayStore::readInt(buffer, offset);
+      turn.frames = ReplayStore::readInt(buffer, offset);
+      if(offset + 8 > (int)buffer.size())
+      {
+         turns.clear();
+         return false;
+      }
+      unsigned int bits[2] = {0, 0};
+      for(int f = 0; f < 2; f++)
+      {
+         for(int b = 0; b < 4; b++)
+         {
+            bits[f] |= ((unsigned int)buffer[offset]) << (8 * b);
+            offset++;
+         }
+      }
+      memcpy(&turn.forceX, &bits[0], sizeof(float));
+      memcpy(&turn.forceZ, &bits[1], sizeof(float));
+      turns.push_back(turn);
+   }
+
+   /* Turns initial positions */
+   if( (!snapshots.load(buffer, offset)) || 
+       (snapshots.getEndFrame() != total) )
+   {
+      turns.clear();
+      snapshots.clear();
+      return false;
+   }
+
+   return true;
+}
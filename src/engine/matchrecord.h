@@ -0,0 +1,161 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _btsoccer_match_record_h
+#define _btsoccer_match_record_h
+
+#include "../btsoccer.h"
+#include "replay.h"
+
+#include <vector>
+
+namespace BtSoccer
+{
+
+/*! Identifier of the match record files */
+#define MATCH_RECORD_MAGIC         0x52535442
+/*! Current version of the match record files */
+#define MATCH_RECORD_VERSION       1
+/*! Max physics frames a recorded turn could be played */
+#define MATCH_RECORD_MAX_FRAMES    2400
+
+/*! FNV-1a parameters, for the state hash */
+#define MATCH_RECORD_HASH_BASIS    2166136261U
+#define MATCH_RECORD_HASH_PRIME    16777619U
+
+/*! Input of a recorded turn */
+typedef struct _MatchRecordTurn
+{
+   int actor;      /**< Replay index of the object acted (0 is the ball) */
+   float forceX;   /**< X component of the applied force */
+   float forceZ;   /**< Z component of the applied force */
+   int frames;     /**< Physics frames the turn took, or 0 if unknown */
+}MatchRecordTurn;
+
+/*! An event-sourced record of a match: instead of positions of each 
+ * frame, only the initial positions of each turn (as a quantized 
+ * snapshot, delta-encoded to the previous turn's one) and its input 
+ * (the force applied) are stored. The turn is then re-simulated on 
+ * playback, through the deterministic PhysicsContext::stepFrame.
+ * \note to be deterministic, the recorded snapshot is applied to the
+ *       objects (and the physics state reset) before the force is
+ *       applied, both when recording and playing. */
+class MatchRecord
+{
+   public:
+      /*! Constructor */
+      MatchRecord();
+      /*! Destructor */
+      ~MatchRecord();
+
+      /*! Define the objects to record (or play) turns of
+       * \param tA -> team A
+       * \param tB -> team B
+       * \param b -> the ball */
+      void setObjects(Team* tA, Team* tB, Ball* b);
+
+      /*! Clear all recorded turns */
+      void clear();
+
+      /*! Record a new turn, with current objects positions. Must be called
+       * just before applying the force to the actor. 
+       * \note the positions are stored quantized, and the objects are
+       *       put at that stored state, resetting the simulation state,
+       *       so the live turn starts exactly as a played one (as also 
+       *       needed by lockstep, where both sides must simulate the 
+       *       same).
+       * \param actor -> object which will receive the force 
+       * \param forceX -> X component of the force to apply
+       * \param forceZ -> Z component of the force to apply */
+      void recordTurn(FieldObject* actor, float forceX, float forceZ);
+
+      /*! Tell the last recorded turn is done (ie: the world is stable).
+       * \param frames -> physics frames the turn took */
+      void endTurn(int frames);
+
+      /*! \return number of recorded turns */
+      int getTotalTurns() { return (int)turns.size(); };
+
+      /*! Start to play a recorded turn: its positions are set and its
+       * force applied. Rules aren't checked while playing.
+       * \param turn -> turn number [0, getTotalTurns())
+       * \return false if no such turn */
+      bool startTurnPlayback(int turn);
+
+      /*! Step the turn being played by a physics frame 
+       * \return false when the turn is done (and its playback stopped) */
+      bool stepTurnPlayback();
+
+      /*! Stop the current turn playback, if any */
+      void stopTurnPlayback();
+
+      /*! \return if is playing a turn */
+      bool isPlaying() { return playingTurn >= 0; };
+
+      /*! Get a hash of the current objects positions and orientations,
+       * as quantized at the snapshots (thus, equal states have equal
+       * hashes, even with float noise below the quantization).
+       * \return hash of the current state */
+      unsigned int getStateHash();
+
+      /*! Get an object by its protocol's update type and disk number
+       * \param updateType -> UPDATE_TYPE_BALL, UPDATE_TYPE_TEAM_A or 
+       *        UPDATE_TYPE_TEAM_B
+       * \param diskNumber -> disk number, UPDATE_GK_INDEX for the goal 
+       *        keeper.
+       * \return the object or NULL */
+      FieldObject* getObject(int updateType, int diskNumber);
+
+      /*! Save the record to a file
+       * \param fileName -> name of the file to save to
+       * \return if saved */
+      bool save(Ogre::String fileName);
+
+      /*! Load a record from a file, replacing the current one
+       * \param fileName -> name of the file to load
+       * \return if loaded */
+      bool load(Ogre::String fileName);
+
+   protected:
+      /*! \return object of a replay index, or NULL */
+      FieldObject* getObject(int index);
+      /*! \return replay index of an object, or -1 */
+      int getObjectIndex(FieldObject* obj);
+
+      /*! Get the current positions and angles of the objects */
+      void getPositions(ReplayData* data);
+      /*! Set the positions and angles of the objects, resetting the
+       * physics simulation state. */
+      void setPositions(ReplayData* data);
+
+      Team* teamA;           /**< Current team A */
+      Team* teamB;           /**< Current team B */
+      Ball* ball;            /**< Current ball */
+
+      ReplayStore snapshots; /**< Initial positions of each turn */
+      std::vector<MatchRecordTurn> turns; /**< Input of each turn */
+
+      int playingTurn;       /**< Turn being played or -1 */
+      bool checkedRules;     /**< If rules were checked before playing */
+};
+
+}
+
+#endif
@@ -0,0 +1,505 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "matchsimulator.h"
+
+#include "ball.h"
+#include "field.h"
+#include "goalkeeper.h"
+#include "matchrecord.h"
+#include "rules.h"
+#include "stats.h"
+#include "team.h"
+#include "teamplayer.h"
+#include "threadlog.h"
+#include "../ai/decourtai.h"
+#include "../ai/dummyai.h"
+#include "../ai/fuzzyai.h"
+#include "../ai/searchai.h"
+#include "../physics/bulletlink.h"
+#include "../physics/physicscontext.h"
+
+using namespace BtSoccer;
+
+/***********************************************************************
+ *                             Constructor                             *
+ ***********************************************************************/
+MatchSimulator::MatchSimulator(int minutesPerHalf, int aiTeamA, int aiTeamB)
+{
+   this->minutesPerHalf = minutesPerHalf;
+   aiType[0] = aiTeamA;
+   aiType[1] = aiTeamB;
+   teamNames[0] = "TeamA";
+   teamNames[1] = "TeamB";
+
+   /* No sound system at simulations */
+   physics = new PhysicsContext();
+   physics->setPlaySounds(false);
+
+   teamA = NULL;
+   teamB = NULL;
+   ball = NULL;
+   field = NULL;
+   matchRecord = NULL;
+}
+
+/***********************************************************************
+ *                              Destructor                             *
+ ***********************************************************************/
+MatchSimulator::~MatchSimulator()
+{
+   delete physics;
+}
+
+/***********************************************************************
+ *                             setTeamNames                            *
+ ***********************************************************************/
+void MatchSimulator::setTeamNames(Ogre::String nameA, Ogre::String nameB)
+{
+   teamNames[0] = nameA;
+   teamNames[1] = nameB;
+}
+
+/***********************************************************************
+ *                              getAIType                              *
+ ***********************************************************************/
+int MatchSimulator::getAIType(Ogre::String name)
+{
+   if(name == "decourt")
+   {
+      return AI_DECOURT;
+   }
+   else if(name == "fuzzy")
+   {
+      return AI_FUZZY;
+   }
+   else if(name == "dummy")
+   {
+      return AI_DUMMY;
+   }
+   else if(name == "search")
+   {
+      return AI_SEARCH;
+   }
+
+   return -1;
+}
+
+/***********************************************************************
+ *                               createAI                              *
+ ***********************************************************************/
+BaseAI* MatchSimulator::createAI(int type, Team* t)
+{
+   switch(type)
+   {
+      case AI_FUZZY:
+         return new FuzzyAI(t, field);
+      case AI_DUMMY:
+         return new DummyAI(t, field);
+      case AI_SEARCH:
+      {
+         /* Nothing to render here: just wait for the search (and use a
+          * single worker, as matches could already run in parallel). */
+         SearchAI* ai = new SearchAI(t, field, 1);
+         ai->setWaitSlice(SEARCH_AI_TIME_BUDGET);
+         return ai;
+      }
+      case AI_DECOURT:
+      default:
+         return new DecourtAI(t, field);
+   }
+}
+
+/***********************************************************************
+ *                            createScenario                           *
+ ***********************************************************************/
+void MatchSimulator::createScenario()
+{
+   /* Every object created from now on will live at our world, and
+    * every rules call will use our own rules state. */
+   BulletLink::setThreadContext(physics);
+   Rules::setThreadContext(&rules);
+
+   teamA = new Team(teamNames[0], true);
+   teamB = new Team(teamNames[1], true);
+
+   field = new Field();
+   field->createFieldForTestCases(true);
+
+   ball = new Ball();
+
+   teamA->setAI(createAI(aiType[0], teamA));
+   teamB->setAI(createAI(aiType[1], teamB));
+
+   /* Set pointers, as Core::setPointers */
+   coldet.setTeamA(teamA);
+   coldet.setTeamB(teamB);
+   coldet.setBall(ball);
+   coldet.setField(field);
+   physics->setPointers(teamA, teamB, ball, field, false);
+
+   Rules::setTeamA(teamA);
+   Rules::setTeamB(teamB);
+   Rules::setBall(ball);
+   Rules::setField(field);
+   Rules::setMinutesPerHalf(minutesPerHalf);
+
+   if(matchRecord)
+   {
+      matchRecord->clear();
+      matchRecord->setObjects(teamA, teamB, ball);
+   }
+
+   Stats::clear();
+}
+
+/***********************************************************************
+ *                            finishScenario                           *
+ ***********************************************************************/
+void MatchSimulator::finishScenario()
+{
+   physics->setPointers(NULL, NULL, NULL, NULL, false);
+   if(matchRecord)
+   {
+      matchRecord->setObjects(NULL, NULL, NULL);
+   }
+
+   delete teamA;
+   delete teamB;
+   delete ball;
+   field->deleteField();
+   delete field;
+
+   teamA = NULL;
+   teamB = NULL;
+   ball = NULL;
+   field = NULL;
+
+   BulletLink::setThreadContext(NULL);
+   Rules::setThreadContext(NULL);
+}
+
+/***********************************************************************
+ *                               simulate                              *
+ ***********************************************************************/
+void MatchSimulator::simulate(MatchSimulatorResult& result)
+{
+   result.turns = 0;
+   result.physicsFrames = 0;
+   result.simulatedTime = 0;
+
+   createScenario();
+
+   playHalf(true, result);
+   playHalf(false, result);
+
+   /* Get the match statistics */
+   for(int i = 0; i < 2; i++)
+   {
+      bool isTeamA = (i == 0);
+      result.goals[i] = Stats::getGoals(isTeamA);
+      result.fouls[i] = Stats::getFouls(isTeamA);
+      result.goalShoots[i] = Stats::getGoalShoots(isTeamA);
+      result.corners[i] = Stats::getCorners(isTeamA);
+      result.throwIns[i] = Stats::getThrows(isTeamA);
+      result.goalKicks[i] = Stats::getGoalKicks(isTeamA);
+      result.penalties[i] = Stats::getPenalties(isTeamA);
+      result.moves[i] = Stats::getTotalMoves(isTeamA);
+   }
+
+   finishScenario();
+}
+
+/***********************************************************************
+ *                               playHalf                              *
+ ***********************************************************************/
+void MatchSimulator::playHalf(bool firstHalf, MatchSimulatorResult& result)
+{
+   unsigned long halfTime = 0;
+   unsigned long totalTime = minutesPerHalf * 60000;
+
+   Rules::startHalf(firstHalf);
+
+   /* Workaround: let things stabilize at their positions, as done
+    * by Core::newMatch. */
+   for(int i = 0; i < 200; i++)
+   {
+      physics->forcedStep();
+   }
+
+   Rules::newTurn();
+
+   int turns = 0;
+   while((halfTime < totalTime) && (turns < MATCH_SIMULATOR_MAX_TURNS_PER_HALF))
+   {
+      halfTime += playTurn(result);
+      turns++;
+   }
+
+   if(turns >= MATCH_SIMULATOR_MAX_TURNS_PER_HALF)
+   {
+      ThreadLog::getLog()->stream(Ogre::LML_CRITICAL)
+         << "MatchSimulator: half ended by turn limit, at " 
+         << halfTime << "ms";
+   }
+
+   result.turns += turns;
+   result.simulatedTime += halfTime;
+}
+
+/***********************************************************************
+ *                               playTurn                              *
+ ***********************************************************************/
+unsigned long MatchSimulator::playTurn(MatchSimulatorResult& result)
+{
+   BaseAI* ai = Rules::getActiveTeam()->getAI();
+
+   if(!selectAndShoot(ai))
+   {
+      /* AI couldn't define an action: as done at Core for AI controlled
+       * teams, a null force is accepted as the turn's act. */
+      ThreadLog::getLog()->stream(Ogre::LML_NORMAL)
+         << "MatchSimulator: " << Rules::getActiveTeam()->getName()
+         << " AI couldn't select an action.";
+      Rules::clearFlags();
+      ai->clear();
+   }
+
+   int frames = runPhysics();
+   result.physicsFrames += frames;
+   if(matchRecord)
+   {
+      matchRecord->endTurn(frames);
+   }
+
+   verifyRulesResult();
+
+   return (unsigned long)(frames * BTSOCCER_PHYSICS_FRAME_TIME) + 
+          MATCH_SIMULATOR_TURN_THINK_TIME;
+}
+
+/***********************************************************************
+ *                            selectAndShoot                           *
+ ***********************************************************************/
+bool MatchSimulator::selectAndShoot(BaseAI* ai)
+{
+   int tries = 0;
+
+   /* Select an action, as Core::diskIO does for AI teams */
+   while(!ai->hasAction())
+   {
+      if(tries >= MATCH_SIMULATOR_MAX_SELECT_TRIES)
+      {
+         return false;
+      }
+      tries++;
+
+      if(ai->selectAction())
+      {
+         TeamPlayer* tp = ai->getSelectedPlayer();
+         if(tp != NULL)
+         {
+            if(Rules::setDiskAct(tp))
+            {
+               if( (!Rules::goalShootDefined()) && (ai->willGoalShoot()) )
+               {
+                  prepareToShoot(false);
+               }
+            }
+            else
+            {
+               ThreadLog::getLog()->stream(Ogre::LML_NORMAL)
+                  << "Warn: AI defined an invalid disk to act!";
+            }
+         }
+         else
+         {
+            Rules::setBallAct();
+         }
+      }
+   }
+
+   if(ai->willGoalShoot())
+   {
+      /* Calculate the goal shoot after the goalkeeper is defined */
+      ai->calculateGoalShoot();
+   }
+
+   doTheShoot(ai);
+   ai->clear();
+
+   return true;
+}
+
+/***********************************************************************
+ *                              doTheShoot                             *
+ ***********************************************************************/
+void MatchSimulator::doTheShoot(BaseAI* ai)
+{
+   float value=0, dX=0, dZ=0;
+
+   /* Clear any rules system state */
+   Rules::clearFlags();
+
+   force.setInitial(ai->getInitialForceX(), ai->getInitialForceZ());
+   force.setFinal(ai->getFinalForceX(), ai->getFinalForceZ());
+
+   /* Note: AI controlled teams accept 0 values for force, so nothing
+    * to do when not defined. */
+   if(force.getForce(value, dX, dZ))
+   {
+      if(!matchRecord)
+      {
+         /* Without a record to do it (see MatchRecord::recordTurn), 
+          * must reset the state here, to always start the turn the 
+          * same way. */
+         physics->resetSimulationState();
+      }
+      TeamPlayer* tp = ai->getSelectedPlayer();
+      if(tp != NULL)
+      {
+         /* Act with disk */
+         if(matchRecord)
+         {
+            matchRecord->recordTurn(tp, value*dX, value*dZ);
+         }
+         tp->applyForce(value*dX, 0.0f, value*dZ);
+      }
+      else if(ai->willActOnBall())
+      {
+         /* Act with ball, emulating to rules as a team disk collided */
+         value /= BTSOCCER_BALL_FORCE_DIVIDER;
+         if(matchRecord)
+         {
+            matchRecord->recordTurn(ball, value*dX, value*dZ);
+         }
+         ball->applyForce(value*dX, 0.0f, value*dZ);
+         Rules::ballCollideDisk(Rules::getActiveTeam());
+      }
+   }
+}
+
+/***********************************************************************
+ *                            prepareToShoot                           *
+ ***********************************************************************/
+void MatchSimulator::prepareToShoot(bool restric)
+{
+   /* tell that will shoot */
+   Rules::prepareToShoot();
+
+   /* And let the opponent AI position its goal keeper */
+   Team* opponent = (Rules::getActiveTeam() == teamA) ? teamB : teamA;
+   GoalKeeper* gk = opponent->getGoalKeeper();
+   gk->setRestrictMove(restric);
+   opponent->getAI()->doGoalKeeperPosition(gk);
+}
+
+/***********************************************************************
+ *                              runPhysics                             *
+ ***********************************************************************/
+int MatchSimulator::runPhysics()
+{
+   /* Whole frames, as the steps are always the same, not depending on
+    * any time (the simulation state was reset before applying the turn's
+    * force, see #doTheShoot). */
+   TurnResult turnResult;
+   physics->resolve(turnResult, MATCH_SIMULATOR_MAX_TURN_FRAMES);
+   int frames = turnResult.getFrames();
+
+   if(!turnResult.isStable())
+   {
+      ThreadLog::getLog()->stream(Ogre::LML_NORMAL)
+         << "MatchSimulator: world not stable after " << frames << " frames.";
+   }
+
+   return frames;
+}
+
+/***********************************************************************
+ *                          verifyRulesResult                          *
+ ***********************************************************************/
+void MatchSimulator::verifyRulesResult()
+{
+   bool diskPosition = false;
+   bool resolved = true;
+
+   Rules::ballAtFinalPosition(false);
+
+   switch(Rules::getState())
+   {
+      case Rules::STATE_MIDDLE:
+      {
+         /* A goal happened: reset the teams and put ball at middle */
+         Rules::setPositions();
+         Rules::clearFlags();
+      }
+      break;
+
+      case Rules::STATE_GOAL_KICK:
+      case Rules::STATE_FREE_KICK:
+      case Rules::STATE_PENALTY_KICK:
+      {
+         /* Remove disks from penalty areas */
+         coldet.removeFromPenaltyAreas();
+      }
+      case Rules::STATE_CORNER_KICK:
+      case Rules::STATE_THROW_IN:
+      {
+         /* Set the position and remove all contacts, isolating the ball */
+         Rules::setPositions();
+         resolved = coldet.removeContacts(true, field);
+         diskPosition = true;
+      }
+      break;
+
+      case Rules::STATE_NORMAL:
+      default:
+      {
+         /* Remove all contacts */
+         resolved = coldet.removeContacts(false, field);
+         Rules::setPositions();
+      }
+      break;
+   }
+
+   if(!resolved)
+   {
+      ThreadLog::getLog()->stream(Ogre::LML_CRITICAL)
+         << "MatchSimulator: couldn't remove all contacts.";
+   }
+
+   Rules::newTurn();
+
+   if(diskPosition)
+   {
+      /* Let the AI position the disk to do the kick */
+      Ogre::Vector3 ballPos = ball->getPosition();
+      Team* activeTeam = Rules::getActiveTeam();
+      activeTeam->getAI()->doDiskPosition(
+            activeTeam->getNearestPlayer(ballPos.x, ballPos.z));
+
+      if(Rules::getState() == Rules::STATE_PENALTY_KICK)
+      {
+         /* Penalty shoot: the "tell we'll shoot" is automatic */
+         prepareToShoot(true);
+      }
+   }
+}
+
@@ -0,0 +1,165 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _btsoccer_match_simulator_h
+#define _btsoccer_match_simulator_h
+
+#include "../btsoccer.h"
+#include "../physics/collision.h"
+#include "../physics/forceio.h"
+#include "rules.h"
+
+namespace BtSoccer
+{
+
+/** Simulated time (in ms) each turn spends before the shoot, as if
+ * the player was thinking on it. Added to the physics time to define
+ * the match clock. */
+#define MATCH_SIMULATOR_TURN_THINK_TIME     3000
+/** Maximum number of physics frames for a single turn to stabilize. */
+#define MATCH_SIMULATOR_MAX_TURN_FRAMES     2400
+/** Maximum number of tries for an AI to select its action. */
+#define MATCH_SIMULATOR_MAX_SELECT_TRIES    100
+/** Maximum number of turns for a single half, whatever its time. */
+#define MATCH_SIMULATOR_MAX_TURNS_PER_HALF  2000
+
+/*! Result of a simulated match, with its score and statistics.
+ * \note each array is indexed by 0 for teamA and 1 for teamB. */
+typedef struct _MatchSimulatorResult
+{
+   public:
+      int goals[2];       /**< Goals of each team */
+      int fouls[2];       /**< Fouls of each team */
+      int goalShoots[2];  /**< Goal shoots of each team */
+      int corners[2];     /**< Corners of each team */
+      int throwIns[2];    /**< Throw-ins of each team */
+      int goalKicks[2];   /**< Goal kicks of each team */
+      int penalties[2];   /**< Penalties of each team */
+      int moves[2];       /**< Total moves of each team */
+      int turns;          /**< Total turns played */
+      unsigned long physicsFrames; /**< Total physics frames done */
+      unsigned long simulatedTime; /**< Simulated match time (ms) */
+}MatchSimulatorResult;
+
+/*! The MatchSimulator plays complete AI versus AI matches without any
+ * graphical (or sound) element, reproducing the turn flow of 
+ * Core::gameCycle, but stepping physics as fast as possible. Usually
+ * used to tune AIs by playing lots of matches.
+ * \note the match clock is simulated: each turn takes its physics time
+ *       plus MATCH_SIMULATOR_TURN_THINK_TIME.
+ * \note each simulator has its own physics world and rules state, bound
+ *       to the calling thread while simulating, so different threads
+ *       could simulate at the same time, each one with its simulator. */
+class MatchSimulator
+{
+   public:
+      enum MatchSimulatorAITypes
+      {
+         AI_DECOURT,
+         AI_FUZZY,
+         AI_DUMMY,
+         AI_SEARCH
+      };
+
+      /*! Constructor
+       * \param minutesPerHalf duration of each half
+       * \param aiTeamA MatchSimulatorAITypes controlling teamA
+       * \param aiTeamB MatchSimulatorAITypes controlling teamB */
+      MatchSimulator(int minutesPerHalf, int aiTeamA, int aiTeamB);
+      /*! Destructor */
+      ~MatchSimulator();
+
+      /*! Define the record where the turns of next simulated matches
+       * will be recorded (cleared at each match start).
+       * \param record MatchRecord to use (not owned) or NULL to not 
+       *        record. */
+      void setMatchRecord(MatchRecord* record) { matchRecord = record; };
+
+      /*! Set names of the teams of next simulated matches
+       * \param nameA name of teamA
+       * \param nameB name of teamB */
+      void setTeamNames(Ogre::String nameA, Ogre::String nameB);
+
+      /*! Play a full match.
+       * \param result will receive the match's result and statistics. */
+      void simulate(MatchSimulatorResult& result);
+
+      /*! Get an AI type by its name.
+       * \param name AI name ("decourt", "fuzzy", "dummy" or "search")
+       * \return MatchSimulatorAITypes constant or -1 if unknown. */
+      static int getAIType(Ogre::String name);
+
+   protected:
+      /*! Create teams, field and ball for a new match */
+      void createScenario();
+      /*! Delete the scenario created by #createScenario */
+      void finishScenario();
+
+      /*! Create an AI to control a team.
+       * \param type MatchSimulatorAITypes constant
+       * \param t team to control */
+      BaseAI* createAI(int type, Team* t);
+
+      /*! Play a whole half of the match */
+      void playHalf(bool firstHalf, MatchSimulatorResult& result);
+
+      /*! Play a single turn: AI selection, shoot, physics and rules.
+       * \return simulated time the turn took (in ms). */
+      unsigned long playTurn(MatchSimulatorResult& result);
+
+      /*! Let the AI select its action, doing its shoot.
+       * \return true if the AI shooted, false if couldn't select one. */
+      bool selectAndShoot(BaseAI* ai);
+
+      /*! Apply the AI defined force, as Core::doTheShoot */
+      void doTheShoot(BaseAI* ai);
+
+      /*! Tell the rules a goal shoot will be done and position the
+       * opponent goal keeper, as Core::prepareToShoot */
+      void prepareToShoot(bool restric);
+
+      /*! Step physics frames until the world is stable
+       * \return number of frames done */
+      int runPhysics();
+
+      /*! Verify the result of the turn and position things to the
+       * next one, as Core::verifyRulesResult */
+      void verifyRulesResult();
+
+   private:
+      int minutesPerHalf;    /**< Minutes each half lasts */
+      int aiType[2];         /**< AI of each team */
+      Ogre::String teamNames[2]; /**< Name of each team */
+
+      PhysicsContext* physics; /**< Simulator's own bullet world */
+      RulesContext rules;    /**< Simulator's own rules state */
+      Collision coldet;      /**< Collision resolver */
+      ForceInput force;      /**< Force calculator */
+      Team* teamA;           /**< Current teamA */
+      Team* teamB;           /**< Current teamB */
+      Ball* ball;            /**< Current ball */
+      Field* field;          /**< Current field */
+      MatchRecord* matchRecord; /**< Record of the match, if any */
+};
+
+}
+
+#endif
+
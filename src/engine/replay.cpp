@@ -36,12 +36,9 @@ Replay::Replay(Field* pfield)
    
    gameField = pfield;
    
-   start = 0;
-   currentFrame = 0;
-   end = 0;
    replaying = false;
    lastTurnFrames[0] = 0;
-   lastTurnFrames[1] = 1;
+   lastTurnFrames[1] = 0;
    onlineGame = false;
 
    /* Load the Controller Texture */
@@ -86,7 +83,9 @@ void Replay::setBall(Ball *b)
  **************************************************************/
 void Replay::clear()
 {
-   end = start;
+   store.clear();
+   lastTurnFrames[0] = 0;
+   lastTurnFrames[1] = 0;
 }
 
 /**************************************************************
@@ -96,6 +95,8 @@ void Replay::updateData(ReplayData* repData)
 {
    int i;
 
+   repData->clear();
+
    if( (teamA) && (teamB) )
    {
       /* TeamA Goal Keeper */
@@ -138,17 +139,9 @@ void Replay::updateData()
       return;
    }
  
-   /* update date to current replay frame */
-   updateData(&data[end]);     
-    
-   /* setting new vector end position */
-   end = (end+1) % FRAMES_TO_REPLAY;
-   
-   /* if vector is full, shift elements */
-   if(end == start)
-   {
-      start = (start + 1) % FRAMES_TO_REPLAY;
-   }
+   /* update data to current frame and store it */
+   updateData(&curData);
+   store.addFrame(&curData);
 }
 
 /**************************************************************
@@ -157,7 +150,7 @@ void Replay::updateData()
 void Replay::newTurnStarted()
 {
    lastTurnFrames[0] = lastTurnFrames[1];
-   lastTurnFrames[1] = (end+1) % FRAMES_TO_REPLAY;
+   lastTurnFrames[1] = store.getEndFrame();
 }
 
 /**************************************************************
@@ -165,25 +158,8 @@ void Replay::newTurnStarted()
  **************************************************************/   
 ReplayData* Replay::getData(int frame)
 {
-   /* Transforming frame index from 0-FRAMES_TO_REPLAY to start-end */
-   frame = frame+start;
-   
-   /* Making sure frame is inside start-end interval */
-   if(end < start)
-   {
-      int end2 = end+FRAMES_TO_REPLAY;
-      if(frame >= end2)
-      {
-         frame = end2 - 1;
-      }
-   }
-   else if(frame >= end)
-   {
-      frame = end-1;
-   }
-   frame = frame % FRAMES_TO_REPLAY;
-   
-   return(&data[frame]);
+   /* The store clamps the frame to its interval */
+   return(store.getFrame(store.getFirstFrame() + frame));
 }
 
 /**************************************************************
@@ -191,7 +167,7 @@ ReplayData* Replay::getData(int frame)
  **************************************************************/
 void Replay::initReplay(bool startAtLastTwoTurns, bool onlineGame)
 {
-   if( (start == 0) && (end == 0) )
+   if(store.isEmpty())
    {
       /* no replay if no data! */
       replaying = false;
@@ -203,13 +179,14 @@ void Replay::initReplay(bool startAtLastTwoTurns, bool onlineGame)
 
    /* Set to replay' init */
    replaying = true;
-   if(startAtLastTwoTurns)
+   if( (startAtLastTwoTurns) && 
+       (lastTurnFrames[0] >= store.getFirstFrame()) )
    {
       position = lastTurnFrames[0];
    }
    else
    {
-      position = start;
+      position = store.getFirstFrame();
    }
    curSpeed = 1.0;
    delta = curSpeed;
@@ -237,8 +214,9 @@ int Replay::verifyEvents(int mouseX, int mouseY, bool leftButtonPressed)
    }
 
    /* Set current frame */
-   int frame = (int)(position) % FRAMES_TO_REPLAY;
-   int end2 = (end < start)?end+FRAMES_TO_REPLAY:end;
+   int frame = (int)(position);
+   int start = store.getFirstFrame();
+   int end = store.getEndFrame();
 
    /* Verify events */
    switch(replayGui->verifyEvents(mouseX, mouseY, leftButtonPressed))
@@ -333,9 +311,9 @@ int Replay::verifyEvents(int mouseX, int mouseY, bool leftButtonPressed)
    {
       position = start;
    }
-   else if(position >= end2)
+   else if(position >= end)
    {
-      position = end2-1;
+      position = end-1;
       if(onlineGame)
       {
          /* At online mode, must exit after end 
@@ -399,7 +377,11 @@ void Replay::setPositions(ReplayData* repData)
  **************************************************************/
 void Replay::setFramePositions(int frame)
 {
-   setPositions(&data[frame]);
+   ReplayData* repData = store.getFrame(frame);
+   if(repData)
+   {
+      setPositions(repData);
+   }
 }
 
 /**************************************************************
@@ -410,3 +392,593 @@ void Replay::restorePositions()
    setPositions(&prevPositions);
 }
 
+
+/**************************************************************
+ *                     ReplayData::clear                      *
+ **************************************************************/
+void ReplayData::clear()
+{
+   for(int i = 0; i < REPLAY_OBJECTS; i++)
+   {
+      getPosition(i) = Ogre::Vector3::ZERO;
+      getAngle(i) = Ogre::Quaternion::IDENTITY;
+   }
+}
+
+/**************************************************************
+ *                   ReplayData::getPosition                  *
+ **************************************************************/
+Ogre::Vector3& ReplayData::getPosition(int index)
+{
+   if(index == 0)
+   {
+      return ballPosition;
+   }
+   else if(index <= 11)
+   {
+      return teamAPositions[index - 1];
+   }
+   return teamBPositions[index - 12];
+}
+
+/**************************************************************
+ *                     ReplayData::getAngle                   *
+ **************************************************************/
+Ogre::Quaternion& ReplayData::getAngle(int index)
+{
+   if(index == 0)
+   {
+      return ballAngle;
+   }
+   else if(index <= 11)
+   {
+      return teamAAngles[index - 1];
+   }
+   return teamBAngles[index - 12];
+}
+
+/**************************************************************
+ *                 ReplayObjectState::clear                   *
+ **************************************************************/
+void ReplayObjectState::clear()
+{
+   for(int i = 0; i < 3; i++)
+   {
+      position[i] = 0;
+   }
+   for(int i = 0; i < 4; i++)
+   {
+      rotation[i] = 0;
+   }
+   rotationKind = ROTATION_NONE;
+}
+
+/**************************************************************
+ *                  ReplayBlock::ReplayBlock                  *
+ **************************************************************/
+ReplayBlock::ReplayBlock()
+{
+   totalFrames = 0;
+}
+
+/**************************************************************
+ *                     ReplayBlock::clear                     *
+ **************************************************************/
+void ReplayBlock::clear()
+{
+   /* Note: keeping the buffer capacity for reuse */
+   buffer.clear();
+   totalFrames = 0;
+}
+
+/**************************************************************
+ *                 ReplayStore::ReplayStore                   *
+ **************************************************************/
+ReplayStore::ReplayStore()
+{
+   for(int i = 0; i < REPLAY_MAX_BLOCKS; i++)
+   {
+      blocks[i] = NULL;
+   }
+   clear();
+}
+
+/**************************************************************
+ *                 ReplayStore::~ReplayStore                  *
+ **************************************************************/
+ReplayStore::~ReplayStore()
+{
+   for(int i = 0; i < REPLAY_MAX_BLOCKS; i++)
+   {
+      if(blocks[i])
+      {
+         delete blocks[i];
+      }
+   }
+}
+
+/**************************************************************
+ *                     ReplayStore::clear                     *
+ **************************************************************/
+void ReplayStore::clear()
+{
+   for(int i = 0; i < REPLAY_MAX_BLOCKS; i++)
+   {
+      if(blocks[i])
+      {
+         blocks[i]->clear();
+      }
+   }
+   firstFrame = 0;
+   endFrame = 0;
+   decodedFrame = -1;
+   decodedOffset = 0;
+}
+
+/**************************************************************
+ *                    ReplayStore::getBlock                   *
+ **************************************************************/
+ReplayBlock* ReplayStore::getBlock(int frame)
+{
+   return blocks[(frame / REPLAY_FRAMES_PER_BLOCK) % REPLAY_MAX_BLOCKS];
+}
+
+/**************************************************************
+ *                    ReplayStore::addFrame                   *
+ **************************************************************/
+void ReplayStore::addFrame(ReplayData* data)
+{
+   ReplayObjectState states[REPLAY_OBJECTS];
+   quantize(data, states);
+
+   bool keyFrame = (endFrame % REPLAY_FRAMES_PER_BLOCK) == 0;
+   int index = (endFrame / REPLAY_FRAMES_PER_BLOCK) % REPLAY_MAX_BLOCKS;
+   if(keyFrame)
+   {
+      /* Starting a new block */
+      if(!blocks[index])
+      {
+         blocks[index] = new ReplayBlock();
+      }
+      else
+      {
+         if((endFrame - firstFrame) >= 
+               REPLAY_FRAMES_PER_BLOCK * REPLAY_MAX_BLOCKS)
+         {
+            /* Reusing the oldest one: its frames are gone. */
+            firstFrame += REPLAY_FRAMES_PER_BLOCK;
+            if(decodedFrame < firstFrame)
+            {
+               decodedFrame = -1;
+            }
+         }
+         blocks[index]->clear();
+      }
+   }
+
+   encodeFrame(blocks[index], states, keyFrame);
+   endFrame++;
+}
+
+/**************************************************************
+ *                    ReplayStore::getFrame                   *
+ **************************************************************/
+ReplayData* ReplayStore::getFrame(int frame)
+{
+   if(isEmpty())
+   {
+      return NULL;
+   }
+
+   /* Clamp to stored interval */
+   if(frame < firstFrame)
+   {
+      frame = firstFrame;
+   }
+   else if(frame >= endFrame)
+   {
+      frame = endFrame - 1;
+   }
+
+   if(frame == decodedFrame)
+   {
+      /* Already decoded */
+      return &decodedData;
+   }
+
+   ReplayBlock* block = getBlock(frame);
+   int blockStart = frame - (frame % REPLAY_FRAMES_PER_BLOCK);
+   if( (decodedFrame < blockStart) || (decodedFrame > frame) )
+   {
+      /* Must restart decoding from the block's key frame */
+      for(int i = 0; i < REPLAY_OBJECTS; i++)
+      {
+         decoderState[i].clear();
+      }
+      decodedOffset = decodeFrame(block, 0, decoderState);
+      decodedFrame = blockStart;
+   }
+
+   /* Apply the deltas until the desired frame */
+   while(decodedFrame < frame)
+   {
+      decodedOffset = decodeFrame(block, decodedOffset, decoderState);
+      decodedFrame++;
+   }
+
+   dequantize(decoderState, &decodedData);
+   return &decodedData;
+}
+
+/**************************************************************
+ *                    ReplayStore::quantize                   *
+ **************************************************************/
+void ReplayStore::quantize(ReplayData* data, ReplayObjectState* states)
+{
+   for(int i = 0; i < REPLAY_OBJECTS; i++)
+   {
+      Ogre::Vector3& pos = data->getPosition(i);
+      for(int c = 0; c < 3; c++)
+      {
+         states[i].position[c] = (int)floorf(pos[c] * REPLAY_POSITION_SCALE 
+               + 0.5f);
+      }
+
+      Ogre::Quaternion q = data->getAngle(i);
+      q.normalise();
+      if(q.w < 0.0f)
+      {
+         /* Same rotation, but avoiding sign flips between frames */
+         q = -q;
+      }
+      states[i].rotation[1] = 0;
+      states[i].rotation[2] = 0;
+      states[i].rotation[3] = 0;
+      if( (fabs(q.x) < REPLAY_UPRIGHT_EPSILON) && 
+          (fabs(q.z) < REPLAY_UPRIGHT_EPSILON) )
+      {
+         /* Upright: only its yaw matters */
+         Ogre::Real yaw = 2.0f * atan2f(q.y, q.w);
+         states[i].rotation[0] = ((int)floorf(yaw / Ogre::Math::TWO_PI *
+                  REPLAY_YAW_STEPS + 0.5f)) & (REPLAY_YAW_STEPS - 1);
+         states[i].rotationKind = ReplayObjectState::ROTATION_YAW;
+      }
+      else
+      {
+         states[i].rotation[0] = (int)floorf(q.x * REPLAY_QUATERNION_SCALE 
+               + 0.5f);
+         states[i].rotation[1] = (int)floorf(q.y * REPLAY_QUATERNION_SCALE 
+               + 0.5f);
+         states[i].rotation[2] = (int)floorf(q.z * REPLAY_QUATERNION_SCALE 
+               + 0.5f);
+         states[i].rotation[3] = (int)floorf(q.w * REPLAY_QUATERNION_SCALE 
+               + 0.5f);
+         states[i].rotationKind = ReplayObjectState::ROTATION_QUATERNION;
+      }
+   }
+}
+
+/**************************************************************
+ *                   ReplayStore::dequantize                  *
+ **************************************************************/
+void ReplayStore::dequantize(ReplayObjectState* states, ReplayData* data)
+{
+   for(int i = 0; i < REPLAY_OBJECTS; i++)
+   {
+      data->getPosition(i) = Ogre::Vector3(
+            states[i].position[0] / REPLAY_POSITION_SCALE,
+            states[i].position[1] / REPLAY_POSITION_SCALE,
+            states[i].position[2] / REPLAY_POSITION_SCALE);
+
+      if(states[i].rotationKind == ReplayObjectState::ROTATION_YAW)
+      {
+         data->getAngle(i) = Ogre::Quaternion(Ogre::Radian(
+                  states[i].rotation[0] * Ogre::Math::TWO_PI / 
+                  REPLAY_YAW_STEPS), Ogre::Vector3::UNIT_Y);
+      }
+      else if(states[i].rotationKind == 
+              ReplayObjectState::ROTATION_QUATERNION)
+      {
+         Ogre::Quaternion q(states[i].rotation[3] / REPLAY_QUATERNION_SCALE,
+                            states[i].rotation[0] / REPLAY_QUATERNION_SCALE,
+                            states[i].rotation[1] / REPLAY_QUATERNION_SCALE,
+                            states[i].rotation[2] / REPLAY_QUATERNION_SCALE);
+         q.normalise();
+         data->getAngle(i) = q;
+      }
+      else
+      {
+         data->getAngle(i) = Ogre::Quaternion::IDENTITY;
+      }
+   }
+}
+
+/**************************************************************
+ *                  ReplayStore::encodeFrame                  *
+ **************************************************************/
+void ReplayStore::encodeFrame(ReplayBlock* block, ReplayObjectState* states,
+      bool keyFrame)
+{
+   int i, c;
+   unsigned int mask = 0;
+   unsigned char flags[REPLAY_OBJECTS];
+
+   if(keyFrame)
+   {
+      /* Key frames are against the initial state */
+      for(i = 0; i < REPLAY_OBJECTS; i++)
+      {
+         encoderState[i].clear();
+      }
+   }
+
+   /* Define what changed (unchanged objects are skipped) */
+   for(i = 0; i < REPLAY_OBJECTS; i++)
+   {
+      flags[i] = 0;
+      for(c = 0; c < 3; c++)
+      {
+         if(states[i].position[c] != encoderState[i].position[c])
+         {
+            flags[i] |= ReplayBlock::ENTRY_POSITION;
+         }
+      }
+      if(states[i].rotationKind != encoderState[i].rotationKind)
+      {
+         flags[i] |= ReplayBlock::ENTRY_ROTATION;
+      }
+      for(c = 0; c < 4; c++)
+      {
+         if(states[i].rotation[c] != encoderState[i].rotation[c])
+         {
+            flags[i] |= ReplayBlock::ENTRY_ROTATION;
+         }
+      }
+      if(states[i].rotationKind == ReplayObjectState::ROTATION_QUATERNION)
+      {
+         flags[i] |= ReplayBlock::ENTRY_QUATERNION;
+      }
+      if(flags[i] & (ReplayBlock::ENTRY_POSITION | 
+                     ReplayBlock::ENTRY_ROTATION))
+      {
+         mask |= (1 << i);
+      }
+   }
+
+   /* Write the mask */
+   block->buffer.push_back(mask & 0xFF);
+   block->buffer.push_back((mask >> 8) & 0xFF);
+   block->buffer.push_back((mask >> 16) & 0xFF);
+
+   /* And each changed object */
+   for(i = 0; i < REPLAY_OBJECTS; i++)
+   {
+      if(!(mask & (1 << i)))
+      {
+         continue;
+      }
+      block->buffer.push_back(flags[i]);
+      if(flags[i] & ReplayBlock::ENTRY_POSITION)
+      {
+         for(c = 0; c < 3; c++)
+         {
+            writeInt(block->buffer, 
+                  states[i].position[c] - encoderState[i].position[c]);
+         }
+      }
+      if(flags[i] & ReplayBlock::ENTRY_ROTATION)
+      {
+         bool sameKind = 
+            (states[i].rotationKind == encoderState[i].rotationKind);
+         if(states[i].rotationKind == ReplayObjectState::ROTATION_YAW)
+         {
+            /* Yaw delta, wrapped to the shortest turn */
+            int prev = (sameKind) ? encoderState[i].rotation[0] : 0;
+            int delta = (states[i].rotation[0] - prev) & 
+                        (REPLAY_YAW_STEPS - 1);
+            if(delta >= REPLAY_YAW_STEPS / 2)
+            {
+               delta -= REPLAY_YAW_STEPS;
+            }
+            writeInt(block->buffer, delta);
+         }
+         else
+         {
+            for(c = 0; c < 4; c++)
+            {
+               int prev = (sameKind) ? encoderState[i].rotation[c] : 0;
+               writeInt(block->buffer, states[i].rotation[c] - prev);
+            }
+         }
+      }
+      encoderState[i] = states[i];
+   }
+
+   block->totalFrames++;
+}
+
+/**************************************************************
+ *                  ReplayStore::decodeFrame                  *
+ **************************************************************/
+int ReplayStore::decodeFrame(ReplayBlock* block, int offset,
+      ReplayObjectState* states)
+{
+   int i, c;
+   if(offset + 3 > (int)block->buffer.size())
+   {
+      /* Malformed (only possible with loaded blocks) */
+      return offset;
+   }
+   unsigned int mask = block->buffer[offset] | 
+                       (block->buffer[offset + 1] << 8) |
+                       (block->buffer[offset + 2] << 16);
+   offset += 3;
+
+   for(i = 0; i < REPLAY_OBJECTS; i++)
+   {
+      if(!(mask & (1 << i)))
+      {
+         continue;
+      }
+      if(offset >= (int)block->buffer.size())
+      {
+         return offset;
+      }
+      unsigned char flags = block->buffer[offset];
+      offset++;
+      if(flags & ReplayBlock::ENTRY_POSITION)
+      {
+         for(c = 0; c < 3; c++)
+         {
+            states[i].position[c] += readInt(block->buffer, offset);
+         }
+      }
+      if(flags & ReplayBlock::ENTRY_ROTATION)
+      {
+         int kind = (flags & ReplayBlock::ENTRY_QUATERNION) ?
+            ReplayObjectState::ROTATION_QUATERNION :
+            ReplayObjectState::ROTATION_YAW;
+         if(kind != states[i].rotationKind)
+         {
+            /* Kind changed: values are absolute */
+            for(c = 0; c < 4; c++)
+            {
+               states[i].rotation[c] = 0;
+            }
+            states[i].rotationKind = kind;
+         }
+         if(kind == ReplayObjectState::ROTATION_YAW)
+         {
+            states[i].rotation[0] = (states[i].rotation[0] + 
+                  readInt(block->buffer, offset)) & (REPLAY_YAW_STEPS - 1);
+         }
+         else
+         {
+            for(c = 0; c < 4; c++)
+            {
+               states[i].rotation[c] += readInt(block->buffer, offset);
+            }
+         }
+      }
+   }
+
+   return offset;
+}
+
+/**************************************************************
+ *                      ReplayStore::save                     *
+ **************************************************************/
+void ReplayStore::save(std::vector<unsigned char>& out)
+{
+   writeInt(out, firstFrame);
+   writeInt(out, endFrame);
+
+   /* Each block with frames, from the oldest one */
+   for(int frame = firstFrame; frame < endFrame; 
+       frame += REPLAY_FRAMES_PER_BLOCK)
+   {
+      ReplayBlock* block = getBlock(frame);
+      writeInt(out, (int)block->buffer.size());
+      out.insert(out.end(), block->buffer.begin(), block->buffer.end());
+   }
+}
+
+/**************************************************************
+ *                      ReplayStore::load                     *
+ **************************************************************/
+bool ReplayStore::load(std::vector<unsigned char>& in, int& offset)
+{
+   clear();
+
+   if(offset >= (int)in.size())
+   {
+      return false;
+   }
+   int first = readInt(in, offset);
+   int end = readInt(in, offset);
+   if( (first < 0) || (end < first) || 
+       (first % REPLAY_FRAMES_PER_BLOCK != 0) ||
+       (end - first > REPLAY_FRAMES_PER_BLOCK * REPLAY_MAX_BLOCKS) )
+   {
+      return false;
+   }
+
+   for(int frame = first; frame < end; frame += REPLAY_FRAMES_PER_BLOCK)
+   {
+      if(offset >= (int)in.size())
+      {
+         clear();
+         return false;
+      }
+      int size = readInt(in, offset);
+      if( (size <= 0) || (offset + size > (int)in.size()) )
+      {
+         clear();
+         return false;
+      }
+      int index = (frame / REPLAY_FRAMES_PER_BLOCK) % REPLAY_MAX_BLOCKS;
+      if(!blocks[index])
+      {
+         blocks[index] = new ReplayBlock();
+      }
+      blocks[index]->buffer.assign(in.begin() + offset, 
+                                   in.begin() + offset + size);
+      blocks[index]->totalFrames = ((end - frame) < REPLAY_FRAMES_PER_BLOCK)?
+                                   (end - frame) : REPLAY_FRAMES_PER_BLOCK;
+      offset += size;
+   }
+   firstFrame = first;
+   endFrame = end;
+
+   if(!isEmpty())
+   {
+      /* Let the encoder continue from the last frame */
+      getFrame(endFrame - 1);
+      for(int i = 0; i < REPLAY_OBJECTS; i++)
+      {
+         encoderState[i] = decoderState[i];
+      }
+   }
+
+   return true;
+}
+
+/**************************************************************
+ *                    ReplayStore::writeInt                   *
+ **************************************************************/
+void ReplayStore::writeInt(std::vector<unsigned char>& buffer, int value)
+{
+   /* Zig-zag, to small absolute values use few bytes */
+   unsigned int v = (value < 0) ? (((unsigned int)(-(value + 1))) << 1) | 1 :
+                                  ((unsigned int)value) << 1;
+   while(v >= 0x80)
+   {
+      buffer.push_back((v & 0x7F) | 0x80);
+      v >>= 7;
+   }
+   buffer.push_back(v);
+}
+
+/**************************************************************
+ *                     ReplayStore::readInt                   *
+ **************************************************************/
+int ReplayStore::readInt(std::vector<unsigned char>& buffer, int& offset)
+{
+   unsigned int v = 0;
+   int shift = 0;
+   unsigned char b;
+   do
+   {
+      if( (offset >= (int)buffer.size()) || (shift > 28) )
+      {
+         /* Malformed: truncated or too long value */
+         return 0;
+      }
+      b = buffer[offset];
+      offset++;
+      v |= ((unsigned int)(b & 0x7F)) << shift;
+      shift += 7;
+   } while(b & 0x80);
+
+   return (v & 1) ? -((int)(v >> 1)) - 1 : (int)(v >> 1);
+}
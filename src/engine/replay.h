@@ -30,7 +30,22 @@
 
 #include "../gui/guireplay.h"
 
-#define FRAMES_TO_REPLAY 500  /**< Quantity of frames to replay */
+#include <vector>
+
+/*! Frames on each compressed replay block */
+#define REPLAY_FRAMES_PER_BLOCK   128
+/*! Max number of blocks kept. When full, the oldest block is discarded. */
+#define REPLAY_MAX_BLOCKS         256
+/*! Number of objects on each frame: ball, then 11 of teamA and 11 of teamB */
+#define REPLAY_OBJECTS            23
+/*! Quantization scale for positions (ie: 1/1000 of ogre units) */
+#define REPLAY_POSITION_SCALE     1000.0f
+/*! Quantization scale for quaternion components */
+#define REPLAY_QUATERNION_SCALE   32767.0f
+/*! Quantization steps for a yaw angle full turn */
+#define REPLAY_YAW_STEPS          65536
+/*! Max X and Z quaternion components for the object to be upright */
+#define REPLAY_UPRIGHT_EPSILON    0.0005f
 
 namespace BtSoccer
 {
@@ -48,10 +63,151 @@ class ReplayData
    
       Ogre::Vector3 ballPosition;        /**< Position of the ball */
       Ogre::Quaternion ballAngle;        /**< Angle of the ball */
+
+      /*! Set all positions to zero and angles to identity */
+      void clear();
+
+      /*! \return position of an object by its replay index
+       * (0: ball, 1-11: teamA, 12-22: teamB) */
+      Ogre::Vector3& getPosition(int index);
+      /*! \return angle of an object by its replay index */
+      Ogre::Quaternion& getAngle(int index);
+};
+
+/*! Quantized state of an object on a replay frame */
+class ReplayObjectState
+{
+   public:
+      enum RotationKind
+      {
+         /*! No rotation defined yet (at key frames start) */
+         ROTATION_NONE = 0,
+         /*! Upright object: only rotation[0] with yaw is used */
+         ROTATION_YAW,
+         /*! Full quaternion at rotation[0..3] (x, y, z, w) */
+         ROTATION_QUATERNION
+      };
+
+      int position[3];  /**< Quantized position */
+      int rotation[4];  /**< Quantized rotation, as defined by its kind */
+      int rotationKind; /**< Current RotationKind */
+
+      /*! Reset to the initial (no position, no rotation) state */
+      void clear();
+};
+
+/*! A block of REPLAY_FRAMES_PER_BLOCK compressed frames. The first frame 
+ * is a key frame (encoded against the cleared state), and each of the 
+ * others is encoded as the difference to its previous frame.
+ * Each frame is:
+ *   [0..2]  -> mask of the objects present on the frame (little endian)
+ *   For each present object:
+ *     flags -> ENTRY_POSITION | ENTRY_ROTATION | ENTRY_QUATERNION
+ *     if ENTRY_POSITION: 3 position deltas
+ *     if ENTRY_ROTATION: yaw delta or 4 quaternion components deltas
+ *                        (ENTRY_QUATERNION), against previous value if
+ *                        same kind or 0 otherwise.
+ * All deltas are zig-zag variable length integers. */
+class ReplayBlock
+{
+   public:
+      enum EntryFlags
+      {
+         ENTRY_POSITION   = 0x1,
+         ENTRY_ROTATION   = 0x2,
+         ENTRY_QUATERNION = 0x4
+      };
+
+      /*! Constructor */
+      ReplayBlock();
+
+      /*! Clear the block for reuse */
+      void clear();
+
+      std::vector<unsigned char> buffer; /**< Encoded frames */
+      int totalFrames;                   /**< Frames at the buffer */
+};
+
+/*! Compressed storage of replay frames, with random access to any of its
+ * frames. Memory is bounded by REPLAY_MAX_BLOCKS of 
+ * REPLAY_FRAMES_PER_BLOCK frames each. */
+class ReplayStore
+{
+   public:
+      /*! Constructor */
+      ReplayStore();
+      /*! Destructor */
+      ~ReplayStore();
+
+      /*! Clear all stored frames */
+      void clear();
+
+      /*! Add a frame to the end of the store
+       * \param data -> positions and angles of the frame */
+      void addFrame(ReplayData* data);
+
+      /*! Get a stored frame
+       * \param frame -> frame number, from #getFirstFrame to 
+       *        #getEndFrame - 1. Out of bounds are clamped.
+       * \return pointer to the decoded frame data (valid until next call)
+       *         or NULL if no frames stored. */
+      ReplayData* getFrame(int frame);
+
+      /*! \return number of the first frame still stored */
+      int getFirstFrame() { return firstFrame; };
+      /*! \return number of the frame after the last stored one */
+      int getEndFrame() { return endFrame; };
+      /*! \return if there's no stored frames */
+      bool isEmpty() { return firstFrame == endFrame; };
+
+      /*! Serialize the stored frames to the end of a buffer
+       * \param out -> buffer to append the frames to */
+      void save(std::vector<unsigned char>& out);
+      /*! Load frames serialized by #save, replacing current ones.
+       * \param in -> buffer with the serialized frames
+       * \param offset -> offset of the frames at the buffer. Will be
+       *        advanced to the end of them.
+       * \return false if the buffer is malformed */
+      bool load(std::vector<unsigned char>& in, int& offset);
+
+      /*! Write a zig-zag variable length integer */
+      static void writeInt(std::vector<unsigned char>& buffer, int value);
+      /*! Read a zig-zag variable length integer, advancing the offset */
+      static int readInt(std::vector<unsigned char>& buffer, int& offset);
+
+      /*! Quantize a frame data to object states */
+      void quantize(ReplayData* data, ReplayObjectState* states);
+      /*! Dequantize object states to a frame data */
+      void dequantize(ReplayObjectState* states, ReplayData* data);
+
+   protected:
+
+      /*! Encode a frame to the block, updating encoderState.
+       * \param keyFrame -> if is the block's key frame */
+      void encodeFrame(ReplayBlock* block, ReplayObjectState* states,
+            bool keyFrame);
+      /*! Decode the frame at offset of the block, updating the states.
+       * \return offset of the next frame */
+      int decodeFrame(ReplayBlock* block, int offset, 
+            ReplayObjectState* states);
+
+      /*! \return the block of a frame number */
+      ReplayBlock* getBlock(int frame);
+
+      ReplayBlock* blocks[REPLAY_MAX_BLOCKS]; /**< Ring of blocks */
+      int firstFrame;    /**< First frame still stored */
+      int endFrame;      /**< Frame number after the last stored */
+
+      ReplayObjectState encoderState[REPLAY_OBJECTS]; /**< Last encoded */
+      ReplayObjectState decoderState[REPLAY_OBJECTS]; /**< Last decoded */
+      int decodedFrame;  /**< Frame of decoderState, or -1 */
+      int decodedOffset; /**< Offset of the frame after decodedFrame */
+      ReplayData decodedData; /**< decoderState as positions and angles */
 };
 
-/*! The replay class saves FRAMES_TO_REPLAY frames and replay them at
- * any time, with a simple video controller. */
+/*! The replay class continuously saves the match frames (compressed at
+ * a ReplayStore) and replay them at any time, with a simple video 
+ * controller. */
 class Replay
 {
    public:
@@ -92,8 +248,9 @@ class Replay
       void newTurnStarted();
 
       /*! Get data for a desired frame
-       * \param frame -> frame number to get
-       * \return -> data of the desired frame */
+       * \param frame -> frame number to get, relative to the first
+       *        stored one.
+       * \return -> data of the desired frame or NULL, if none */
       ReplayData* getData(int frame);
 
       /*! Init the replay display
@@ -135,11 +292,9 @@ class Replay
       float position;                     /**< current position for frame */
       float curSpeed;                     /**< current frame change speed */
       
-      int start,                          /**< start frame on the vector */
-          currentFrame,                   /**< current frame on the vector */
-          end;                            /**< end frame on the vector */
       bool replaying;                     /**< true if is rendering replay */
-      ReplayData data[FRAMES_TO_REPLAY];  /**< The replay Vector */
+      ReplayStore store;                  /**< The stored frames */
+      ReplayData curData;                 /**< Frame being stored */
       ReplayData prevPositions;           /**< Positions before call replay */
    
       int lastTurnFrames[2];              /**< Init frame of last 2 turns */
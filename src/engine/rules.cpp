@@ -25,9 +25,9 @@
 #include "goalkeeper.h"
 #include "team.h"
 #include "teamplayer.h"
+#include "threadlog.h"
 #include "../net/protocol.h"
-
-#include <OGRE/OgreLogManager.h>
+#include "../physics/worldsnapshot.h"
 
 using namespace BtSoccer;
 
@@ -41,25 +41,27 @@ using namespace BtSoccer;
  **********************************************************************/
 void Rules::clear()
 {
+   RulesContext* ctx = getContext();
+
    /* Time */
-   halfMinutes = 0;
-   halfSeconds = 0;
-   periodTimer.reset();
+   ctx->halfMinutes = 0;
+   ctx->halfSeconds = 0;
+   ctx->periodTimer.reset();
 
    /* Remaining Things */
-   changedBallOwner = false;
-   currentDisk = NULL;
-   activeTeam = NULL;
-   remainingGlobalTouches = maxRemainingGlobalTouches();
-   remainingDiskTouches = 1; //Since middlefield kick
-   lastBallCollided = NULL;
-   ballAction = BALL_ACTION_NONE;
-   collidedBallFirst = false;
-   collidedOwnDiskFirst = false;
-   collidedEnemyDiskFirst = false;
+   ctx->changedBallOwner = false;
+   ctx->currentDisk = NULL;
+   ctx->activeTeam = NULL;
+   ctx->remainingGlobalTouches = maxRemainingGlobalTouches();
+   ctx->remainingDiskTouches = 1; //Since middlefield kick
+   ctx->lastBallCollided = NULL;
+   ctx->ballAction = BALL_ACTION_NONE;
+   ctx->collidedBallFirst = false;
+   ctx->collidedOwnDiskFirst = false;
+   ctx->collidedEnemyDiskFirst = false;
 
    /* Change the half */
-   state = STATE_MIDDLE;
+   ctx->state = STATE_MIDDLE;
 }
 
 /**********************************************************************
@@ -67,14 +69,16 @@ void Rules::clear()
  **********************************************************************/
 int Rules::maxRemainingDiskTouches()
 {
+   RulesContext* ctx = getContext();
+
    /* To not change remaining at "stoppped" states */
-   if(state == STATE_NORMAL)
+   if(ctx->state == STATE_NORMAL)
    {
       //TODO implement other Rules here in a switch!
       //switch(gameType)
       return(3);
    }
-   return(remainingDiskTouches);
+   return(ctx->remainingDiskTouches);
 }
 
 /**********************************************************************
@@ -91,8 +95,10 @@ int Rules::maxRemainingGlobalTouches()
  **********************************************************************/
 void Rules::clearTouchesCounters()
 {
-   remainingGlobalTouches = maxRemainingGlobalTouches();
-   remainingDiskTouches = 1;
+   RulesContext* ctx = getContext();
+
+   ctx->remainingGlobalTouches = maxRemainingGlobalTouches();
+   ctx->remainingDiskTouches = 1;
 }
 
 /**********************************************************************
@@ -100,14 +106,16 @@ void Rules::clearTouchesCounters()
  **********************************************************************/
 void Rules::changeTeamToAct()
 {
-   remainingGlobalTouches = maxRemainingGlobalTouches();
-   if(activeTeam == teamA)
+   RulesContext* ctx = getContext();
+
+   ctx->remainingGlobalTouches = maxRemainingGlobalTouches();
+   if(ctx->activeTeam == ctx->teamA)
    {
-      activeTeam = teamB;
+      ctx->activeTeam = ctx->teamB;
    }
    else
    {
-      activeTeam = teamA;
+      ctx->activeTeam = ctx->teamA;
    }
 }
 
@@ -116,7 +124,7 @@ void Rules::changeTeamToAct()
  **********************************************************************/
 int Rules::getState()
 {
-   return(state);
+   return(getContext()->state);
 }
 
 /**********************************************************************
@@ -124,7 +132,7 @@ int Rules::getState()
  **********************************************************************/
 void Rules::setState(int st)
 {
-   state = st;
+   getContext()->state = st;
 }
 
 /**********************************************************************
@@ -132,7 +140,7 @@ void Rules::setState(int st)
  **********************************************************************/
 Team* Rules::getInactiveTeam()
 {
-   return getOtherTeam(activeTeam);
+   return getOtherTeam(getContext()->activeTeam);
 }
 
 /**********************************************************************
@@ -140,7 +148,7 @@ Team* Rules::getInactiveTeam()
  **********************************************************************/
 Team* Rules::getActiveTeam()
 {
-   return(activeTeam);
+   return(getContext()->activeTeam);
 }
 
 /**********************************************************************
@@ -148,7 +156,7 @@ Team* Rules::getActiveTeam()
  **********************************************************************/
 void Rules::setActiveTeam(Team* t)
 {
-   activeTeam = t;
+   getContext()->activeTeam = t;
 }
 
 /**********************************************************************
@@ -156,12 +164,158 @@ void Rules::setActiveTeam(Team* t)
  **********************************************************************/
 void Rules::set(ProtocolParsedMessage& msg)
 {
-   Team* lastTeam = activeTeam;
-   state = msg.msgInfo;
-   activeTeam = (msg.msgAditionalInfo == UPDATE_TYPE_TEAM_A)?teamA:teamB;
-   changedBallOwner = (activeTeam != lastTeam);
+   RulesContext* ctx = getContext();
+
+   Team* lastTeam = ctx->activeTeam;
+   ctx->state = msg.msgInfo;
+   ctx->activeTeam = (msg.msgAditionalInfo == UPDATE_TYPE_TEAM_A) ?
+                     ctx->teamA : ctx->teamB;
+   ctx->changedBallOwner = (ctx->activeTeam != lastTeam);
    setRemainingTouches();
-   updateStatistics(state, lastTeam, activeTeam);
+   updateStatistics(ctx->state, lastTeam, ctx->activeTeam);
+}
+
+/**********************************************************************
+ *                        getTeamSnapshotIndex                        *
+ **********************************************************************/
+int Rules::getTeamSnapshotIndex(Team* t)
+{
+   RulesContext* ctx = getContext();
+   if(t == NULL)
+   {
+      return -1;
+   }
+   return (t == ctx->teamA) ? 0 : 1;
+}
+
+/**********************************************************************
+ *                          getSnapshotTeam                           *
+ **********************************************************************/
+Team* Rules::getSnapshotTeam(int index)
+{
+   RulesContext* ctx = getContext();
+   if(index < 0)
+   {
+      return NULL;
+   }
+   return (index == 0) ? ctx->teamA : ctx->teamB;
+}
+
+/**********************************************************************
+ *                        getDiskSnapshotIndex                        *
+ **********************************************************************/
+int Rules::getDiskSnapshotIndex(TeamPlayer* tp)
+{
+   RulesContext* ctx = getContext();
+   if((tp == NULL) || (ctx->teamA == NULL) || (ctx->teamB == NULL))
+   {
+      return -1;
+   }
+   return WorldSnapshot::getObjectIndex(tp, ctx->teamA, ctx->teamB, 
+         ctx->usedBall);
+}
+
+/**********************************************************************
+ *                          getSnapshotDisk                           *
+ **********************************************************************/
+TeamPlayer* Rules::getSnapshotDisk(int index)
+{
+   RulesContext* ctx = getContext();
+   if((index <= 0) || (ctx->teamA == NULL) || (ctx->teamB == NULL))
+   {
+      /* None (or the ball, which isn't a disk) */
+      return NULL;
+   }
+   return (TeamPlayer*) WorldSnapshot::getObject(index, ctx->teamA, 
+         ctx->teamB, ctx->usedBall);
+}
+
+/**********************************************************************
+ *                             getSnapshot                            *
+ **********************************************************************/
+void Rules::getSnapshot(RulesSnapshot& snap)
+{
+   RulesContext* ctx = getContext();
+
+   snap.state = ctx->state;
+   snap.secondHalf = ctx->secondHalf;
+   snap.willShoot = ctx->willShoot;
+   snap.remainingGlobalTouches = ctx->remainingGlobalTouches;
+   snap.remainingDiskTouches = ctx->remainingDiskTouches;
+   snap.currentDisk = getDiskSnapshotIndex(ctx->currentDisk);
+   snap.lastActiveDisk[0] = (ctx->teamA) ? 
+      getDiskSnapshotIndex(ctx->teamA->getLastActiveTeamPlayer()) : -1;
+   snap.lastActiveDisk[1] = (ctx->teamB) ? 
+      getDiskSnapshotIndex(ctx->teamB->getLastActiveTeamPlayer()) : -1;
+   snap.activeTeam = getTeamSnapshotIndex(ctx->activeTeam);
+   snap.upperTeam = getTeamSnapshotIndex(ctx->upperTeam);
+   snap.lastBallCollided = getTeamSnapshotIndex(ctx->lastBallCollided);
+   snap.changedBallOwner = ctx->changedBallOwner;
+   snap.collidedBallFirst = ctx->collidedBallFirst;
+   snap.collidedOwnDiskFirst = ctx->collidedOwnDiskFirst;
+   snap.collidedEnemyDiskFirst = ctx->collidedEnemyDiskFirst;
+   snap.ballAction = ctx->ballAction;
+   snap.pX = ctx->pX;
+   snap.pZ = ctx->pZ;
+   snap.ballUpper = ctx->ballUpper;
+   for(int i = 0; i < 2; i++)
+   {
+      snap.goals[i] = ctx->goals[i];
+      snap.fouls[i] = ctx->fouls[i];
+      snap.goalShoots[i] = ctx->goalShoots[i];
+      snap.corners[i] = ctx->corners[i];
+      snap.throwIns[i] = ctx->throwIns[i];
+      snap.goalKicks[i] = ctx->goalKicks[i];
+      snap.penalties[i] = ctx->penalties[i];
+      snap.totalMoves[i] = ctx->totalMoves[i];
+   }
+}
+
+/**********************************************************************
+ *                             setSnapshot                            *
+ **********************************************************************/
+void Rules::setSnapshot(const RulesSnapshot& snap)
+{
+   RulesContext* ctx = getContext();
+
+   ctx->state = snap.state;
+   ctx->secondHalf = (snap.secondHalf != 0);
+   ctx->willShoot = (snap.willShoot != 0);
+   ctx->remainingGlobalTouches = snap.remainingGlobalTouches;
+   ctx->remainingDiskTouches = snap.remainingDiskTouches;
+   ctx->currentDisk = getSnapshotDisk(snap.currentDisk);
+   if(ctx->teamA)
+   {
+      ctx->teamA->setLastActiveTeamPlayer(
+            getSnapshotDisk(snap.lastActiveDisk[0]));
+   }
+   if(ctx->teamB)
+   {
+      ctx->teamB->setLastActiveTeamPlayer(
+            getSnapshotDisk(snap.lastActiveDisk[1]));
+   }
+   ctx->activeTeam = getSnapshotTeam(snap.activeTeam);
+   ctx->upperTeam = getSnapshotTeam(snap.upperTeam);
+   ctx->lastBallCollided = getSnapshotTeam(snap.lastBallCollided);
+   ctx->changedBallOwner = (snap.changedBallOwner != 0);
+   ctx->collidedBallFirst = (snap.collidedBallFirst != 0);
+   ctx->collidedOwnDiskFirst = (snap.collidedOwnDiskFirst != 0);
+   ctx->collidedEnemyDiskFirst = (snap.collidedEnemyDiskFirst != 0);
+   ctx->ballAction = snap.ballAction;
+   ctx->pX = snap.pX;
+   ctx->pZ = snap.pZ;
+   ctx->ballUpper = (snap.ballUpper != 0);
+   for(int i = 0; i < 2; i++)
+   {
+      ctx->goals[i] = snap.goals[i];
+      ctx->fouls[i] = snap.fouls[i];
+      ctx->goalShoots[i] = snap.goalShoots[i];
+      ctx->corners[i] = snap.corners[i];
+      ctx->throwIns[i] = snap.throwIns[i];
+      ctx->goalKicks[i] = snap.goalKicks[i];
+      ctx->penalties[i] = snap.penalties[i];
+      ctx->totalMoves[i] = snap.totalMoves[i];
+   }
 }
 
 /**********************************************************************
@@ -169,7 +323,7 @@ void Rules::set(ProtocolParsedMessage& msg)
  **********************************************************************/
 TeamPlayer* Rules::getCurrentDisk()
 {
-   return currentDisk;
+   return getContext()->currentDisk;
 }
 
 /**********************************************************************
@@ -178,7 +332,7 @@ TeamPlayer* Rules::getCurrentDisk()
 void Rules::setCurrentDisk(TeamPlayer* tp)
 {
    /* Set it as the acting team player */
-   currentDisk = tp;
+   getContext()->currentDisk = tp;
    /* Set it as the last to act on the active team */
    getActiveTeam()->setLastActiveTeamPlayer(tp);
    /* And make sure the inactive team has no last active player. */
@@ -190,7 +344,7 @@ void Rules::setCurrentDisk(TeamPlayer* tp)
  **********************************************************************/
 Team* Rules::getUpperTeam()
 {
-   return upperTeam;
+   return getContext()->upperTeam;
 }
 
 /**********************************************************************
@@ -198,11 +352,13 @@ Team* Rules::getUpperTeam()
  **********************************************************************/
 Team* Rules::getOtherTeam(Team* t)
 {
-   if(t == teamA)
+   RulesContext* ctx = getContext();
+
+   if(t == ctx->teamA)
    {
-      return teamB;
+      return ctx->teamB;
    }
-   return teamA;
+   return ctx->teamA;
 }
 
 /**********************************************************************
@@ -210,7 +366,7 @@ Team* Rules::getOtherTeam(Team* t)
  **********************************************************************/
 void Rules::setUpperTeam(Team* t)
 {
-   upperTeam = t;
+   getContext()->upperTeam = t;
 }
 
 /**********************************************************************
@@ -218,7 +374,7 @@ void Rules::setUpperTeam(Team* t)
  **********************************************************************/
 Ball* Rules::getBall()
 {
-   return usedBall;
+   return getContext()->usedBall;
 }
 
 
@@ -227,7 +383,7 @@ Ball* Rules::getBall()
  **********************************************************************/
 void Rules::setBall(Ball* b)
 {
-   usedBall = b;
+   getContext()->usedBall = b;
 }
 
 /**********************************************************************
@@ -235,7 +391,7 @@ void Rules::setBall(Ball* b)
  **********************************************************************/
 Field* Rules::getField()
 {
-   return usedField;
+   return getContext()->usedField;
 }
 
 
@@ -244,7 +400,7 @@ Field* Rules::getField()
  **********************************************************************/
 void Rules::setField(Field* f)
 {
-   usedField = f;
+   getContext()->usedField = f;
 }
 
 /**********************************************************************
@@ -252,7 +408,7 @@ void Rules::setField(Field* f)
  **********************************************************************/
 void Rules::setTeamA(Team* t)
 {
-   teamA = t;
+   getContext()->teamA = t;
 }
 
 /**********************************************************************
@@ -260,7 +416,7 @@ void Rules::setTeamA(Team* t)
  **********************************************************************/
 void Rules::setTeamB(Team* t)
 {
-   teamB = t;
+   getContext()->teamB = t;
 }
 
 /**********************************************************************
@@ -268,7 +424,7 @@ void Rules::setTeamB(Team* t)
  **********************************************************************/
 Team* Rules::getTeamA()
 {
-   return teamA;
+   return getContext()->teamA;
 }
 
 /**********************************************************************
@@ -276,7 +432,7 @@ Team* Rules::getTeamA()
  **********************************************************************/
 Team* Rules::getTeamB()
 {
-   return teamB;
+   return getContext()->teamB;
 }
 
 /**********************************************************************
@@ -284,12 +440,14 @@ Team* Rules::getTeamB()
  **********************************************************************/
 bool Rules::setDiskAct(TeamPlayer* disk)
 {
-   if(currentDisk == disk)
+   RulesContext* ctx = getContext();
+
+   if(ctx->currentDisk == disk)
    {
-      if(remainingDiskTouches <= 0)
+      if(ctx->remainingDiskTouches <= 0)
       {
          /* Can't Use this disk! */
-         remainingDiskTouches = 0;
+         ctx->remainingDiskTouches = 0;
          return false;
       }
    }
@@ -298,26 +456,26 @@ bool Rules::setDiskAct(TeamPlayer* disk)
       /* Clear Disk Touches */
       setCurrentDisk(disk);
       /* Reset disk touches */
-      remainingDiskTouches = maxRemainingDiskTouches();
-      if(remainingDiskTouches < 0)
+      ctx->remainingDiskTouches = maxRemainingDiskTouches();
+      if(ctx->remainingDiskTouches < 0)
       {
-         remainingDiskTouches = 0;
+         ctx->remainingDiskTouches = 0;
       }
    }
  
-   Ogre::LogManager::getSingleton().stream()
-      << "Will dec: global: " << remainingGlobalTouches
-      << " disk: " << remainingDiskTouches;
+   ThreadLog::getLog()->stream()
+      << "Will dec: global: " << ctx->remainingGlobalTouches
+      << " disk: " << ctx->remainingDiskTouches;
 
    /* Decrease Disk Touches */
-   remainingDiskTouches--;
-   if(remainingDiskTouches < 0)
+   ctx->remainingDiskTouches--;
+   if(ctx->remainingDiskTouches < 0)
    {
       /* To avoid underflow  */
-      remainingDiskTouches = 0;
+      ctx->remainingDiskTouches = 0;
    }
    /* Decrease Global Touches */
-   remainingGlobalTouches--;
+   ctx->remainingGlobalTouches--;
 
    return true;
 }
@@ -327,7 +485,7 @@ bool Rules::setDiskAct(TeamPlayer* disk)
  **********************************************************************/
 void Rules::setBallAct()
 {
-   remainingGlobalTouches--;
+   getContext()->remainingGlobalTouches--;
 }
 
 /**********************************************************************
@@ -335,7 +493,7 @@ void Rules::setBallAct()
  **********************************************************************/
 int Rules::getRemainingTouches()
 {
-   return remainingGlobalTouches;
+   return getContext()->remainingGlobalTouches;
 }
 
 /**********************************************************************
@@ -343,7 +501,7 @@ int Rules::getRemainingTouches()
  **********************************************************************/
 void Rules::setGlobalRemainingTouches(int t)
 {
-   remainingGlobalTouches = t;
+   getContext()->remainingGlobalTouches = t;
 }
 
 /**********************************************************************
@@ -351,19 +509,21 @@ void Rules::setGlobalRemainingTouches(int t)
  **********************************************************************/
 int Rules::getRemainingTouches(TeamPlayer* disk)
 {
-   if(disk == currentDisk)
+   RulesContext* ctx = getContext();
+
+   if(disk == ctx->currentDisk)
    {
       /* Is the current, so */
-      return remainingDiskTouches;
+      return ctx->remainingDiskTouches;
    }
 
    /* Isn't the current, so get max remaining */
    int res = maxRemainingDiskTouches();
 
    /* Make shure the remaining disk touches is lesser or equal to global */
-   if(res > remainingGlobalTouches)
+   if(res > ctx->remainingGlobalTouches)
    {
-      res = remainingGlobalTouches;
+      res = ctx->remainingGlobalTouches;
    }
    return res;
 }
@@ -373,7 +533,7 @@ int Rules::getRemainingTouches(TeamPlayer* disk)
  **********************************************************************/
 void Rules::setDiskRemainingTouches(int t)
 {
-   remainingDiskTouches = t;
+   getContext()->remainingDiskTouches = t;
 }
 
 /*********************************************************************
@@ -381,44 +541,49 @@ void Rules::setDiskRemainingTouches(int t)
  *********************************************************************/
 void Rules::setPositions()
 {
-   bool isTeamAUpper = (upperTeam == teamA);
-   bool isTeamAActing = (activeTeam == teamA);
+   RulesContext* ctx = getContext();
+
+   bool isTeamAUpper = (ctx->upperTeam == ctx->teamA);
+   bool isTeamAActing = (ctx->activeTeam == ctx->teamA);
 
    //bool ballUpperSide = (usedBall->getPosX() >= FIELD_MIDDLE_X);
 
    float x=0, z=0;
 
-   Ogre::Vector2 halfSize = usedField->getHalfSize();
-   Ogre::Vector2 sideDelta = usedField->getSideDelta();
-   Ogre::Vector2 littleAreaDelta = usedField->getLittleAreaDelta();
+   Ogre::Vector2 halfSize = ctx->usedField->getHalfSize();
+   Ogre::Vector2 sideDelta = ctx->usedField->getSideDelta();
+   Ogre::Vector2 littleAreaDelta = ctx->usedField->getLittleAreaDelta();
+
+   /* Place everyone, settling them with a single physics step */
+   BulletLink::beginPlacement();
 
-   if(willShoot)
+   if(ctx->willShoot)
    {
       /* Called after a goal shoot. Must reset goalkeepers positions 
        * to respective goal middles. */
-      teamB->getGoalKeeper()->startPositionAtField(!isTeamAUpper, 
-            usedField);
-      teamA->getGoalKeeper()->startPositionAtField(isTeamAUpper, 
-            usedField);
+      ctx->teamB->getGoalKeeper()->startPositionAtField(!isTeamAUpper, 
+            ctx->usedField);
+      ctx->teamA->getGoalKeeper()->startPositionAtField(isTeamAUpper, 
+            ctx->usedField);
    }
    
-   switch(state)
+   switch(ctx->state)
    {
       case STATE_MIDDLE:
       {
-         teamA->startPositionAtField(isTeamAUpper, isTeamAActing,
-                                     usedField);
-         teamB->startPositionAtField(!isTeamAUpper, !isTeamAActing,
-                                     usedField);
+         ctx->teamA->startPositionAtField(isTeamAUpper, isTeamAActing,
+                                     ctx->usedField);
+         ctx->teamB->startPositionAtField(!isTeamAUpper, !isTeamAActing,
+                                     ctx->usedField);
          /* Put Ball At Center */
-         usedBall->setPosition(FIELD_MIDDLE_X, 0.0f, FIELD_MIDDLE_Z);
+         ctx->usedBall->setPosition(FIELD_MIDDLE_X, 0.0f, FIELD_MIDDLE_Z);
       }
       break;
 
       case STATE_CORNER_KICK:
       {
          /* Define X Position */
-         if(ballUpper)
+         if(ctx->ballUpper)
          {
             x = halfSize[0] - sideDelta[0] - 0.05f;
          }
@@ -428,7 +593,7 @@ void Rules::setPositions()
          }
          
          /* Define Z position */
-         if(pZ >= FIELD_MIDDLE_Z)
+         if(ctx->pZ >= FIELD_MIDDLE_Z)
          {
             z = halfSize[1] - sideDelta[1] - 0.05f;
          }  
@@ -438,15 +603,15 @@ void Rules::setPositions()
          }
 
          /* Put Ball At Corner */
-         usedBall->setPosition(x, 0.0, z);
+         ctx->usedBall->setPosition(x, 0.0, z);
       }
       break;
 
       case STATE_THROW_IN:
       {
          /* Put Ball At Exit X Position, and SIDE */
-         x = pX;
-         if(pZ > 0)
+         x = ctx->pX;
+         if(ctx->pZ > 0)
          {
             z = halfSize[1] - sideDelta[1] - 0.05f;
          }
@@ -454,14 +619,14 @@ void Rules::setPositions()
          {
             z = -halfSize[1] + sideDelta[1] + 0.05f;
          }
-         usedBall->setPosition(pX, 0.0, z);
+         ctx->usedBall->setPosition(ctx->pX, 0.0, z);
       }
       break;
 
       case STATE_GOAL_KICK:
       {
          /* Define X Position */
-         if(ballUpper)
+         if(ctx->ballUpper)
          {
             x = halfSize[0] - littleAreaDelta[0];
          }
@@ -471,7 +636,7 @@ void Rules::setPositions()
          }
          
          /* Define Z position */
-         if(pZ >= FIELD_MIDDLE_Z)
+         if(ctx->pZ >= FIELD_MIDDLE_Z)
          {
             z = FIELD_MIDDLE_Z + littleAreaDelta[1];
          }  
@@ -481,35 +646,37 @@ void Rules::setPositions()
          }
 
          /* Put Ball At Little Area */
-         usedBall->setPosition(x, 0.0, z);
+         ctx->usedBall->setPosition(x, 0.0, z);
       }
       break;
 
       case STATE_FREE_KICK:
       {
          /* Put Ball At Foul Position, making sure it's in-field */
-         usedField->getNearestPointInPlayableArea(pX, pZ);
-         usedBall->setPosition(pX, 0.0, pZ);
+         ctx->usedField->getNearestPointInPlayableArea(ctx->pX, ctx->pZ);
+         ctx->usedBall->setPosition(ctx->pX, 0.0, ctx->pZ);
       }
       break;
 
       case STATE_PENALTY_KICK:
       {
          /* Set X Position */  
-         if(pX <= FIELD_MIDDLE_X)
+         if(ctx->pX <= FIELD_MIDDLE_X)
          {
-            x = -halfSize[0] + usedField->getPenaltyMark();
+            x = -halfSize[0] + ctx->usedField->getPenaltyMark();
          }
          else
          {
-            x = halfSize[0] - usedField->getPenaltyMark();
+            x = halfSize[0] - ctx->usedField->getPenaltyMark();
          }
          
          /* Put Ball At Penalty Mark */
-         usedBall->setPosition(x, 0.0, z);
+         ctx->usedBall->setPosition(x, 0.0, z);
       }
       break;
    }
+
+   BulletLink::endPlacement();
 }
 
 /**********************************************************************
@@ -517,13 +684,15 @@ void Rules::setPositions()
  **********************************************************************/
 void Rules::clearFlags()
 {
-   collidedBallFirst = false;
-   collidedOwnDiskFirst = false;
-   collidedEnemyDiskFirst = false;
-   ballAction = BALL_ACTION_NONE;
-   pX = -1;
-   pZ = -1;
-   lastBallCollided = activeTeam;
+   RulesContext* ctx = getContext();
+
+   ctx->collidedBallFirst = false;
+   ctx->collidedOwnDiskFirst = false;
+   ctx->collidedEnemyDiskFirst = false;
+   ctx->ballAction = BALL_ACTION_NONE;
+   ctx->pX = -1;
+   ctx->pZ = -1;
+   ctx->lastBallCollided = ctx->activeTeam;
 }
 
 /**********************************************************************
@@ -531,29 +700,33 @@ void Rules::clearFlags()
  **********************************************************************/
 Team* Rules::newTurn()
 {
+   RulesContext* ctx = getContext();
+
    /* Clear things */
-   willShoot = (state == STATE_PENALTY_KICK);
+   ctx->willShoot = (ctx->state == STATE_PENALTY_KICK);
    clearFlags();
    
    /* Tell GUI which team is active */
-   GuiScore::newTurn(activeTeam == teamA);
+   GuiScore::newTurn(ctx->activeTeam == ctx->teamA);
 
-   Ogre::Log::Stream stream = Ogre::LogManager::getSingleton().stream();
+   Ogre::Log::Stream stream = ThreadLog::getLog()->stream();
    stream << "\n***************************************************\n"
-          << "* New Turn. Active Team: " << activeTeam->getName() << "\n";
-   if(currentDisk != NULL)
+          << "* New Turn. Active Team: " << ctx->activeTeam->getName() << "\n";
+   if(ctx->currentDisk != NULL)
    {
-      stream << "* Active Disk: " << currentDisk->getName() << "\n";
+      stream << "* Active Disk: " << ctx->currentDisk->getName() << "\n";
    }
    else
    {
       stream << "* Active Disk: None\n";
    }
-   stream << "* Remaining Global Touches: " << remainingGlobalTouches << "\n"
-          << "* Remaining active disk touches: " << remainingDiskTouches << "\n"
-          << "* State: " << state;
+   stream << "* Remaining Global Touches: " << ctx->remainingGlobalTouches 
+          << "\n"
+          << "* Remaining active disk touches: " << ctx->remainingDiskTouches 
+          << "\n"
+          << "* State: " << ctx->state;
 
-   return activeTeam;
+   return ctx->activeTeam;
 }
 
 /**********************************************************************
@@ -561,34 +734,38 @@ Team* Rules::newTurn()
  **********************************************************************/
 void Rules::startHalf(bool firstHalf)
 {
+   RulesContext* ctx = getContext();
+
    clear();
 
-   secondHalf = !firstHalf;
+   ctx->secondHalf = !firstHalf;
 
    /* Set first player to act */
    if(firstHalf)
    {
-      activeTeam = teamA;
-      upperTeam = teamB;
+      ctx->activeTeam = ctx->teamA;
+      ctx->upperTeam = ctx->teamB;
    }
    else
    {
-      activeTeam = teamB;
-      upperTeam = teamA;
+      ctx->activeTeam = ctx->teamB;
+      ctx->upperTeam = ctx->teamA;
    }
 
    /* Put everyone at middle state positions */
-   state = STATE_MIDDLE;
-   teamA->startPositionAtField((upperTeam == teamA), (activeTeam == teamA),
-                               usedField);
-   teamB->startPositionAtField((upperTeam == teamB), (activeTeam == teamB),
-                               usedField);
-   usedBall->setPosition(FIELD_MIDDLE_X, 0.0f, FIELD_MIDDLE_Z);
+   ctx->state = STATE_MIDDLE;
+   BulletLink::beginPlacement();
+   ctx->teamA->startPositionAtField((ctx->upperTeam == ctx->teamA), 
+         (ctx->activeTeam == ctx->teamA), ctx->usedField);
+   ctx->teamB->startPositionAtField((ctx->upperTeam == ctx->teamB), 
+         (ctx->activeTeam == ctx->teamB), ctx->usedField);
+   ctx->usedBall->setPosition(FIELD_MIDDLE_X, 0.0f, FIELD_MIDDLE_Z);
+   BulletLink::endPlacement();
    
    /* Tell GUI which team is active */
    if(GuiScore::isInited())
    {
-      GuiScore::newTurn(activeTeam == teamA);
+      GuiScore::newTurn(ctx->activeTeam == ctx->teamA);
    }
 }
 
@@ -597,12 +774,14 @@ void Rules::startHalf(bool firstHalf)
  **********************************************************************/
 bool Rules::updateClock()
 {
-   unsigned long time = periodTimer.getMilliseconds();
+   RulesContext* ctx = getContext();
 
-   halfSeconds = ((time / 1000) % 60);
-   halfMinutes = time / 60000;
+   unsigned long time = ctx->periodTimer.getMilliseconds();
 
-   return (halfMinutes >= minutesPerHalf);
+   ctx->halfSeconds = ((time / 1000) % 60);
+   ctx->halfMinutes = time / 60000;
+
+   return (ctx->halfMinutes >= ctx->minutesPerHalf);
 }
 
 /**********************************************************************
@@ -610,7 +789,7 @@ bool Rules::updateClock()
  **********************************************************************/
 unsigned long Rules::getCurrentHalfTime()
 {
-   return periodTimer.getMilliseconds();
+   return getContext()->periodTimer.getMilliseconds();
 }
 
 /**********************************************************************
@@ -618,7 +797,7 @@ unsigned long Rules::getCurrentHalfTime()
  **********************************************************************/
 void Rules::setCurrentHalfTime(unsigned long ms)
 {
-   periodTimer.reset(ms);
+   getContext()->periodTimer.reset(ms);
 }
 
 /**********************************************************************
@@ -626,7 +805,7 @@ void Rules::setCurrentHalfTime(unsigned long ms)
  **********************************************************************/
 void Rules::pause()
 {
-   periodTimer.pause();
+   getContext()->periodTimer.pause();
 }
 
 /**********************************************************************
@@ -634,7 +813,7 @@ void Rules::pause()
  **********************************************************************/
 void Rules::resume()
 {
-   periodTimer.resume();
+   getContext()->periodTimer.resume();
 }
 
 /**********************************************************************
@@ -642,7 +821,7 @@ void Rules::resume()
  **********************************************************************/
 void Rules::setGameType(int type)
 {
-   gameType = type;
+   getContext()->gameType = type;
 }
 
 /**********************************************************************
@@ -650,7 +829,7 @@ void Rules::setGameType(int type)
  **********************************************************************/
 void Rules::setMinutesPerHalf(int minutes)
 {
-   minutesPerHalf = minutes;
+   getContext()->minutesPerHalf = minutes;
 }
 
 /**********************************************************************
@@ -658,7 +837,7 @@ void Rules::setMinutesPerHalf(int minutes)
  **********************************************************************/
 bool Rules::isFirstHalf()
 {
-   return !secondHalf;
+   return !getContext()->secondHalf;
 }
 
 /**********************************************************************
@@ -666,7 +845,7 @@ bool Rules::isFirstHalf()
  **********************************************************************/
 void Rules::setHalf(bool first)
 {
-   secondHalf = !first;
+   getContext()->secondHalf = !first;
 }
 
 /**********************************************************************
@@ -674,8 +853,10 @@ void Rules::setHalf(bool first)
  **********************************************************************/
 void Rules::prepareToShoot()
 {
-   willShoot = true;
-   Stats::goalShoot(activeTeam == teamA);
+   RulesContext* ctx = getContext();
+
+   ctx->willShoot = true;
+   Stats::goalShoot(ctx->activeTeam == ctx->teamA);
 }
 
 /**********************************************************************
@@ -683,7 +864,7 @@ void Rules::prepareToShoot()
  **********************************************************************/
 bool Rules::goalShootDefined()
 {
-   return willShoot;
+   return getContext()->willShoot;
 }
 
 /**********************************************************************
@@ -692,21 +873,23 @@ bool Rules::goalShootDefined()
 void Rules::diskCollideDisk(Team* diskPlayer1, Team* diskPlayer2,
                             float x, float z)
 {
-   if( (!collidedBallFirst) && 
-       (!collidedOwnDiskFirst) && 
-       (!collidedEnemyDiskFirst) &&
-       ( (activeTeam == diskPlayer1) || 
-         (activeTeam == diskPlayer2)) )
+   RulesContext* ctx = getContext();
+
+   if( (!ctx->collidedBallFirst) && 
+       (!ctx->collidedOwnDiskFirst) && 
+       (!ctx->collidedEnemyDiskFirst) &&
+       ( (ctx->activeTeam == diskPlayer1) || 
+         (ctx->activeTeam == diskPlayer2)) )
    {
-      pX = x;
-      pZ = z;
+      ctx->pX = x;
+      ctx->pZ = z;
       if(diskPlayer1 != diskPlayer2)
       {
-         collidedEnemyDiskFirst = true;
+         ctx->collidedEnemyDiskFirst = true;
       }
       else
       {
-         collidedOwnDiskFirst = true;
+         ctx->collidedOwnDiskFirst = true;
       }
    }
 }
@@ -716,20 +899,22 @@ void Rules::diskCollideDisk(Team* diskPlayer1, Team* diskPlayer2,
  **********************************************************************/
 void Rules::ballCollideDisk(Team* player)
 {
+   RulesContext* ctx = getContext();
+
    /* Define last player contact the ball, if ball not already exited
     * the field */
-   if(ballAction == BALL_ACTION_NONE)
+   if(ctx->ballAction == BALL_ACTION_NONE)
    {
-      lastBallCollided = player;
+      ctx->lastBallCollided = player;
    }
    
 
    /* Define if activeTeam disk player collidedd with ball first */
-   if( (ballAction == BALL_ACTION_NONE) && 
-       (player == activeTeam) && 
-       (!collidedOwnDiskFirst) && (!collidedEnemyDiskFirst) )
+   if( (ctx->ballAction == BALL_ACTION_NONE) && 
+       (player == ctx->activeTeam) && 
+       (!ctx->collidedOwnDiskFirst) && (!ctx->collidedEnemyDiskFirst) )
    {
-      collidedBallFirst = true;
+      ctx->collidedBallFirst = true;
    }
 }
 
@@ -738,11 +923,13 @@ void Rules::ballCollideDisk(Team* player)
  **********************************************************************/
 void Rules::ballExitAtSide(float x, float z)
 {
-   if( (!collidedEnemyDiskFirst) && (ballAction == BALL_ACTION_NONE) )
+   RulesContext* ctx = getContext();
+
+   if( (!ctx->collidedEnemyDiskFirst) && (ctx->ballAction == BALL_ACTION_NONE) )
    {
-      ballAction = BALL_ACTION_SIDE;
-      pX = x;
-      pZ = z;
+      ctx->ballAction = BALL_ACTION_SIDE;
+      ctx->pX = x;
+      ctx->pZ = z;
    }
 }
 
@@ -751,12 +938,14 @@ void Rules::ballExitAtSide(float x, float z)
  **********************************************************************/
 void Rules::ballExitAtByline(bool upper, float z)
 {
-   if( (!collidedEnemyDiskFirst) && (ballAction == BALL_ACTION_NONE) )
+   RulesContext* ctx = getContext();
+
+   if( (!ctx->collidedEnemyDiskFirst) && (ctx->ballAction == BALL_ACTION_NONE) )
    {
-      ballAction = BALL_ACTION_BYLINE;
-      pX = -1;
-      pZ = z;
-      ballUpper = upper;
+      ctx->ballAction = BALL_ACTION_BYLINE;
+      ctx->pX = -1;
+      ctx->pZ = z;
+      ctx->ballUpper = upper;
    }
 }
 
@@ -765,10 +954,12 @@ void Rules::ballExitAtByline(bool upper, float z)
  **********************************************************************/
 void Rules::ballEnterGoal(bool upper)
 {
-   if( (!collidedEnemyDiskFirst) && (ballAction == BALL_ACTION_NONE) )
+   RulesContext* ctx = getContext();
+
+   if( (!ctx->collidedEnemyDiskFirst) && (ctx->ballAction == BALL_ACTION_NONE) )
    {
-      ballAction = BALL_ACTION_GOAL;
-      ballUpper = upper;
+      ctx->ballAction = BALL_ACTION_GOAL;
+      ctx->ballUpper = upper;
    }
 }
 
@@ -777,29 +968,31 @@ void Rules::ballEnterGoal(bool upper)
  **********************************************************************/
 void Rules::verifyGoalValid(bool onlineMode)
 {
+   RulesContext* ctx = getContext();
+
    /* Verify of witch team the goal is from */
-   bool teamAGoal = ( ( (ballUpper) && (upperTeam != teamA) ) ||
-                      ( (!ballUpper) && (upperTeam == teamA) ) );
+   bool teamAGoal = ( ( (ctx->ballUpper) && (ctx->upperTeam != ctx->teamA) ) ||
+                      ( (!ctx->ballUpper) && (ctx->upperTeam == ctx->teamA) ) );
    
    bool valid = false;
    
    /* If auto goal, always valid. */
-   if( ((teamAGoal) && (activeTeam == teamB)) ||
-       ((!teamAGoal) && (activeTeam == teamA)) )
+   if( ((teamAGoal) && (ctx->activeTeam == ctx->teamB)) ||
+       ((!teamAGoal) && (ctx->activeTeam == ctx->teamA)) )
    {
       valid = true;
    }
    /* Otherwise, will be valid if defined goal shoot */
-   else if(willShoot)
+   else if(ctx->willShoot)
    {
       /* AND not knocked-down opponent's gk. */
       if(teamAGoal)
       {
-         valid = teamB->getGoalKeeper()->isFacingUp();
+         valid = ctx->teamB->getGoalKeeper()->isFacingUp();
       }
       else
       {
-         valid = teamA->getGoalKeeper()->isFacingUp();
+         valid = ctx->teamA->getGoalKeeper()->isFacingUp();
       }
    }
    
@@ -807,27 +1000,31 @@ void Rules::verifyGoalValid(bool onlineMode)
    if(valid)
    {
       GuiMessage::set("Goal!");
-      if(teamAGoal)
+      Stats::goal(teamAGoal);
+      if(GuiScore::isInited())
       {
-         GuiScore::goalTeamA();
-      }
-      else
-      {
-         GuiScore::goalTeamB();
+         if(teamAGoal)
+         {
+            GuiScore::goalTeamA();
+         }
+         else
+         {
+            GuiScore::goalTeamB();
+         }
       }
       if(onlineMode)
       {
          Protocol protocol;
          protocol.queueGoalHappened(teamAGoal);
       }
-      state = STATE_MIDDLE;
+      ctx->state = STATE_MIDDLE;
       /* Reset Touches */
-      remainingGlobalTouches = maxRemainingGlobalTouches();
-      remainingDiskTouches = 1;
+      ctx->remainingGlobalTouches = maxRemainingGlobalTouches();
+      ctx->remainingDiskTouches = 1;
    }
    else
    {
-      state = STATE_GOAL_KICK;
+      ctx->state = STATE_GOAL_KICK;
    }
 }
 
@@ -836,7 +1033,7 @@ void Rules::verifyGoalValid(bool onlineMode)
  **********************************************************************/
 bool Rules::changedTeamToAct()
 {
-   return changedBallOwner;
+   return getContext()->changedBallOwner;
 }
 
 /**********************************************************************
@@ -844,7 +1041,9 @@ bool Rules::changedTeamToAct()
  **********************************************************************/
 void Rules::showStateMessage()
 {
-   switch(state)
+   RulesContext* ctx = getContext();
+
+   switch(ctx->state)
    {
       case STATE_PENALTY_KICK:
       {
@@ -863,8 +1062,8 @@ void Rules::showStateMessage()
       break;
       case STATE_GOAL_KICK:
       {
-         if( (ballAction == BALL_ACTION_GOAL) &&
-             (collidedBallFirst) )
+         if( (ctx->ballAction == BALL_ACTION_GOAL) &&
+             (ctx->collidedBallFirst) )
          {
             GuiMessage::set("Invalid Goal!");
          }
@@ -881,7 +1080,7 @@ void Rules::showStateMessage()
       break;
       case STATE_NORMAL:
       {
-         if(remainingGlobalTouches <= 0)
+         if(ctx->remainingGlobalTouches <= 0)
          {
             GuiMessage::set("No remaining moves!");
          }
@@ -895,47 +1094,49 @@ void Rules::showStateMessage()
  **********************************************************************/
 void Rules::ballAtFinalPosition(bool onlineMode)
 {
+   RulesContext* ctx = getContext();
+
    /* The System is stable, so verify things to the next turn */
-   bool isUpTeamActing = (activeTeam == upperTeam);
+   bool isUpTeamActing = (ctx->activeTeam == ctx->upperTeam);
 
    /* If shooted, always change team to act */
-   changedBallOwner = willShoot;
+   ctx->changedBallOwner = ctx->willShoot;
 
    /* Verify Fouls */
-   if(collidedEnemyDiskFirst)
+   if(ctx->collidedEnemyDiskFirst)
    {
-      if(usedField->isInnerPenaltyArea(pX, pZ, isUpTeamActing,
+      if(ctx->usedField->isInnerPenaltyArea(ctx->pX, ctx->pZ, isUpTeamActing,
                                        !isUpTeamActing))
       {
          /* Foul occurred inner own disk area, so its a penalty! */
-         state = STATE_PENALTY_KICK;
+         ctx->state = STATE_PENALTY_KICK;
       }
       else
       {
-         state = STATE_FREE_KICK;
+         ctx->state = STATE_FREE_KICK;
       }
-      changedBallOwner = true;
+      ctx->changedBallOwner = true;
    }
 
    /* Verify balls miss */
-   else if( (!collidedBallFirst) )
+   else if( (!ctx->collidedBallFirst) )
    {
-      changedBallOwner = true;
-      if(ballAction == BALL_ACTION_NONE)
+      ctx->changedBallOwner = true;
+      if(ctx->ballAction == BALL_ACTION_NONE)
       {
          /* Do Not Collided with anything, or only 
           * with his own players, so ball's owner change */
-         state = STATE_NORMAL;
+         ctx->state = STATE_NORMAL;
       }
       else 
       {
          /* Ball moved somewhere outside... */
-         if(ballAction == BALL_ACTION_SIDE)
+         if(ctx->ballAction == BALL_ACTION_SIDE)
          {
-            state = STATE_THROW_IN;
+            ctx->state = STATE_THROW_IN;
          }
-         else if( (ballAction == BALL_ACTION_BYLINE) ||
-                  (ballAction == BALL_ACTION_GOAL) )
+         else if( (ctx->ballAction == BALL_ACTION_BYLINE) ||
+                  (ctx->ballAction == BALL_ACTION_GOAL) )
          {
             /* Must check if action goal too, as it could be an invalid one
              * (and if invalid, a goal kick should be). */
@@ -945,38 +1146,38 @@ void Rules::ballAtFinalPosition(bool onlineMode)
    }
 
    /* Verify Throw-ins */
-   else if(ballAction == BALL_ACTION_SIDE)
+   else if(ctx->ballAction == BALL_ACTION_SIDE)
    {
-      state = STATE_THROW_IN;
-      if(activeTeam == lastBallCollided)
+      ctx->state = STATE_THROW_IN;
+      if(ctx->activeTeam == ctx->lastBallCollided)
       {
-         changedBallOwner = true;
+         ctx->changedBallOwner = true;
       }
    }
 
    /* Verify Corner Kicks and Goal Kicks */
-   else if(ballAction == BALL_ACTION_BYLINE)
+   else if(ctx->ballAction == BALL_ACTION_BYLINE)
    {
       checkCornerOrGoalKick();      
-      changedBallOwner = (activeTeam == lastBallCollided);
+      ctx->changedBallOwner = (ctx->activeTeam == ctx->lastBallCollided);
    }
 
    /* Verify goals */
-   else if(ballAction == BALL_ACTION_GOAL)
+   else if(ctx->ballAction == BALL_ACTION_GOAL)
    {
       /* verify goal of who to change (or not) the owner */
-      if(ballUpper) 
+      if(ctx->ballUpper) 
       {
-         if(upperTeam != activeTeam)
+         if(ctx->upperTeam != ctx->activeTeam)
          {
-            changedBallOwner = true;
+            ctx->changedBallOwner = true;
          }
       }
       else
       {
-         if(upperTeam == activeTeam)
+         if(ctx->upperTeam == ctx->activeTeam)
          {
-            changedBallOwner = true;
+            ctx->changedBallOwner = true;
          }
       }
 
@@ -986,30 +1187,30 @@ void Rules::ballAtFinalPosition(bool onlineMode)
    }
 
    /* Verify if global touches is underflowed */
-   else if(remainingGlobalTouches <= 0)
+   else if(ctx->remainingGlobalTouches <= 0)
    {
-      state = STATE_NORMAL;
-      changedBallOwner = true;
+      ctx->state = STATE_NORMAL;
+      ctx->changedBallOwner = true;
    }
 
    /* Finally verify if collided with ball */
-   else if(collidedBallFirst)
+   else if(ctx->collidedBallFirst)
    {
-      state = STATE_NORMAL;
+      ctx->state = STATE_NORMAL;
    }
    
    /* Set limits of touches for new state */
    setRemainingTouches();
 
    /* Verify if the ball's owner changed */
-   Team* previousActiveTeam = activeTeam;
-   if(changedBallOwner)
+   Team* previousActiveTeam = ctx->activeTeam;
+   if(ctx->changedBallOwner)
    {
       changeTeamToAct();
    }
    
    /* Set statistics */
-   updateStatistics(state, previousActiveTeam, activeTeam);
+   updateStatistics(ctx->state, previousActiveTeam, ctx->activeTeam);
 
    /* Show a message of the state defined. */
    showStateMessage();
@@ -1020,14 +1221,16 @@ void Rules::ballAtFinalPosition(bool onlineMode)
  **********************************************************************/
 void Rules::setRemainingTouches()
 {
-   switch(state)
+   RulesContext* ctx = getContext();
+
+   switch(ctx->state)
    {
       default:
       case STATE_NORMAL:
-         if(changedBallOwner)
+         if(ctx->changedBallOwner)
          {
-            remainingGlobalTouches = maxRemainingGlobalTouches();
-            remainingDiskTouches = 3;
+            ctx->remainingGlobalTouches = maxRemainingGlobalTouches();
+            ctx->remainingDiskTouches = 3;
          }
       break;
       case STATE_MIDDLE:
@@ -1036,8 +1239,8 @@ void Rules::setRemainingTouches()
       case STATE_THROW_IN:
       case STATE_GOAL_KICK:
       case STATE_PENALTY_KICK:
-         remainingGlobalTouches = maxRemainingGlobalTouches();
-         remainingDiskTouches = 1;
+         ctx->remainingGlobalTouches = maxRemainingGlobalTouches();
+         ctx->remainingDiskTouches = 1;
       break;
    }
 }
@@ -1047,26 +1250,28 @@ void Rules::setRemainingTouches()
  **********************************************************************/
 void Rules::checkCornerOrGoalKick()
 {
-   if(ballUpper) 
+   RulesContext* ctx = getContext();
+
+   if(ctx->ballUpper) 
    {
-      if(upperTeam == lastBallCollided)
+      if(ctx->upperTeam == ctx->lastBallCollided)
       {
-         state = STATE_CORNER_KICK;
+         ctx->state = STATE_CORNER_KICK;
       }
       else
       {
-         state = STATE_GOAL_KICK;
+         ctx->state = STATE_GOAL_KICK;
       }
    }
    else
    {
-      if(upperTeam != lastBallCollided)
+      if(ctx->upperTeam != ctx->lastBallCollided)
       {
-         state = STATE_CORNER_KICK;
+         ctx->state = STATE_CORNER_KICK;
       }
       else
       {
-         state = STATE_GOAL_KICK;
+         ctx->state = STATE_GOAL_KICK;
       }
    }
 }
@@ -1077,54 +1282,110 @@ void Rules::checkCornerOrGoalKick()
 void Rules::updateStatistics(int nextState, Team* actingTeam,
                              Team* nextActingTeam)
 {
+   RulesContext* ctx = getContext();
+
    /* Someone just moved. */
-   Stats::moved(activeTeam == teamA);
+   Stats::moved(ctx->activeTeam == ctx->teamA);
    
    /* And some special states check. */
    switch(nextState)
    {
       case STATE_GOAL_KICK:
-         Stats::goalKick(nextActingTeam == teamA);
+         Stats::goalKick(nextActingTeam == ctx->teamA);
       break;
       case STATE_CORNER_KICK:
-         Stats::corner(nextActingTeam == teamA);
+         Stats::corner(nextActingTeam == ctx->teamA);
       break;
       case STATE_PENALTY_KICK:
       case STATE_FREE_KICK:
-         Stats::foul(activeTeam == teamA);
+         Stats::foul(ctx->activeTeam == ctx->teamA);
       break;
       case STATE_THROW_IN:
-         Stats::throwIn(nextActingTeam == teamA);
+         Stats::throwIn(nextActingTeam == ctx->teamA);
       break;
    }
 }
 
 
-/*  Static Variables   */
-int Rules::state;
-int Rules::minutesPerHalf = 10;
-int Rules::gameType = Rules::TYPE_BALL_12;
-int Rules::halfMinutes;
-int Rules::halfSeconds;
-Kobold::Timer Rules::periodTimer;
-TeamPlayer* Rules::currentDisk;
-bool Rules::secondHalf = true;
-bool Rules::willShoot = false;
-int Rules::remainingGlobalTouches;
-int Rules::remainingDiskTouches;
-Team* Rules::teamA = NULL;
-Team* Rules::teamB = NULL;
-Team* Rules::activeTeam = NULL;
-Team* Rules::upperTeam = NULL;
-Team* Rules::lastBallCollided = NULL;
-Ball* Rules::usedBall = NULL;
-Field* Rules::usedField = NULL;
-bool Rules::collidedBallFirst = false;
-bool Rules::collidedOwnDiskFirst = false;
-bool Rules::collidedEnemyDiskFirst = false;
-int Rules::ballAction = BALL_ACTION_NONE;
-float Rules::pX = -1;
-float Rules::pZ = -1;
-bool Rules::ballUpper = false;
-bool Rules::changedBallOwner = false;
+/**********************************************************************
+ *                        createThreadContextKey                      *
+ **********************************************************************/
+void Rules::createThreadContextKey()
+{
+   pthread_key_create(&threadContextKey, NULL);
+}
 
+/**********************************************************************
+ *                          setThreadContext                          *
+ **********************************************************************/
+void Rules::setThreadContext(RulesContext* context)
+{
+   pthread_once(&threadContextKeyOnce, createThreadContextKey);
+   pthread_setspecific(threadContextKey, context);
+}
+
+/**********************************************************************
+ *                             getContext                             *
+ **********************************************************************/
+RulesContext* Rules::getContext()
+{
+   pthread_once(&threadContextKeyOnce, createThreadContextKey);
+   RulesContext* context = (RulesContext*) 
+      pthread_getspecific(threadContextKey);
+   if(context != NULL)
+   {
+      return context;
+   }
+
+   return &defaultContext;
+}
+
+/**********************************************************************
+ *                       RulesContext Constructor                     *
+ **********************************************************************/
+RulesContext::RulesContext()
+{
+   state = Rules::STATE_MIDDLE;
+   minutesPerHalf = 10;
+   gameType = Rules::TYPE_BALL_12;
+   halfMinutes = 0;
+   halfSeconds = 0;
+   currentDisk = NULL;
+   secondHalf = true;
+   willShoot = false;
+   remainingGlobalTouches = 0;
+   remainingDiskTouches = 0;
+   teamA = NULL;
+   teamB = NULL;
+   activeTeam = NULL;
+   upperTeam = NULL;
+   lastBallCollided = NULL;
+   usedBall = NULL;
+   usedField = NULL;
+   collidedBallFirst = false;
+   collidedOwnDiskFirst = false;
+   collidedEnemyDiskFirst = false;
+   ballAction = BALL_ACTION_NONE;
+   pX = -1;
+   pZ = -1;
+   ballUpper = false;
+   changedBallOwner = false;
+
+   for(int i = 0; i < 2; i++)
+   {
+      goals[i] = 0;
+      fouls[i] = 0;
+      goalShoots[i] = 0;
+      corners[i] = 0;
+      throwIns[i] = 0;
+      goalKicks[i] = 0;
+      penalties[i] = 0;
+      totalMoves[i] = 0;
+   }
+}
+
+
+/*  Static Variables   */
+RulesContext Rules::defaultContext;
+pthread_key_t Rules::threadContextKey;
+pthread_once_t Rules::threadContextKeyOnce = PTHREAD_ONCE_INIT;
@@ -22,6 +22,7 @@
 */
 
 #include <kobold/timer.h>
+#include <pthread.h>
 
 #include "../btsoccer.h"
 #include "../gui/guimessage.h"
@@ -32,6 +33,109 @@
 namespace BtSoccer
 {
 
+/*! The dynamic rules state of a match, as plain values (thus could be 
+ * copied, stored or compared as a flat buffer, see WorldSnapshot).
+ * Teams are kept as 0 for teamA, 1 for teamB or -1 for none, and disks
+ * by their WorldSnapshot object index (or -1 for none).
+ * \note the match clock and the rules configuration (game type, minutes
+ *       per half, etc.) aren't part of it. */
+typedef struct _RulesSnapshot
+{
+   int state;                  /**< Rules state */
+   int secondHalf;             /**< If at the second half */
+   int willShoot;              /**< If declared a goal shoot */
+   int remainingGlobalTouches; /**< Touches to do on play */
+   int remainingDiskTouches;   /**< Remaining consecutive touches */
+   int currentDisk;            /**< Current actor disk */
+   int lastActiveDisk[2];      /**< Last active disk of each team */
+   int activeTeam;             /**< Team in act */
+   int upperTeam;              /**< Team at upper side */
+   int lastBallCollided;       /**< Last team the ball collided to */
+   int changedBallOwner;       /**< If changed the active team */
+   int collidedBallFirst;      /**< If the actor collided ball first */
+   int collidedOwnDiskFirst;   /**< If collided own disk first */
+   int collidedEnemyDiskFirst; /**< If collided opponent disk first */
+   int ballAction;             /**< Ball action identifier */
+   float pX;                   /**< X coordinate of the action */
+   float pZ;                   /**< Z coordinate of the action */
+   int ballUpper;              /**< If ball at upper */
+   int goals[2];               /**< Statistics counters, 0 for teamA */
+   int fouls[2];
+   int goalShoots[2];
+   int corners[2];
+   int throwIns[2];
+   int goalKicks[2];
+   int penalties[2];
+   int totalMoves[2];
+}RulesSnapshot;
+
+/*! The state of a match for the rules system (and its statistics
+ * counters). Usually there's just the default one, but each thread
+ * simulating its own match should bind its own context (see
+ * Rules::setThreadContext). */
+class RulesContext
+{
+   public:
+      /*! Constructor: a context with no teams defined */
+      RulesContext();
+
+   private:
+      friend class Rules;
+      friend class Stats;
+
+      bool changedBallOwner;  /**< Flag of changed the active team */
+
+      int state;              /**< Current Rules State */
+
+      int minutesPerHalf;     /**< Number of minutes per half time */
+      int gameType;           /**< Current Game Type */
+
+      int halfMinutes;        /**< Current Half Minutes */
+      int halfSeconds;        /**< Current Half Seconds */
+
+      Kobold::Timer periodTimer; /**< The time for current period */
+
+      TeamPlayer* currentDisk;  /**< Current actor disk */
+
+      bool secondHalf;        /**< True if is the second half */
+
+      bool willShoot;         /**< True if the player will try a shoot */
+
+      int remainingGlobalTouches; /**< Touches to do on play */
+      int remainingDiskTouches;   /**< Remaining consecutive touches */
+
+      Team* teamA;            /**< Current TeamA */
+      Team* teamB;            /**< Current TeamB */
+      Team* activeTeam;       /**< Current Team in Act */
+      Team* upperTeam;        /**< Current team at upper side */
+      Team* lastBallCollided; /**< Last team the ball collide to */
+
+      Ball* usedBall;         /**< Current Ball */
+
+      Field* usedField;       /**< Current Field*/
+
+      bool collidedBallFirst; /**< When the player collided ball first */
+      bool collidedOwnDiskFirst; /**< When the player collided with
+                                      another disk first of the same player */
+      bool collidedEnemyDiskFirst; /**< When the player collided with
+                                        disk from the other player */
+
+      int ballAction;        /**< ID of some ball action */
+      float pX;              /**< X coordinate of the action */
+      float pZ;              /**< Z coordinate of the action */
+      bool ballUpper;        /**< True if ball at upper */
+
+      /* Statistics counters, for Stats, indexed by 0 for teamA */
+      int goals[2];          /**< total goals */
+      int fouls[2];          /**< total fouls*/
+      int goalShoots[2];     /**< total goal shoots */
+      int corners[2];        /**< total corners */
+      int throwIns[2];       /**< total throw-ins */
+      int goalKicks[2];      /**< total goal kicks */
+      int penalties[2];      /**< total penalty kicks */
+      int totalMoves[2];     /**< total moves */
+};
+
 /*! The rules class is the controller of the game rules. By it 
  *  fouls, next player to play, goals, and all rules are defined
  *  based on the active rule system. */
@@ -58,17 +162,27 @@ class Rules
          TYPE_DISK_1
       };
 
+      /*! Bind a rules context to the calling thread. From now on, all
+       * Rules (and Stats counters) calls made by the thread will use it.
+       * \param context context to use or NULL to use the default one. 
+       * \note the context is not owned by Rules. */
+      static void setThreadContext(RulesContext* context);
+      /*! \return the context bound to the calling thread or, if none,
+       *          the default one. */
+      static RulesContext* getContext();
+
       /*! Define the current game type
        * \param type -> integer constant with the game type */
       static void setGameType(int type);
       /*! Get the current game type */
-      static int getGameType(){return(gameType);};
+      static int getGameType(){return(getContext()->gameType);};
       
       /*! Define the length of each half of the match
        * \param minutes -> number of minutes per half */
       static void setMinutesPerHalf(int minutes);
       /*! Get the current minutes per half */
-      static int getMinutesPerHalf(){return(minutesPerHalf);};
+      static int getMinutesPerHalf()
+         {return(getContext()->minutesPerHalf);};
 
       /*! Verify if we are at the first half
        * \return -> true if at the first half. False if at the second. */
@@ -137,6 +251,14 @@ class Rules
       /*! Set the rules, according a received protocol message */
       static void set(ProtocolParsedMessage& msg);
 
+      /*! Get the current dynamic rules state
+       * \param snap will receive the state */
+      static void getSnapshot(RulesSnapshot& snap);
+      /*! Restore the dynamic rules state (without any message or 
+       * statistics update)
+       * \param snap state to restore */
+      static void setSnapshot(const RulesSnapshot& snap);
+
       /*! Get the current active team.
        * \return -> pointer to the team acting */
       static Team* getActiveTeam();
@@ -165,7 +287,7 @@ class Rules
       static Ball* getBall();
 
       /*! Verify if ball exited at upper side */
-      static bool isBallUpper(){return ballUpper;};
+      static bool isBallUpper(){return getContext()->ballUpper;};
 
       /*! Get the current field
        * \return pointer to the field used */
@@ -282,49 +404,21 @@ class Rules
       /*! Instances not allowed. */
       Rules(){};
 
-
-      static bool changedBallOwner;  /**< Flag of changed the active team */
-
-      static int state;              /**< Current Rules State */
-
-      static int minutesPerHalf;     /**< Number of minutes per half time */
-      static int gameType;           /**< Current Game Type */
-
-      static int halfMinutes;        /**< Current Half Minutes */
-      static int halfSeconds;        /**< Current Half Seconds */
-
-      static Kobold::Timer periodTimer; /**< The time for current period */
-
-      static TeamPlayer* currentDisk;  /**< Current actor disk */
-
-      static bool secondHalf;        /**< True if is the second half */
-
-      static bool willShoot;         /**< True if the player will try a shoot */
-
-      static int remainingGlobalTouches; /**< Touches to do on play */
-      static int remainingDiskTouches;   /**< Remaining consecutive touches */
-
-      static Team* teamA;            /**< Current TeamA */
-      static Team* teamB;            /**< Current TeamB */
-      static Team* activeTeam;       /**< Current Team in Act */
-      static Team* upperTeam;        /**< Current team at upper side */
-      static Team* lastBallCollided; /**< Last team the ball collide to */
-
-      static Ball* usedBall;         /**< Current Ball */
-
-      static Field* usedField;       /**< Current Field*/
-
-      static bool collidedBallFirst; /**< When the player collided ball first */
-      static bool collidedOwnDiskFirst; /**< When the player collided with
-                                       another disk first of the same player */
-      static bool collidedEnemyDiskFirst; /**< When the player collided with
-                                          disk from the other player */
-
-      static int ballAction;        /**< ID of some ball action */
-      static float pX;              /**< X coordinate of the action */
-      static float pZ;              /**< Z coordinate of the action */
-      static bool ballUpper;        /**< True if ball at upper */
-
+      /*! Create the key used to bind contexts to threads */
+      static void createThreadContextKey();
+
+      /*! \return index of a team at a RulesSnapshot */
+      static int getTeamSnapshotIndex(Team* t);
+      /*! \return team of a RulesSnapshot index */
+      static Team* getSnapshotTeam(int index);
+      /*! \return index of a disk at a RulesSnapshot */
+      static int getDiskSnapshotIndex(TeamPlayer* tp);
+      /*! \return disk of a RulesSnapshot index */
+      static TeamPlayer* getSnapshotDisk(int index);
+
+      static RulesContext defaultContext; /**< Context used by default */
+      static pthread_key_t threadContextKey; /**< Key for thread context */
+      static pthread_once_t threadContextKeyOnce; /**< Key creation */
 };
 
 }
@@ -0,0 +1,143 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "soundeffects.h"
+
+#include <kosound/sound.h>
+#include <kobold/ogre3d/ogrefilereader.h>
+#include <string.h>
+
+using namespace BtSoccer;
+
+/***********************************************************************
+ *                                queue                                *
+ ***********************************************************************/
+void SoundEffects::queue(const char* file, Ogre::Vector3 pos)
+{
+   /* Merge with a near one of the same frame */
+   for(int i = 0; i < totalRequests; i++)
+   {
+      if( (strcmp(requests[i].file, file) == 0) &&
+          (requests[i].pos.squaredDistance(pos) < 
+           SOUND_EFFECTS_COALESCE_DIST * SOUND_EFFECTS_COALESCE_DIST) )
+      {
+         return;
+      }
+   }
+
+   if(totalRequests < SOUND_EFFECTS_MAX_REQUESTS)
+   {
+      requests[totalRequests].file = file;
+      requests[totalRequests].pos = pos;
+      totalRequests++;
+   }
+}
+
+/***********************************************************************
+ *                                clear                                *
+ ***********************************************************************/
+void SoundEffects::clear()
+{
+   totalRequests = 0;
+}
+
+/***********************************************************************
+ *                             isCoalesced                             *
+ ***********************************************************************/
+bool SoundEffects::isCoalesced(SoundEffectRequest& req, unsigned long now)
+{
+   for(int i = 0; i < SOUND_EFFECTS_MAX_SLOTS; i++)
+   {
+      if( (slots[i].file != NULL) && 
+          (now - slots[i].start < SOUND_EFFECTS_COALESCE_TIME) &&
+          (strcmp(slots[i].file, req.file) == 0) &&
+          (slots[i].pos.squaredDistance(req.pos) < 
+           SOUND_EFFECTS_COALESCE_DIST * SOUND_EFFECTS_COALESCE_DIST) )
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+/***********************************************************************
+ *                               getSlot                               *
+ ***********************************************************************/
+int SoundEffects::getSlot(unsigned long now)
+{
+   int oldest = -1;
+   for(int i = 0; i < SOUND_EFFECTS_MAX_SLOTS; i++)
+   {
+      if( (slots[i].file == NULL) || 
+          (now - slots[i].start >= SOUND_EFFECTS_SLOT_TIME) )
+      {
+         /* Free one */
+         return i;
+      }
+      if( (oldest == -1) || (slots[i].start < slots[oldest].start) )
+      {
+         oldest = i;
+      }
+   }
+
+   /* All busy: reuse the oldest, if not just started */
+   if(now - slots[oldest].start >= SOUND_EFFECTS_MIN_REUSE_TIME)
+   {
+      return oldest;
+   }
+   return -1;
+}
+
+/***********************************************************************
+ *                                flush                                *
+ ***********************************************************************/
+void SoundEffects::flush()
+{
+   unsigned long now = timer.getMilliseconds();
+
+   for(int i = 0; i < totalRequests; i++)
+   {
+      SoundEffectRequest& req = requests[i];
+      if(isCoalesced(req, now))
+      {
+         continue;
+      }
+      int v = getSlot(now);
+      if(v == -1)
+      {
+         /* Rate limit reached: discard the remaining ones */
+         break;
+      }
+
+      slots[v].file = req.file;
+      slots[v].pos = req.pos;
+      slots[v].start = now;
+      Kosound::Sound::addSoundEffect(req.pos.x, req.pos.y, req.pos.z,
+            SOUND_NO_LOOP, req.file, new Kobold::OgreFileReader());
+   }
+
+   totalRequests = 0;
+}
+
+SoundEffectRequest SoundEffects::requests[SOUND_EFFECTS_MAX_REQUESTS];
+int SoundEffects::totalRequests = 0;
+SoundEffectSlot SoundEffects::slots[SOUND_EFFECTS_MAX_SLOTS];
+Ogre::Timer SoundEffects::timer;
+
@@ -0,0 +1,103 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _btsoccer_sound_effects_h
+#define _btsoccer_sound_effects_h
+
+#include <OGRE/OgreVector3.h>
+#include <OGRE/OgreTimer.h>
+#include "../btsoccer.h"
+
+namespace BtSoccer
+{
+
+/*! Max sound effects requested per frame (the others are discarded) */
+#define SOUND_EFFECTS_MAX_REQUESTS     32
+/*! Max sound effects started by SoundEffects at each 
+ * SOUND_EFFECTS_SLOT_TIME (a rate limit: started clips aren't stopped) */
+#define SOUND_EFFECTS_MAX_SLOTS        6
+/*! Time (in ms) a started effect keeps its rate slot busy */
+#define SOUND_EFFECTS_SLOT_TIME        300
+/*! Min time (in ms) before reusing the oldest busy slot */
+#define SOUND_EFFECTS_MIN_REUSE_TIME   60
+/*! Time (in ms) and distance an effect is merged into a near one */
+#define SOUND_EFFECTS_COALESCE_TIME    40
+#define SOUND_EFFECTS_COALESCE_DIST    2.0f
+
+/*! A sound effect requested to play at the current frame */
+typedef struct _SoundEffectRequest
+{
+   const char* file;     /**< Sound file */
+   Ogre::Vector3 pos;    /**< Where to play it */
+}SoundEffectRequest;
+
+/*! A rate slot, used by a started effect */
+typedef struct _SoundEffectSlot
+{
+   const char* file;     /**< Sound file started, NULL if never used */
+   Ogre::Vector3 pos;    /**< Where it was started */
+   unsigned long start;  /**< When it started */
+}SoundEffectSlot;
+
+/*! Queue of the sound effects that could happen in bursts (like the 
+ * collisions of a multi-disk pile-up). The effects are just queued (without
+ * any allocation) when they happen - usually from inside the physics
+ * tick - and played once per frame at #flush, merging near simultaneous
+ * ones and rate limited to SOUND_EFFECTS_MAX_SLOTS started effects at each
+ * SOUND_EFFECTS_SLOT_TIME.
+ * \note this isn't a mixing budget: Kosound has no way to stop a started
+ *       clip, thus reusing a slot just lets a new effect start, with the
+ *       old one still playing until its end.
+ * \note only for the main (rendering) thread. */
+class SoundEffects
+{
+   public:
+      /*! Queue a sound effect to play at the next #flush
+       * \param file sound file (one of the BTSOCCER_SOUND_* constants)
+       * \param pos where to play it */
+      static void queue(const char* file, Ogre::Vector3 pos);
+
+      /*! Play the queued effects. Usually called once per frame. */
+      static void flush();
+
+      /*! Discard all queued effects */
+      static void clear();
+
+   private:
+      SoundEffects(){};
+
+      /*! \return if a near effect with the same file is just playing */
+      static bool isCoalesced(SoundEffectRequest& req, unsigned long now);
+
+      /*! Get a rate slot to start an effect: a free one or the oldest 
+       * one, if used for at least SOUND_EFFECTS_MIN_REUSE_TIME.
+       * \return slot index or -1 if none available */
+      static int getSlot(unsigned long now);
+
+      static SoundEffectRequest requests[SOUND_EFFECTS_MAX_REQUESTS];
+      static int totalRequests;
+      static SoundEffectSlot slots[SOUND_EFFECTS_MAX_SLOTS];
+      static Ogre::Timer timer;
+};
+
+}
+
+#endif
+
@@ -22,6 +22,7 @@
 #include <goblin/screeninfo.h>
 
 #include "stats.h"
+#include "rules.h"
 #include "../gui/guiscore.h"
 #include "../soundfiles.h"
 using namespace BtSoccer;
@@ -48,16 +49,18 @@ Ogre::String statsTextTitles[]=
  ***********************************************************************/
 void Stats::clear()
 {
+   RulesContext* ctx = Rules::getContext();
    int i;
    for(i=0; i < 2; i++)
    {
-      fouls[i] = 0;
-      goalShoots[i] = 0;
-      corners[i] = 0;
-      throwIns[i] = 0;
-      goalKicks[i] = 0;
-      penalties[i] = 0;
-      totalMoves[i] = 0;
+      ctx->goals[i] = 0;
+      ctx->fouls[i] = 0;
+      ctx->goalShoots[i] = 0;
+      ctx->corners[i] = 0;
+      ctx->throwIns[i] = 0;
+      ctx->goalKicks[i] = 0;
+      ctx->penalties[i] = 0;
+      ctx->totalMoves[i] = 0;
    }
    returnStatus = false;
 }
@@ -92,16 +95,28 @@ void Stats::setTeams(Ogre::String teamA, Ogre::String teamB)
 }
 
 
+/***********************************************************************
+ *                                 goal                                *
+ ***********************************************************************/
+void Stats::goal(bool teamA)
+{
+   Rules::getContext()->goals[((teamA)?0:1)]++;
+}
+int Stats::getGoals(bool teamA)
+{
+   return(Rules::getContext()->goals[((teamA)?0:1)]);
+}
+
 /***********************************************************************
  *                                 foul                                *
  ***********************************************************************/
 void Stats::foul(bool teamA)
 {
-   fouls[((teamA)?0:1)]++;
+   Rules::getContext()->fouls[((teamA)?0:1)]++;
 }
 int Stats::getFouls(bool teamA)
 {
-   return(fouls[((teamA)?0:1)]);
+   return(Rules::getContext()->fouls[((teamA)?0:1)]);
 }
 
 /***********************************************************************
@@ -109,11 +124,11 @@ int Stats::getFouls(bool teamA)
  ***********************************************************************/
 void Stats::goalShoot(bool teamA)
 {
-   goalShoots[((teamA)?0:1)]++;
+   Rules::getContext()->goalShoots[((teamA)?0:1)]++;
 }
 int Stats::getGoalShoots(bool teamA)
 {
-   return(goalShoots[((teamA)?0:1)]);
+   return(Rules::getContext()->goalShoots[((teamA)?0:1)]);
 }
 
 /***********************************************************************
@@ -121,11 +136,11 @@ int Stats::getGoalShoots(bool teamA)
  ***********************************************************************/
 void Stats::corner(bool teamA)
 {
-   corners[((teamA)?0:1)]++;
+   Rules::getContext()->corners[((teamA)?0:1)]++;
 }
 int Stats::getCorners(bool teamA)
 {
-   return(corners[((teamA)?0:1)]);
+   return(Rules::getContext()->corners[((teamA)?0:1)]);
 }
 
 /***********************************************************************
@@ -133,11 +148,11 @@ int Stats::getCorners(bool teamA)
  ***********************************************************************/
 void Stats::throwIn(bool teamA)
 {
-   throwIns[((teamA)?0:1)]++;
+   Rules::getContext()->throwIns[((teamA)?0:1)]++;
 }
 int Stats::getThrows(bool teamA)
 {
-   return(throwIns[((teamA)?0:1)]);
+   return(Rules::getContext()->throwIns[((teamA)?0:1)]);
 }
 
 /***********************************************************************
@@ -145,11 +160,11 @@ int Stats::getThrows(bool teamA)
  ***********************************************************************/
 void Stats::goalKick(bool teamA)
 {
-   goalKicks[((teamA)?0:1)]++;
+   Rules::getContext()->goalKicks[((teamA)?0:1)]++;
 }
 int Stats::getGoalKicks(bool teamA)
 {
-   return(goalKicks[((teamA)?0:1)]);
+   return(Rules::getContext()->goalKicks[((teamA)?0:1)]);
 }
 
 /***********************************************************************
@@ -157,11 +172,11 @@ int Stats::getGoalKicks(bool teamA)
  ***********************************************************************/
 void Stats::penalty(bool teamA)
 {
-   penalties[((teamA)?0:1)]++;
+   Rules::getContext()->penalties[((teamA)?0:1)]++;
 }
 int Stats::getPenalties(bool teamA)
 {
-   return(penalties[((teamA)?0:1)]);
+   return(Rules::getContext()->penalties[((teamA)?0:1)]);
 }
 
 /***********************************************************************
@@ -169,11 +184,11 @@ int Stats::getPenalties(bool teamA)
  ***********************************************************************/
 void Stats::moved(bool teamA)
 {
-   totalMoves[((teamA)?0:1)]++;
+   Rules::getContext()->totalMoves[((teamA)?0:1)]++;
 }
 int Stats::getTotalMoves(bool teamA)
 {
-   return(totalMoves[((teamA)?0:1)]);
+   return(Rules::getContext()->totalMoves[((teamA)?0:1)]);
 }
 
 
@@ -357,6 +372,7 @@ bool Stats::verifyEvents(int mouseX, int mouseY, bool leftButtonPressed,
  ***********************************************************************/
 void Stats::setTexts()
 {
+   RulesContext* ctx = Rules::getContext();
    char buf[16];
 
    /* Set score text */
@@ -367,9 +383,10 @@ void Stats::setTexts()
 
    /* Calculate ball possession */
    int ballPossession = 50;
-   if( (totalMoves[0] != 0) || (totalMoves[1] != 0) )
+   if( (ctx->totalMoves[0] != 0) || (ctx->totalMoves[1] != 0) )
    {
-      float poss = (totalMoves[0]/(float)(totalMoves[0]+totalMoves[1]))*100.0f;
+      float poss = (ctx->totalMoves[0] / 
+            (float)(ctx->totalMoves[0] + ctx->totalMoves[1])) * 100.0f;
       ballPossession = (int)poss;
    }
 
@@ -380,39 +397,39 @@ void Stats::setTexts()
    text[1]->setText(buf);
 
    /* Set Fouls texts */
-   sprintf(buf, "%d", fouls[0]);
+   sprintf(buf, "%d", ctx->fouls[0]);
    text[2]->setText(buf);
-   sprintf(buf, "%d", fouls[1]);
+   sprintf(buf, "%d", ctx->fouls[1]);
    text[3]->setText(buf);
 
    /* Set Goal Attempts texts */
-   sprintf(buf, "%d", goalShoots[0]);
+   sprintf(buf, "%d", ctx->goalShoots[0]);
    text[4]->setText(buf);
-   sprintf(buf, "%d", goalShoots[1]);
+   sprintf(buf, "%d", ctx->goalShoots[1]);
    text[5]->setText(buf);
 
    /* Set Goal Kicks texts */
-   sprintf(buf, "%d", goalKicks[0]);
+   sprintf(buf, "%d", ctx->goalKicks[0]);
    text[6]->setText(buf);
-   sprintf(buf, "%d", goalKicks[1]);
+   sprintf(buf, "%d", ctx->goalKicks[1]);
    text[7]->setText(buf);
 
    /* Set Throw-ins texts */
-   sprintf(buf, "%d", throwIns[0]);
+   sprintf(buf, "%d", ctx->throwIns[0]);
    text[8]->setText(buf);
-   sprintf(buf, "%d", throwIns[1]);
+   sprintf(buf, "%d", ctx->throwIns[1]);
    text[9]->setText(buf);
 
    /* Set Corners texts */
-   sprintf(buf, "%d", corners[0]);
+   sprintf(buf, "%d", ctx->corners[0]);
    text[10]->setText(buf);
-   sprintf(buf, "%d", corners[1]);
+   sprintf(buf, "%d", ctx->corners[1]);
    text[11]->setText(buf);
 
    /* Set Moves texts */
-   sprintf(buf, "%d", totalMoves[0]);
+   sprintf(buf, "%d", ctx->totalMoves[0]);
    text[12]->setText(buf);
-   sprintf(buf, "%d", totalMoves[1]);
+   sprintf(buf, "%d", ctx->totalMoves[1]);
    text[13]->setText(buf);
 }
 
@@ -551,13 +568,6 @@ void Stats::hide()
 
 
 
-int Stats::fouls[2];
-int Stats::goalShoots[2];
-int Stats::corners[2];
-int Stats::throwIns[2];
-int Stats::goalKicks[2];
-int Stats::penalties[2];
-int Stats::totalMoves[2];
 Ogre::Overlay* Stats::ogreOverlay=NULL;
 Goblin::Ibutton* Stats::buttonClose=NULL;
 Goblin::Image* Stats::backImage=NULL;
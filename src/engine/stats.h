@@ -34,7 +34,8 @@ namespace BtSoccer
 #define BTSOCCER_TOTAL_TEXT_STATS   BTSOCCER_TOTAL_STATS*2
 
 /* The Stats class keep statistics about a Match, usually being show
- * at halftime and at match's end. */
+ * at halftime and at match's end. 
+ * \note the counters live at the RulesContext of the calling thread. */
 class Stats
 {
     public:
@@ -58,6 +59,9 @@ class Stats
        /*! Set current match teams */
        static void setTeams(Ogre::String teamA, Ogre::String teamB);
 
+       /*! Tell a goal occurred
+        * \param teamA -> true if teamA scored */
+       static void goal(bool teamA);
        /*! Tell a foul occurred
         * \param teamA -> true if teamA was the infractor */
        static void foul(bool teamA);
@@ -85,6 +89,8 @@ class Stats
        /*! hide the statistics screen */
        static void hide();
 
+       /*! get number of goals for team */
+       static int getGoals(bool teamA);
        /*! get number of fouls for team */
        static int getFouls(bool teamA);
        /*! get number of goal shoots for team */
@@ -111,14 +117,6 @@ class Stats
        /*! No allowed instances */
        Stats(){};
 
-       static int fouls[2];        /**< total fouls*/
-       static int goalShoots[2];   /**< total goal shoots */
-       static int corners[2];      /**< total corners */
-       static int throwIns[2];     /**< total throw-ins */
-       static int goalKicks[2];    /**< total goal kicks */
-       static int penalties[2];    /**< total penalty kicks */
-       static int totalMoves[2];   /**< total moves */
-
        static Ogre::Overlay* ogreOverlay;   /**< Overlay for statistics */
        static Goblin::Ibutton* buttonClose; /**< Close Button */
        static Goblin::Image* backImage;     /**< Background image */
@@ -23,12 +23,18 @@
 #include "field.h"
 #include "teamplayer.h"
 #include "goalkeeper.h"
+#include "threadlog.h"
 
 #include "../gui/guiscore.h"
 #include "../ai/baseai.h"
 #include "../ai/decourtai.h"
 
-#include <OGRE/OgreLogManager.h>
+#include <OGRE/OgreRoot.h>
+#include <OGRE/OgreMeshManager.h>
+#include <OGRE/OgreMaterialManager.h>
+#include <OGRE/OgreGpuProgramManager.h>
+#include <OGRE/OgreTechnique.h>
+#include <OGRE/OgreInstanceBatch.h>
 #include <kobold/ogre3d/i18n.h>
 #include <kobold/ogre3d/ogredefparser.h>
 #include <algorithm>
@@ -84,19 +90,29 @@ Team::Team(Ogre::String teamName, bool createAI)
    this->controlledByHuman = true;
    this->fileName = "Non graphical";
    this->scManager = NULL;
+   this->diskInstanceManager = NULL;
    this->name = teamName;
-   //FIXME
+   this->debugDraw = NULL;
    ai = NULL;
 
    /* Create team elements as non-graphical ones. */
    gKeeper = new GoalKeeper(teamName + "gk");
+   gKeeper->setTeam(this);
    for(int i = 0; i < TEAM_MAX_DISKS; i++)
    {
       ss.str("");
       ss << i;
       disk[i] = new TeamPlayer(FieldObject::TYPE_DISK, teamName + ss.str());
+      disk[i]->setTeam(this);
    }
    lastActiveDisk = NULL;
+
+   if(createAI)
+   {
+      /* No field known yet: the AI will be set latter by #setAI, when
+       * the field is available. Just mark as not controlled by human. */
+      controlledByHuman = false;
+   }
 }
 
 /*************************************************************
@@ -124,11 +140,13 @@ void Team::load(Ogre::String fileName, Ogre::SceneManager* ogreSceneManager,
       disk[i] = NULL;
    }
    lastActiveDisk = NULL;
+   diskInstanceManager = NULL;
+   scManager = ogreSceneManager;
 
    /* Let's load team definition */
    if(!def.load(fileName, false))
    {
-      Ogre::LogManager::getSingleton().stream(Ogre::LML_CRITICAL)
+      ThreadLog::getLog()->stream(Ogre::LML_CRITICAL)
           << "Couldn't load team: '" << fileName << "'";
       return;
    }
@@ -203,6 +221,13 @@ void Team::load(Ogre::String fileName, Ogre::SceneManager* ogreSceneManager,
       gKeeper->setMaterial(gKeeperMaterial);
    }
 
+   /* Try to render all disks with a single instanced batch */
+   Ogre::String diskInstancedMaterial = "";
+#ifdef BTSOCCER_USE_DISK_INSTANCING
+   diskInstancedMaterial = createDiskInstancing(diskBaseName + "_instancing",
+         diskFile, diskMaterial, ogreSceneManager, f->getNumberOfDisks());
+#endif
+
    /* Load All Models */
    for(i = 2; i < f->getNumberOfDisks()+2; i++)
    {
@@ -210,14 +235,15 @@ void Team::load(Ogre::String fileName, Ogre::SceneManager* ogreSceneManager,
       ss.str("");
       ss << i;
       disk[i-2] = new BtSoccer::TeamPlayer(FieldObject::TYPE_DISK,
-            diskBaseName + ss.str(), diskFile, ogreSceneManager, debugDraw);
+            diskBaseName + ss.str(), diskFile, ogreSceneManager, debugDraw,
+            diskInstanceManager, diskInstancedMaterial);
       disk[i-2]->setTeam(this);
       disk[i-2]->hide();
 
       /* TODO: set number on texture */
 
-      /* Change its material */
-      if(!diskMaterial.empty())
+      /* Change its material (instanced ones already have theirs) */
+      if((!diskMaterial.empty()) && (!diskInstanceManager))
       {
          disk[i-2]->setMaterial(diskMaterial);
       }
@@ -227,7 +253,91 @@ void Team::load(Ogre::String fileName, Ogre::SceneManager* ogreSceneManager,
             Ogre::Degree(360.0 * (rand() / (RAND_MAX + 1.0))));
    }
 
-   scManager = ogreSceneManager;
+   if(diskInstanceManager)
+   {
+      /* The batches are just the renderables of our disks: avoid to
+       * get them on scene queries (the disks themselves are there). */
+      Ogre::InstanceManager::InstanceBatchIterator it = 
+         diskInstanceManager->getInstanceBatchIterator(diskInstancedMaterial);
+      while(it.hasMoreElements())
+      {
+         it.getNext()->setQueryFlags(0);
+      }
+   }
+}
+
+/*************************************************************
+ *                   createDiskInstancing                    *
+ *************************************************************/
+Ogre::String Team::createDiskInstancing(Ogre::String managerName, 
+      Ogre::String diskFile, Ogre::String diskMaterial, 
+      Ogre::SceneManager* ogreSceneManager, int totalDisks)
+{
+   /* Check if the render system could do hardware instancing */
+   Ogre::RenderSystem* renderSystem = 
+      Ogre::Root::getSingleton().getRenderSystem();
+   if((!renderSystem) || (!renderSystem->getCapabilities()->hasCapability(
+               Ogre::RSC_VERTEX_BUFFER_INSTANCE_DATA)))
+   {
+      return "";
+   }
+
+   /* And if our instancing programs are available */
+   Ogre::GpuProgramPtr vp = Ogre::GpuProgramManager::getSingleton().getByName(
+         TEAM_DISK_INSTANCING_VP, 
+         Ogre::ResourceGroupManager::AUTODETECT_RESOURCE_GROUP_NAME);
+   Ogre::GpuProgramPtr fp = Ogre::GpuProgramManager::getSingleton().getByName(
+         TEAM_DISK_INSTANCING_FP,
+         Ogre::ResourceGroupManager::AUTODETECT_RESOURCE_GROUP_NAME);
+   if((!vp) || (!fp) || (!vp->isSupported()) || (!fp->isSupported()))
+   {
+      return "";
+   }
+
+   /* Get the material to instance */
+   if(diskMaterial.empty())
+   {
+      Ogre::MeshPtr mesh = Ogre::MeshManager::getSingleton().load(diskFile,
+            "game");
+      diskMaterial = mesh->getSubMesh(0)->getMaterialName();
+   }
+   Ogre::MaterialPtr material = 
+      Ogre::MaterialManager::getSingleton().getByName(diskMaterial);
+   if(!material)
+   {
+      return "";
+   }
+
+   /* Define its instanced version (could be already defined by a team
+    * with the same disks at a previous match). */
+   Ogre::String instancedName = diskMaterial + TEAM_DISK_INSTANCED_SUFFIX;
+   Ogre::MaterialPtr instanced = 
+      Ogre::MaterialManager::getSingleton().getByName(instancedName);
+   if(!instanced)
+   {
+      instanced = material->clone(instancedName);
+      Ogre::Pass* pass = instanced->getTechnique(0)->getPass(0);
+      pass->setVertexProgram(TEAM_DISK_INSTANCING_VP);
+      pass->setFragmentProgram(TEAM_DISK_INSTANCING_FP);
+   }
+   instanced->load();
+   if(!instanced->getBestTechnique())
+   {
+      ThreadLog::getLog()->stream(Ogre::LML_NORMAL)
+         << "Disk instancing unsupported for material '" << instancedName
+         << "'. Using individual entities.";
+      return "";
+   }
+
+   /* Finally, create the manager, with all disks at a single batch. */
+   diskInstanceManager = ogreSceneManager->createInstanceManager(managerName,
+         diskFile, "game", Ogre::InstanceManager::HWInstancingBasic,
+         totalDisks);
+   /* Stencil shadows aren't supported by instanced batches */
+   diskInstanceManager->setSetting(Ogre::InstanceManager::CAST_SHADOWS, 
+         false);
+
+   return instancedName;
 }
 
 /*************************************************************
@@ -250,6 +360,23 @@ Team::~Team()
          delete disk[i];
       }
    }
+   if(diskInstanceManager)
+   {
+      scManager->destroyInstanceManager(diskInstanceManager);
+   }
+}
+
+/*************************************************************
+ *                           setAI                           *
+ *************************************************************/
+void Team::setAI(BaseAI* newAI)
+{
+   if(ai)
+   {
+      delete ai;
+   }
+   ai = newAI;
+   controlledByHuman = (ai == NULL);
 }
 
 /*************************************************************
@@ -272,6 +399,9 @@ void Team::startPositionAtField(bool upper, bool withBall,
    Ogre::Vector2 halfSize = f->getHalfSize();
    Ogre::Vector2 sideDelta = f->getSideDelta();
 
+   /* Place everyone, settling them with a single physics step */
+   BulletLink::beginPlacement();
+
    /* Set Goal Keeper */
    gKeeper->startPositionAtField(upper, f);
 
@@ -378,6 +508,7 @@ void Team::startPositionAtField(bool upper, bool withBall,
          disk[7]->setPosition(m * 9.75f, 0, 2.5f);
       }
    }
+   BulletLink::endPlacement();
    
    /* Set the models to show */
    int i;
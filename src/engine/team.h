@@ -22,6 +22,7 @@
 #define _btsoccer_team_h
 
 #include <OGRE/OgreSceneManager.h>
+#include <OGRE/OgreInstanceManager.h>
 
 #include <kobold/defparser.h>
 
@@ -38,6 +39,13 @@ namespace BtSoccer
 #define DEFAULT_DISK_MODEL         "disk/disk.mesh"
 #define DEFAULT_GOAL_KEEPER_MODEL  "goalkeeper/goalkeeper.mesh"
 
+/*! Vertex program used to render instanced disks */
+#define TEAM_DISK_INSTANCING_VP    "BtSoccer/DiskInstancingVP"
+/*! Fragment program used to render instanced disks */
+#define TEAM_DISK_INSTANCING_FP    "BtSoccer/DiskInstancingFP"
+/*! Suffix appended to the disk material name for its instanced version */
+#define TEAM_DISK_INSTANCED_SUFFIX "/Instanced"
+
 /*! The team is the entity the user plays with. Each team is composed of 
  * 11 teamPlayers. 1 goal keeper and 10 disks. Each team has its
  * own models for the disks and for the goal keeper. */
@@ -59,13 +67,21 @@ class Team
            Field* f, Ogre::String oponentPredominantColor, 
            BulletDebugDraw* debugDraw,  bool createAI=false);
       /*! Constructor for dummy team (without graphic elements), used 
-       * only at test cases. */
+       * at test cases and headless simulations.
+       * \param teamName -> name of the team
+       * \param createAI -> if the team will be AI controlled. As no field
+       *        is known here, the AI itself must be later defined
+       *        with #setAI. */
       Team(Ogre::String teamName, bool createAI=false);
       /*! Destructor */
       ~Team();
 
       /*! \return the AI which controlls the team, if any */
       BaseAI* getAI() { return ai; };
+      /*! Set the AI which controlls the team, deleting the previous one.
+       * \param newAI -> new AI to use (owned by the team) or NULL for
+       *        a human controlled team. */
+      void setAI(BaseAI* newAI);
 
       /*! Put the team at a start position on the field.
        * \param upper -> true if the team is at upper side of the field, false
@@ -179,6 +195,21 @@ class Team
       void load(Ogre::String fileName, Ogre::SceneManager* ogreSceneManager,
            Field* f, Ogre::String oponentPredominantColor);
 
+      /*! Create the instance manager to draw all team disks with a single
+       * hardware instanced batch, if supported by the render system.
+       * \param managerName -> name of the instance manager to create
+       * \param diskFile -> disk mesh file name
+       * \param diskMaterial -> disk material name (or empty for the 
+       *        mesh's default one)
+       * \param ogreSceneManager -> pointer to the scene manager used
+       * \param totalDisks -> number of disks the team will have
+       * \return name of the material to use for the instances, or empty
+       *         if instancing is not available (thus #diskInstanceManager
+       *         isn't created and disks must be individual entities). */
+      Ogre::String createDiskInstancing(Ogre::String managerName, 
+            Ogre::String diskFile, Ogre::String diskMaterial,
+            Ogre::SceneManager* ogreSceneManager, int totalDisks);
+
 
       Ogre::String fileName;             /**< Team File Name */
       Ogre::String name;                 /**< The Team Name */
@@ -195,6 +226,8 @@ class Team
 
       bool controlledByHuman;            /**< If controlled by human or AI */
       Ogre::SceneManager* scManager;     /**< The scene manager used */
+      Ogre::InstanceManager* diskInstanceManager; /**< Instancing used to 
+                                                       render the disks */
 
       BulletDebugDraw* debugDraw; /**< Used for draw some debug info */
 
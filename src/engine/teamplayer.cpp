@@ -29,11 +29,13 @@ using namespace BtSoccer;
  *                           Constructor                          *
  ******************************************************************/
 TeamPlayer::TeamPlayer(int type, Ogre::String name, Ogre::String fileName, 
-      Ogre::SceneManager* ogreSceneManager, BulletDebugDraw* debugDraw)
+      Ogre::SceneManager* ogreSceneManager, BulletDebugDraw* debugDraw,
+      Ogre::InstanceManager* instanceManager, Ogre::String instancedMaterial)
       :FieldObject(type, name, fileName, ogreSceneManager, 
             TEAM_PLAYER_SCALE_FACTOR,
             (type == TYPE_DISK)?DISK_MASS:GKEEPER_MASS,
-            DISK_RESTITUTION, DISK_FRICTION, DISK_ROLLING_FRICTION, debugDraw)
+            DISK_RESTITUTION, DISK_FRICTION, DISK_ROLLING_FRICTION, debugDraw,
+            instanceManager, instancedMaterial)
 {
    init();
 }
@@ -95,8 +97,11 @@ BtSoccer::Team* TeamPlayer::getTeam()
  ******************************************************************/
 void TeamPlayer::setMaterial(Ogre::String materialName)
 {
-   this->materialName = materialName;
-   model->setMaterialName(materialName);
+   if(model)
+   {
+      this->materialName = materialName;
+      model->setMaterialName(materialName);
+   }
 }
 
 /******************************************************************
@@ -46,9 +46,14 @@ class TeamPlayer: public FieldObject
        * \param type -> FieldObject::TYPE_DISK or FieldObject::TYPE_GOAL_KEEPER
        * \param name -> internal name of the team player
        * \param fileName -> model's filename 
-       * \param ogreSceneManager -> pointer to the used scene manager */
+       * \param ogreSceneManager -> pointer to the used scene manager
+       * \param instanceManager -> if not NULL, the instance manager of
+       *        fileName mesh to render the model as an instance of.
+       * \param instancedMaterial -> material to use for the instance. */
       TeamPlayer(int type, Ogre::String name, Ogre::String fileName, 
-            Ogre::SceneManager* ogreSceneManager, BulletDebugDraw* debugDraw);
+            Ogre::SceneManager* ogreSceneManager, BulletDebugDraw* debugDraw,
+            Ogre::InstanceManager* instanceManager=NULL,
+            Ogre::String instancedMaterial="");
 
       /*! Constructor without graphical elements. Usually used in test cases.*/
       TeamPlayer(int type, Ogre::String name);
@@ -57,7 +62,9 @@ class TeamPlayer: public FieldObject
       ~TeamPlayer();
 
       /*! Set the teamPlayer material 
-       * \param materialName -> name of the new material */
+       * \param materialName -> name of the new material
+       * \note instanced teamPlayers have their material defined at
+       *       creation, thus it is ignored for them. */
       void setMaterial(Ogre::String materialName);
 
       /*! Get the ammount of time after last collision with the ball
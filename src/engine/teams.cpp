@@ -69,7 +69,7 @@ bool Region::sortedInsert(TeamInfo* t)
 /***********************************************************************
  *                         Load team definitions                       *
  ***********************************************************************/
-void Regions::load()
+void Regions::load(Ogre::String listFile, bool fullPath)
 {
    Ogre::String fileName="";
    Kobold::OgreDefParser def;
@@ -78,7 +78,7 @@ void Regions::load()
    
    totalTeams = 0;
    totalRegions=0;
-   if(!def.load("teams.lst", false))
+   if(!def.load(listFile, fullPath))
    {
       return;
    }
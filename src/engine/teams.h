@@ -64,8 +64,12 @@ class Region : public Kobold::List
 class Regions
 {
    public:
-      /*! Load all teams information */
-      static void load();
+      /*! Load all teams information
+       * \param listFile file with the teams list
+       * \param fullPath if listFile is a full path (true) or a file at
+       *        the Ogre resources (false). */
+      static void load(Ogre::String listFile="teams.lst", 
+            bool fullPath=false);
       /*! Clear all loaded team infos */
       static void clear();
 
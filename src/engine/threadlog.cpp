@@ -0,0 +1,119 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "threadlog.h"
+
+#include <OGRE/OgreLogManager.h>
+
+using namespace BtSoccer;
+
+/***********************************************************************
+ *                             Constructor                             *
+ ***********************************************************************/
+ThreadLog::ThreadLog()
+{
+   /* Not registered at the LogManager, without debugger nor file 
+    * output: only us, as listener, receive its messages. */
+   log = new Ogre::Log("btsoccer_thread", false, true);
+   log->addListener(this);
+   discarded = 0;
+}
+
+/***********************************************************************
+ *                              Destructor                             *
+ ***********************************************************************/
+ThreadLog::~ThreadLog()
+{
+   log->removeListener(this);
+   delete log;
+}
+
+/***********************************************************************
+ *                                flush                                *
+ ***********************************************************************/
+void ThreadLog::flush()
+{
+   Ogre::Log* defaultLog = Ogre::LogManager::getSingleton().getDefaultLog();
+   for(unsigned int i = 0; i < messages.size(); i++)
+   {
+      defaultLog->logMessage(messages[i].message, messages[i].lml);
+   }
+   if(discarded > 0)
+   {
+      defaultLog->stream(Ogre::LML_CRITICAL) << "Warning: " << discarded
+         << " messages discarded by a thread log!";
+   }
+   messages.clear();
+   discarded = 0;
+}
+
+/***********************************************************************
+ *                            messageLogged                            *
+ ***********************************************************************/
+void ThreadLog::messageLogged(const Ogre::String& message, 
+      Ogre::LogMessageLevel lml, bool maskDebug, 
+      const Ogre::String& logName, bool& skipThisMessage)
+{
+   if(messages.size() >= THREAD_LOG_MAX_MESSAGES)
+   {
+      discarded++;
+      return;
+   }
+   ThreadLogMessage msg;
+   msg.message = message;
+   msg.lml = lml;
+   messages.push_back(msg);
+}
+
+/***********************************************************************
+ *                         createThreadLogKey                          *
+ ***********************************************************************/
+void ThreadLog::createThreadLogKey()
+{
+   pthread_key_create(&threadLogKey, NULL);
+}
+
+/***********************************************************************
+ *                            setThreadLog                             *
+ ***********************************************************************/
+void ThreadLog::setThreadLog(ThreadLog* threadLog)
+{
+   pthread_once(&threadLogKeyOnce, createThreadLogKey);
+   pthread_setspecific(threadLogKey, threadLog);
+}
+
+/***********************************************************************
+ *                               getLog                                *
+ ***********************************************************************/
+Ogre::Log* ThreadLog::getLog()
+{
+   pthread_once(&threadLogKeyOnce, createThreadLogKey);
+   ThreadLog* threadLog = (ThreadLog*) pthread_getspecific(threadLogKey);
+   if(threadLog != NULL)
+   {
+      return threadLog->log;
+   }
+
+   return Ogre::LogManager::getSingleton().getDefaultLog();
+}
+
+/*  Static Variables   */
+pthread_key_t ThreadLog::threadLogKey;
+pthread_once_t ThreadLog::threadLogKeyOnce = PTHREAD_ONCE_INIT;
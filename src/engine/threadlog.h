@@ -0,0 +1,88 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _btsoccer_thread_log_h
+#define _btsoccer_thread_log_h
+
+#include <OGRE/OgreLog.h>
+#include <pthread.h>
+
+#include <vector>
+
+namespace BtSoccer
+{
+
+/*! Max messages kept by a ThreadLog before #flush. Later ones are 
+ * discarded (and their number reported at the flush). */
+#define THREAD_LOG_MAX_MESSAGES  4096
+
+/*! A message kept by a ThreadLog */
+typedef struct _ThreadLogMessage
+{
+   Ogre::String message;       /**< Message text */
+   Ogre::LogMessageLevel lml;  /**< Its level */
+}ThreadLogMessage;
+
+/*! The ThreadLog keeps the messages logged by a worker thread (as the
+ * MatchFarm ones), which can't use Ogre's LogManager, until the main
+ * thread flushes them to Ogre's default log. 
+ * \note code that could run at worker threads should log through
+ *       #getLog instead of the LogManager. */
+class ThreadLog : public Ogre::LogListener
+{
+   public:
+      /*! Constructor. Must be called by the main thread. */
+      ThreadLog();
+      /*! Destructor */
+      ~ThreadLog();
+
+      /*! Write all kept messages to Ogre's default log, clearing them.
+       * \note must be called by the main thread, while the worker 
+       *       thread isn't logging (ie: after joined). */
+      void flush();
+
+      /*! Ogre::LogListener: keep the message to the #flush. */
+      void messageLogged(const Ogre::String& message, 
+            Ogre::LogMessageLevel lml, bool maskDebug, 
+            const Ogre::String& logName, bool& skipThisMessage);
+
+      /*! Bind a ThreadLog to the calling thread.
+       * \param threadLog ThreadLog to use or NULL to use Ogre's 
+       *        default log again. */
+      static void setThreadLog(ThreadLog* threadLog);
+      /*! \return log to use at the calling thread: its ThreadLog one,
+       *          if bound, or Ogre's default log. */
+      static Ogre::Log* getLog();
+
+   private:
+      /*! Create the key used to bind ThreadLogs to threads */
+      static void createThreadLogKey();
+
+      Ogre::Log* log;   /**< Log (without file) the thread writes to */
+      std::vector<ThreadLogMessage> messages; /**< Kept messages */
+      int discarded;    /**< Messages discarded after the max */
+
+      static pthread_key_t threadLogKey; /**< Key for thread log */
+      static pthread_once_t threadLogKeyOnce; /**< Key creation */
+};
+
+}
+
+#endif
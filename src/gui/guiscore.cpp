@@ -485,9 +485,12 @@ int GuiScore::goalsTeamB()
  ***************************************************************/
 void GuiScore::setText()
 {
-   scoreText->setText(Ogre::StringConverter::toString(teamGoalsA) +
-                      Ogre::String(" x ") +
-                      Ogre::StringConverter::toString(teamGoalsB) );
+   if(scoreText)
+   {
+      scoreText->setText(Ogre::StringConverter::toString(teamGoalsA) +
+                         Ogre::String(" x ") +
+                         Ogre::StringConverter::toString(teamGoalsB) );
+   }
 }
 
 /***************************************************************
@@ -21,6 +21,9 @@
 #include "protocol.h"
 #include "../btsoccer.h"
 
+#include <OGRE/OgreLogManager.h>
+#include <sched.h>
+
 #if OGRE_PLATFORM == OGRE_PLATFORM_APPLE_IOS
    #include "gamecenternetwork.h"
 #endif
@@ -29,6 +32,27 @@
 #define MIN_MAJOR_SUPPORTED_VERSION  1
 #define MIN_MINOR_SUPPORTED_VERSION  0
 
+/* Fixed point scale for the smallest-three quaternion components, which
+ * are at [-1/sqrt(2), 1/sqrt(2)] */
+#define SMALLEST_THREE_SCALE  (32767.0f * 1.41421356f)
+
+/* Full memory barrier: ring slots must be written (or read) before 
+ * publishing its new index to the other thread. */
+#define PROTOCOL_MEMORY_BARRIER()   __sync_synchronize()
+
+/* States of the staging message (the last position update one) */
+#define PROTOCOL_STAGING_EMPTY   0 /* No staging message */
+#define PROTOCOL_STAGING_OPEN    1 /* Defined, could be taken */
+#define PROTOCOL_STAGING_BUSY    2 /* Taken by some thread */
+
+/* Encodings this side will negotiate: lockstep only if enabled */
+#ifdef BTSOCCER_USE_NET_LOCKSTEP
+   #define PROTOCOL_LOCAL_ENCODINGS  PROTOCOL_SUPPORTED_ENCODINGS
+#else
+   #define PROTOCOL_LOCAL_ENCODINGS  (PROTOCOL_SUPPORTED_ENCODINGS & \
+                                      ~PROTOCOL_ENCODING_LOCKSTEP)
+#endif
+
 using namespace BtSoccer;
 
 /***********************************************************************
@@ -43,18 +67,38 @@ void Protocol::initProtocol(bool gameCenter, int fieldConstant)
    isForTeamA = false;
    initSend = 0;
    endSend = 0;
+   sendStagingState = PROTOCOL_STAGING_EMPTY;
+   initReply = 0;
+   endReply = 0;
+   initControl = 0;
+   endControl = 0;
+   initConnectionReceived = false;
    initReceived = 0;
    endReceived = 0;
+   memset(&overflows, 0, sizeof(ProtocolOverflowCounters));
    curQueueToSendInc = 0;
    curReceivedInc = 0;
+   receivedIncMask = 0;
+   receivedCumulativeInc = 0;
    doubleSize = sizeof(double);
-   messageWaitingForAck = NULL;
-   pthread_mutex_init(&mutexSend, NULL);
-   pthread_mutex_init(&mutexReceived, NULL);
-   haveAckOrNackToSend = false;
+   memset(&waitingAckInc[0], 0, sizeof(waitingAckInc));
+   totalWaitingAck = 0;
+   smoothedRtt = PROTOCOL_INITIAL_RTT_MS;
+   hasHeldMessage = false;
+   initReceivedAcks = 0;
+   endReceivedAcks = 0;
+   pthread_mutex_init(&mutexSnapshot, NULL);
+   senderClock.reset();
+   curSnapshotId = 0;
+   clearSentSnapshots();
+   clearReceivedSnapshots();
    isInited = true;
    usingGameCenter = gameCenter;
    fieldSize = fieldConstant;
+   /* Only use the compact encoding after negotiated with the other side */
+   compactEncoding = false;
+   snapshotEncoding = false;
+   lockstepEncoding = false;
 }
 
 /***********************************************************************
@@ -62,8 +106,7 @@ void Protocol::initProtocol(bool gameCenter, int fieldConstant)
  ***********************************************************************/
 void Protocol::finishProtocol()
 {
-   pthread_mutex_destroy(&mutexSend);
-   pthread_mutex_destroy(&mutexReceived);
+   pthread_mutex_destroy(&mutexSnapshot);
    isInited = false;
 }
 
@@ -107,28 +150,214 @@ bool Protocol::isUsingGameCenter()
    return usingGameCenter;
 }
 
+/***********************************************************************
+ *                        isUsingCompactEncoding                       *
+ ***********************************************************************/
+bool Protocol::isUsingCompactEncoding()
+{
+   return compactEncoding;
+}
+
+/***********************************************************************
+ *                          isUsingSnapshots                           *
+ ***********************************************************************/
+bool Protocol::isUsingSnapshots()
+{
+   return snapshotEncoding;
+}
+
+/***********************************************************************
+ *                           isUsingLockstep                           *
+ ***********************************************************************/
+bool Protocol::isUsingLockstep()
+{
+   return lockstepEncoding;
+}
+
+/***********************************************************************
+ *                          getOverflowCounters                        *
+ ***********************************************************************/
+void Protocol::getOverflowCounters(ProtocolOverflowCounters* counters)
+{
+   memcpy(counters, &overflows, sizeof(ProtocolOverflowCounters));
+}
+
+/***********************************************************************
+ *                             pushMessage                             *
+ ***********************************************************************/
+bool Protocol::pushMessage(ProtocolMessage* ring, int size, 
+      volatile int* init, volatile int* end, ProtocolMessage* msg)
+{
+   int curEnd = *end;
+   int next = (curEnd + 1) % size;
+
+   if(next == *init)
+   {
+      /* Full */
+      return false;
+   }
+
+   memcpy(&ring[curEnd], msg, sizeof(ProtocolMessage));
+   /* The consumer must only see the new end after the slot is written */
+   PROTOCOL_MEMORY_BARRIER();
+   *end = next;
+
+   return true;
+}
+
+/***********************************************************************
+ *                              popMessage                             *
+ ***********************************************************************/
+bool Protocol::popMessage(ProtocolMessage* ring, int size,
+      volatile int* init, volatile int* end, ProtocolMessage* msg)
+{
+   int curInit = *init;
+
+   if(curInit == *end)
+   {
+      /* Empty */
+      return false;
+   }
+
+   PROTOCOL_MEMORY_BARRIER();
+   memcpy(msg, &ring[curInit], sizeof(ProtocolMessage));
+   /* The producer must only reuse the slot after it was read */
+   PROTOCOL_MEMORY_BARRIER();
+   *init = (curInit + 1) % size;
+
+   return true;
+}
+
+/***********************************************************************
+ *                           pushSendMessage                           *
+ ***********************************************************************/
+void Protocol::pushSendMessage(ProtocolMessage* msg)
+{
+   if(pushMessage(&send[0], PROTOCOL_MAX_QUEUED_MESSAGES, &initSend,
+            &endSend, msg))
+   {
+      return;
+   }
+
+#ifdef BTSOCCER_NET_DEBUG
+   printf("Messages to send queue overflow!\n");
+#endif
+
+   if(msg->needAck == 0)
+   {
+      /* Unreliable messages could be lost (usually an intermediary 
+       * position, with a newer one to come) */
+      overflows.droppedUnreliable++;
+      return;
+   }
+
+   /* Reliable: wait a bit for the network thread to make some room */
+   overflows.waitedReliable++;
+   Kobold::Timer overflowTimer;
+   overflowTimer.reset();
+   while(overflowTimer.getMilliseconds() < PROTOCOL_OVERFLOW_WAIT_MS)
+   {
+      sched_yield();
+      if(pushMessage(&send[0], PROTOCOL_MAX_QUEUED_MESSAGES, &initSend,
+               &endSend, msg))
+      {
+         return;
+      }
+   }
+
+   overflows.droppedReliable++;
+   Ogre::LogManager::getSingleton().stream(Ogre::LML_CRITICAL)
+      << "Protocol: dropped reliable message " << (int)msg->type
+      << " as the queue to send is full!";
+}
+
 /***********************************************************************
  *                            queueMessage                             *
  ***********************************************************************/
 void Protocol::queueMessage(ProtocolMessage* msg)
 {
-   pthread_mutex_lock(&mutexSend);
-   
-   /* Queue the message using protocol queue */
-   if( ((endSend + 1) % PROTOCOL_MAX_QUEUED_MESSAGES) == initSend )
+   ProtocolMessage staged;
+
+   /* The staging message is older than this one: must be queued first */
+   if(takeStagingMessage(&staged))
+   {
+      releaseStagingMessage(&staged);
+   }
+
+   pushSendMessage(msg);
+}
+
+/***********************************************************************
+ *                          takeStagingMessage                         *
+ ***********************************************************************/
+bool Protocol::takeStagingMessage(ProtocolMessage* msg)
+{
+   for(;;)
+   {
+      if(__sync_bool_compare_and_swap(&sendStagingState, 
+               PROTOCOL_STAGING_OPEN, PROTOCOL_STAGING_BUSY))
+      {
+         memcpy(msg, &sendStaging, sizeof(ProtocolMessage));
+         return true;
+      }
+      if(sendStagingState == PROTOCOL_STAGING_EMPTY)
+      {
+         return false;
+      }
+      /* The network thread is just taking it: wait for its copy. */
+      sched_yield();
+   }
+   return false;
+}
+
+/***********************************************************************
+ *                          setStagingMessage                          *
+ ***********************************************************************/
+void Protocol::setStagingMessage(ProtocolMessage* msg)
+{
+   memcpy(&sendStaging, msg, sizeof(ProtocolMessage));
+   PROTOCOL_MEMORY_BARRIER();
+   sendStagingState = PROTOCOL_STAGING_OPEN;
+}
+
+/***********************************************************************
+ *                        releaseStagingMessage                        *
+ ***********************************************************************/
+void Protocol::releaseStagingMessage(ProtocolMessage* msg)
+{
+   pushSendMessage(msg);
+   PROTOCOL_MEMORY_BARRIER();
+   sendStagingState = PROTOCOL_STAGING_EMPTY;
+}
+
+/***********************************************************************
+ *                             queueReply                              *
+ ***********************************************************************/
+void Protocol::queueReply(ProtocolMessage* msg)
+{
+   if(!pushMessage(&reply[0], PROTOCOL_MAX_QUEUED_REPLIES, &initReply,
+            &endReply, msg))
    {
+      /* Not a problem: the other side will resend the message */
 #ifdef BTSOCCER_NET_DEBUG
-      printf("Messages to send queue overflow!\n");
+      printf("Replies queue overflow!\n");
 #endif
-      pthread_mutex_unlock(&mutexSend);
+      overflows.droppedReplies++;
+   }
+}
+
+/***********************************************************************
+ *                         queueControlMessage                         *
+ ***********************************************************************/
+void Protocol::queueControlMessage(ProtocolMessage* msg)
+{
+   if( ((endControl + 1) % PROTOCOL_MAX_CONTROL_MESSAGES) == initControl )
+   {
+      overflows.droppedReplies++;
       return;
    }
-      
-   /* Insert the message on the queue */
-   memcpy(&send[endSend], msg, sizeof(ProtocolMessage));
-   endSend = (endSend+1) % PROTOCOL_MAX_QUEUED_MESSAGES;
-   
-   pthread_mutex_unlock(&mutexSend);
+   memcpy(&control[endControl], msg, sizeof(ProtocolMessage));
+   endControl = (endControl + 1) % PROTOCOL_MAX_CONTROL_MESSAGES;
 }
 
 /***********************************************************************
@@ -136,83 +365,178 @@ void Protocol::queueMessage(ProtocolMessage* msg)
  ***********************************************************************/
 bool Protocol::getNextMessageToSend(ProtocolMessage* msg)
 {
-   bool hasMessage = false;
-   pthread_mutex_lock(&mutexSend);
-   
-   if(haveAckOrNackToSend)
+   /* Acks and nacks must not respect the queue, and be direct sent. */
+   if(popMessage(&reply[0], PROTOCOL_MAX_QUEUED_REPLIES, &initReply,
+            &endReply, msg))
    {
-      /* Have an ack or nack to send, must send it. */
 #ifdef BTSOCCER_NET_DEBUG
-      printf("I will send ack or nack: %d\n", ackNackToSend.type);
+      printf("I will send ack or nack: %d\n", msg->type);
 #endif
-      memcpy(msg, &ackNackToSend, sizeof(ProtocolMessage));
-      haveAckOrNackToSend = false;
-      hasMessage = true;
+      return true;
    }
-   else if(messageWaitingForAck != NULL)
+
+   treatReceivedAcks();
+
+   if(initConnectionReceived)
    {
-      /* Some message is waiting for ack, must re-send it, as ack
-       * was not yet received. */
-      if(waitingTimer.getMilliseconds() > PROTOCOL_TIME_TO_RESEND_MS)
-      {
-         waitingTimer.reset();
-#ifdef BTSOCCER_NET_DEBUG
-         printf("Will resend: %d\n", messageWaitingForAck->type);
-#endif
-         memcpy(msg, messageWaitingForAck, sizeof(ProtocolMessage));
-         hasMessage = true;
-      }
+      initConnectionReceived = false;
+      queueInitConnectionAnswers();
    }
-   else if(initSend != endSend)
+   checkSnapshotResend();
+
+   /* Messages not acknowledged in time must be resent */
+   if(getNextMessageToResend(msg))
    {
-      //printf("Init: %d End: %d\n", initSend, endSend);
-      setSendIncValue(&send[initSend].inc[0]);
-      memcpy(msg, &send[initSend], sizeof(ProtocolMessage));
-#ifdef BTSOCCER_NET_DEBUG
-      printf("Will send: %d\n", send[initSend].type);
-#endif
-      if(send[initSend].needAck != 0)
+      return true;
+   }
+
+   if(totalWaitingAck >= getSendWindow())
+   {
+      /* Window is full: must wait for some ack */
+      return false;
+   }
+
+   return getNextQueuedMessage(msg);
+}
+
+/***********************************************************************
+ *                            getSendWindow                            *
+ ***********************************************************************/
+int Protocol::getSendWindow()
+{
+   /* Only in-order transports (TCP) could pipeline reliable messages:
+    * as the receiver has no reorder buffer, at game center a later 
+    * message must not be sent before the reliable one is acknowledged. */
+   if(usingGameCenter)
+   {
+      return 1;
+   }
+   return PROTOCOL_SEND_WINDOW;
+}
+
+/***********************************************************************
+ *                        getNextMessageToResend                       *
+ ***********************************************************************/
+bool Protocol::getNextMessageToResend(ProtocolMessage* msg)
+{
+   int i;
+   for(i = 0; i < PROTOCOL_SEND_WINDOW; i++)
+   {
+      if(waitingAckInc[i] != 0)
       {
+         if( (waitingAckSkipped[i] >= PROTOCOL_FAST_RETRANSMIT_ACKS) ||
+             (waitingAckTimer[i].getMilliseconds() > 
+              PROTOCOL_TIME_TO_RESEND_MS) )
+         {
 #ifdef BTSOCCER_NET_DEBUG
-         printf("Will wait for ack\n");
+            printf("Will resend: %d (inc %lu)\n", waitingAck[i].type, 
+                  waitingAckInc[i]);
 #endif
-         waitingTimer.reset();
-         /* Must mark we are waiting for it */
-         messageWaitingForAck = &send[initSend];
-      }
-      else
-      {
-         initSend = (initSend+1)%PROTOCOL_MAX_QUEUED_MESSAGES;
+            /* Note: resent with same inc value */
+            waitingAckTimer[i].reset();
+            waitingAckSkipped[i] = 0;
+            waitingAckResent[i] = true;
+            memcpy(msg, &waitingAck[i], sizeof(ProtocolMessage));
+            return true;
+         }
       }
-      hasMessage = true;
    }
 
-   pthread_mutex_unlock(&mutexSend);
-   return hasMessage;
+   return false;
 }
 
 /***********************************************************************
- *                        getLastMessageToSend                         *
+ *                        getNextQueuedMessage                         *
  ***********************************************************************/
-bool Protocol::getLastMessageToSend(ProtocolMessage* msg)
+bool Protocol::getNextQueuedMessage(ProtocolMessage* msg)
 {
    bool hasMessage = false;
-   pthread_mutex_lock(&mutexSend);
 
-   if(initSend != endSend)
+   if(initControl != endControl)
+   {
+      /* Messages we generated here (as final snapshot resends) */
+      memcpy(msg, &control[initControl], sizeof(ProtocolMessage));
+      initControl = (initControl + 1) % PROTOCOL_MAX_CONTROL_MESSAGES;
+      hasMessage = true;
+   }
+   else if(hasHeldMessage)
+   {
+      if(isFinalSnapshotPending())
+      {
+         /* Still waiting the final snapshot ack: nothing after it */
+         return false;
+      }
+      memcpy(msg, &heldMessage, sizeof(ProtocolMessage));
+      hasHeldMessage = false;
+      hasMessage = true;
+   }
+   else if(popMessage(&send[0], PROTOCOL_MAX_QUEUED_MESSAGES, &initSend,
+            &endSend, msg))
+   {
+      hasMessage = true;
+   }
+   else if(__sync_bool_compare_and_swap(&sendStagingState, 
+            PROTOCOL_STAGING_OPEN, PROTOCOL_STAGING_BUSY))
    {
-      endSend--;
-      if(endSend < 0)
+      /* Must check the queue again, as messages older than the staging
+       * one could be queued before we took it (but not after). */
+      if(popMessage(&send[0], PROTOCOL_MAX_QUEUED_MESSAGES, &initSend,
+               &endSend, msg))
+      {
+         PROTOCOL_MEMORY_BARRIER();
+         sendStagingState = PROTOCOL_STAGING_OPEN;
+      }
+      else
       {
-         endSend = PROTOCOL_MAX_QUEUED_MESSAGES-1;
+         memcpy(msg, &sendStaging, sizeof(ProtocolMessage));
+         PROTOCOL_MEMORY_BARRIER();
+         sendStagingState = PROTOCOL_STAGING_EMPTY;
       }
-      memcpy(msg, &send[endSend], sizeof(ProtocolMessage));
       hasMessage = true;
    }
 
-   pthread_mutex_unlock(&mutexSend);
-   return hasMessage;
+   if(!hasMessage)
+   {
+      return false;
+   }
+
+   if( (msg->type == MESSAGE_RULES_RESULT) && (isFinalSnapshotPending()) )
+   {
+      /* The result must only be applied at the other side after it has
+       * the final positions (the snapshot isn't reliable, and at game
+       * center could even arrive after a later message). */
+      memcpy(&heldMessage, msg, sizeof(ProtocolMessage));
+      hasHeldMessage = true;
+      return false;
+   }
+
+   setSendIncValue(&msg->inc[0]);
+#ifdef BTSOCCER_NET_DEBUG
+   printf("Will send: %d\n", msg->type);
+#endif
+   if(msg->needAck != 0)
+   {
+#ifdef BTSOCCER_NET_DEBUG
+      printf("Will wait for ack\n");
+#endif
+      /* Must keep it at the window, waiting for its ack */
+      int i;
+      for(i = 0; i < PROTOCOL_SEND_WINDOW; i++)
+      {
+         if(waitingAckInc[i] == 0)
+         {
+            memcpy(&waitingAck[i], msg, sizeof(ProtocolMessage));
+            waitingAckInc[i] = curQueueToSendInc;
+            waitingAckTimer[i].reset();
+            waitingAckSkipped[i] = 0;
+            waitingAckResent[i] = false;
+            totalWaitingAck++;
+            break;
+         }
+      }
+   }
 
+   return true;
 }
 
 /***********************************************************************
@@ -220,25 +544,29 @@ bool Protocol::getLastMessageToSend(ProtocolMessage* msg)
  ***********************************************************************/
 void Protocol::queueParsedMessage(ProtocolParsedMessage* msg)
 {
-   pthread_mutex_lock(&mutexReceived);
-   if( (endReceived + 1) % PROTOCOL_MAX_QUEUED_MESSAGES == initReceived )
+   int curEnd = endReceived;
+   int next = (curEnd + 1) % PROTOCOL_MAX_QUEUED_MESSAGES;
+
+   if(next == initReceived)
    {
 #ifdef BTSOCCER_NET_DEBUG
       printf("Messages received queue overflow!\n");
 #endif
-      pthread_mutex_unlock(&mutexReceived);
+      overflows.droppedReceived++;
       return;
    }
  
    /* Insert the message on the queue */
-   received[endReceived].msgType = msg->msgType;
-   received[endReceived].msgInfo = msg->msgInfo;
-   received[endReceived].msgAditionalInfo = msg->msgAditionalInfo;
-   received[endReceived].position = msg->position;
-   received[endReceived].angles = msg->angles;
-   received[endReceived].str = msg->str;
-   endReceived = (endReceived+1) % PROTOCOL_MAX_QUEUED_MESSAGES;
-   pthread_mutex_unlock(&mutexReceived);
+   received[curEnd].msgType = msg->msgType;
+   received[curEnd].msgInfo = msg->msgInfo;
+   received[curEnd].msgAditionalInfo = msg->msgAditionalInfo;
+   received[curEnd].position = msg->position;
+   received[curEnd].angles = msg->angles;
+   received[curEnd].str = msg->str;
+   received[curEnd].turn = msg->turn;
+   received[curEnd].hash = msg->hash;
+   PROTOCOL_MEMORY_BARRIER();
+   endReceived = next;
 }
 
 /***********************************************************************
@@ -246,24 +574,26 @@ void Protocol::queueParsedMessage(ProtocolParsedMessage* msg)
  ***********************************************************************/
 bool Protocol::getNextReceivedMessage(ProtocolParsedMessage* msg)
 {
-   bool hasMessage = false;
+   int curInit = initReceived;
 
-   pthread_mutex_lock(&mutexReceived);
-
-   if(initReceived != endReceived)
+   if(curInit == endReceived)
    {
-      msg->msgType = received[initReceived].msgType;
-      msg->msgInfo = received[initReceived].msgInfo;
-      msg->msgAditionalInfo = received[initReceived].msgAditionalInfo;
-      msg->position = received[initReceived].position;
-      msg->angles = received[initReceived].angles;
-      msg->str = received[initReceived].str;
-      initReceived = (initReceived+1)%PROTOCOL_MAX_QUEUED_MESSAGES;
-      hasMessage = true;
+      return false;
    }
 
-   pthread_mutex_unlock(&mutexReceived);
-   return hasMessage;
+   PROTOCOL_MEMORY_BARRIER();
+   msg->msgType = received[curInit].msgType;
+   msg->msgInfo = received[curInit].msgInfo;
+   msg->msgAditionalInfo = received[curInit].msgAditionalInfo;
+   msg->position = received[curInit].position;
+   msg->angles = received[curInit].angles;
+   msg->str = received[curInit].str;
+   msg->turn = received[curInit].turn;
+   msg->hash = received[curInit].hash;
+   PROTOCOL_MEMORY_BARRIER();
+   initReceived = (curInit + 1) % PROTOCOL_MAX_QUEUED_MESSAGES;
+
+   return true;
 }
 
 /***********************************************************************
@@ -277,6 +607,7 @@ void Protocol::queueHello()
    msg.needAck = 1;
    msg.data[0] = BTSOCCER_VERSION_MAJOR; 
    msg.data[1] = BTSOCCER_VERSION_MINOR; 
+   msg.data[2] = PROTOCOL_LOCAL_ENCODINGS;
    queueMessage(&msg);
 }
 
@@ -287,28 +618,61 @@ void Protocol::queueHello()
 void Protocol::queueSetTeam(Ogre::String teamFile)
 {
    ProtocolMessage msg;
-   memset(msg.data, 0, PROTOCOL_DATA_SIZE);
-   msg.type = MESSAGE_SET_TEAM;
-   msg.needAck = 1;
-   msg.data[0] = (isForTeamA)?UPDATE_TYPE_TEAM_A:UPDATE_TYPE_TEAM_B;
-   sprintf(&msg.data[1], "%s", teamFile.c_str());
-
+   defineSetTeam(&msg, teamFile);
    queueMessage(&msg);
 }
 
+/***********************************************************************
+ *                           defineSetTeam                             *
+ ***********************************************************************/
+void Protocol::defineSetTeam(ProtocolMessage* msg, Ogre::String teamFile)
+{
+   memset(msg->data, 0, PROTOCOL_DATA_SIZE);
+   msg->type = MESSAGE_SET_TEAM;
+   msg->needAck = 1;
+   msg->data[0] = (isForTeamA)?UPDATE_TYPE_TEAM_A:UPDATE_TYPE_TEAM_B;
+   snprintf(&msg->data[1], PROTOCOL_DATA_SIZE - 1, "%s", teamFile.c_str());
+}
+
 /***********************************************************************
  *                          queueSetField                              *
  ***********************************************************************/
 void Protocol::queueSetField(int fieldConstant)
 {
    ProtocolMessage msg;
-   memset(msg.data, 0, PROTOCOL_DATA_SIZE);
-   msg.type = MESSAGE_SET_FIELD;
-   msg.needAck = 1;
-   msg.data[0] = fieldConstant; 
+   defineSetField(&msg, fieldConstant);
    queueMessage(&msg);
 }
 
+/***********************************************************************
+ *                          defineSetField                             *
+ ***********************************************************************/
+void Protocol::defineSetField(ProtocolMessage* msg, int fieldConstant)
+{
+   memset(msg->data, 0, PROTOCOL_DATA_SIZE);
+   msg->type = MESSAGE_SET_FIELD;
+   msg->needAck = 1;
+   msg->data[0] = fieldConstant; 
+   msg->data[1] = ((compactEncoding) ? PROTOCOL_ENCODING_COMPACT : 0) |
+                  ((snapshotEncoding) ? PROTOCOL_ENCODING_SNAPSHOT : 0) |
+                  ((lockstepEncoding) ? PROTOCOL_ENCODING_LOCKSTEP : 0);
+}
+
+/***********************************************************************
+ *                     queueInitConnectionAnswers                      *
+ ***********************************************************************/
+void Protocol::queueInitConnectionAnswers()
+{
+   ProtocolMessage msg;
+
+   /* must send back the field defined at the user server */
+   defineSetField(&msg, fieldSize);
+   queueControlMessage(&msg);
+   /* must send back the team the user with the server will use. */
+   defineSetTeam(&msg, teamFile);
+   queueControlMessage(&msg);
+}
+
 /***********************************************************************
  *                       queueBallUpdateToSend                         *
  ***********************************************************************/
@@ -318,6 +682,19 @@ void Protocol::queueBallUpdateToSend(Ogre::Vector3 pos,
    ProtocolMessage msg;
    memset(msg.data, 0, PROTOCOL_DATA_SIZE);
    int i;
+
+   if(snapshotEncoding)
+   {
+      /* Will be sent at next snapshot */
+      setSnapshotObject(UPDATE_TYPE_BALL, 0, pos, angles);
+      return;
+   }
+   if(compactEncoding)
+   {
+      queueCompactUpdate(UPDATE_TYPE_BALL, 0, pos, angles, 
+            (isFinalPosition) ? 1 : 0);
+      return;
+   }
   
    /* Define header */ 
    msg.type = MESSAGE_UPDATE_POSITIONS;
@@ -360,10 +737,23 @@ void Protocol::queueTeamPlayerUpdateToSend(bool teamA, bool manualInput,
       desiredMessage = (teamA)?UPDATE_TYPE_TEAM_A:UPDATE_TYPE_TEAM_B;
    }
 
+   if((snapshotEncoding) && (!manualInput))
+   {
+      /* Will be sent at next snapshot. Note that manual inputs aren't
+       * part of the snapshots, as shouldn't update replay. */
+      setSnapshotObject(desiredMessage, diskNumber, pos, angles);
+      return;
+   }
+   if(compactEncoding)
+   {
+      queueCompactUpdate(desiredMessage, diskNumber, pos, angles, needAck);
+      return;
+   }
+
    /* First, get last added message and see if it is
     * a teamUpdate message of the same team and have
     * some room to add more data to it. */
-   if(getLastMessageToSend(&msg))
+   if(takeStagingMessage(&msg))
    {
       if( (msg.type == MESSAGE_UPDATE_POSITIONS) &&
           (msg.data[0] == desiredMessage) &&
@@ -379,8 +769,8 @@ void Protocol::queueTeamPlayerUpdateToSend(bool teamA, bool manualInput,
       else
       {
          /* Message not of the same type/team or already full
-          * Put message back at the queue */
-         queueMessage(&msg);
+          * Put message at the queue */
+         releaseStagingMessage(&msg);
       }
    }
    
@@ -407,54 +797,426 @@ void Protocol::queueTeamPlayerUpdateToSend(bool teamA, bool manualInput,
    /* Set the angles*/
    setQuaternion(angles, &msg.data[i]);
    i += 4*doubleSize;
-   /*And add it to the queue */
-   queueMessage(&msg);
+   /* And keep it open to receive more positions */
+   setStagingMessage(&msg);
 }
 
 /***********************************************************************
- *                        queueResultRules                             *
+ *                         queueCompactUpdate                          *
  ***********************************************************************/
-void Protocol::queueRulesResult(int ruleState, bool ballWithTeamA)
+void Protocol::queueCompactUpdate(int updateType, int diskNumber,
+      Ogre::Vector3 pos, Ogre::Quaternion angles, int needAck)
 {
    ProtocolMessage msg;
-   memset(msg.data, 0, PROTOCOL_DATA_SIZE);
-   msg.needAck = 1;
-   msg.type = MESSAGE_RULES_RESULT;
-   msg.data[0] = ruleState;
-   msg.data[1] = (ballWithTeamA)?UPDATE_TYPE_TEAM_A:UPDATE_TYPE_TEAM_B;
-   queueMessage(&msg);
+   char entry[PROTOCOL_COMPACT_SMALLEST_THREE_SIZE];
+   int entrySize = setCompactEntry(updateType, diskNumber, pos, angles,
+         &entry[0]);
+   bool useLast = false;
+
+   /* Try to append to the last queued message, if a compact update
+    * with same ack need and enough room. As each entry carries its
+    * update type, ball and both teams could share the same message. */
+   if(takeStagingMessage(&msg))
+   {
+      if( (msg.type == MESSAGE_UPDATE_POSITIONS_COMPACT) &&
+          (msg.needAck == needAck) &&
+          (PROTOCOL_COMPACT_HEADER_SIZE + getCompactEntriesSize(&msg) + 
+           entrySize <= PROTOCOL_DATA_SIZE) )
+      {
+         useLast = true;
+      }
+      else
+      {
+         /* Put message at the queue */
+         releaseStagingMessage(&msg);
+      }
+   }
+
+   if(!useLast)
+   {
+      memset(msg.data, 0, PROTOCOL_DATA_SIZE);
+      msg.type = MESSAGE_UPDATE_POSITIONS_COMPACT;
+      msg.needAck = needAck;
+      msg.data[0] = 0; // still without entries
+   }
+
+   memcpy(&msg.data[PROTOCOL_COMPACT_HEADER_SIZE + 
+          getCompactEntriesSize(&msg)], &entry[0], entrySize);
+   msg.data[0] += 1;
+   /* Time of the newest entry (older ones of the same object would be
+    * replaced by it at the other side) */
+   setUnsigned32((unsigned int)senderClock.getMilliseconds(), &msg.data[1]);
+   setStagingMessage(&msg);
 }
 
 /***********************************************************************
- *                            queueNack                                *
+ *                          setSnapshotObject                          *
  ***********************************************************************/
-void Protocol::queueNack(char nackReason, char extraInfo)
+void Protocol::setSnapshotObject(int updateType, int diskNumber,
+      Ogre::Vector3 pos, Ogre::Quaternion angles)
 {
-   pthread_mutex_lock(&mutexSend);
-   
-   haveAckOrNackToSend = true;
-   memset(ackNackToSend.data, 0, PROTOCOL_DATA_SIZE);
-   ackNackToSend.needAck = 0;
-   ackNackToSend.type = MESSAGE_NACK;
-   ackNackToSend.data[0] = NACK_REASON_EXPECTED_ANOTHER;
-   ackNackToSend.data[1] = extraInfo;
-   
-   pthread_mutex_unlock(&mutexSend);
+   ProtocolSnapshotEntry entry;
+   entry.size = setCompactEntry(updateType, diskNumber, pos, angles, 
+         &entry.data[0]);
+   int index = getSnapshotObjectIndex(&entry.data[0]);
+   if(index < 0)
+   {
+      return;
+   }
+
+   pthread_mutex_lock(&mutexSnapshot);
+   /* Note: comparing the quantized values, as changes smaller than
+    * its resolution won't be seen by the other side. */
+   if( (snapshotWorld[index].size != entry.size) ||
+       (memcmp(&snapshotWorld[index].data[0], &entry.data[0], 
+               entry.size) != 0) )
+   {
+      memcpy(&snapshotWorld[index], &entry, sizeof(ProtocolSnapshotEntry));
+      worldChanged = true;
+   }
+   pthread_mutex_unlock(&mutexSnapshot);
+}
+
+/***********************************************************************
+ *                            queueSnapshot                            *
+ ***********************************************************************/
+void Protocol::queueSnapshot(bool isFinalPosition)
+{
+   if(!snapshotEncoding)
+   {
+      return;
+   }
+
+   pthread_mutex_lock(&mutexSnapshot);
+   if(snapshotAppliedId != 0)
+   {
+      /* We are now the acting side: the snapshots received from the
+       * other side are no more valid. */
+      clearReceivedSnapshots();
+   }
+   if((worldChanged) || (isFinalPosition))
+   {
+      queueCurrentSnapshot(isFinalPosition);
+   }
+   pthread_mutex_unlock(&mutexSnapshot);
+}
+
+/***********************************************************************
+ *                        queueCurrentSnapshot                         *
+ ***********************************************************************/
+void Protocol::queueCurrentSnapshot(bool isFinalPosition, bool resend)
+{
+   ProtocolMessage msg;
+   ProtocolSnapshotEntry* baseState = NULL;
+   unsigned short baseId = 0;
+   int changed[PROTOCOL_SNAPSHOT_OBJECTS];
+   int totalChanged = 0;
+   int i, size;
+
+   /* Define the next snapshot id (0 is reserved for none) */
+   unsigned short id = curSnapshotId + 1;
+   if(id == 0)
+   {
+      id = 1;
+   }
+
+   /* Define the base: last acknowledged snapshot, if still at history.
+    * At lockstep, snapshots are only sent to resync a world that differs
+    * (and was simulated since then), thus always full. */
+   if( (!lockstepEncoding) && (snapshotAckedId != 0) && 
+       ((unsigned short)(id - snapshotAckedId) < PROTOCOL_SNAPSHOT_HISTORY) &&
+       (snapshotSentId[snapshotAckedId % PROTOCOL_SNAPSHOT_HISTORY] == 
+        snapshotAckedId) )
+   {
+      baseId = snapshotAckedId;
+      baseState = &snapshotSent[baseId % PROTOCOL_SNAPSHOT_HISTORY][0];
+   }
+
+   /* Get the objects changed since the base (unchanged ones cost 
+    * nothing, as the other side already have them). */
+   for(i = 0; i < PROTOCOL_SNAPSHOT_OBJECTS; i++)
+   {
+      if( (snapshotWorld[i].size != 0) &&
+          ( (baseState == NULL) || 
+            (baseState[i].size != snapshotWorld[i].size) ||
+            (memcmp(&baseState[i].data[0], &snapshotWorld[i].data[0],
+                    snapshotWorld[i].size) != 0) ) )
+      {
+         changed[totalChanged] = i;
+         totalChanged++;
+      }
+   }
+
+   if((totalChanged == 0) && (!isFinalPosition))
+   {
+      /* Nothing to send */
+      worldChanged = false;
+      return;
+   }
+
+   /* Keep the world state, to use as base when acknowledged */
+   curSnapshotId = id;
+   memcpy(&snapshotSent[id % PROTOCOL_SNAPSHOT_HISTORY][0], 
+          &snapshotWorld[0], sizeof(snapshotWorld));
+   snapshotSentId[id % PROTOCOL_SNAPSHOT_HISTORY] = id;
+   worldChanged = false;
+
+   /* Calculate how many parts the snapshot needs */
+   int parts = 1;
+   size = 0;
+   for(i = 0; i < totalChanged; i++)
+   {
+      if(PROTOCOL_SNAPSHOT_HEADER_SIZE + size + 
+         snapshotWorld[changed[i]].size > PROTOCOL_DATA_SIZE)
+      {
+         parts++;
+         size = 0;
+      }
+      size += snapshotWorld[changed[i]].size;
+   }
+
+   /* Finally, queue each part */
+   unsigned int time = (unsigned int)senderClock.getMilliseconds();
+   int cur = 0;
+   int part;
+   for(part = 0; part < parts; part++)
+   {
+      memset(msg.data, 0, PROTOCOL_DATA_SIZE);
+      msg.type = MESSAGE_SNAPSHOT;
+      msg.needAck = 0;
+      setUnsigned16(id, &msg.data[0]);
+      setUnsigned16(baseId, &msg.data[2]);
+      msg.data[4] = part;
+      msg.data[5] = parts;
+      msg.data[6] = (isFinalPosition) ? PROTOCOL_SNAPSHOT_FINAL : 0;
+      msg.data[7] = 0;
+      setUnsigned32(time, &msg.data[8]);
+
+      size = PROTOCOL_SNAPSHOT_HEADER_SIZE;
+      while( (cur < totalChanged) && 
+             (size + snapshotWorld[changed[cur]].size <= PROTOCOL_DATA_SIZE) )
+      {
+         memcpy(&msg.data[size], &snapshotWorld[changed[cur]].data[0],
+                snapshotWorld[changed[cur]].size);
+         size += snapshotWorld[changed[cur]].size;
+         msg.data[7] += 1;
+         cur++;
+      }
+      if(resend)
+      {
+         queueControlMessage(&msg);
+      }
+      else
+      {
+         queueMessage(&msg);
+      }
+   }
+#ifdef BTSOCCER_NET_DEBUG
+   printf("Snapshot %d (base %d): %d objects in %d parts\n", id, baseId,
+         totalChanged, parts);
+#endif
+
+   if(isFinalPosition)
+   {
+      /* Must be sure the other side have it */
+      snapshotFinalId = id;
+      snapshotTimer.reset();
+   }
+}
+
+/***********************************************************************
+ *                         checkSnapshotResend                         *
+ ***********************************************************************/
+void Protocol::checkSnapshotResend()
+{
+   if(!snapshotEncoding)
+   {
+      return;
+   }
+
+   pthread_mutex_lock(&mutexSnapshot);
+   if( (snapshotFinalId != 0) && 
+       (snapshotTimer.getMilliseconds() > getSnapshotResendTime()) )
+   {
+#ifdef BTSOCCER_NET_DEBUG
+      printf("Will resend final snapshot: %d\n", snapshotFinalId);
+#endif
+      /* Note: sent as a new snapshot, against the last acknowledged */
+      queueCurrentSnapshot(true, true);
+   }
+   pthread_mutex_unlock(&mutexSnapshot);
+}
+
+/***********************************************************************
+ *                        getSnapshotResendTime                        *
+ ***********************************************************************/
+unsigned long Protocol::getSnapshotResendTime()
+{
+   /* The turn only ends at the other side with the final snapshot, thus
+    * can't wait as long as the other reliable messages. */
+   unsigned long time = 2 * smoothedRtt;
+   if(time < PROTOCOL_MIN_SNAPSHOT_RESEND_MS)
+   {
+      return PROTOCOL_MIN_SNAPSHOT_RESEND_MS;
+   }
+   else if(time > PROTOCOL_TIME_TO_RESEND_MS)
+   {
+      return PROTOCOL_TIME_TO_RESEND_MS;
+   }
+   return time;
+}
+
+/***********************************************************************
+ *                        isFinalSnapshotPending                       *
+ ***********************************************************************/
+bool Protocol::isFinalSnapshotPending()
+{
+   if(!snapshotEncoding)
+   {
+      return false;
+   }
+   pthread_mutex_lock(&mutexSnapshot);
+   bool pending = (snapshotFinalId != 0);
+   pthread_mutex_unlock(&mutexSnapshot);
+   return pending;
+}
+
+/***********************************************************************
+ *                             addRttSample                            *
+ ***********************************************************************/
+void Protocol::addRttSample(unsigned long rtt)
+{
+   /* Usual 1/8 smoothing */
+   smoothedRtt = (7 * smoothedRtt + rtt) / 8;
+}
+
+/***********************************************************************
+ *                         clearSentSnapshots                          *
+ ***********************************************************************/
+void Protocol::clearSentSnapshots()
+{
+   memset(&snapshotWorld[0], 0, sizeof(snapshotWorld));
+   memset(&snapshotSentId[0], 0, sizeof(snapshotSentId));
+   snapshotAckedId = 0;
+   snapshotFinalId = 0;
+   worldChanged = false;
+}
+
+/***********************************************************************
+ *                        queueResultRules                             *
+ ***********************************************************************/
+void Protocol::queueRulesResult(int ruleState, bool ballWithTeamA)
+{
+   ProtocolMessage msg;
+   memset(msg.data, 0, PROTOCOL_DATA_SIZE);
+   msg.needAck = 1;
+   msg.type = MESSAGE_RULES_RESULT;
+   msg.data[0] = ruleState;
+   msg.data[1] = (ballWithTeamA)?UPDATE_TYPE_TEAM_A:UPDATE_TYPE_TEAM_B;
+   queueMessage(&msg);
+}
+
+/***********************************************************************
+ *                            queueNack                                *
+ ***********************************************************************/
+void Protocol::queueNack(char nackReason, char extraInfo)
+{
+   ProtocolMessage nack;
+   memset(nack.inc, 0, PROTOCOL_INC_SIZE);
+   memset(nack.data, 0, PROTOCOL_DATA_SIZE);
+   nack.needAck = 0;
+   nack.type = MESSAGE_NACK;
+   nack.data[0] = NACK_REASON_EXPECTED_ANOTHER;
+   nack.data[1] = extraInfo;
+   queueReply(&nack);
 }
 
 /***********************************************************************
  *                             queueAck                                *
  ***********************************************************************/
-void Protocol::queueAck()
+void Protocol::queueAck(ProtocolMessage* msg)
 {
-   pthread_mutex_lock(&mutexSend);
-   
-   memset(ackNackToSend.data, 0, PROTOCOL_DATA_SIZE);
-   ackNackToSend.type = MESSAGE_ACK;
-   ackNackToSend.needAck = 0;
-   haveAckOrNackToSend = true;
-   
-   pthread_mutex_unlock(&mutexSend);
+   ProtocolMessage ack;
+   memset(ack.inc, 0, PROTOCOL_INC_SIZE);
+   memset(ack.data, 0, PROTOCOL_DATA_SIZE);
+   ack.type = MESSAGE_ACK;
+   ack.needAck = 0;
+
+   /* The acknowledged one */
+   memcpy(&ack.data[0], &msg->inc[0], PROTOCOL_INC_SIZE);
+   /* And all we know were received (thus, a lost ack is covered by the
+    * next ones) */
+   memcpy(&ack.data[4], &receivedCumulativeInc, PROTOCOL_INC_SIZE);
+   memcpy(&ack.data[8], &curReceivedInc, PROTOCOL_INC_SIZE);
+   memcpy(&ack.data[12], &receivedIncMask, PROTOCOL_INC_SIZE);
+
+   queueReply(&ack);
+}
+
+/***********************************************************************
+ *                          queueReceivedAck                           *
+ ***********************************************************************/
+void Protocol::queueReceivedAck(ProtocolMessage* msg)
+{
+   if(!pushMessage(&receivedAcks[0], PROTOCOL_MAX_QUEUED_REPLIES, 
+            &initReceivedAcks, &endReceivedAcks, msg))
+   {
+      /* Not a problem: next acks carry the state of this one */
+      overflows.droppedReplies++;
+   }
+}
+
+/***********************************************************************
+ *                          treatReceivedAcks                          *
+ ***********************************************************************/
+void Protocol::treatReceivedAcks()
+{
+   ProtocolMessage ack;
+   unsigned long acked, cumulative, greatest, mask, inc;
+   int i;
+
+   while(popMessage(&receivedAcks[0], PROTOCOL_MAX_QUEUED_REPLIES,
+            &initReceivedAcks, &endReceivedAcks, &ack))
+   {
+      acked = 0;
+      cumulative = 0;
+      greatest = 0;
+      mask = 0;
+      memcpy(&acked, &ack.data[0], PROTOCOL_INC_SIZE);
+      memcpy(&cumulative, &ack.data[4], PROTOCOL_INC_SIZE);
+      memcpy(&greatest, &ack.data[8], PROTOCOL_INC_SIZE);
+      memcpy(&mask, &ack.data[12], PROTOCOL_INC_SIZE);
+
+      for(i = 0; i < PROTOCOL_SEND_WINDOW; i++)
+      {
+         inc = waitingAckInc[i];
+         if(inc == 0)
+         {
+            continue;
+         }
+         if( (inc == acked) || (inc <= cumulative) || (inc == greatest) ||
+             ( (inc < greatest) && 
+               (greatest - inc - 1 < PROTOCOL_ACK_MASK_BITS) &&
+               (((mask >> (greatest - inc - 1)) & 1) != 0) ) )
+         {
+#ifdef BTSOCCER_NET_DEBUG
+            printf("Received ack of %lu\n", inc);
+#endif
+            /* Acknowledged: free its window slot */
+            if(!waitingAckResent[i])
+            {
+               addRttSample(waitingAckTimer[i].getMilliseconds());
+            }
+            waitingAckInc[i] = 0;
+            totalWaitingAck--;
+         }
+         else if(inc < greatest)
+         {
+            /* A later one was received, but not this: probably lost. */
+            waitingAckSkipped[i]++;
+         }
+      }
+   }
 }
 
 /***********************************************************************
@@ -520,6 +1282,64 @@ void Protocol::queueGoalHappened(bool teamAGoal)
    queueMessage(&msg);
 }
 
+/***********************************************************************
+ *                            queueTurnInput                           *
+ ***********************************************************************/
+void Protocol::queueTurnInput(int turn, int updateType, int diskNumber,
+      float forceX, float forceZ)
+{
+   ProtocolMessage msg;
+   memset(msg.data, 0, PROTOCOL_DATA_SIZE);
+
+   msg.type = MESSAGE_TURN_INPUT;
+   msg.needAck = 1;
+
+   /* Forces as their exact bits, as the other side must simulate the
+    * very same turn */
+   unsigned int bits[2];
+   memcpy(&bits[0], &forceX, sizeof(float));
+   memcpy(&bits[1], &forceZ, sizeof(float));
+
+   setUnsigned16((unsigned short)turn, &msg.data[0]);
+   msg.data[2] = updateType;
+   msg.data[3] = diskNumber;
+   setUnsigned32(bits[0], &msg.data[4]);
+   setUnsigned32(bits[1], &msg.data[8]);
+
+   queueMessage(&msg);
+}
+
+/***********************************************************************
+ *                            queueTurnHash                            *
+ ***********************************************************************/
+void Protocol::queueTurnHash(int turn, unsigned int hash)
+{
+   ProtocolMessage msg;
+   memset(msg.data, 0, PROTOCOL_DATA_SIZE);
+
+   msg.type = MESSAGE_TURN_HASH;
+   msg.needAck = 1;
+   setUnsigned16((unsigned short)turn, &msg.data[0]);
+   setUnsigned32(hash, &msg.data[2]);
+
+   queueMessage(&msg);
+}
+
+/***********************************************************************
+ *                          queueResyncRequest                         *
+ ***********************************************************************/
+void Protocol::queueResyncRequest(int turn)
+{
+   ProtocolMessage msg;
+   memset(msg.data, 0, PROTOCOL_DATA_SIZE);
+
+   msg.type = MESSAGE_RESYNC_REQUEST;
+   msg.needAck = 1;
+   setUnsigned16((unsigned short)turn, &msg.data[0]);
+
+   queueMessage(&msg);
+}
+
 /***********************************************************************
  *                            queuePause                               *
  ***********************************************************************/
@@ -579,38 +1399,12 @@ void Protocol::defineGoodbye(ProtocolMessage* bye)
 }
 
 /***********************************************************************
- *                       parseReceivedMessage                          *
- ***********************************************************************/
-void Protocol::removeMessageWaitingForAck()
-{
-#ifdef BTSOCCER_NET_DEBUG
-   printf("Removed ack wait\n");
-#endif
-   pthread_mutex_lock(&mutexSend);
-   messageWaitingForAck = NULL;
-   initSend = (initSend+1)%PROTOCOL_MAX_QUEUED_MESSAGES;
-   pthread_mutex_unlock(&mutexSend);
-}
-
-/***********************************************************************
- *                         checkIfWaitingAck                           *
- ***********************************************************************/
-bool Protocol::checkIfWaitingForAck()
-{
-   bool res = false;
-   pthread_mutex_lock(&mutexSend);
-   res = messageWaitingForAck != NULL;
-   pthread_mutex_unlock(&mutexSend);
-   
-   return res;
-}
-
-/***********************************************************************
- *                         checkIfWaitingAck                           *
+ *                        discardReceivedMessage                       *
  ***********************************************************************/
 bool Protocol::discardReceivedMessage(ProtocolMessage* msg)
 {
-   if( (msg->type == MESSAGE_ACK) || (msg->type == MESSAGE_NACK) )
+   if( (msg->type == MESSAGE_ACK) || (msg->type == MESSAGE_NACK) ||
+       (msg->type == MESSAGE_SNAPSHOT_ACK) )
    {
       /* Always accept ack or nack. */
       return false;
@@ -618,19 +1412,87 @@ bool Protocol::discardReceivedMessage(ProtocolMessage* msg)
    
    unsigned long received = 0;
    memcpy(&received, &msg->inc[0], PROTOCOL_INC_SIZE);
-   if(received <= curReceivedInc)
+   if(received == 0)
+   {
+      /* Invalid: never sent */
+      return true;
+   }
+
+   if(received > curReceivedInc)
+   {
+      /* Newer than all: shift the mask to it */
+      unsigned long delta = received - curReceivedInc;
+      if(delta >= PROTOCOL_ACK_MASK_BITS)
+      {
+         receivedIncMask = 0;
+      }
+      else
+      {
+         receivedIncMask = ((receivedIncMask << delta) | 
+                            (1UL << (delta - 1))) & 0xFFFFFFFFUL;
+      }
+      curReceivedInc = received;
+   }
+   else if(isIncReceived(received))
+   {
+      /* Already received (the other side didn't get our ack) */
+#ifdef BTSOCCER_NET_DEBUG
+      printf("Received duplicated message. Discarted\n");
+#endif
+      return true;
+   }
+   else if(curReceivedInc - received - 1 >= PROTOCOL_ACK_MASK_BITS)
    {
-      /* Message too old, must discard */
+      /* Message too old (can't know if received), must discard */
 #ifdef BTSOCCER_NET_DEBUG
       printf("Received too old message. Discarted\n");
 #endif
       return true;
    }
+   else if(usingGameCenter)
+   {
+      /* Out of order at a transport that could reorder: as a reliable 
+       * message is never followed by another before acknowledged (see
+       * getSendWindow), this is an outdated unreliable one. Discard it,
+       * instead of delivering it after newer ones. */
+#ifdef BTSOCCER_NET_DEBUG
+      printf("Received out of order message. Discarted\n");
+#endif
+      return true;
+   }
+   else
+   {
+      /* Older, but not yet received (out of order): accept it */
+      receivedIncMask |= 1UL << (curReceivedInc - received - 1);
+   }
+
+   /* Update the cumulative one */
+   while(isIncReceived(receivedCumulativeInc + 1))
+   {
+      receivedCumulativeInc++;
+   }
+
    /* Message up-to-date, must accept */
-   curReceivedInc = received;
    return false;
 }
 
+/***********************************************************************
+ *                            isIncReceived                            *
+ ***********************************************************************/
+bool Protocol::isIncReceived(unsigned long inc)
+{
+   if( (inc <= receivedCumulativeInc) || (inc == curReceivedInc) )
+   {
+      return true;
+   }
+   if( (inc > curReceivedInc) || 
+       (curReceivedInc - inc - 1 >= PROTOCOL_ACK_MASK_BITS) )
+   {
+      return false;
+   }
+   return ((receivedIncMask >> (curReceivedInc - inc - 1)) & 1) != 0;
+}
+
 /***********************************************************************
  *                         checkIfWaitingAck                           *
  ***********************************************************************/
@@ -648,162 +1510,173 @@ bool Protocol::parseReceivedMessage(ProtocolMessage* msg)
 #ifdef BTSOCCER_NET_DEBUG
    printf("Received: %d\n", msg->type);
 #endif
-   if( (checkIfWaitingForAck()) && (msg->type != MESSAGE_ACK))
+   /* Check if already received (or too old), marking it as received */
+   bool discard = discardReceivedMessage(msg);
+
+   /* Send the ack, if needed. Note that must ack even if already received,
+    * as the other side could have lost our previous ack. */
+   if(msg->needAck)
    {
-#ifdef BTSOCCER_NET_DEBUG
-      printf("Message unexpected: %d -> %d\n", msg->type, MESSAGE_ACK);
-#endif
-      /* Unexpected message received */
-      if(msg->needAck)
-      {
-         if(discardReceivedMessage(msg))
-         {
-            /* Message was already received, must resend the ack */
-            queueAck();
-         }
-         else
-         {
-            /* Nack, as unexpected and new! */
-            queueNack(NACK_REASON_EXPECTED_ANOTHER, MESSAGE_ACK);
-         }
-         return true;
-      }
+      queueAck(msg);
    }
-   else
+   
+   if(discard)
    {
-      /* Send the ack, if needed. */
-      if(msg->needAck)
-      {
-         queueAck();
-      }
-      
-      if(discardReceivedMessage(msg))
-      {
-         /* Message is too old to accept. */
-         return true;
-      }
-      
-      /* Let's parse the message got */
-      switch(msg->type)
-      {
-         case MESSAGE_ACK:
+      /* Message is too old to accept. */
+      return true;
+   }
+   
+   /* Let's parse the message got */
+   switch(msg->type)
+   {
+      case MESSAGE_ACK:
 #ifdef BTSOCCER_NET_DEBUG
-            printf("Received ack\n");
+         printf("Received ack\n");
 #endif
-            /* If was waiting for ack, can remove the waiting for ack msg. */
-            removeMessageWaitingForAck();
-         break;
-         case MESSAGE_NACK:
-            /* Received an NACK. TODO: must threat it. */
+         /* Remove the acknowledged messages from the waiting window */
+         queueReceivedAck(msg);
+      break;
+      case MESSAGE_NACK:
+         /* Received an NACK. TODO: must threat it. */
 #ifdef BTSOCCER_NET_DEBUG
-            printf("Received nack, reason: %d\n", msg->data[0]);
+         printf("Received nack, reason: %d\n", msg->data[0]);
 #endif
-         break;
-         case MESSAGE_INIT_CONNECTION:
-         {
-#ifdef BTSOCCER_NET_DEBUG
-            printf("Received hello\n");
-            printf("Client version: %d.%d\n", msg->data[0], msg->data[1]);
-#endif
-            /* Must check if at last minimum version supported. */
-            if( (msg->data[0] >= MIN_MAJOR_SUPPORTED_VERSION) &&
-                (msg->data[1] >= MIN_MINOR_SUPPORTED_VERSION) )
-            {
-               /* must send back the field defined at the user server */
-               queueSetField(fieldSize);
-               /* must send back the team the user with the server will use. */
-               queueSetTeam(teamFile);
-               return true;
-            }
-            else
-            {
-               /* Version unsupported. TODO: close connection and 
-                * set message for user. */
-               queueNack(NACK_REASON_DIFFERENT_VERSIONS);
-               return true;
-            }
-         }
-         break;
-         case MESSAGE_SET_FIELD:
+      break;
+      case MESSAGE_INIT_CONNECTION:
+      {
+#ifdef BTSOCCER_NET_DEBUG
+         printf("Received hello\n");
+         printf("Client version: %d.%d\n", msg->data[0], msg->data[1]);
+#endif
+         /* Must check if at last minimum version supported. */
+         if( (msg->data[0] >= MIN_MAJOR_SUPPORTED_VERSION) &&
+             (msg->data[1] >= MIN_MINOR_SUPPORTED_VERSION) )
          {
-            /* Received set game field. */
-            queueReceivedSetField(msg);
+            /* Use the compact encoding if the client supports it 
+             * (older ones send 0 here). */
+            compactEncoding = (msg->data[2] & PROTOCOL_ENCODING_COMPACT)
+               != 0;
+            snapshotEncoding = (compactEncoding) &&
+               ((msg->data[2] & PROTOCOL_ENCODING_SNAPSHOT) != 0);
+            lockstepEncoding = ((msg->data[2] & PROTOCOL_LOCAL_ENCODINGS &
+                                 PROTOCOL_ENCODING_LOCKSTEP) != 0);
+            /* must send back the field and team defined at the user 
+             * server (by the thread getting messages to send, as the 
+             * only one that should queue messages from here). */
+            PROTOCOL_MEMORY_BARRIER();
+            initConnectionReceived = true;
+            return true;
          }
-         break;
-         case MESSAGE_SET_TEAM:
+         else
          {
-            /* Received the team that will play */
-            queueReceivedSetTeam(msg);
+            /* Version unsupported. TODO: close connection and 
+             * set message for user. */
+            queueNack(NACK_REASON_DIFFERENT_VERSIONS);
+            return true;
          }
-         break;
-         case MESSAGE_UPDATE_POSITIONS:
+      }
+      break;
+      case MESSAGE_SET_FIELD:
+      {
+         /* Received set game field. */
+         queueReceivedSetField(msg);
+      }
+      break;
+      case MESSAGE_SET_TEAM:
+      {
+         /* Received the team that will play */
+         queueReceivedSetTeam(msg);
+      }
+      break;
+      case MESSAGE_UPDATE_POSITIONS:
+      {
+         switch(msg->data[0])
          {
-            switch(msg->data[0])
+            case UPDATE_TYPE_BALL:
             {
-               case UPDATE_TYPE_BALL:
-               {
-                  queueReceivedBallUpdate(msg);
-               }
-               break;
-               case UPDATE_TYPE_TEAM_A:
-               case UPDATE_TYPE_TEAM_B:
-               case UPDATE_TYPE_MANUAL_TEAM_A_INPUT:
-               case UPDATE_TYPE_MANUAL_TEAM_B_INPUT:
-               {
-                  queueReceivedTeamPlayerUpdate(msg);
-               }
-               break;
-               default:
-                  //printf("Unknow update type!\n");
-               break;
+               queueReceivedBallUpdate(msg);
             }
+            break;
+            case UPDATE_TYPE_TEAM_A:
+            case UPDATE_TYPE_TEAM_B:
+            case UPDATE_TYPE_MANUAL_TEAM_A_INPUT:
+            case UPDATE_TYPE_MANUAL_TEAM_B_INPUT:
+            {
+               queueReceivedTeamPlayerUpdate(msg);
+            }
+            break;
+            default:
+               //printf("Unknow update type!\n");
+            break;
          }
-         break;
-         case MESSAGE_PLAY_SOUND:
-         {
-            queueReceivedSoundEffect(msg);
-         }
-         break;
-         case MESSAGE_GOAL:
-         {
-            queueReceivedGoal(msg);
-         }
-         break;
-         case MESSAGE_WILL_SHOOT:
-         case MESSAGE_GOAL_KEEPER_DONE:
-         case MESSAGE_PAUSE:
-         case MESSAGE_RESUME:
-         case MESSAGE_BEGIN_HALF:
-         case MESSAGE_END_HALF:
-         {
-            ProtocolParsedMessage parsed;
-            parsed.msgType = msg->type;
-            queueParsedMessage(&parsed);
-         }
-         break;
-         case MESSAGE_RULES_RESULT:
-         {
-            queueReceivedRulesResult(msg);
-         }
-         break;
-         case MESSAGE_GOODBYE:
-            return false;
-         break;
-         default:
-         {
-            /* Unknow message or message not supported! */
+      }
+      break;
+      case MESSAGE_UPDATE_POSITIONS_COMPACT:
+      {
+         queueReceivedCompactUpdate(msg);
+      }
+      break;
+      case MESSAGE_SNAPSHOT:
+      {
+         queueReceivedSnapshot(msg);
+      }
+      break;
+      case MESSAGE_SNAPSHOT_ACK:
+      {
+         receivedSnapshotAck(msg);
+      }
+      break;
+      case MESSAGE_PLAY_SOUND:
+      {
+         queueReceivedSoundEffect(msg);
+      }
+      break;
+      case MESSAGE_GOAL:
+      {
+         queueReceivedGoal(msg);
+      }
+      break;
+      case MESSAGE_TURN_INPUT:
+      case MESSAGE_TURN_HASH:
+      case MESSAGE_RESYNC_REQUEST:
+      {
+         queueReceivedLockstep(msg);
+      }
+      break;
+      case MESSAGE_WILL_SHOOT:
+      case MESSAGE_GOAL_KEEPER_DONE:
+      case MESSAGE_PAUSE:
+      case MESSAGE_RESUME:
+      case MESSAGE_BEGIN_HALF:
+      case MESSAGE_END_HALF:
+      {
+         ProtocolParsedMessage parsed;
+         parsed.msgType = msg->type;
+         queueParsedMessage(&parsed);
+      }
+      break;
+      case MESSAGE_RULES_RESULT:
+      {
+         queueReceivedRulesResult(msg);
+      }
+      break;
+      case MESSAGE_GOODBYE:
+         return false;
+      break;
+      default:
+      {
+         /* Unknow message or message not supported! */
 #ifdef BTSOCCER_NET_DEBUG
-            printf("Received unknow or not implemented message: %d\n",
-                   msg->type);
+         printf("Received unknow or not implemented message: %d\n",
+                msg->type);
 #endif
-            if(msg->needAck)
-            {
-               queueNack(NACK_REASON_UNKNOW_MESSAGE);
-               return true;
-            }
+         if(msg->needAck)
+         {
+            queueNack(NACK_REASON_UNKNOW_MESSAGE);
+            return true;
          }
-         break;
       }
+      break;
    }
 
    return true;
@@ -874,6 +1747,231 @@ void Protocol::parseQuaternion(double* vec, char* data)
    memcpy(&vec[3], &data[i], doubleSize);
 }
 
+/***********************************************************************
+ *                              setFixed16                             *
+ ***********************************************************************/
+void Protocol::setFixed16(Ogre::Real v, Ogre::Real scale, char* data)
+{
+   long iv = (long)Ogre::Math::Floor(v * scale + 0.5f);
+   if(iv > 32767)
+   {
+      iv = 32767;
+   }
+   else if(iv < -32767)
+   {
+      iv = -32767;
+   }
+   unsigned int uv = (unsigned int)(iv & 0xFFFF);
+   data[0] = (char)(uv & 0xFF);
+   data[1] = (char)((uv >> 8) & 0xFF);
+}
+
+/***********************************************************************
+ *                             parseFixed16                            *
+ ***********************************************************************/
+Ogre::Real Protocol::parseFixed16(Ogre::Real scale, char* data)
+{
+   int v = ((unsigned char)data[0]) | (((unsigned char)data[1]) << 8);
+   if(v >= 32768)
+   {
+      v -= 65536;
+   }
+   return v / scale;
+}
+
+/***********************************************************************
+ *                            setUnsigned16                            *
+ ***********************************************************************/
+void Protocol::setUnsigned16(unsigned short v, char* data)
+{
+   data[0] = (char)(v & 0xFF);
+   data[1] = (char)((v >> 8) & 0xFF);
+}
+
+/***********************************************************************
+ *                           parseUnsigned16                           *
+ ***********************************************************************/
+unsigned short Protocol::parseUnsigned16(char* data)
+{
+   return (unsigned short)(((unsigned char)data[0]) | 
+                           (((unsigned char)data[1]) << 8));
+}
+
+/***********************************************************************
+ *                            setUnsigned32                            *
+ ***********************************************************************/
+void Protocol::setUnsigned32(unsigned int v, char* data)
+{
+   setUnsigned16((unsigned short)(v & 0xFFFF), &data[0]);
+   setUnsigned16((unsigned short)((v >> 16) & 0xFFFF), &data[2]);
+}
+
+/***********************************************************************
+ *                           parseUnsigned32                           *
+ ***********************************************************************/
+unsigned int Protocol::parseUnsigned32(char* data)
+{
+   return ((unsigned int)parseUnsigned16(&data[0])) |
+          (((unsigned int)parseUnsigned16(&data[2])) << 16);
+}
+
+/***********************************************************************
+ *                           isSnapshotNewer                           *
+ ***********************************************************************/
+bool Protocol::isSnapshotNewer(unsigned short a, unsigned short b)
+{
+   /* Half of the id range ahead is newer, the other half is older. */
+   unsigned short delta = a - b;
+   return (delta != 0) && (delta < 32768);
+}
+
+/***********************************************************************
+ *                        getSnapshotObjectIndex                       *
+ ***********************************************************************/
+int Protocol::getSnapshotObjectIndex(char* entry)
+{
+   unsigned char id = (unsigned char)entry[0];
+   int updateType = (id >> 4) & 0xF;
+   int diskNumber = id & 0xF;
+
+   if(diskNumber > UPDATE_GK_INDEX)
+   {
+      return -1;
+   }
+
+   switch(updateType)
+   {
+      case UPDATE_TYPE_BALL:
+         return 0;
+      case UPDATE_TYPE_TEAM_A:
+         return 1 + diskNumber;
+      case UPDATE_TYPE_TEAM_B:
+         return 1 + (UPDATE_GK_INDEX + 1) + diskNumber;
+   }
+
+   return -1;
+}
+
+/***********************************************************************
+ *                           setCompactEntry                           *
+ ***********************************************************************/
+int Protocol::setCompactEntry(int updateType, int diskNumber, 
+      Ogre::Vector3 pos, Ogre::Quaternion q, char* data)
+{
+   data[0] = (char)(((updateType & 0xF) << 4) | (diskNumber & 0xF));
+
+   /* Positions as fixed point */
+   setFixed16(pos.x, PROTOCOL_COMPACT_POSITION_SCALE, &data[2]);
+   setFixed16(pos.y, PROTOCOL_COMPACT_POSITION_SCALE, &data[4]);
+   setFixed16(pos.z, PROTOCOL_COMPACT_POSITION_SCALE, &data[6]);
+
+   q.normalise();
+   if( (Ogre::Math::Abs(q.x) < PROTOCOL_COMPACT_UPRIGHT_EPSILON) &&
+       (Ogre::Math::Abs(q.z) < PROTOCOL_COMPACT_UPRIGHT_EPSILON) )
+   {
+      /* Upright (usually disks): just the angle along Y axis */
+      data[1] = PROTOCOL_ROTATION_Y_ONLY;
+      Ogre::Real a = 2.0f * Ogre::Math::ATan2(q.y, q.w).valueRadians();
+      while(a < 0.0f)
+      {
+         a += Ogre::Math::TWO_PI;
+      }
+      unsigned int v = ((unsigned int)Ogre::Math::Floor(
+               (a / Ogre::Math::TWO_PI) * 65536.0f + 0.5f)) & 0xFFFF;
+      data[8] = (char)(v & 0xFF);
+      data[9] = (char)((v >> 8) & 0xFF);
+      return PROTOCOL_COMPACT_Y_ONLY_SIZE;
+   }
+
+   /* Smallest three: send the three smallest components, as the 
+    * largest one could be calculated from them (it's an unit 
+    * quaternion). As q and -q are the same rotation, the largest
+    * is always made positive. */
+   data[1] = PROTOCOL_ROTATION_SMALLEST_THREE;
+   Ogre::Real c[4] = {q.w, q.x, q.y, q.z};
+   int largest = 0;
+   int i, j;
+   for(i = 1; i < 4; i++)
+   {
+      if(Ogre::Math::Abs(c[i]) > Ogre::Math::Abs(c[largest]))
+      {
+         largest = i;
+      }
+   }
+   Ogre::Real sign = (c[largest] < 0.0f) ? -1.0f : 1.0f;
+   data[8] = (char)largest;
+   j = 9;
+   for(i = 0; i < 4; i++)
+   {
+      if(i != largest)
+      {
+         setFixed16(c[i] * sign, SMALLEST_THREE_SCALE, &data[j]);
+         j += 2;
+      }
+   }
+
+   return PROTOCOL_COMPACT_SMALLEST_THREE_SIZE;
+}
+
+/***********************************************************************
+ *                          parseCompactEntry                          *
+ ***********************************************************************/
+int Protocol::parseCompactEntry(ProtocolParsedMessage* parsed, char* data)
+{
+   unsigned char id = (unsigned char)data[0];
+   parsed->msgInfo = (id >> 4) & 0xF;
+   parsed->msgAditionalInfo = id & 0xF;
+
+   parsed->position = Ogre::Vector3(
+         parseFixed16(PROTOCOL_COMPACT_POSITION_SCALE, &data[2]),
+         parseFixed16(PROTOCOL_COMPACT_POSITION_SCALE, &data[4]),
+         parseFixed16(PROTOCOL_COMPACT_POSITION_SCALE, &data[6]));
+
+   if(data[1] == PROTOCOL_ROTATION_Y_ONLY)
+   {
+      unsigned int v = ((unsigned char)data[8]) | 
+                       (((unsigned char)data[9]) << 8);
+      Ogre::Real halfA = (v / 65536.0f) * Ogre::Math::PI;
+      parsed->angles = Ogre::Quaternion(Ogre::Math::Cos(halfA), 0.0f,
+            Ogre::Math::Sin(halfA), 0.0f);
+      return PROTOCOL_COMPACT_Y_ONLY_SIZE;
+   }
+
+   Ogre::Real c[4];
+   int largest = data[8] & 0x3;
+   int i, j = 9;
+   Ogre::Real sum = 0.0f;
+   for(i = 0; i < 4; i++)
+   {
+      if(i != largest)
+      {
+         c[i] = parseFixed16(SMALLEST_THREE_SCALE, &data[j]);
+         sum += c[i] * c[i];
+         j += 2;
+      }
+   }
+   c[largest] = (sum < 1.0f) ? Ogre::Math::Sqrt(1.0f - sum) : 0.0f;
+   parsed->angles = Ogre::Quaternion(c[0], c[1], c[2], c[3]);
+
+   return PROTOCOL_COMPACT_SMALLEST_THREE_SIZE;
+}
+
+/***********************************************************************
+ *                        getCompactEntriesSize                        *
+ ***********************************************************************/
+int Protocol::getCompactEntriesSize(ProtocolMessage* msg)
+{
+   int i;
+   int size = 0;
+   for(i = 0; i < msg->data[0]; i++)
+   {
+      size += (msg->data[PROTOCOL_COMPACT_HEADER_SIZE + size + 1] == 
+               PROTOCOL_ROTATION_Y_ONLY) ?
+         PROTOCOL_COMPACT_Y_ONLY_SIZE : PROTOCOL_COMPACT_SMALLEST_THREE_SIZE;
+   }
+   return size;
+}
+
 /***********************************************************************
  *                      queueReceivedSetField                          *
  ***********************************************************************/
@@ -884,8 +1982,16 @@ void Protocol::queueReceivedSetField(ProtocolMessage* msg)
    parsed.msgType = msg->type;
    parsed.msgInfo = msg->data[0];
 
+   /* Define the encoding the server chosen */
+   compactEncoding = (msg->data[1] & PROTOCOL_ENCODING_COMPACT) != 0;
+   snapshotEncoding = (compactEncoding) && 
+      ((msg->data[1] & PROTOCOL_ENCODING_SNAPSHOT) != 0);
+   lockstepEncoding = (msg->data[1] & PROTOCOL_ENCODING_LOCKSTEP) != 0;
+
 #ifdef BTSOCCER_NET_DEBUG
-   printf("Received: field: %d\n", parsed.msgInfo);
+   printf("Received: field: %d (compact: %d snapshot: %d lockstep: %d)\n",
+         parsed.msgInfo, compactEncoding, snapshotEncoding, 
+         lockstepEncoding);
 #endif
    queueParsedMessage(&parsed);
 }
@@ -947,6 +2053,7 @@ void Protocol::queueReceivedBallUpdate(ProtocolMessage* msg)
    /* Define the parsed message */
    parsed.msgType = msg->type;
    parsed.msgInfo = UPDATE_TYPE_BALL;
+   parsed.hasSenderTime = false;
    parsed.position = Ogre::Vector3(pos[0], pos[1], pos[2]);
    parsed.angles = Ogre::Quaternion(angle[0], angle[1], angle[2], angle[3]);
    queueParsedMessage(&parsed);
@@ -983,6 +2090,42 @@ void Protocol::queueReceivedGoal(ProtocolMessage* msg)
    queueParsedMessage(&parsed);
 }
 
+/***********************************************************************
+ *                        queueReceivedLockstep                        *
+ ***********************************************************************/
+void Protocol::queueReceivedLockstep(ProtocolMessage* msg)
+{
+   ProtocolParsedMessage parsed;
+
+   parsed.msgType = msg->type;
+   parsed.turn = parseUnsigned16(&msg->data[0]);
+   parsed.hash = 0;
+
+   if(msg->type == MESSAGE_TURN_INPUT)
+   {
+      unsigned int bits[2];
+      float force[2];
+      bits[0] = parseUnsigned32(&msg->data[4]);
+      bits[1] = parseUnsigned32(&msg->data[8]);
+      memcpy(&force[0], &bits[0], sizeof(float));
+      memcpy(&force[1], &bits[1], sizeof(float));
+
+      parsed.msgInfo = msg->data[2];
+      parsed.msgAditionalInfo = msg->data[3];
+      parsed.position = Ogre::Vector3(force[0], 0.0f, force[1]);
+   }
+   else if(msg->type == MESSAGE_TURN_HASH)
+   {
+      parsed.hash = parseUnsigned32(&msg->data[2]);
+   }
+
+#ifdef BTSOCCER_NET_DEBUG
+   printf("Received lockstep message %d: turn %d hash %u\n", msg->type,
+         parsed.turn, parsed.hash);
+#endif
+   queueParsedMessage(&parsed);
+}
+
 /***********************************************************************
  *                   queueReceivedTeamPlayerUpdate                     *
  ***********************************************************************/
@@ -995,6 +2138,7 @@ void Protocol::queueReceivedTeamPlayerUpdate(ProtocolMessage* msg)
    ProtocolParsedMessage parsed;
    parsed.msgType = msg->type;
    parsed.msgInfo = msg->data[0];
+   parsed.hasSenderTime = false;
 #ifdef BTSOCCER_NET_DEBUG
    printf("Updated Team %d\n", parsed.msgInfo);
 #endif
@@ -1020,24 +2164,271 @@ void Protocol::queueReceivedTeamPlayerUpdate(ProtocolMessage* msg)
 
 }
 
+/***********************************************************************
+ *                    queueReceivedCompactUpdate                       *
+ ***********************************************************************/
+void Protocol::queueReceivedCompactUpdate(ProtocolMessage* msg)
+{
+   int i;
+   int pos = PROTOCOL_COMPACT_HEADER_SIZE;
+   ProtocolParsedMessage parsed;
+
+   /* Note: parsed as usual position updates */
+   parsed.msgType = MESSAGE_UPDATE_POSITIONS;
+   parsed.senderTime = parseUnsigned32(&msg->data[1]);
+   parsed.hasSenderTime = true;
+
+   for(i = 0; i < msg->data[0]; i++)
+   {
+      if(pos + PROTOCOL_COMPACT_Y_ONLY_SIZE > PROTOCOL_DATA_SIZE)
+      {
+         /* Malformed message */
+         break;
+      }
+      if((msg->data[pos + 1] != PROTOCOL_ROTATION_Y_ONLY) &&
+         (pos + PROTOCOL_COMPACT_SMALLEST_THREE_SIZE > PROTOCOL_DATA_SIZE))
+      {
+         break;
+      }
+      pos += parseCompactEntry(&parsed, &msg->data[pos]);
+      queueParsedMessage(&parsed);
+#ifdef BTSOCCER_NET_DEBUG
+      printf("   compact %d: %d - pos(%.3f, %.3f, %.3f)\n", 
+            parsed.msgInfo, parsed.msgAditionalInfo, parsed.position[0], 
+            parsed.position[1], parsed.position[2]);
+#endif
+   }
+}
+
+/***********************************************************************
+ *                        queueReceivedSnapshot                        *
+ ***********************************************************************/
+void Protocol::queueReceivedSnapshot(ProtocolMessage* msg)
+{
+   unsigned short id = parseUnsigned16(&msg->data[0]);
+   unsigned short baseId = parseUnsigned16(&msg->data[2]);
+   int part = (unsigned char)msg->data[4];
+   int parts = (unsigned char)msg->data[5];
+   int entries = (unsigned char)msg->data[7];
+   int slot = id % PROTOCOL_SNAPSHOT_HISTORY;
+   int i, index, entrySize;
+
+   if((id == 0) || (parts == 0) || (part >= parts))
+   {
+      /* Malformed message */
+      return;
+   }
+
+   pthread_mutex_lock(&mutexSnapshot);
+
+   if( (snapshotAppliedId != 0) && (!isSnapshotNewer(id, snapshotAppliedId)) )
+   {
+      /* Already have a newer one */
+      pthread_mutex_unlock(&mutexSnapshot);
+      return;
+   }
+
+   if( (snapshotSentId[curSnapshotId % PROTOCOL_SNAPSHOT_HISTORY] != 0) ||
+       (worldChanged) )
+   {
+      /* The other side is the acting one now: our last sent snapshots 
+       * are no more valid as base. */
+      clearSentSnapshots();
+   }
+
+   if(snapshotReceivedId[slot] != id)
+   {
+      /* First part received: the snapshot begins as its base */
+      if(baseId == 0)
+      {
+         memset(&snapshotReceived[slot][0], 0, 
+                sizeof(ProtocolSnapshotEntry) * PROTOCOL_SNAPSHOT_OBJECTS);
+      }
+      else
+      {
+         int baseSlot = baseId % PROTOCOL_SNAPSHOT_HISTORY;
+         if( (baseSlot == slot) || (snapshotReceivedId[baseSlot] != baseId) ||
+             (snapshotReceivedParts[baseSlot] != 0) )
+         {
+            /* Base not available: can't decode (the other side will 
+             * send a full one, when our last ack get too old). */
+#ifdef BTSOCCER_NET_DEBUG
+            printf("Snapshot %d with unknown base %d\n", id, baseId);
+#endif
+            pthread_mutex_unlock(&mutexSnapshot);
+            return;
+         }
+         memcpy(&snapshotReceived[slot][0], &snapshotReceived[baseSlot][0],
+                sizeof(ProtocolSnapshotEntry) * PROTOCOL_SNAPSHOT_OBJECTS);
+      }
+      snapshotReceivedId[slot] = id;
+      snapshotReceivedParts[slot] = parts;
+   }
+   else if(snapshotReceivedParts[slot] == 0)
+   {
+      /* Already complete */
+      pthread_mutex_unlock(&mutexSnapshot);
+      return;
+   }
+
+   /* Apply the part entries */
+   int pos = PROTOCOL_SNAPSHOT_HEADER_SIZE;
+   for(i = 0; i < entries; i++)
+   {
+      if(pos + PROTOCOL_COMPACT_Y_ONLY_SIZE > PROTOCOL_DATA_SIZE)
+      {
+         /* Malformed message */
+         break;
+      }
+      entrySize = (msg->data[pos + 1] == PROTOCOL_ROTATION_Y_ONLY) ?
+         PROTOCOL_COMPACT_Y_ONLY_SIZE : PROTOCOL_COMPACT_SMALLEST_THREE_SIZE;
+      if(pos + entrySize > PROTOCOL_DATA_SIZE)
+      {
+         break;
+      }
+      index = getSnapshotObjectIndex(&msg->data[pos]);
+      if(index >= 0)
+      {
+         snapshotReceived[slot][index].size = entrySize;
+         memcpy(&snapshotReceived[slot][index].data[0], &msg->data[pos],
+                entrySize);
+      }
+      pos += entrySize;
+   }
+   snapshotReceivedParts[slot]--;
+
+   if(snapshotReceivedParts[slot] == 0)
+   {
+      /* Snapshot complete: queue each object changed from the current 
+       * applied state (parsed as usual position updates). At lockstep, 
+       * the objects were locally simulated after applied, thus all
+       * are queued. */
+      ProtocolParsedMessage parsed;
+      parsed.msgType = MESSAGE_UPDATE_POSITIONS;
+      parsed.senderTime = parseUnsigned32(&msg->data[8]);
+      parsed.hasSenderTime = true;
+      for(i = 0; i < PROTOCOL_SNAPSHOT_OBJECTS; i++)
+      {
+         ProtocolSnapshotEntry* entry = &snapshotReceived[slot][i];
+         if( (entry->size != 0) &&
+             ( (lockstepEncoding) ||
+               (snapshotApplied[i].size != entry->size) ||
+               (memcmp(&snapshotApplied[i].data[0], &entry->data[0],
+                       entry->size) != 0) ) )
+         {
+            parseCompactEntry(&parsed, &entry->data[0]);
+            queueParsedMessage(&parsed);
+            memcpy(&snapshotApplied[i], entry, sizeof(ProtocolSnapshotEntry));
+         }
+      }
+      snapshotAppliedId = id;
+#ifdef BTSOCCER_NET_DEBUG
+      printf("Received snapshot %d (base %d)\n", id, baseId);
+#endif
+
+      /* Acknowledge it */
+      ProtocolMessage ack;
+      memset(ack.inc, 0, PROTOCOL_INC_SIZE);
+      memset(ack.data, 0, PROTOCOL_DATA_SIZE);
+      ack.type = MESSAGE_SNAPSHOT_ACK;
+      ack.needAck = 0;
+      setUnsigned16(id, &ack.data[0]);
+      queueReply(&ack);
+   }
+
+   pthread_mutex_unlock(&mutexSnapshot);
+}
+
+/***********************************************************************
+ *                         receivedSnapshotAck                         *
+ ***********************************************************************/
+void Protocol::receivedSnapshotAck(ProtocolMessage* msg)
+{
+   unsigned short id = parseUnsigned16(&msg->data[0]);
+
+   pthread_mutex_lock(&mutexSnapshot);
+   if( (id != 0) && 
+       (snapshotSentId[id % PROTOCOL_SNAPSHOT_HISTORY] == id) &&
+       ( (snapshotAckedId == 0) || (isSnapshotNewer(id, snapshotAckedId)) ) )
+   {
+      /* Will be the base for the next snapshots */
+      snapshotAckedId = id;
+   }
+   if( (snapshotFinalId != 0) && (!isSnapshotNewer(snapshotFinalId, id)) )
+   {
+      /* Final positions are at the other side */
+      snapshotFinalId = 0;
+   }
+   pthread_mutex_unlock(&mutexSnapshot);
+}
+
+/***********************************************************************
+ *                       clearReceivedSnapshots                        *
+ ***********************************************************************/
+void Protocol::clearReceivedSnapshots()
+{
+   memset(&snapshotReceivedId[0], 0, sizeof(snapshotReceivedId));
+   memset(&snapshotReceivedParts[0], 0, sizeof(snapshotReceivedParts));
+   memset(&snapshotApplied[0], 0, sizeof(snapshotApplied));
+   snapshotAppliedId = 0;
+}
+
 ProtocolMessage Protocol::send[PROTOCOL_MAX_QUEUED_MESSAGES];
-int Protocol::endSend;
-int Protocol::initSend;
+volatile int Protocol::endSend;
+volatile int Protocol::initSend;
+ProtocolMessage Protocol::sendStaging;
+volatile int Protocol::sendStagingState;
+ProtocolMessage Protocol::reply[PROTOCOL_MAX_QUEUED_REPLIES];
+volatile int Protocol::initReply;
+volatile int Protocol::endReply;
+ProtocolMessage Protocol::control[PROTOCOL_MAX_CONTROL_MESSAGES];
+int Protocol::initControl;
+int Protocol::endControl;
+volatile bool Protocol::initConnectionReceived;
 ProtocolParsedMessage Protocol::received[PROTOCOL_MAX_QUEUED_MESSAGES];
-int Protocol::initReceived;
-int Protocol::endReceived;
+volatile int Protocol::initReceived;
+volatile int Protocol::endReceived;
+ProtocolOverflowCounters Protocol::overflows;
 unsigned long int Protocol::doubleSize;
 bool Protocol::isForTeamA;
 bool Protocol::isInited;
 bool Protocol::usingGameCenter;
-pthread_mutex_t Protocol::mutexSend;
-pthread_mutex_t Protocol::mutexReceived;
+bool Protocol::compactEncoding;
+bool Protocol::snapshotEncoding;
+bool Protocol::lockstepEncoding;
 Ogre::String Protocol::teamFile;
 int Protocol::fieldSize;
-ProtocolMessage* Protocol::messageWaitingForAck;
+ProtocolMessage Protocol::waitingAck[PROTOCOL_SEND_WINDOW];
+unsigned long Protocol::waitingAckInc[PROTOCOL_SEND_WINDOW];
+Kobold::Timer Protocol::waitingAckTimer[PROTOCOL_SEND_WINDOW];
+int Protocol::waitingAckSkipped[PROTOCOL_SEND_WINDOW];
+bool Protocol::waitingAckResent[PROTOCOL_SEND_WINDOW];
+unsigned long Protocol::smoothedRtt;
+ProtocolMessage Protocol::heldMessage;
+bool Protocol::hasHeldMessage;
+int Protocol::totalWaitingAck;
+ProtocolMessage Protocol::receivedAcks[PROTOCOL_MAX_QUEUED_REPLIES];
+volatile int Protocol::initReceivedAcks;
+volatile int Protocol::endReceivedAcks;
 unsigned long Protocol::curQueueToSendInc;
 unsigned long Protocol::curReceivedInc;
-ProtocolMessage Protocol::ackNackToSend;
-bool Protocol::haveAckOrNackToSend;
-Kobold::Timer Protocol::waitingTimer;
+unsigned long Protocol::receivedIncMask;
+unsigned long Protocol::receivedCumulativeInc;
+ProtocolSnapshotEntry Protocol::snapshotWorld[PROTOCOL_SNAPSHOT_OBJECTS];
+ProtocolSnapshotEntry Protocol::snapshotSent[PROTOCOL_SNAPSHOT_HISTORY]
+                                            [PROTOCOL_SNAPSHOT_OBJECTS];
+unsigned short Protocol::snapshotSentId[PROTOCOL_SNAPSHOT_HISTORY];
+unsigned short Protocol::curSnapshotId;
+unsigned short Protocol::snapshotAckedId;
+unsigned short Protocol::snapshotFinalId;
+Kobold::Timer Protocol::snapshotTimer;
+Kobold::Timer Protocol::senderClock;
+bool Protocol::worldChanged;
+ProtocolSnapshotEntry Protocol::snapshotReceived[PROTOCOL_SNAPSHOT_HISTORY]
+                                                [PROTOCOL_SNAPSHOT_OBJECTS];
+unsigned short Protocol::snapshotReceivedId[PROTOCOL_SNAPSHOT_HISTORY];
+int Protocol::snapshotReceivedParts[PROTOCOL_SNAPSHOT_HISTORY];
+ProtocolSnapshotEntry Protocol::snapshotApplied[PROTOCOL_SNAPSHOT_OBJECTS];
+unsigned short Protocol::snapshotAppliedId;
+pthread_mutex_t Protocol::mutexSnapshot;
 
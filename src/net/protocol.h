@@ -30,6 +30,22 @@ namespace BtSoccer
 
 /*! Time before try to resend. */
 #define PROTOCOL_TIME_TO_RESEND_MS  2000
+/*! Max number of reliable messages (needAck: 1) sent and still waiting
+ * for ack at the same time. Only used by in-order transports (TCP): at
+ * game center the window is a single message (stop-and-wait). */
+#define PROTOCOL_SEND_WINDOW        16
+/*! Number of acks of later messages received without a message in the 
+ * window being acknowledged to resend it, without waiting for 
+ * PROTOCOL_TIME_TO_RESEND_MS. */
+#define PROTOCOL_FAST_RETRANSMIT_ACKS  3
+/*! Round trip time (ms) assumed before measuring any */
+#define PROTOCOL_INITIAL_RTT_MS     200
+/*! Min time (ms) before resending a final snapshot not acknowledged (it 
+ * is resent at twice the smoothed round trip time, up to 
+ * PROTOCOL_TIME_TO_RESEND_MS). */
+#define PROTOCOL_MIN_SNAPSHOT_RESEND_MS  50
+/*! Number of received messages before the greatest one at an ack */
+#define PROTOCOL_ACK_MASK_BITS      32
    
 #define PROTOCOL_DATA_SIZE 253
 #define PROTOCOL_INC_SIZE    4 // must not be greater than unsigned long size.
@@ -71,6 +87,12 @@ typedef struct _ProtocolParsedMessage
       Ogre::Vector3 position; /**< Position related to the parsed message  */
       Ogre::Quaternion angles; /**< Orientation related to the parsed message */
       Ogre::String str; /**< String related: for example: team filename */ 
+      int turn; /**< Turn related (lockstep messages) */
+      unsigned int hash; /**< World state hash (MESSAGE_TURN_HASH) */
+      /*! Sender's clock (ms) when the positions were queued, if 
+       * hasSenderTime (compact updates and snapshots) */
+      unsigned int senderTime;
+      bool hasSenderTime; /**< If senderTime is defined */
 }ProtocolParsedMessage;
 
 /**************************
@@ -79,23 +101,31 @@ typedef struct _ProtocolParsedMessage
 
 /** Note: each turn, the team to act is responsible for the
  * physics and rules calculations/results. The other player 
- * just receive data from it. */
+ * just receive data from it (or, when negotiated 
+ * PROTOCOL_ENCODING_LOCKSTEP, simulates the physics itself from the 
+ * received turn input, just receiving the rules results). */
 
 /*! Just to point that is wating for no message */
 #define MESSAGE_NONE                    -1
 
 /*! Ack: used to acknowledge that a message was received. NeedAck: 0. 
- * Data: MSG_TYPE of the received message. */
+ * Data[0..3]: inc of the received message acknowledged.
+ * Data[4..7]: cumulative inc: all messages until it were received.
+ * Data[8..11]: greatest inc received.
+ * Data[12..15]: bitmask of the PROTOCOL_ACK_MASK_BITS messages before the 
+ *               greatest one (bit n is for inc 'greatest - 1 - n'). */
 #define MESSAGE_ACK                     0x0
 /*! Nack: on refuse of some message due to some restriction. NeedAck: 0.
  * Data: MSG_TYPE + NACK_REASON */
 #define MESSAGE_NACK                    0x1
 /*! Init connection. Need Ack: 1.
  * Data[0]: Game version Major.
- * Data[1]: Game version Minor. */
+ * Data[1]: Game version Minor. 
+ * Data[2]: PROTOCOL_ENCODING flags supported by the client. */
 #define MESSAGE_INIT_CONNECTION         0x2
 /*! Set field type. NeedAck: 1.
- *  Data[0]: Field constant. */
+ *  Data[0]: Field constant. 
+ *  Data[1]: PROTOCOL_ENCODING flags both sides will use. */
 #define MESSAGE_SET_FIELD               0x3
 /*! Set team. NeedAck: 1. 
  *   Data[0]: UPDATE_TYPE_TEAM_A or UPDATE_TYPE_TEAM_B
@@ -154,7 +184,9 @@ typedef struct _ProtocolParsedMessage
 /*! Send a new rule result. NeedAck: 1. Data: Rule result state,
  * with any needed aditional data (ie: position of foul, etc).
  * data[0] -> rule state.
- * data[1] -> active team. */
+ * data[1] -> active team.
+ * With PROTOCOL_ENCODING_SNAPSHOT, only sent after the final snapshot of
+ * the turn was acknowledged. */
 #define MESSAGE_RULES_RESULT            0x8
 /*! Send a message telling the user to positionate its gk to a shoot. 
  * Need ack: 1 */
@@ -181,6 +213,104 @@ typedef struct _ProtocolParsedMessage
 /*! Message sent when some part will exit.
  * Need ack: 0 (as connection will be closed)*/
 #define MESSAGE_GOODBYE                 0xF
+/*! Update positions, with compact encoding (only used when negotiated
+ * PROTOCOL_ENCODING_COMPACT). NeedAck: as MESSAGE_UPDATE_POSITIONS.
+ *   Data[0] -> Total entries defined
+ *   Data[1..4] -> sender's clock (ms, unsigned 32 bits, little endian) 
+ *                 when its newest entry was queued.
+ *   For each entry, from Data[PROTOCOL_COMPACT_HEADER_SIZE]:
+ *     byte 0 -> UPDATE_TYPE (high 4 bits) and disk number (low 4 bits,
+ *               UPDATE_GK_INDEX for goal keeper, 0 for ball).
+ *     byte 1 -> PROTOCOL_ROTATION mode.
+ *     bytes 2..7 -> position x,y,z as fixed point signed 16 bits 
+ *                   (little endian), with PROTOCOL_COMPACT_POSITION_SCALE.
+ *     PROTOCOL_ROTATION_Y_ONLY: bytes 8..9 -> angle along Y axis, as 
+ *                   unsigned 16 bits (65536 is a full turn).
+ *     PROTOCOL_ROTATION_SMALLEST_THREE: byte 8 -> index (w,x,y,z) of the
+ *                   largest component (omitted, always positive); 
+ *                   bytes 9..14 -> the other three components, as fixed 
+ *                   point signed 16 bits of [-1/sqrt(2), 1/sqrt(2)]. */
+#define MESSAGE_UPDATE_POSITIONS_COMPACT 0x10
+#define PROTOCOL_ROTATION_Y_ONLY         0x0
+#define PROTOCOL_ROTATION_SMALLEST_THREE 0x1
+/*! Size of the MESSAGE_UPDATE_POSITIONS_COMPACT header, before entries */
+#define PROTOCOL_COMPACT_HEADER_SIZE            5
+/*! Size of a compact position entry with only Y rotation */
+#define PROTOCOL_COMPACT_Y_ONLY_SIZE            10
+/*! Size of a compact position entry with full rotation */
+#define PROTOCOL_COMPACT_SMALLEST_THREE_SIZE    15
+/*! Fixed point scale for positions: 1/1000 units of resolution, for 
+ *  positions in [-32.767, 32.767] (field coordinates are relative to its
+ *  center, and the biggest one has 19.1 of half size). */
+#define PROTOCOL_COMPACT_POSITION_SCALE  1000.0f
+/*! Max deviation from upright (on quaternion's x and z) to encode only
+ * the Y rotation. */
+#define PROTOCOL_COMPACT_UPRIGHT_EPSILON 0.0005f
+/*! Numbered world snapshot, encoded as a delta against the last snapshot
+ * the peer acknowledged (only used when negotiated 
+ * PROTOCOL_ENCODING_SNAPSHOT). Objects unchanged since the base snapshot
+ * aren't sent at all. As a snapshot could not fit a single message, it 
+ * could be split in parts. NeedAck: 0 (acknowledged by snapshot id, with
+ * MESSAGE_SNAPSHOT_ACK, after receiving all its parts).
+ *   Data[0..1] -> snapshot id (unsigned 16 bits, little endian, never 0)
+ *   Data[2..3] -> base snapshot id (0 for none: a full snapshot)
+ *   Data[4] -> part index
+ *   Data[5] -> total parts of the snapshot
+ *   Data[6] -> PROTOCOL_SNAPSHOT flags
+ *   Data[7] -> Total entries defined at this part
+ *   Data[8..11] -> sender's clock (ms, unsigned 32 bits, little endian)
+ *                  when the snapshot was taken
+ *   Data[12..] -> entries, as at MESSAGE_UPDATE_POSITIONS_COMPACT */
+#define MESSAGE_SNAPSHOT                 0x11
+/*! Acknowledge a completely received snapshot. NeedAck: 0.
+ *   Data[0..1] -> snapshot id */
+#define MESSAGE_SNAPSHOT_ACK             0x12
+/*! Input of a turn, sent instead of the positions while simulating (only
+ * used when negotiated PROTOCOL_ENCODING_LOCKSTEP). NeedAck: 1.
+ *   Data[0..1] -> turn number (unsigned 16 bits, little endian)
+ *   Data[2] -> UPDATE_TYPE_BALL, UPDATE_TYPE_TEAM_A or UPDATE_TYPE_TEAM_B
+ *   Data[3] -> disk number (UPDATE_GK_INDEX for goal keeper, 0 for ball)
+ *   Data[4..7] -> force x, as its IEEE 754 float bits (little endian)
+ *   Data[8..11] -> force z, as its IEEE 754 float bits (little endian) */
+#define MESSAGE_TURN_INPUT               0x13
+/*! Hash of the world state after the turn's rules result was applied, 
+ * sent after the MESSAGE_RULES_RESULT (only with 
+ * PROTOCOL_ENCODING_LOCKSTEP). NeedAck: 1.
+ *   Data[0..1] -> turn number
+ *   Data[2..5] -> world state hash (unsigned 32 bits, little endian) */
+#define MESSAGE_TURN_HASH                0x14
+/*! Request of all positions, after the local world state differed from
+ * the received MESSAGE_TURN_HASH. Answered with final position updates
+ * followed by a new MESSAGE_TURN_HASH. NeedAck: 1.
+ *   Data[0..1] -> turn number */
+#define MESSAGE_RESYNC_REQUEST           0x15
+/*! Snapshot with positions after physics was stable */
+#define PROTOCOL_SNAPSHOT_FINAL          0x1
+/*! Size of the MESSAGE_SNAPSHOT header, before its entries */
+#define PROTOCOL_SNAPSHOT_HEADER_SIZE    12
+/*! Objects at a snapshot: ball and (TEAM_MAX_DISKS + goal keeper) disks 
+ * of each team, indexed by UPDATE_GK_INDEX (thus, 13 slots each). */
+#define PROTOCOL_SNAPSHOT_OBJECTS        27
+/*! Number of snapshots kept to be used as delta bases. If the peer's 
+ * acknowledged one is older than that, a full snapshot is sent. */
+#define PROTOCOL_SNAPSHOT_HISTORY        32
+
+/**************************
+ * Encodings              *
+ **************************/
+
+/*! Compact (quantized) position updates: MESSAGE_UPDATE_POSITIONS_COMPACT */
+#define PROTOCOL_ENCODING_COMPACT       0x1
+/*! Delta-compressed world snapshots: MESSAGE_SNAPSHOT. Only used 
+ * together with PROTOCOL_ENCODING_COMPACT, as reuse its entries. */
+#define PROTOCOL_ENCODING_SNAPSHOT      0x2
+/*! Deterministic lockstep: turns are sent as inputs (MESSAGE_TURN_INPUT)
+ * and both sides simulate them, checking the result by its hash. */
+#define PROTOCOL_ENCODING_LOCKSTEP      0x4
+/*! All encodings supported by this version */
+#define PROTOCOL_SUPPORTED_ENCODINGS    (PROTOCOL_ENCODING_COMPACT | \
+                                         PROTOCOL_ENCODING_SNAPSHOT | \
+                                         PROTOCOL_ENCODING_LOCKSTEP)
 
 /**************************
  * NACK Reasons           *
@@ -198,8 +328,44 @@ typedef struct _ProtocolParsedMessage
 #define NACK_REASON_SAME_TEAMS          0x4
 
 
+/*! An object state at a world snapshot: its compact entry, as the 
+ * quantized values are what the peer will see (and thus what should 
+ * be compared to know if the object changed). */
+typedef struct _ProtocolSnapshotEntry
+{
+   char size; /**< Entry size. 0 if the object state is undefined. */
+   char data[PROTOCOL_COMPACT_SMALLEST_THREE_SIZE]; /**< Compact entry */
+}ProtocolSnapshotEntry;
+
 /** Max number of messages to keep qeued at the protocol */
 #define PROTOCOL_MAX_QUEUED_MESSAGES    256
+/** Max number of replies (acks, nacks) to keep queued at the protocol */
+#define PROTOCOL_MAX_QUEUED_REPLIES     32
+/** Max number of messages the sender thread generates to itself (answers
+ * to the connection init and final snapshot resends). */
+#define PROTOCOL_MAX_CONTROL_MESSAGES   8
+/** Max time a reliable message (needAck: 1) waits for room at a full
+ * queue to send, before being dropped. Unreliable ones are just dropped. */
+#define PROTOCOL_OVERFLOW_WAIT_MS       100
+
+/*! Counters of queue overflows: messages dropped (or delayed) as a queue
+ * was full. Each counter is only incremented by the thread that produce
+ * messages to the related queue. */
+typedef struct _ProtocolOverflowCounters
+{
+   /*! Unreliable messages (needAck: 0) dropped at the queue to send */
+   unsigned long droppedUnreliable;
+   /*! Reliable messages (needAck: 1) dropped at the queue to send, after
+    * waiting PROTOCOL_OVERFLOW_WAIT_MS for room */
+   unsigned long droppedReliable;
+   /*! Reliable messages that needed to wait for room to be queued */
+   unsigned long waitedReliable;
+   /*! Acks, nacks and control messages dropped (the other side will 
+    * resend, as not acknowledged) */
+   unsigned long droppedReplies;
+   /*! Parsed messages dropped at the received queue */
+   unsigned long droppedReceived;
+}ProtocolOverflowCounters;
 
 /*! The protocol interface, responsible
  * for creating / parsing and queuing BtSoccer protocol messages.
@@ -221,7 +387,21 @@ typedef struct _ProtocolParsedMessage
  *|                          |     UPDATE_POSITIONS    |
  *|                          |          (...)          |
  *|                          |       RESULT_RULES      |
- *|           ACK            |                         | */
+ *|           ACK            |                         | 
+ * \note Threads: the queues are single-producer / single-consumer 
+ *       lock-free rings. Only a single thread (usually the game one) must
+ *       queue messages to send (and get the received ones), only a single
+ *       thread must get the messages to send (the network one), and only
+ *       a single thread must parse the received messages (the network 
+ *       one or, at game center, the game one). 
+ * \note When negotiated PROTOCOL_ENCODING_SNAPSHOT, the UPDATE_POSITIONS 
+ *       are replaced by SNAPSHOTs, each acknowledged by a SNAPSHOT_ACK. 
+ * \note Reliable messages aren't stop-and-wait: up to PROTOCOL_SEND_WINDOW
+ *       could be waiting for their acks, each resent on its own timer 
+ *       (or sooner, if later messages were acknowledged). There's no
+ *       reorder buffer, thus the window relies on an in-order transport:
+ *       at game center (which could reorder) it is a single message, and 
+ *       out of order messages are discarded. */
 class Protocol
 {
    public:
@@ -273,6 +453,15 @@ class Protocol
       void queueBallUpdateToSend(Ogre::Vector3 pos, Ogre::Quaternion angles,
                                  bool isFinalPosition);
 
+      /*! Queue the world snapshot with all ball and team player updates
+       * queued since the last call, as a delta against the last snapshot
+       * acknowledged by the other side.
+       * \note only does something if using snapshot encoding (otherwise
+       *       the updates were already queued as individual messages).
+       * \param isFinalPosition true if sending positions after physics
+       *        was stable (and thus the snapshot is resent until acked). */
+      void queueSnapshot(bool isFinalPosition);
+
       /*! Queue a rule result message 
        * \param ruleState the current rule state
        * \param ballWithTeamA if ball pocession is with teamA or teamB */
@@ -285,6 +474,25 @@ class Protocol
        * tell the oponent it's done. */
       void queueGoalKeeperDone();
    
+      /*! Queue the input of a turn (lockstep mode).
+       * \param turn turn number
+       * \param updateType UPDATE_TYPE_BALL, UPDATE_TYPE_TEAM_A or 
+       *        UPDATE_TYPE_TEAM_B
+       * \param diskNumber disk number (UPDATE_GK_INDEX for goal keeper,
+       *        0 for ball)
+       * \param forceX force applied at x axis
+       * \param forceZ force applied at z axis */
+      void queueTurnInput(int turn, int updateType, int diskNumber,
+            float forceX, float forceZ);
+      /*! Queue the world state hash after a turn (lockstep mode).
+       * \param turn turn number
+       * \param hash world state hash */
+      void queueTurnHash(int turn, unsigned int hash);
+      /*! Queue a request of all positions, as the world state differs
+       * (lockstep mode).
+       * \param turn turn number where the difference was detected */
+      void queueResyncRequest(int turn);
+
       /*! Queue a message telling opponent to play a sound on a position.
        * \param soundType SOUND_TYPE constant, describing which sound to play
        * \param pos position where sound effect should be played. */
@@ -318,8 +526,6 @@ class Protocol
        * \param msg pointer to the variable that will receive the messsage.
        * \note: this function will remove the message from the queue. */
       bool getNextMessageToSend(ProtocolMessage* msg);
-      /*! Get the last message at the queue to send. */
-      bool getLastMessageToSend(ProtocolMessage* msg);
 
       /*! Get the next received parsed message on the queue.
        * \return true if the message is defined. False if no more messages
@@ -331,10 +537,25 @@ class Protocol
       /*! @return if protocol is using iOS game center */
       bool isUsingGameCenter();
 
+      /*! @return if position updates are sent with the compact encoding,
+       *  negotiated at connection. */
+      bool isUsingCompactEncoding();
+      /*! @return if position updates are sent as delta-compressed world
+       *  snapshots, negotiated at connection. */
+      bool isUsingSnapshots();
+      /*! @return if turns are sent as inputs, simulated at both sides,
+       *  negotiated at connection. */
+      bool isUsingLockstep();
+
+      /*! Get the current queues overflow counters
+       * \param counters pointer to the struct to receive the counters */
+      void getOverflowCounters(ProtocolOverflowCounters* counters);
+
    protected:
 
-      /*! Queue an ack message to send */
-      void queueAck();
+      /*! Queue an ack message to send
+       * \param msg received message to acknowledge */
+      void queueAck(ProtocolMessage* msg);
       /*! Queue a nack message to send */
       void queueNack(char nackReaon, char extraInfo=0);
       /*! Define a message as a bye message */
@@ -346,6 +567,17 @@ class Protocol
        *        can be deleted/freed without problems. */
       void queueMessage(ProtocolMessage* msg);
 
+      /*! Take the message of position updates still open to append more 
+       * positions, if any. After, it must be defined back with 
+       * #setStagingMessage or released with #releaseStagingMessage.
+       * \param msg pointer to receive the message
+       * \return true if got the message */
+      bool takeStagingMessage(ProtocolMessage* msg);
+      /*! Define the message of position updates still open to append */
+      void setStagingMessage(ProtocolMessage* msg);
+      /*! Release the staging message previously taken, queueing it. */
+      void releaseStagingMessage(ProtocolMessage* msg);
+
       /*! Queue a parsed message received
        * \param pointer to the message to queue.
        * \note: the message is copied on the queue, so the pointer
@@ -366,6 +598,48 @@ class Protocol
       void queueReceivedSoundEffect(ProtocolMessage* msg);
       /*! Queue a received goal to the parsed queue */
       void queueReceivedGoal(ProtocolMessage* msg);
+      /*! Queue a received lockstep message (turn input, turn hash or
+       * resync request) to the parsed queue. */
+      void queueReceivedLockstep(ProtocolMessage* msg);
+      /*! Queue each entry of a received compact position update */
+      void queueReceivedCompactUpdate(ProtocolMessage* msg);
+
+      /*! Queue a position update to send, with compact encoding, 
+       * appending it to the last queued one when possible.
+       * \param updateType UPDATE_TYPE constant
+       * \param diskNumber disk number (or 0 for ball)
+       * \param pos position to send
+       * \param angles orientation to send
+       * \param needAck if the update must receive ack */
+      void queueCompactUpdate(int updateType, int diskNumber, 
+            Ogre::Vector3 pos, Ogre::Quaternion angles, int needAck);
+
+      /*! Set the current state of an object at the world to snapshot.
+       * \param updateType UPDATE_TYPE_BALL, UPDATE_TYPE_TEAM_A or 
+       *        UPDATE_TYPE_TEAM_B.
+       * \param diskNumber disk number (or 0 for ball)
+       * \param pos current position
+       * \param angles current orientation */
+      void setSnapshotObject(int updateType, int diskNumber, 
+            Ogre::Vector3 pos, Ogre::Quaternion angles);
+      /*! Queue a received snapshot part, queueing the changed objects
+       * to the parsed queue when the snapshot is complete. */
+      void queueReceivedSnapshot(ProtocolMessage* msg);
+      /*! Treat a received snapshot ack, defining the new delta base. */
+      void receivedSnapshotAck(ProtocolMessage* msg);
+      /*! Resend the final snapshot if not yet acknowledged in time 
+       * (see #getSnapshotResendTime).
+       * \note only called by the thread getting messages to send. */
+      void checkSnapshotResend();
+      /*! \return time (ms) to wait a final snapshot ack before resending
+       *         it: twice the smoothed round trip time, clamped to 
+       *         [PROTOCOL_MIN_SNAPSHOT_RESEND_MS, 
+       *          PROTOCOL_TIME_TO_RESEND_MS]. */
+      unsigned long getSnapshotResendTime();
+      /*! \return if the last final snapshot wasn't yet acknowledged */
+      bool isFinalSnapshotPending();
+      /*! Add a measured round trip time to the smoothed one */
+      void addRttSample(unsigned long rtt);
 
    protected:
       static Ogre::String teamFile;       /**< File of the owners team*/
@@ -378,57 +652,208 @@ class Protocol
       void parseVector3(double* vec, char* data);
       void setQuaternion(Ogre::Quaternion q, char* data);
       void parseQuaternion(double* vec, char* data);
+
+      /*! Set a compact position entry to the data vector.
+       * \return entry size */
+      int setCompactEntry(int updateType, int diskNumber, Ogre::Vector3 pos,
+            Ogre::Quaternion q, char* data);
+      /*! Parse a compact position entry from the data vector
+       * \return entry size */
+      int parseCompactEntry(ProtocolParsedMessage* parsed, char* data);
+      /*! \return size of the compact entries at a message */
+      int getCompactEntriesSize(ProtocolMessage* msg);
+      /*! \return snapshot object index of a compact entry, or -1 */
+      int getSnapshotObjectIndex(char* entry);
+      /*! \return if snapshot id a is newer than b (with wrap around) */
+      bool isSnapshotNewer(unsigned short a, unsigned short b);
+      /*! Set a 16 bits unsigned value at data (little endian) */
+      void setUnsigned16(unsigned short v, char* data);
+      /*! Get a 16 bits unsigned value from data (little endian) */
+      unsigned short parseUnsigned16(char* data);
+      /*! Set a 32 bits unsigned value at data (little endian) */
+      void setUnsigned32(unsigned int v, char* data);
+      /*! Get a 32 bits unsigned value from data (little endian) */
+      unsigned int parseUnsigned32(char* data);
+      /*! Queue the current world snapshot (must be called inside 
+       * mutexSnapshot lock).
+       * \param isFinalPosition if positions after physics was stable
+       * \param resend if resending it from the thread getting messages
+       *        to send (thus, queued as control messages). */
+      void queueCurrentSnapshot(bool isFinalPosition, bool resend=false);
+      /*! Clear the state of the snapshots sent (and acknowledged) */
+      void clearSentSnapshots();
+      /*! Clear the state of the snapshots received */
+      void clearReceivedSnapshots();
+
+      /*! Set a fixed point signed 16 bits value at data */
+      void setFixed16(Ogre::Real v, Ogre::Real scale, char* data);
+      /*! Get a fixed point signed 16 bits value from data */
+      Ogre::Real parseFixed16(Ogre::Real scale, char* data);
    
-      /*! Check if will discard message based on received increment value.
+      /*! Check if will discard message based on received increment value,
+       * marking it as received if not.
        * \note always accept ack and nack.
-       * @return true if will discard, false if will accept. */
+       * \note at game center, out of order messages are discarded too.
+       * @return true if will discard (already received or too old), 
+       *         false if will accept. */
       bool discardReceivedMessage(ProtocolMessage* msg);
+      /*! \return if message with inc value was already received */
+      bool isIncReceived(unsigned long inc);
    
       /*! Set the inc value to send, incrementing it. */
       void setSendIncValue(char* incValue);
    
-      /*! Remove the message that was waiting for ack, usually after
-      * receveing it. */
-      void removeMessageWaitingForAck();
-      /*! Check if is currently waiting for an ack.
-       * \note: must not be called inside lock of mutexSend, as it also
-       *   lock this muxed. (thus, if called inside, we'll get a dead lock*/
-      bool checkIfWaitingForAck();
-
-      /*! Messages queued to send  */
+      /*! Queue a received ack to be treated by the thread getting the
+       * messages to send (the owner of the messages waiting for ack). */
+      void queueReceivedAck(ProtocolMessage* msg);
+      /*! Treat all received acks, removing acknowledged messages from the
+       * window of messages waiting for ack. */
+      void treatReceivedAcks();
+      /*! \return max number of reliable messages waiting for ack at the
+       *         same time for the current transport. */
+      int getSendWindow();
+      /*! Get the next message waiting for ack to resend, if any. */
+      bool getNextMessageToResend(ProtocolMessage* msg);
+
+      /*! Push a message to a lock-free ring (by its single producer).
+       * \return false if the ring is full. */
+      bool pushMessage(ProtocolMessage* ring, int size, volatile int* init,
+            volatile int* end, ProtocolMessage* msg);
+      /*! Pop a message from a lock-free ring (by its single consumer).
+       * \return false if the ring is empty. */
+      bool popMessage(ProtocolMessage* ring, int size, volatile int* init,
+            volatile int* end, ProtocolMessage* msg);
+      /*! Push a message to the send ring, with the overflow policy. */
+      void pushSendMessage(ProtocolMessage* msg);
+      /*! Queue a reply (ack or nack) to send, from the parser thread */
+      void queueReply(ProtocolMessage* msg);
+      /*! Queue a control message, from the thread getting messages to send
+       * (no need to synchronize, as is its own). */
+      void queueControlMessage(ProtocolMessage* msg);
+      /*! Queue the answers to a received connection init */
+      void queueInitConnectionAnswers();
+      /*! Define a message as a set field one */
+      void defineSetField(ProtocolMessage* msg, int fieldConstant);
+      /*! Define a message as a set team one */
+      void defineSetTeam(ProtocolMessage* msg, Ogre::String teamFile);
+      /*! Get the next message to send, besides acks and nacks, defining 
+       * it as waiting for ack if needed. */
+      bool getNextQueuedMessage(ProtocolMessage* msg);
+
+      /*! Messages queued to send (produced by game thread, consumed 
+       * by network one) */
       static ProtocolMessage send[PROTOCOL_MAX_QUEUED_MESSAGES];
       /*! Current end of the send queue */
-      static int endSend;
+      static volatile int endSend;
       /*! Current init of the send queue*/
-      static int initSend;
+      static volatile int initSend;
+      /*! The last queued position update message, still open to receive
+       * more positions (thus, not yet on the send queue) */
+      static ProtocolMessage sendStaging;
+      /*! State of the sendStaging (PROTOCOL_STAGING constants) */
+      static volatile int sendStagingState;
+      /*! Acks and nacks to send (produced by the parser thread) */
+      static ProtocolMessage reply[PROTOCOL_MAX_QUEUED_REPLIES];
+      static volatile int initReply; /**< Current init of reply queue */
+      static volatile int endReply; /**< Current end of reply queue */
+      /*! Messages generated by the thread getting messages to send itself 
+       * (not a shared queue) */
+      static ProtocolMessage control[PROTOCOL_MAX_CONTROL_MESSAGES];
+      static int initControl; /**< Current init of control queue */
+      static int endControl; /**< Current end of control queue */
+      /*! If received a connection init, to answer it */
+      static volatile bool initConnectionReceived;
       /*! Queue of parsed messages received */
       static ProtocolParsedMessage received[PROTOCOL_MAX_QUEUED_MESSAGES];
       /*! Current init of the received queue */
-      static int initReceived;
+      static volatile int initReceived;
       /*! Current end of the received queue */
-      static int endReceived;
+      static volatile int endReceived;
+
+      /*! Overflow counters */
+      static ProtocolOverflowCounters overflows;
    
       /*! Current inc value of same message type. */
       static unsigned long curQueueToSendInc;
-      /*! Current inc value from last received message  */
+      /*! Greatest inc value received */
       static unsigned long curReceivedInc;
+      /*! Received messages before curReceivedInc (bit n: 
+       * 'curReceivedInc - 1 - n') */
+      static unsigned long receivedIncMask;
+      /*! All messages until this inc value were received */
+      static unsigned long receivedCumulativeInc;
    
       /*! Keep the sizeof(double) */
       static unsigned long int doubleSize;
 
       static bool isForTeamA; /**< if the protocol is at the server */
       static bool usingGameCenter; /**< if is using protocol with gamecenter*/
+      static bool compactEncoding; /**< if using compact position updates */
+      static bool snapshotEncoding; /**< if using world snapshots */
+      static bool lockstepEncoding; /**< if using lockstep turn inputs */
       static bool isInited; /**< if the protocol was previous inited. */
    
-      static ProtocolMessage* messageWaitingForAck; /**< Message that is 
-                                                  currently waiting for ack. */
-      /*! Ack and NACK must not respect the queue, and be direct sent. */
-      static ProtocolMessage ackNackToSend;
-      static bool haveAckOrNackToSend; /**< When must send a ack or nack */
-      static Kobold::Timer waitingTimer; /**< Waiting for ack timer */
-
-      static pthread_mutex_t mutexSend; /**< Mutex for send queue*/
-      static pthread_mutex_t mutexReceived; /**< Mutex for received queue */
+      /* Window of messages waiting for ack (only used by the thread 
+       * getting messages to send) */
+      /*! Copy of each message waiting for ack */
+      static ProtocolMessage waitingAck[PROTOCOL_SEND_WINDOW];
+      /*! Inc value of each message waiting for ack (0 for free slot) */
+      static unsigned long waitingAckInc[PROTOCOL_SEND_WINDOW];
+      /*! Time since each message was (re)sent */
+      static Kobold::Timer waitingAckTimer[PROTOCOL_SEND_WINDOW];
+      /*! Acks received of later messages, without acknowledging it */
+      static int waitingAckSkipped[PROTOCOL_SEND_WINDOW];
+      /*! If each message was resent (thus its ack isn't a valid round
+       * trip time sample, as could be of any of its sends). */
+      static bool waitingAckResent[PROTOCOL_SEND_WINDOW];
+      /*! Smoothed round trip time, in ms (only used by the thread getting
+       * messages to send) */
+      static unsigned long smoothedRtt;
+      /*! MESSAGE_RULES_RESULT held until the final snapshot (with the
+       * positions it is about) is acknowledged */
+      static ProtocolMessage heldMessage;
+      static bool hasHeldMessage; /**< If heldMessage is defined */
+      static int totalWaitingAck; /**< Messages waiting for ack */
+      /*! Acks received by the parser (to the thread getting messages to
+       * send, lock-free) */
+      static ProtocolMessage receivedAcks[PROTOCOL_MAX_QUEUED_REPLIES];
+      static volatile int initReceivedAcks; /**< Init of receivedAcks */
+      static volatile int endReceivedAcks; /**< End of receivedAcks */
+
+      /* Snapshots to send */
+      /*! Current state of the world, to send at next snapshot */
+      static ProtocolSnapshotEntry 
+         snapshotWorld[PROTOCOL_SNAPSHOT_OBJECTS];
+      /*! Each sent snapshot world state, indexed by id modulo history */
+      static ProtocolSnapshotEntry 
+         snapshotSent[PROTOCOL_SNAPSHOT_HISTORY][PROTOCOL_SNAPSHOT_OBJECTS];
+      /*! Id of each sent snapshot at snapshotSent (0 for none) */
+      static unsigned short snapshotSentId[PROTOCOL_SNAPSHOT_HISTORY];
+      static unsigned short curSnapshotId; /**< Last sent snapshot id */
+      static unsigned short snapshotAckedId; /**< Last acknowledged id */
+      /*! Final snapshot waiting for ack (0 for none) */
+      static unsigned short snapshotFinalId;
+      static Kobold::Timer snapshotTimer; /**< Final snapshot ack timer */
+      /*! Sender's clock, stamped on position updates, thus the other
+       * side could render them at the times they were simulated (instead
+       * of when received). */
+      static Kobold::Timer senderClock;
+      static bool worldChanged; /**< If world changed since last snapshot */
+
+      /* Snapshots received */
+      /*! Each received snapshot world state, indexed by id modulo history */
+      static ProtocolSnapshotEntry snapshotReceived[PROTOCOL_SNAPSHOT_HISTORY]
+                                                   [PROTOCOL_SNAPSHOT_OBJECTS];
+      /*! Id of each received snapshot at snapshotReceived (0 for none) */
+      static unsigned short snapshotReceivedId[PROTOCOL_SNAPSHOT_HISTORY];
+      /*! Parts already received of each snapshot at snapshotReceived */
+      static int snapshotReceivedParts[PROTOCOL_SNAPSHOT_HISTORY];
+      /*! World state already queued to the parsed queue */
+      static ProtocolSnapshotEntry 
+         snapshotApplied[PROTOCOL_SNAPSHOT_OBJECTS];
+      static unsigned short snapshotAppliedId; /**< Last applied snapshot */
+
+      static pthread_mutex_t mutexSnapshot; /**< Mutex for snapshots */
 
 };
 
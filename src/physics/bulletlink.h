@@ -18,28 +18,44 @@
   along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-
 #ifndef _btsoccer_bulletlink_h
 #define _btsoccer_bulletlink_h
 
 #include <btBulletDynamicsCommon.h>
+#include <pthread.h>
+#include "physicscontext.h"
 #include "../debug/bulletdebugdraw.h"
-#include "../net/protocol.h"
 #include "../btsoccer.h"
 
 namespace BtSoccer
 {
    /*! Class that make the link with bullet, initing it,
-    * setting the world, etc. */
+    * setting the world, etc.
+    * It is a facade to the PhysicsContext bound to the calling thread
+    * (see #setThreadContext) or, if none, to the default one, created
+    * by #createBulletWorld. */
    class BulletLink
    {
       public:
-         /*! Create the bullet world to use */
+         /*! Create the default bullet world (context) to use */
          static void createBulletWorld();
 
-         /*! Delete the created bulled world */
+         /*! Delete the created default bulled world */
          static void deleteBulletWorld();
 
+         /*! Bind a context to the calling thread. While bound, all
+          * BulletLink calls from the thread will use it instead of the
+          * default one, and all FieldObjects created by the thread will
+          * live on its world.
+          * \param context context to bind, or NULL to use the default one. */
+         static void setThreadContext(PhysicsContext* context);
+
+         /*! \return context to use by the calling thread */
+         static PhysicsContext* getContext();
+
+         /*! \return the default context, if created */
+         static PhysicsContext* getDefaultContext() { return defaultContext; };
+
          /*! Set pointers used by the bullet link 
           * \param tA -> pointer to team A 
           * \param tB -> pointer to team B
@@ -49,12 +65,10 @@ namespace BtSoccer
          static void setPointers(Team* tA, Team* tB, FieldObject* b, 
                Field* f, bool online);
 
-         /*! The callback for bullet tick */
-         static void tickCallBack();
-
          /*! Add rigid body to the world
-          * \param rigidBody -> pointer to the rigid body to add */
-         static void addRigidBody(btRigidBody* rigidBody);
+          * \param rigidBody -> pointer to the rigid body to add
+          * \param group -> its collision filter group (PHYSICS_GROUP_*) */
+         static void addRigidBody(btRigidBody* rigidBody, int group);
          
          /*! Remove rigid body from the world
           * \param rigidBody -> pointer to the rigid body to remove */
@@ -76,9 +90,25 @@ namespace BtSoccer
           * \param maxSubSteps -> numer of bullet sub steps */
          static void step(btScalar timeStep, int maxSubSteps);
 
+         /*! Resolve a turn to rest, as fast as possible, without 
+          * rendering. See PhysicsContext::resolveTurn. */
+         static bool resolveTurn(FieldObject* actor, Ogre::Real fx, 
+               Ogre::Real fz, TurnResult& result,
+               int maxFrames=PHYSICS_CONTEXT_MAX_RESOLVE_FRAMES);
+
+         /*! Resolve the current simulation to rest, as fast as possible.
+          * See PhysicsContext::resolve. */
+         static bool resolve(TurnResult& result, 
+               int maxFrames=PHYSICS_CONTEXT_MAX_RESOLVE_FRAMES);
+
          /*! Do a step just to stabilize physics after a position set. */
          static void forcedStep(btScalar timeStep=0.1f, int maxSubSteps=5);
 
+         /*! Start a placement batch. See PhysicsContext::beginPlacement */
+         static void beginPlacement();
+         /*! End a placement batch. See PhysicsContext::endPlacement */
+         static void endPlacement();
+
          /*! Check if the world system is stable (ie: with no
           * velocities and forces; aka: static!) */
          static bool isWorldStable();
@@ -89,31 +119,17 @@ namespace BtSoccer
           *                   the ones that changed.*/
          static void queueUpdatesToProtocol(bool sendAll=false);
 
-      protected:
-
-         /*! Check if ball is inner the field and tell rules otherwise. */
-         static void checkBallFieldLimits();
-
       private:
          BulletLink(){};
 
-         static btBroadphaseInterface* broadPhase; 
-         static btDefaultCollisionConfiguration* collisionConfiguration;
-         static btCollisionDispatcher* dispatcher;
-         static btSequentialImpulseConstraintSolver* solver;
-         static btDiscreteDynamicsWorld* dynamicsWorld;
-         static BulletDebugDraw* bulletDebugDraw;
-         static Team* teamA;
-         static Team* teamB;
-         static Ogre::Real diskDiameter;
-         static FieldObject* ball;
-         static Field* field;
-         static bool rulesEnabled;
-         static bool onlineGame;
-         static Protocol protocol;
+         /*! Create the key used to bind contexts to threads */
+         static void createThreadContextKey();
+
+         static PhysicsContext* defaultContext;
+         static pthread_key_t threadContextKey;
+         static pthread_once_t threadContextKeyOnce;
    };
 
 }
 
 #endif
-
@@ -126,31 +126,32 @@ void Collision::checkOrientations()
 /*****************************************************************
  *                         removeContacts                        *
  *****************************************************************/
-void Collision::removeContacts(bool isolateBall, Field* f)
+bool Collision::removeContacts(bool isolateBall, Field* f)
 {
    int i;
 
+   /* Place all away from contacts, settling them with a single step */
+   BulletLink::beginPlacement();
+
    /* Check orientations to be facing up */
    checkOrientations();
 
-   /* Verify Each Team */
+   /* Define the circles: disks could be moved, while the ball and goal
+    * keepers are kept at their positions. */
+   totalCircles = 0;
+   float diskRadius = 0.0f;
    Team* curTeam = teamA;
    while(curTeam)
    {
-      /* Verify Each Disk */
       for(i=0; i < field->getNumberOfDisks(); i++)
       {
-         if(removeContact(isolateBall, curTeam->getDisk(i), f))
-         {
-            /* One or more contacts were removed. Must verify all
-             * disks again with the new defined position. */
-            i = 0;
-            curTeam = teamA;
-         }
+         TeamPlayer* disk = curTeam->getDisk(i);
+         diskRadius = disk->getSphereRadius() + 
+            BTSOCCER_COLLISION_THRESHOLD_DELTA;
+         addCircle(disk, disk->getPosition(), diskRadius, true);
       }
-
-      /* FIXME: Verify GoalKeeper */
-      //removeContact(isolateBall, curTeam->getGoalKeeper());
+      GoalKeeper* gk = curTeam->getGoalKeeper();
+      addCircle(gk, gk->getPosition(), gk->getSphereRadius(), false);
 
       /* Select next team or end */
       if(curTeam != teamB)
@@ -162,160 +163,278 @@ void Collision::removeContacts(bool isolateBall, Field* f)
          curTeam = NULL;
       }
    }
+   float ballRadius = gameBall->getSphereRadius();
+   if(isolateBall)
+   {
+      ballRadius += 3.0f * diskRadius;
+   }
+   addCircle(NULL, gameBall->getPosition(), ballRadius, false);
+
+   bool resolved = resolveOverlaps(isolateBall, f);
+
+   /* Write back the new positions */
+   for(i = 0; i < totalCircles; i++)
+   {
+      CollisionCircle& c = circles[i];
+      if(c.movable)
+      {
+         Ogre::Vector3 pos = c.disk->getPosition();
+         if((pos.x != c.x) || (pos.z != c.z))
+         {
+            c.disk->setPosition(c.x, 0.0f, c.z);
+         }
+      }
+   }
+
+   BulletLink::endPlacement();
+
+   return resolved;
+}
+
+/*****************************************************************
+ *                           addCircle                           *
+ *****************************************************************/
+void Collision::addCircle(TeamPlayer* disk, Ogre::Vector3 pos, 
+                          float radius, bool movable)
+{
+   if(totalCircles >= COLLISION_MAX_CIRCLES)
+   {
+      return;
+   }
+   CollisionCircle& c = circles[totalCircles];
+   c.disk = disk;
+   c.x = pos.x;
+   c.z = pos.z;
+   c.radius = radius;
+   c.movable = movable;
+   c.cellX = 0;
+   c.cellZ = 0;
+   c.next = -1;
+   totalCircles++;
 }
 
 /*****************************************************************
- *                         removeContact                         *
+ *                           getBucket                           *
  *****************************************************************/
-bool Collision::removeContact(bool isolateBall, TeamPlayer* disk,
-                              Field* f)
+int Collision::getBucket(int cellX, int cellZ)
+{
+   unsigned int h = ((unsigned int)cellX * 73856093U) ^ 
+                    ((unsigned int)cellZ * 19349663U);
+   return h & (COLLISION_HASH_BUCKETS - 1);
+}
+
+/*****************************************************************
+ *                          hashCircles                          *
+ *****************************************************************/
+void Collision::hashCircles()
+{
+   int i;
+   for(i = 0; i < COLLISION_HASH_BUCKETS; i++)
+   {
+      buckets[i] = -1;
+   }
+   for(i = 0; i < totalCircles; i++)
+   {
+      CollisionCircle& c = circles[i];
+      c.cellX = (int) floor(c.x / cellSize);
+      c.cellZ = (int) floor(c.z / cellSize);
+      int b = getBucket(c.cellX, c.cellZ);
+      c.next = buckets[b];
+      buckets[b] = i;
+   }
+}
+
+/*****************************************************************
+ *                          keepInField                          *
+ *****************************************************************/
+bool Collision::keepInField(CollisionCircle& c, bool isolateBall, Field* f)
 {
-   float diskRadius = disk->getSphere().getRadius() +
-                        BTSOCCER_COLLISION_THRESHOLD_DELTA;
-   float diskDiameter = 2*diskRadius;
-   Ogre::Vector3 diskPos = disk->getPosition(); 
-   float dist;
    Ogre::Vector2 halfSize = f->getHalfSize();
    Ogre::Vector2 sideDelta = f->getSideDelta();
+   bool moved = false;
    
    /* If is to isolateBall, must make sure the disks are inner the playable
     * field area (and not between side lines and borders)*/
    Ogre::Vector2 inDelta = (isolateBall)?sideDelta:Ogre::Vector2(0.0f, 0.0f);
 
-   /* Make sure the disk is in the field  */
-   if(diskPos.x-diskRadius < -halfSize[0] + inDelta[0])
+   if(c.x - c.radius < -halfSize[0] + inDelta[0])
    {
-      disk->setPosition(diskRadius+sideDelta[0]-halfSize[0],
-            0.0f, diskPos.z);
-      diskPos = disk->getPosition();
+      c.x = c.radius + sideDelta[0] - halfSize[0];
+      moved = true;
    }
-   else if(diskPos.x+diskRadius > halfSize[0] - inDelta[0])
+   else if(c.x + c.radius > halfSize[0] - inDelta[0])
    {
-      disk->setPosition(halfSize[0]-diskRadius-sideDelta[0],
-            0.0f, diskPos.z);
-      diskPos = disk->getPosition();
+      c.x = halfSize[0] - c.radius - sideDelta[0];
+      moved = true;
    }
-   if(diskPos.z-diskRadius < -halfSize[1] + inDelta[1])
+   if(c.z - c.radius < -halfSize[1] + inDelta[1])
    { 
-      disk->setPosition(diskPos.x, 0.0f, 
-            diskRadius+sideDelta[1]-halfSize[1]);
-      diskPos = disk->getPosition();
+      c.z = c.radius + sideDelta[1] - halfSize[1];
+      moved = true;
    }
-   else if(diskPos.z+diskRadius > halfSize[1] - inDelta[1])
+   else if(c.z + c.radius > halfSize[1] - inDelta[1])
    {
-      disk->setPosition(diskPos.x, 0.0f, 
-            halfSize[1]-diskRadius-sideDelta[1]);
-      diskPos = disk->getPosition();
+      c.z = halfSize[1] - c.radius - sideDelta[1];
+      moved = true;
    }
 
-   /* Verify contact with the ball */
-   float ballRadius = gameBall->getSphere().getRadius();
-   Ogre::Vector3 ballPos = gameBall->getPosition();
-   if(isolateBall)
+   return moved;
+}
+
+/*****************************************************************
+ *                            separate                           *
+ *****************************************************************/
+bool Collision::separate(CollisionCircle& a, CollisionCircle& b)
+{
+   if((!a.movable) && (!b.movable))
    {
-      ballRadius += 3.0f*diskRadius;
+      return false;
    }
-   dist = sqrt( (ballPos.x - diskPos.x) * 
-                (ballPos.x - diskPos.x) +
-                (ballPos.z - diskPos.z) * 
-                (ballPos.z - diskPos.z) );
-   if(dist <= ballRadius+diskRadius)
-   { 
-      /* Have a contact! Must get away from the ball */
-      getAwayFrom(disk, ballPos.x, ballPos.z,
-                  ballRadius+diskRadius);
-      return(true);
+
+   float dx = b.x - a.x;
+   float dz = b.z - a.z;
+   float minDist = a.radius + b.radius;
+   float distSqr = dx * dx + dz * dz;
+   if(distSqr >= minDist * minDist)
+   {
+      return false;
    }
 
-   /* Verify contact with all other disks */
-   Team* curTeam = teamA;
-   TeamPlayer* teamDisk;
-   Ogre::Vector3 disk2Pos;
-   int i;
-   while(curTeam != NULL)
+   /* Direction to push b away from a (any fixed one if at the same
+    * position) */
+   float dist = sqrt(distSqr);
+   if(dist > 0.0001f)
+   {
+      dx /= dist;
+      dz /= dist;
+   }
+   else
+   {
+      dx = 1.0f;
+      dz = 0.0f;
+   }
+
+   /* needToMove+ to be > not >=, splitted if both could move. */
+   float needToMove = minDist - dist + BTSOCCER_COLLISION_THRESHOLD_DELTA;
+   if((a.movable) && (b.movable))
+   {
+      needToMove /= 2.0f;
+      a.x -= needToMove * dx;
+      a.z -= needToMove * dz;
+      b.x += needToMove * dx;
+      b.z += needToMove * dz;
+   }
+   else if(a.movable)
+   {
+      a.x -= needToMove * dx;
+      a.z -= needToMove * dz;
+   }
+   else
+   {
+      b.x += needToMove * dx;
+      b.z += needToMove * dz;
+   }
+
+   return true;
+}
+
+/*****************************************************************
+ *                        resolveOverlaps                        *
+ *****************************************************************/
+bool Collision::resolveOverlaps(bool isolateBall, Field* f)
+{
+   int i, it;
+
+   /* Cells big enough to overlaps only happen at neighbour ones */
+   float maxRadius = 0.0f;
+   for(i = 0; i < totalCircles; i++)
    {
-      for(i = 0; i < field->getNumberOfDisks(); i++)
+      if(circles[i].radius > maxRadius)
       {
-         teamDisk = curTeam->getDisk(i);
-         disk2Pos = teamDisk->getPosition();
-         /* Verify contact, if the disks are distinct */
-         if(disk != teamDisk)
+         maxRadius = circles[i].radius;
+      }
+   }
+   cellSize = (maxRadius > 0.0f) ? 2.0f * maxRadius : 1.0f;
+
+   for(it = 0; it < COLLISION_MAX_ITERATIONS; it++)
+   {
+      bool moved = false;
+
+      /* Make sure the disks are in the field */
+      for(i = 0; i < totalCircles; i++)
+      {
+         if(circles[i].movable)
          {
-            dist =  sqrt( (disk2Pos.x - diskPos.x) * 
-                          (disk2Pos.x - diskPos.x) +
-                          (disk2Pos.z - diskPos.z) * 
-                          (disk2Pos.z - diskPos.z) );
-            if(dist < diskDiameter)
-            {
-               /* Have a contact! Must get away from the disk */
-               getAwayFrom(disk, teamDisk, diskDiameter);
-               return(true);
-            }
+            moved |= keepInField(circles[i], isolateBall, f);
          }
       }
 
-      /* Verify Contact with the goal and goalKeeper! */
-      //TODO
-
-      /* Look at the next team or end */
-      if(curTeam == teamA)
+      /* Push apart each overlapping pair, looking only at the 
+       * neighbour cells of each circle. */
+      hashCircles();
+      for(i = 0; i < totalCircles; i++)
       {
-         curTeam = teamB;
+         CollisionCircle& c = circles[i];
+         for(int cx = c.cellX - 1; cx <= c.cellX + 1; cx++)
+         {
+            for(int cz = c.cellZ - 1; cz <= c.cellZ + 1; cz++)
+            {
+               int j = buckets[getBucket(cx, cz)];
+               while(j != -1)
+               {
+                  /* Each pair once, and only the circles really at the 
+                   * cell (not the ones just sharing its bucket). */
+                  if( (j > i) && (circles[j].cellX == cx) && 
+                      (circles[j].cellZ == cz) )
+                  {
+                     moved |= separate(c, circles[j]);
+                  }
+                  j = circles[j].next;
+               }
+            }
+         }
       }
-      else
+
+      if(!moved)
       {
-         curTeam = NULL;
+         return true;
       }
    }
-   return(false);
-}
-
-/*****************************************************************
- *                          getAwayFrom                          *
- *****************************************************************/
-void Collision::getAwayFrom(TeamPlayer* disk, TeamPlayer* disk2, float radius)
-{
-   Ogre::Vector3 diskPos = disk->getPosition();
-   Ogre::Vector3 disk2Pos = disk2->getPosition();
-   
-   /* Calculate how much we need to move to be at "radius" distance */
-   Ogre::Real curDist = diskPos.distance(disk2Pos);
-   Ogre::Real needToMove = radius-curDist;
 
-   /* needToMove+ to be > not >=, and half, as will move each disk. */
-   needToMove += BTSOCCER_COLLISION_THRESHOLD_DELTA;
-   needToMove /= 2.0f;
-   
-   /* Get the direction to the point */
-   Ogre::Vector2 v;
-   v.x = disk2Pos.x - diskPos.x;
-   v.y = disk2Pos.z - diskPos.z;
-   v.normalise();
-
-   /* And Go away from that direction */
-   disk->setPosition(diskPos.x-needToMove*v.x, 0.0f,
-         diskPos.z-needToMove*v.y);
-   disk2->setPosition(disk2Pos.x+needToMove*v.x, 0.0f,
-         disk2Pos.z+needToMove*v.y);
+   /* Simultaneous passes could keep oscillating at dense clusters: 
+    * solve one contact at a time. */
+   return pushOutIncrementally(isolateBall, f);
 }
 
 /*****************************************************************
- *                          getAwayFrom                          *
+ *                     pushOutIncrementally                      *
  *****************************************************************/
-void Collision::getAwayFrom(TeamPlayer* disk, float posX, 
-                            float posZ, float radius)
+bool Collision::pushOutIncrementally(bool isolateBall, Field* f)
 {
-   /* Radius+ to be > not >= */
-   radius += BTSOCCER_COLLISION_THRESHOLD_DELTA;
+   int i, j, step;
+
+   for(step = 0; step < COLLISION_MAX_FALLBACK_STEPS; step++)
+   {
+      bool moved = false;
+      for(i = 0; (i < totalCircles) && (!moved); i++)
+      {
+         if(circles[i].movable)
+         {
+            moved = keepInField(circles[i], isolateBall, f);
+         }
+         for(j = i + 1; (j < totalCircles) && (!moved); j++)
+         {
+            moved = separate(circles[i], circles[j]);
+         }
+      }
 
-   /* Get the direction to the point */
-   Ogre::Vector2 v;
-   v.x = posX - disk->getPosition().x;
-   v.y = posZ - disk->getPosition().z;
-   v.normalise();
+      if(!moved)
+      {
+         return true;
+      }
+   }
 
-   /* And Go away from that direction */
-   disk->setPosition(posX-radius*v.x, 0.0f, posZ-radius*v.y);
+   return false;
 }
 
 /*****************************************************************
@@ -32,6 +32,30 @@
 namespace BtSoccer
 {
 
+/*! Max circles at the contact resolver: the disks and goal keepers of both
+ * teams and the ball. */
+#define COLLISION_MAX_CIRCLES      ((TEAM_MAX_DISKS + 1) * 2 + 1)
+/*! Buckets of the contact resolver spatial hash (must be a power of 2) */
+#define COLLISION_HASH_BUCKETS     64
+/*! Max iterations pushing apart the overlapping circles */
+#define COLLISION_MAX_ITERATIONS   32
+/*! Max single separations done by the incremental push-out, used when
+ * COLLISION_MAX_ITERATIONS weren't enough. */
+#define COLLISION_MAX_FALLBACK_STEPS  1024
+
+/*! A circle at the contact resolver (on the XZ plane) */
+typedef struct _CollisionCircle
+{
+   TeamPlayer* disk;  /**< Disk to place, or NULL if the ball */
+   float x;           /**< Current X position */
+   float z;           /**< Current Z position */
+   float radius;      /**< Radius to keep free */
+   bool movable;      /**< If could be moved (disks) or not (ball, keepers) */
+   int cellX;         /**< Spatial hash cell X */
+   int cellZ;         /**< Spatial hash cell Z */
+   int next;          /**< Next circle at the same bucket or -1 */
+}CollisionCircle;
+
 /*! The collision class which verify physical collisions
  * between the players, the ball and field elements. */
 class Collision
@@ -62,8 +86,9 @@ class Collision
        * on the field)
        * \param isolateBall -> if will put the ball isolated in a radius 
        *                       (usually used for fouls, etc.)
-       * \param f -> pointer to current field */
-      void removeContacts(bool isolateBall, Field* f);
+       * \param f -> pointer to current field
+       * \return false if some overlap couldn't be removed */
+      bool removeContacts(bool isolateBall, Field* f);
    
       /*! Remove all players - except goalkeepers - from both penalty areas */
       void removeFromPenaltyAreas();
@@ -74,25 +99,39 @@ class Collision
       Ball* gameBall;     /**< The ball used pointer */
       Field* field;       /**< The current field pointer */
 
-      /*! Remove All contacts of a disk.
-       * \param isolateBall -> if will isolate the ball
-       * \param disk -> pointer to the disk to remove contacts */
-      bool removeContact(bool isolateBall, TeamPlayer* disk,
-                         Field* f);
-
-      /*! Put the disk away from the position
-       * \param disk -> disk to put away
-       * \param posX -> X position
-       * \param posZ -> Z position
-       * \param radius -> radius to keep away from */
-      void getAwayFrom(TeamPlayer* disk, float posX, float posZ, 
-                       float radius);
-
-      /* Put 2 disks away from each other
-       * \param disk -> first disk to get away
-       * \param disk2 -> second disk to get away
-       * \radius -> min radius from each other */
-      void getAwayFrom(TeamPlayer* disk, TeamPlayer* disk2, float radius);
+      /*! Add a circle to the contact resolver
+       * \param disk -> disk of the circle (NULL for the ball)
+       * \param pos -> current position
+       * \param radius -> radius to keep free around it
+       * \param movable -> if the resolver could move it */
+      void addCircle(TeamPlayer* disk, Ogre::Vector3 pos, float radius,
+                     bool movable);
+
+      /*! Put the circles at their spatial hash buckets */
+      void hashCircles();
+
+      /*! \return spatial hash bucket of a cell */
+      int getBucket(int cellX, int cellZ);
+
+      /*! Make sure a circle is inner the field
+       * \return true if moved it */
+      bool keepInField(CollisionCircle& c, bool isolateBall, Field* f);
+
+      /*! Push apart two circles, if overlapping
+       * \return true if moved any of them */
+      bool separate(CollisionCircle& a, CollisionCircle& b);
+
+      /*! Push apart all overlapping circles, iteratively, until no more
+       * overlaps. If COLLISION_MAX_ITERATIONS weren't enough, falls back
+       * to #pushOutIncrementally.
+       * \return true if no overlaps remain */
+      bool resolveOverlaps(bool isolateBall, Field* f);
+
+      /*! Incremental push-out: separate the first overlap found (looking
+       * at all pairs), then look again from the start, up to
+       * COLLISION_MAX_FALLBACK_STEPS times.
+       * \return true if no overlaps remain */
+      bool pushOutIncrementally(bool isolateBall, Field* f);
       
       /*! Put the disk away from the rectangular area
        * \param disk -> disk to put away
@@ -113,6 +152,11 @@ class Collision
       /*! Check all players orientations to be sure they are "up" */
       void checkOrientations();
 
+      CollisionCircle circles[COLLISION_MAX_CIRCLES]; /**< Resolver circles */
+      int totalCircles;   /**< Circles used */
+      int buckets[COLLISION_HASH_BUCKETS]; /**< First circle at buckets */
+      float cellSize;     /**< Spatial hash cell size */
+
 };
 
 };
@@ -0,0 +1,96 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "collisionevent.h"
+
+using namespace BtSoccer;
+
+/***********************************************************************
+ *                             Constructor                             *
+ ***********************************************************************/
+CollisionEventQueue::CollisionEventQueue()
+{
+   clear();
+}
+
+/***********************************************************************
+ *                                clear                                *
+ ***********************************************************************/
+void CollisionEventQueue::clear()
+{
+   total = 0;
+   discarded = 0;
+}
+
+/***********************************************************************
+ *                                 add                                 *
+ ***********************************************************************/
+CollisionEvent* CollisionEventQueue::add(int type, FieldObject* objA, 
+      FieldObject* objB, unsigned long tick, bool& added)
+{
+   added = false;
+
+   /* Look for the pair at the events of this same tick (they are always
+    * the last ones added). */
+   for(int i = total - 1; (i >= 0) && (events[i].tick == tick); i--)
+   {
+      CollisionEvent& ev = events[i];
+      if( (ev.type == type) && 
+          ( ((ev.objA == objA) && (ev.objB == objB)) ||
+            ((ev.objA == objB) && (ev.objB == objA)) ) )
+      {
+         return &ev;
+      }
+   }
+
+   if(total >= COLLISION_EVENT_QUEUE_MAX)
+   {
+      discarded++;
+      return NULL;
+   }
+
+   CollisionEvent& ev = events[total];
+   total++;
+   ev.type = type;
+   ev.objA = objA;
+   ev.objB = objB;
+   ev.x = 0.0f;
+   ev.z = 0.0f;
+   ev.impulse = 0.0f;
+   ev.tick = tick;
+   ev.newCollision = false;
+   ev.upper = false;
+   added = true;
+
+   return &ev;
+}
+
+/***********************************************************************
+ *                                 get                                 *
+ ***********************************************************************/
+CollisionEvent* CollisionEventQueue::get(int index)
+{
+   if((index < 0) || (index >= total))
+   {
+      return NULL;
+   }
+   return &events[index];
+}
+
@@ -0,0 +1,103 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _btsoccer_collision_event_h
+#define _btsoccer_collision_event_h
+
+#include <btBulletDynamicsCommon.h>
+#include <OGRE/OgreVector3.h>
+#include "../btsoccer.h"
+
+namespace BtSoccer
+{
+
+/*! Max collision events kept by a CollisionEventQueue between two 
+ * consumptions (the exceeding ones are only counted). */
+#define COLLISION_EVENT_QUEUE_MAX   256
+
+   class FieldObject;
+
+   /*! A collision (or goal entering) detected at a physics tick */
+   class CollisionEvent
+   {
+      public:
+         enum CollisionEventType
+         {
+            /*! A disk collided with another disk */
+            EVENT_DISK_DISK,
+            /*! A disk collided with a goal keeper (or both keepers) */
+            EVENT_DISK_GOAL_KEEPER,
+            /*! Ball collided with a disk (or goal keeper) */
+            EVENT_BALL_DISK,
+            /*! Ball fully passed a goal line, entering it */
+            EVENT_BALL_ENTER_GOAL
+         };
+
+         int type;          /**< CollisionEventType */
+         FieldObject* objA; /**< First object involved */
+         FieldObject* objB; /**< Second object involved, if any */
+         Ogre::Real x;      /**< X position of the (first) contact */
+         Ogre::Real z;      /**< Z position of the (first) contact */
+         btScalar impulse;  /**< Greatest impulse applied at the tick */
+         unsigned long tick; /**< Physics tick when happened */
+         bool newCollision; /**< If not a continuation of a recent one */
+         bool upper;        /**< If at upper goal, when applicable */
+   };
+
+   /*! Preallocated buffer of the collision events of a physics frame,
+    * filled by the tick callback and consumed once per frame, in the
+    * same order they happened. */
+   class CollisionEventQueue
+   {
+      public:
+         /*! Constructor */
+         CollisionEventQueue();
+
+         /*! Clear all events, for a new frame */
+         void clear();
+
+         /*! Add an event, or get the one already added for the same pair
+          * of objects at the same tick.
+          * \param type CollisionEvent::CollisionEventType
+          * \param objA first object
+          * \param objB second object (or NULL)
+          * \param tick current physics tick
+          * \param added set to true if a new event was added
+          * \return pointer to the event, or NULL if the queue is full */
+         CollisionEvent* add(int type, FieldObject* objA, FieldObject* objB,
+               unsigned long tick, bool& added);
+
+         /*! \return number of events kept */
+         int getTotal() { return total; };
+         /*! \return number of events discarded by a full queue */
+         int getDiscarded() { return discarded; };
+         /*! \return event at index */
+         CollisionEvent* get(int index);
+
+      private:
+         CollisionEvent events[COLLISION_EVENT_QUEUE_MAX]; /**< Kept ones */
+         int total;     /**< Total events kept */
+         int discarded; /**< Events not kept by a full queue */
+   };
+
+}
+
+#endif
+
@@ -0,0 +1,367 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "diskspace.h"
+#include "../engine/teamplayer.h"
+#include "../engine/goalkeeper.h"
+
+#include <OGRE/OgreMath.h>
+
+#if DISK_SPACE_USE_SSE
+   #include <xmmintrin.h>
+#endif
+
+using namespace BtSoccer;
+
+/***********************************************************************
+ *                             Constructor                             *
+ ***********************************************************************/
+DiskSpace::DiskSpace()
+{
+   int i;
+   total = 0;
+
+   /* Padding elements are never used, but are tested at batches */
+   for(i = 0; i < DISK_SPACE_PACKED_SIZE; i++)
+   {
+      posX[i] = 0.0f;
+      posZ[i] = 0.0f;
+      radii[i] = 0.0f;
+   }
+}
+
+/***********************************************************************
+ *                              Destructor                             *
+ ***********************************************************************/
+DiskSpace::~DiskSpace()
+{
+}
+
+/***********************************************************************
+ *                                 clear                               *
+ ***********************************************************************/
+void DiskSpace::clear()
+{
+   total = 0;
+}
+
+/***********************************************************************
+ *                                  add                                *
+ ***********************************************************************/
+bool DiskSpace::add(FieldObject* obj)
+{
+   if((obj == NULL) || (total >= DISK_SPACE_MAX_OBJECTS))
+   {
+      return false;
+   }
+
+   Ogre::Vector3 pos = obj->getPosition();
+   objects[total] = obj;
+   posX[total] = pos.x;
+   posZ[total] = pos.z;
+   radii[total] = obj->getSphereRadius();
+   total++;
+
+   return true;
+}
+
+/***********************************************************************
+ *                                  set                                *
+ ***********************************************************************/
+void DiskSpace::set(Team* teamA, Team* teamB)
+{
+   Team* teams[2] = {teamA, teamB};
+   int t, i;
+
+   clear();
+   for(t = 0; t < 2; t++)
+   {
+      if(teams[t] != NULL)
+      {
+         for(i = 0; i < TEAM_MAX_DISKS; i++)
+         {
+            add(teams[t]->getDisk(i));
+         }
+         add(teams[t]->getGoalKeeper());
+      }
+   }
+}
+
+/***********************************************************************
+ *                            updatePositions                          *
+ ***********************************************************************/
+void DiskSpace::updatePositions()
+{
+   int i;
+   for(i = 0; i < total; i++)
+   {
+      Ogre::Vector3 pos = objects[i]->getPosition();
+      posX[i] = pos.x;
+      posZ[i] = pos.z;
+   }
+}
+
+/***********************************************************************
+ *                                getWay                               *
+ ***********************************************************************/
+bool DiskSpace::getWay(Ogre::Real x, Ogre::Real z, Ogre::Real radius,
+      Ogre::Real tgtX, Ogre::Real tgtZ, Ogre::Real& dirX, Ogre::Real& dirZ,
+      Ogre::Real& length)
+{
+   dirX = tgtX - x;
+   dirZ = tgtZ - z;
+   length = Ogre::Math::Sqrt(dirX * dirX + dirZ * dirZ);
+   if(length <= 0.0f)
+   {
+      return false;
+   }
+   dirX /= length;
+   dirZ /= length;
+
+   /* As the moving circle will 'hit' the target with its extremity,
+    * the way length is decremented by its radius. */
+   length -= radius;
+   if(length < 0.0f)
+   {
+      length = 0.0f;
+   }
+
+   return true;
+}
+
+/***********************************************************************
+ *                               sweepHits                             *
+ ***********************************************************************/
+bool DiskSpace::sweepHits(int i, Ogre::Real x, Ogre::Real z, 
+      Ogre::Real radius, Ogre::Real dirX, Ogre::Real dirZ, 
+      Ogre::Real length, Ogre::Real& along)
+{
+   Ogre::Real dX = posX[i] - x;
+   Ogre::Real dZ = posZ[i] - z;
+   Ogre::Real minDist = radius + radii[i];
+
+   /* Project the object's center on the way */
+   along = dX * dirX + dZ * dirZ;
+   if(along + radii[i] < 0.0f)
+   {
+      /* Completely behind the origin: not on the way. */
+      return false;
+   }
+
+   /* Get the nearest point of the way (a segment) to the object's
+    * center, and check if the circles touch there. */
+   Ogre::Real t = along;
+   if(t < 0.0f)
+   {
+      t = 0.0f;
+   }
+   else if(t > length)
+   {
+      t = length;
+   }
+   Ogre::Real cX = dX - dirX * t;
+   Ogre::Real cZ = dZ - dirZ * t;
+
+   return (cX * cX + cZ * cZ) < (minDist * minDist);
+}
+
+/***********************************************************************
+ *                               isFreeWay                             *
+ ***********************************************************************/
+bool DiskSpace::isFreeWay(Ogre::Real x, Ogre::Real z, Ogre::Real radius, 
+      Ogre::Real tgtX, Ogre::Real tgtZ, FieldObject* ignore, 
+      FieldObject* ignore2)
+{
+   Ogre::Real dirX, dirZ, length;
+   unsigned int ignoreMask = getObjectMask(ignore) | getObjectMask(ignore2);
+
+   if(!getWay(x, z, radius, tgtX, tgtZ, dirX, dirZ, length))
+   {
+      /* Already there */
+      return true;
+   }
+
+   return (sweepBatch(x, z, radius, dirX, dirZ, length) & ~ignoreMask) == 0;
+}
+
+/***********************************************************************
+ *                            getFirstBlocker                          *
+ ***********************************************************************/
+FieldObject* DiskSpace::getFirstBlocker(Ogre::Real x, Ogre::Real z, 
+      Ogre::Real radius, Ogre::Real tgtX, Ogre::Real tgtZ, 
+      FieldObject* ignore, FieldObject* ignore2)
+{
+   int i;
+   Ogre::Real dirX, dirZ, length, along;
+   Ogre::Real nearest = 0.0f;
+   FieldObject* blocker = NULL;
+
+   if(!getWay(x, z, radius, tgtX, tgtZ, dirX, dirZ, length))
+   {
+      return NULL;
+   }
+
+   for(i = 0; i < total; i++)
+   {
+      if((objects[i] != ignore) && (objects[i] != ignore2) &&
+         (sweepHits(i, x, z, radius, dirX, dirZ, length, along)) &&
+         ((blocker == NULL) || (along < nearest)))
+      {
+         blocker = objects[i];
+         nearest = along;
+      }
+   }
+
+   return blocker;
+}
+
+/***********************************************************************
+ *                             getObjectMask                           *
+ ***********************************************************************/
+unsigned int DiskSpace::getObjectMask(FieldObject* obj)
+{
+   int i;
+   if(obj != NULL)
+   {
+      for(i = 0; i < total; i++)
+      {
+         if(objects[i] == obj)
+         {
+            return 1u << i;
+         }
+      }
+   }
+   return 0;
+}
+
+/***********************************************************************
+ *                               sweepBatch                            *
+ ***********************************************************************/
+unsigned int DiskSpace::sweepBatch(Ogre::Real x, Ogre::Real z, 
+      Ogre::Real radius, Ogre::Real dirX, Ogre::Real dirZ, 
+      Ogre::Real length)
+{
+   unsigned int hits = 0;
+   int i;
+
+#if DISK_SPACE_USE_SSE
+   /* Same test of #sweepHits, but with four objects at once */
+   __m128 vX = _mm_set1_ps(x);
+   __m128 vZ = _mm_set1_ps(z);
+   __m128 vRadius = _mm_set1_ps(radius);
+   __m128 vDirX = _mm_set1_ps(dirX);
+   __m128 vDirZ = _mm_set1_ps(dirZ);
+   __m128 vLength = _mm_set1_ps(length);
+   __m128 vZero = _mm_setzero_ps();
+
+   for(i = 0; i < total; i += 4)
+   {
+      __m128 r = _mm_load_ps(&radii[i]);
+      __m128 dX = _mm_sub_ps(_mm_load_ps(&posX[i]), vX);
+      __m128 dZ = _mm_sub_ps(_mm_load_ps(&posZ[i]), vZ);
+      __m128 along = _mm_add_ps(_mm_mul_ps(dX, vDirX), 
+            _mm_mul_ps(dZ, vDirZ));
+      __m128 t = _mm_min_ps(_mm_max_ps(along, vZero), vLength);
+      __m128 cX = _mm_sub_ps(dX, _mm_mul_ps(vDirX, t));
+      __m128 cZ = _mm_sub_ps(dZ, _mm_mul_ps(vDirZ, t));
+      __m128 minDist = _mm_add_ps(vRadius, r);
+      __m128 touch = _mm_cmplt_ps(
+            _mm_add_ps(_mm_mul_ps(cX, cX), _mm_mul_ps(cZ, cZ)),
+            _mm_mul_ps(minDist, minDist));
+      __m128 ahead = _mm_cmpge_ps(_mm_add_ps(along, r), vZero);
+      hits |= ((unsigned int)_mm_movemask_ps(_mm_and_ps(touch, ahead))) 
+         << i;
+   }
+   /* Discard padding elements */
+   if(total < 32)
+   {
+      hits &= (1u << total) - 1;
+   }
+#else
+   Ogre::Real along;
+   for(i = 0; i < total; i++)
+   {
+      if(sweepHits(i, x, z, radius, dirX, dirZ, length, along))
+      {
+         hits |= 1u << i;
+      }
+   }
+#endif
+
+   return hits;
+}
+
+/***********************************************************************
+ *                            getWaysBlockers                          *
+ ***********************************************************************/
+void DiskSpace::getWaysBlockers(Ogre::Real x, Ogre::Real z, 
+      Ogre::Real radius, const Ogre::Real* tgtX, const Ogre::Real* tgtZ, 
+      int count, unsigned int* blockers)
+{
+   int k;
+   Ogre::Real dirX, dirZ, length;
+
+   for(k = 0; k < count; k++)
+   {
+      if(getWay(x, z, radius, tgtX[k], tgtZ[k], dirX, dirZ, length))
+      {
+         blockers[k] = sweepBatch(x, z, radius, dirX, dirZ, length);
+      }
+      else
+      {
+         /* Already at target */
+         blockers[k] = 0;
+      }
+   }
+}
+
+/***********************************************************************
+ *                              getFreeWays                            *
+ ***********************************************************************/
+int DiskSpace::getFreeWays(Ogre::Real x, Ogre::Real z, Ogre::Real radius,
+      const Ogre::Real* tgtX, const Ogre::Real* tgtZ, int count,
+      bool* freeWays, FieldObject* ignore, FieldObject** targetIgnore)
+{
+   int k;
+   int totalFree = 0;
+   unsigned int ignoreMask = getObjectMask(ignore);
+   Ogre::Real dirX, dirZ, length;
+
+   for(k = 0; k < count; k++)
+   {
+      unsigned int hits = 0;
+      if(getWay(x, z, radius, tgtX[k], tgtZ[k], dirX, dirZ, length))
+      {
+         hits = sweepBatch(x, z, radius, dirX, dirZ, length) & ~ignoreMask;
+         if((hits != 0) && (targetIgnore != NULL))
+         {
+            hits &= ~getObjectMask(targetIgnore[k]);
+         }
+      }
+      freeWays[k] = (hits == 0);
+      if(freeWays[k])
+      {
+         totalFree++;
+      }
+   }
+
+   return totalFree;
+}
+
@@ -0,0 +1,169 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _btsoccer_disk_space_h
+#define _btsoccer_disk_space_h
+
+#include <OGRE/OgrePrerequisites.h>
+#include <LinearMath/btScalar.h>
+
+#include "../engine/team.h"
+
+namespace BtSoccer
+{
+
+/** Maximum number of objects at a DiskSpace: all disks and goal
+ * keepers of both teams. */
+#define DISK_SPACE_MAX_OBJECTS   ((TEAM_MAX_DISKS + 1) * 2)
+/** Size of the packed arrays: DISK_SPACE_MAX_OBJECTS rounded up to a
+ * multiple of 4, to batch tests four objects at once. 
+ * \note must be at most 32, as blockers are returned as bitmasks. */
+#define DISK_SPACE_PACKED_SIZE   ((DISK_SPACE_MAX_OBJECTS + 3) & ~3)
+
+/** If the batch test will use SSE instructions or the scalar fallback */
+#if defined(__SSE__) && !OGRE_DOUBLE_PRECISION
+   #define DISK_SPACE_USE_SSE   1
+#else
+   #define DISK_SPACE_USE_SSE   0
+#endif
+
+/*! The DiskSpace is a 2D (field plane) view of the players, usually 
+ * used by the AIs to check occlusions without any Ogre scene query. 
+ * Each player is represented as a circle, packed with all others in 
+ * plain arrays, and the queries are of swept circles (a circle moving 
+ * from an origin to a target) against them.
+ * \note positions are taken when the objects are added (or at 
+ *       #updatePositions), so it won't reflect any later movement. */
+class DiskSpace
+{
+   public:
+      /*! Constructor */
+      DiskSpace();
+      /*! Destructor */
+      ~DiskSpace();
+
+      /*! Remove all objects from the space */
+      void clear();
+
+      /*! Add an object to the space, with its current position and 
+       * bounding sphere radius.
+       * \param obj object to add
+       * \return false if the space is full. */
+      bool add(FieldObject* obj);
+
+      /*! Clear the space and add all disks and goal keepers of both teams
+       * \param teamA a team (or NULL)
+       * \param teamB another team (or NULL) */
+      void set(Team* teamA, Team* teamB);
+
+      /*! Refresh the packed positions from the current objects ones */
+      void updatePositions();
+
+      /*! Verify if a circle could move from an origin to a target without
+       * touching any object of the space.
+       * \param x origin x coordinate
+       * \param z origin z coordinate
+       * \param radius radius of the moving circle
+       * \param tgtX target x coordinate
+       * \param tgtZ target z coordinate
+       * \param ignore object to ignore (usually the moving one) or NULL
+       * \param ignore2 another object to ignore (usually a target) or NULL
+       * \return true if the way is free */
+      bool isFreeWay(Ogre::Real x, Ogre::Real z, Ogre::Real radius, 
+            Ogre::Real tgtX, Ogre::Real tgtZ, FieldObject* ignore=NULL, 
+            FieldObject* ignore2=NULL);
+
+      /*! Get the first object (the nearest to the origin) touched by a 
+       * circle moving from an origin to a target.
+       * \note same parameters of #isFreeWay.
+       * \return first object on the way or NULL, if free */
+      FieldObject* getFirstBlocker(Ogre::Real x, Ogre::Real z, 
+            Ogre::Real radius, Ogre::Real tgtX, Ogre::Real tgtZ, 
+            FieldObject* ignore=NULL, FieldObject* ignore2=NULL);
+
+      /*! Test a batch of ways (lanes), each one from the same origin to 
+       * a different target, against all objects of the space at once.
+       * \param x origin x coordinate
+       * \param z origin z coordinate
+       * \param radius radius of the moving circle
+       * \param tgtX x coordinate of each target
+       * \param tgtZ z coordinate of each target
+       * \param count number of targets
+       * \param blockers will receive, for each target, the bitmask of 
+       *        objects (bit i is the object of index i) touched. */
+      void getWaysBlockers(Ogre::Real x, Ogre::Real z, Ogre::Real radius,
+            const Ogre::Real* tgtX, const Ogre::Real* tgtZ, int count,
+            unsigned int* blockers);
+
+      /*! Test a batch of ways, each one from the same origin to a 
+       * different target, telling which ones are free.
+       * \note see #getWaysBlockers for parameters.
+       * \param freeWays will receive, for each target, if its way is free
+       * \param ignore object to ignore at all ways (or NULL)
+       * \param targetIgnore object to ignore at each way (usually the
+       *        target disk), or NULL for none.
+       * \return number of free ways */
+      int getFreeWays(Ogre::Real x, Ogre::Real z, Ogre::Real radius,
+            const Ogre::Real* tgtX, const Ogre::Real* tgtZ, int count,
+            bool* freeWays, FieldObject* ignore=NULL, 
+            FieldObject** targetIgnore=NULL);
+
+      /*! Get the bitmask of an object at the space
+       * \return bitmask with the object's index bit, 0 if not at space */
+      unsigned int getObjectMask(FieldObject* obj);
+
+      /*! \return total objects at the space */
+      int getTotal() { return total; };
+
+   protected:
+      /*! Check a swept circle against the object at index i
+       * \param i index of the object
+       * \param along will receive the distance, along the way, from 
+       *        origin to the object projection.
+       * \return true if the object is touched */
+      bool sweepHits(int i, Ogre::Real x, Ogre::Real z, Ogre::Real radius,
+            Ogre::Real dirX, Ogre::Real dirZ, Ogre::Real length, 
+            Ogre::Real& along);
+
+      /*! Define the normalized direction and length of a way
+       * \return false if origin and target are the same. */
+      bool getWay(Ogre::Real x, Ogre::Real z, Ogre::Real radius,
+            Ogre::Real tgtX, Ogre::Real tgtZ, Ogre::Real& dirX, 
+            Ogre::Real& dirZ, Ogre::Real& length);
+
+      /*! Batch test a single way against all objects
+       * \return bitmask of touched objects */
+      unsigned int sweepBatch(Ogre::Real x, Ogre::Real z, Ogre::Real radius,
+            Ogre::Real dirX, Ogre::Real dirZ, Ogre::Real length);
+
+      int total;                                 /**< Objects at space */
+      /*! X of each object */
+      ATTRIBUTE_ALIGNED16(Ogre::Real posX[DISK_SPACE_PACKED_SIZE]);
+      /*! Z of each object */
+      ATTRIBUTE_ALIGNED16(Ogre::Real posZ[DISK_SPACE_PACKED_SIZE]);
+      /*! Radius of each object */
+      ATTRIBUTE_ALIGNED16(Ogre::Real radii[DISK_SPACE_PACKED_SIZE]);
+      FieldObject* objects[DISK_SPACE_MAX_OBJECTS]; /**< The objects */
+};
+
+}
+
+#endif
+
@@ -29,9 +29,15 @@
 
 #include <OGRE/OgreLogManager.h>
 #include <OGRE/OgreLog.h>
+#include <OGRE/OgreResourceGroupManager.h>
 #include <kobold/ogre3d/ogredefparser.h>
+#include <kobold/userinfo.h>
 
+#include <pthread.h>
+#include <string.h>
 #include <iostream>
+#include <fstream>
+#include <vector>
 using namespace std;
 
 using namespace BtSoccer;
@@ -43,20 +49,26 @@ using namespace BtSoccer;
 /***********************************************************************
  *                                init                                 *
  ***********************************************************************/
-void DistTable::init(bool load)
+void DistTable::init(bool load, int threads)
 {
    ballDistancesSize = (DISTTABLE_MAX_RELATIVE_BALL_DIST - 
                 DISTTABLE_MIN_RELATIVE_BALL_DIST) /
                DISTTABLE_RELATIVE_BALL_DIST_INC;
 
    ballDistances = new float[ballDistancesSize];
+   angleTableLoaded = false;
    if(load)
    {
       loadFromDisk();
+      angleTableLoaded = loadAngleTable();
+      if(!angleTableLoaded)
+      {
+         startAngleTableBuild();
+      }
    }
    else
    {
-      preCalculateValues();
+      preCalculateValues(threads);
    }
 }
 
@@ -65,9 +77,69 @@ void DistTable::init(bool load)
  ***********************************************************************/
 void DistTable::finish()
 {
+   if(building)
+   {
+      /* No need to wait it to end: just stop at the next sample */
+      cancelBuild = true;
+      pthread_join(buildThread, NULL);
+      building = false;
+   }
    delete [] ballDistances;
 }
 
+/***********************************************************************
+ *                          getUserAngleFile                           *
+ ***********************************************************************/
+Ogre::String DistTable::getUserAngleFile()
+{
+   return Kobold::UserInfo::getUserHome() + DISTTABLE_ANGLE_FILE;
+}
+
+/***********************************************************************
+ *                        startAngleTableBuild                         *
+ ***********************************************************************/
+void DistTable::startAngleTableBuild()
+{
+   cancelBuild = false;
+   building = (pthread_create(&buildThread, NULL, buildAngleTable, 
+            NULL) == 0);
+   if(building)
+   {
+      Ogre::LogManager::getSingleton().stream(Ogre::LML_NORMAL)
+         << "DistTable: building the angle table at background, to '"
+         << getUserAngleFile() << "'.";
+   }
+   else
+   {
+      Ogre::LogManager::getSingleton().stream(Ogre::LML_CRITICAL)
+         << "DistTable: couldn't create the thread to build the angle "
+         << "table: using frontal ball distances only!";
+   }
+}
+
+/***********************************************************************
+ *                          buildAngleTable                            *
+ ***********************************************************************/
+void* DistTable::buildAngleTable(void* arg)
+{
+   /* Note: no logging here, as not at the main thread */
+   for(int i = 0; i < DISTTABLE_ANGLE_TOTAL; i++)
+   {
+      if(cancelBuild)
+      {
+         return NULL;
+      }
+      calculateAngleDistance(i);
+   }
+   flushAngleTable(getUserAngleFile());
+
+   /* All samples must be visible before telling they are available */
+   __sync_synchronize();
+   angleTableLoaded = true;
+
+   return NULL;
+}
+
 /***********************************************************************
  *                       waitDiskAndBallStable                         *
  ***********************************************************************/
@@ -84,109 +156,292 @@ void DistTable::waitDiskAndBallStable(TeamPlayer* disk, Ball* ball)
    }
 }
 
+/***********************************************************************
+ *                         placeDiskAndBall                            *
+ ***********************************************************************/
+void DistTable::placeDiskAndBall(TeamPlayer* disk, Ogre::Vector3 diskPos,
+      Ball* ball, Ogre::Vector3 ballPos)
+{
+   disk->setPosition(diskPos[0], diskPos[1], diskPos[2]);
+   ball->setPosition(ballPos[0], ballPos[1], ballPos[2]);
+
+   /* Nothing from previous samples (or steps) must affect this one */
+   BulletLink::getContext()->resetSimulationState();
+   waitDiskAndBallStable(disk, ball);
+}
 
 /***********************************************************************
- *                        preCalculateValues                           *
+ *                        calculateDiskDistance                        *
  ***********************************************************************/
-void DistTable::preCalculateValues()
+void DistTable::calculateDiskDistance(int index)
 {
    ForceInput force;
    float forceValue=0.0f, forceX=0.0f, forceZ=0.0f;
- 
+   float length = (index + 1) * DISTTABLE_DISK_DIST_INC;
+
+   /* Isolated (and never sleeping) world for the sample */
+   PhysicsContext context(false, false);
+   BulletLink::setThreadContext(&context);
    Field* field = new Field();
    field->createFieldForTestCases(false);
-
-   /* Create the disk and ball to do the simulation */
    TeamPlayer* disk = new BtSoccer::TeamPlayer(FieldObject::TYPE_DISK, "disk");
    Ball* ball = new BtSoccer::Ball();
-   BulletLink::setPointers(NULL, NULL, ball, field, false);
 
-   ball->setPosition(-200, 0, -200);
-   disk->setPosition(0, 0, 0);
+   placeDiskAndBall(disk, Ogre::Vector3(0, 0, 0), 
+         ball, Ogre::Vector3(-200, 0, -200));
+   Ogre::Vector3 prevPos = disk->getPosition();
+
+   /* Set the force (impulse) for the input vector */
+   force.clear();
+   force.setInitial(0, 0);
+   force.setFinal(-length, 0);
+   force.getForce(forceValue, forceX, forceZ, 0.0f, 
+         BTSOCCER_MAX_FORCE_VALUE);
+
+   /* Apply the force and wait until the disk stopped. */
+   disk->applyForce(forceValue*forceX, 0, forceValue*forceZ);
    waitDiskAndBallStable(disk, ball);
 
-   /* Do all range of impulses to the disk and save distances. */
-   float length = DISTTABLE_DISK_DIST_INC;
-   for(int i=0; i < DISTTABLE_DISK_DIST_LENGTH; i++) 
+   /* Now, get position and calculate distance */
+   Ogre::Vector3 pos = disk->getPosition();
+   diskDistances[index] = Ogre::Math::Sqrt(
+         Ogre::Math::Sqr(pos[0]-prevPos[0]) +  
+         Ogre::Math::Sqr(pos[2]-prevPos[2]));
+
+   /* Delete things */
+   delete ball;
+   delete disk;
+   field->deleteField();
+   delete field;
+   BulletLink::setThreadContext(NULL);
+}
+
+/***********************************************************************
+ *                        calculateBallDistance                        *
+ ***********************************************************************/
+void DistTable::calculateBallDistance(int index)
+{
+   ForceInput force;
+   float forceValue=0.0f, forceX=0.0f, forceZ=0.0f;
+   float j = DISTTABLE_MIN_RELATIVE_BALL_DIST + 
+      index * DISTTABLE_RELATIVE_BALL_DIST_INC;
+
+   /* Isolated (and never sleeping) world for the sample */
+   PhysicsContext context(false, false);
+   BulletLink::setThreadContext(&context);
+   Field* field = new Field();
+   field->createFieldForTestCases(false);
+   TeamPlayer* disk = new BtSoccer::TeamPlayer(FieldObject::TYPE_DISK, "disk");
+   Ball* ball = new BtSoccer::Ball();
+
+   float dist = 0.0f;
+   for(int i = 0; i < DISTTABLE_BALL_DIST_STEPS; i++) 
    {
-      /* Keep current position, for distance calculation */
-      Ogre::Vector3 prevPos = disk->getPosition();
+      float diskPosX = 22 + (1 * i);
+      /* Set calculation positions */
+      placeDiskAndBall(disk, Ogre::Vector3(diskPosX, 0, 0), 
+            ball, Ogre::Vector3(0, 0, 0));
 
       /* Set the force (impulse) for the input vector */
       force.clear();
-      force.setInitial(0, 0);
-      force.setFinal(-length, 0);
-      force.getForce(forceValue, forceX, forceZ, 0.0f, 
-            BTSOCCER_MAX_FORCE_VALUE);
+      force.setInitial(diskPosX, 0);
+      force.setFinal(diskPosX + getDiskInputVectorLength(diskPosX + j), 0);
+      force.getForce(forceValue, forceX, forceZ);
 
-      /* Apply the force and wait until the disk stopped. */
+      /* Apply the force and wait until disk and ball stopped. */
       disk->applyForce(forceValue*forceX, 0, forceValue*forceZ);
       waitDiskAndBallStable(disk, ball);
 
       /* Now, get position and calculate distance */
-      Ogre::Vector3 pos = disk->getPosition();
-      float distance = Ogre::Math::Sqrt(
-            Ogre::Math::Sqr(pos[0]-prevPos[0]) +  
-            Ogre::Math::Sqr(pos[2]-prevPos[2]));
+      Ogre::Vector3 pos = ball->getPosition();
+      float distance = Ogre::Math::Sqrt(Ogre::Math::Sqr(pos[0]) +  
+                                        Ogre::Math::Sqr(pos[2]));
+      dist += distance;
+   }
+   ballDistances[index] = dist / DISTTABLE_BALL_DIST_STEPS;
+
+   /* Delete things */
+   delete ball;
+   delete disk;
+   field->deleteField();
+   delete field;
+   BulletLink::setThreadContext(NULL);
+}
+
+/***********************************************************************
+ *                       calculateAngleDistance                        *
+ ***********************************************************************/
+void DistTable::calculateAngleDistance(int index)
+{
+   ForceInput force;
+   float forceValue=0.0f, forceX=0.0f, forceZ=0.0f;
+
+   /* Sample inputs */
+   int length = index % DISTTABLE_ANGLE_LENGTH_SAMPLES;
+   int angle = (index / DISTTABLE_ANGLE_LENGTH_SAMPLES) % 
+      DISTTABLE_ANGLE_SAMPLES;
+   int travel = index / (DISTTABLE_ANGLE_LENGTH_SAMPLES * 
+         DISTTABLE_ANGLE_SAMPLES);
+   float lengthValue = (length + 1) * DISTTABLE_ANGLE_LENGTH_INC;
+   Ogre::Radian angleValue = Ogre::Degree(angle * DISTTABLE_ANGLE_INC);
+   float travelValue = DISTTABLE_ANGLE_MIN_TRAVEL + 
+      travel * DISTTABLE_ANGLE_TRAVEL_INC;
+
+   /* Isolated (and never sleeping) world for the sample */
+   PhysicsContext context(false, false);
+   BulletLink::setThreadContext(&context);
+   Field* field = new Field();
+   field->createFieldForTestCases(false);
+   TeamPlayer* disk = new BtSoccer::TeamPlayer(FieldObject::TYPE_DISK, "disk");
+   Ball* ball = new BtSoccer::Ball();
+
+   /* Disk goes to -X, touching the ball with the contact angle after
+    * travelling the sample distance. */
+   float r = disk->getSphereRadius() + ball->getSphereRadius();
+   float diskPosX = r * Ogre::Math::Cos(angleValue) + travelValue;
+   float diskPosZ = r * Ogre::Math::Sin(angleValue);
+   placeDiskAndBall(disk, Ogre::Vector3(diskPosX, 0, diskPosZ), 
+         ball, Ogre::Vector3(0, 0, 0));
+   Ogre::Vector3 prevPos = ball->getPosition();
+
+   /* Set the force (impulse) for the input vector */
+   force.clear();
+   force.setInitial(diskPosX, diskPosZ);
+   force.setFinal(diskPosX + lengthValue, diskPosZ);
+   force.getForce(forceValue, forceX, forceZ);
+
+   /* Apply the force and wait until disk and ball stopped. */
+   disk->applyForce(forceValue*forceX, 0, forceValue*forceZ);
+   waitDiskAndBallStable(disk, ball);
+
+   /* Now, get how far the ball went */
+   Ogre::Vector3 pos = ball->getPosition();
+   angleDistances[index] = Ogre::Math::Sqrt(
+         Ogre::Math::Sqr(pos[0]-prevPos[0]) +  
+         Ogre::Math::Sqr(pos[2]-prevPos[2]));
+
+   /* Delete things */
+   delete ball;
+   delete disk;
+   field->deleteField();
+   delete field;
+   BulletLink::setThreadContext(NULL);
+}
+
+/***********************************************************************
+ *                          calculateSample                            *
+ ***********************************************************************/
+void DistTable::calculateSample(int phase, int index)
+{
+   if(phase == DISTTABLE_PHASE_BALL)
+   {
+      calculateBallDistance(index);
+   }
+   else if(index < DISTTABLE_DISK_DIST_LENGTH)
+   {
+      calculateDiskDistance(index);
+   }
+   else
+   {
+      calculateAngleDistance(index - DISTTABLE_DISK_DIST_LENGTH);
+   }
+}
 
-      /* Keep it on the distance table. */
-      diskDistances[i] = distance;
-      //printf("Length: %.3f Dist: %.3f\n", length, distance);
-      /*printf("Force: %.3f (%.2f, %.2f) Distance: %.3f length: %.3f\n", 
-            forceValue, forceX, forceZ, distance, length);*/
+/*! Shared state of the DistTable calculation threads at a phase. */
+class DistTablePhase
+{
+   public:
+      int phase;          /**< DISTTABLE_PHASE_* being calculated */
+      int total;          /**< Number of samples of the phase */
+      volatile int next;  /**< Next sample to calculate */
+};
 
-      length += DISTTABLE_DISK_DIST_INC;
+/***********************************************************************
+ *                             runWorker                               *
+ ***********************************************************************/
+void* DistTable::runWorker(void* arg)
+{
+   DistTablePhase* phase = (DistTablePhase*) arg;
+
+   /* Each sample is on its own world, thus could be taken by any 
+    * worker, in any order, with the same result. */
+   int i = __sync_fetch_and_add(&phase->next, 1);
+   while(i < phase->total)
+   {
+      calculateSample(phase->phase, i);
+      i = __sync_fetch_and_add(&phase->next, 1);
    }
 
-   /* Now, let's calculate distances for ball touches after disk input */
+   return NULL;
+}
 
-   /** Let's calculate */
-   int index = 0;
-   for(float j = DISTTABLE_MIN_RELATIVE_BALL_DIST; 
-           index < ballDistancesSize; 
-           j += DISTTABLE_RELATIVE_BALL_DIST_INC)
+/***********************************************************************
+ *                             runPhase                                *
+ ***********************************************************************/
+void DistTable::runPhase(int phase, int total, int threads)
+{
+   DistTablePhase state;
+   state.phase = phase;
+   state.total = total;
+   state.next = 0;
+
+   /* The calling thread is a worker too. If can't create some of the 
+    * others, the ones created (or the calling thread) will take their
+    * samples. */
+   std::vector<pthread_t> created;
+   for(int i = 1; i < threads; i++)
    {
-      float dist = 0.0f;
-      for(int i = 0; i < DISTTABLE_BALL_DIST_STEPS; i++) 
+      pthread_t thread;
+      if(pthread_create(&thread, NULL, runWorker, &state) == 0)
       {
-         float diskPosX = 22 + (1 * i);
-         /* Set calculation positions */
-         disk->setPosition(diskPosX, 0, 0);
-         ball->setPosition(0, 0, 0);
-         waitDiskAndBallStable(disk, ball);
-
-         /* Set the force (impulse) for the input vector */
-         force.clear();
-         force.setInitial(diskPosX, 0);
-         force.setFinal(diskPosX + getDiskInputVectorLength(diskPosX + j), 0);
-         force.getForce(forceValue, forceX, forceZ);
-
-         /* Apply the force and wait until disk and ball stopped. */
-         disk->applyForce(forceValue*forceX, 0, forceValue*forceZ);
-         waitDiskAndBallStable(disk, ball);
-
-         /* Now, get position and calculate distance */
-         Ogre::Vector3 pos = ball->getPosition();
-         float distance = Ogre::Math::Sqrt(Ogre::Math::Sqr(pos[0]) +  
-                                           Ogre::Math::Sqr(pos[2]));
-         //printf("%.3f ", distance);
-         dist += distance;
+         created.push_back(thread);
       }
-      dist /= DISTTABLE_BALL_DIST_STEPS;
-      ballDistances[index] = dist;
-      index++;
-      //printf("T: %.3f D: %.3f\n", j, dist);
    }
+   if((int) created.size() + 1 < threads)
+   {
+      Ogre::LogManager::getSingleton().stream(Ogre::LML_CRITICAL)
+         << "DistTable: couldn't create all threads. Running with "
+         << created.size() + 1 << " of " << threads << ".";
+   }
+   runWorker(&state);
+
+   for(unsigned int i = 0; i < created.size(); i++)
+   {
+      pthread_join(created[i], NULL);
+   }
+}
 
+/***********************************************************************
+ *                        preCalculateValues                           *
+ ***********************************************************************/
+void DistTable::preCalculateValues(int threads)
+{
+   if(threads < 1)
+   {
+      threads = 1;
+   }
 
-   /* Delete things */
-   delete ball;
-   delete disk;
-   delete field;
+   /* The ball samples depend on the whole diskDistances, thus are only
+    * calculated after them (and the angle ones, independent of both). */
+   runPhase(DISTTABLE_PHASE_DISK_AND_ANGLE, 
+         DISTTABLE_DISK_DIST_LENGTH + DISTTABLE_ANGLE_TOTAL, threads);
+   runPhase(DISTTABLE_PHASE_BALL, ballDistancesSize, threads);
+
+   angleTableLoaded = true;
 
    flushToDisk();
 }
 
+/***********************************************************************
+ *                            copyValues                               *
+ ***********************************************************************/
+void DistTable::copyValues(float* disk, float* ball, float* angle)
+{
+   memcpy(disk, diskDistances, DISTTABLE_DISK_DIST_LENGTH * sizeof(float));
+   memcpy(ball, ballDistances, ballDistancesSize * sizeof(float));
+   memcpy(angle, angleDistances, DISTTABLE_ANGLE_TOTAL * sizeof(float));
+}
+
 /***********************************************************************
  *                           loadFromDisk                              *
  ***********************************************************************/
@@ -236,6 +491,121 @@ void DistTable::loadFromDisk()
    }
 }
 
+/***********************************************************************
+ *                          loadAngleTable                             *
+ ***********************************************************************/
+bool DistTable::loadAngleTable()
+{
+   std::vector<unsigned char> buffer;
+
+   /* Usually from resources, but could be the one built at a previous
+    * run (at user's home) or calculated by the simulator (at the current
+    * directory). */
+   Ogre::ResourceGroupManager* rgm = 
+      Ogre::ResourceGroupManager::getSingletonPtr();
+   if( (rgm != NULL) && 
+       (rgm->resourceExistsInAnyGroup(DISTTABLE_ANGLE_FILE)) )
+   {
+      Ogre::DataStreamPtr stream = rgm->openResource(DISTTABLE_ANGLE_FILE);
+      buffer.resize(stream->size());
+      if(!buffer.empty())
+      {
+         stream->read(&buffer[0], buffer.size());
+      }
+      stream->close();
+   }
+   else
+   {
+      Ogre::String fileNames[2] = {getUserAngleFile(), DISTTABLE_ANGLE_FILE};
+      for(int f = 0; (f < 2) && (buffer.empty()); f++)
+      {
+         ifstream file;
+         file.open(fileNames[f].c_str(), ios::in | ios::binary);
+         if(file)
+         {
+            buffer.assign(istreambuf_iterator<char>(file),
+                          istreambuf_iterator<char>());
+            file.close();
+         }
+      }
+   }
+
+   /* Header: magic, version and dimensions, followed by each sample, as 
+    * little endian 32 bits words. */
+   unsigned int header[6] = {DISTTABLE_ANGLE_MAGIC, DISTTABLE_ANGLE_VERSION,
+      DISTTABLE_ANGLE_TRAVEL_SAMPLES, DISTTABLE_ANGLE_SAMPLES, 
+      DISTTABLE_ANGLE_LENGTH_SAMPLES, DISTTABLE_ANGLE_TOTAL};
+   if(buffer.size() != (6 + DISTTABLE_ANGLE_TOTAL) * 4)
+   {
+      Ogre::LogManager::getSingleton().stream(Ogre::LML_CRITICAL)
+         << "Couldn't load '" << DISTTABLE_ANGLE_FILE << "'!";
+      return false;
+   }
+   int offset = 0;
+   for(int i = 0; i < 6 + DISTTABLE_ANGLE_TOTAL; i++)
+   {
+      unsigned int bits = 0;
+      for(int b = 0; b < 4; b++)
+      {
+         bits |= ((unsigned int)buffer[offset + b]) << (8 * b);
+      }
+      offset += 4;
+      if(i < 6)
+      {
+         if(bits != header[i])
+         {
+            Ogre::LogManager::getSingleton().stream(Ogre::LML_CRITICAL)
+               << "Invalid '" << DISTTABLE_ANGLE_FILE << "' file!";
+            return false;
+         }
+      }
+      else
+      {
+         memcpy(&angleDistances[i - 6], &bits, sizeof(float));
+      }
+   }
+
+   return true;
+}
+
+/***********************************************************************
+ *                          flushAngleTable                            *
+ ***********************************************************************/
+void DistTable::flushAngleTable(Ogre::String fileName)
+{
+   std::vector<unsigned char> buffer;
+   unsigned int header[6] = {DISTTABLE_ANGLE_MAGIC, DISTTABLE_ANGLE_VERSION,
+      DISTTABLE_ANGLE_TRAVEL_SAMPLES, DISTTABLE_ANGLE_SAMPLES, 
+      DISTTABLE_ANGLE_LENGTH_SAMPLES, DISTTABLE_ANGLE_TOTAL};
+
+   for(int i = 0; i < 6 + DISTTABLE_ANGLE_TOTAL; i++)
+   {
+      unsigned int bits;
+      if(i < 6)
+      {
+         bits = header[i];
+      }
+      else
+      {
+         /* Samples as their exact bits */
+         memcpy(&bits, &angleDistances[i - 6], sizeof(float));
+      }
+      for(int b = 0; b < 4; b++)
+      {
+         buffer.push_back((bits >> (8 * b)) & 0xFF);
+      }
+   }
+
+   ofstream file;
+   file.open(fileName.c_str(), ios::out | ios::binary);
+   if(!file)
+   {
+      return;
+   }
+   file.write((const char*)&buffer[0], buffer.size());
+   file.close();
+}
+
 /***********************************************************************
  *                           flushToDisk                               *
  ***********************************************************************/
@@ -263,6 +633,11 @@ void DistTable::flushToDisk()
 
    /* Close and done */
    file.close();
+
+   if(angleTableLoaded)
+   {
+      flushAngleTable(DISTTABLE_ANGLE_FILE);
+   }
 }
 
 /***********************************************************************
@@ -379,7 +754,128 @@ float DistTable::getDiskInputVectorLength(float distanceToBall,
    return getDiskInputVectorLength(targetDiskDistance) * factor;
 }
 
+/***********************************************************************
+ *                         getSamplePosition                           *
+ ***********************************************************************/
+void DistTable::getSamplePosition(float value, float first, float inc,
+      int samples, int& index, float& frac)
+{
+   float pos = (value - first) / inc;
+   if(pos <= 0.0f)
+   {
+      index = 0;
+      frac = 0.0f;
+   }
+   else if(pos >= samples - 1)
+   {
+      index = samples - 1;
+      frac = 0.0f;
+   }
+   else
+   {
+      index = (int) pos;
+      frac = pos - index;
+   }
+}
+
+/***********************************************************************
+ *                            getAngleIndex                            *
+ ***********************************************************************/
+int DistTable::getAngleIndex(int travel, int angle, int length)
+{
+   return (travel * DISTTABLE_ANGLE_SAMPLES + angle) * 
+      DISTTABLE_ANGLE_LENGTH_SAMPLES + length;
+}
+
+/***********************************************************************
+ *                           getAngleSample                            *
+ ***********************************************************************/
+float DistTable::getAngleSample(int travel, float travelFrac, int angle,
+      float angleFrac, int length)
+{
+   /* Next samples (the same one at the limits, where frac is 0) */
+   int nextTravel = (travel + 1 < DISTTABLE_ANGLE_TRAVEL_SAMPLES) ? 
+      travel + 1 : travel;
+   int nextAngle = (angle + 1 < DISTTABLE_ANGLE_SAMPLES) ? angle + 1 : angle;
+
+   float d0 = (1.0f - angleFrac) * 
+                  angleDistances[getAngleIndex(travel, angle, length)] +
+              angleFrac * 
+                  angleDistances[getAngleIndex(travel, nextAngle, length)];
+   float d1 = (1.0f - angleFrac) * 
+                  angleDistances[getAngleIndex(nextTravel, angle, length)] +
+              angleFrac *
+                  angleDistances[getAngleIndex(nextTravel, nextAngle, length)];
+
+   return (1.0f - travelFrac) * d0 + travelFrac * d1;
+}
+
+/***********************************************************************
+ *                          getBallDistance                            *
+ ***********************************************************************/
+float DistTable::getBallDistance(float distanceToBall, float contactAngle,
+      float length)
+{
+   int travel, angle, len;
+   float travelFrac, angleFrac, lenFrac;
+
+   getSamplePosition(distanceToBall, DISTTABLE_ANGLE_MIN_TRAVEL, 
+         DISTTABLE_ANGLE_TRAVEL_INC, DISTTABLE_ANGLE_TRAVEL_SAMPLES, 
+         travel, travelFrac);
+   getSamplePosition(Ogre::Math::Abs(contactAngle), 0.0f, 
+         DISTTABLE_ANGLE_INC, DISTTABLE_ANGLE_SAMPLES, angle, angleFrac);
+   getSamplePosition(length, DISTTABLE_ANGLE_LENGTH_INC,
+         DISTTABLE_ANGLE_LENGTH_INC, DISTTABLE_ANGLE_LENGTH_SAMPLES,
+         len, lenFrac);
+   int nextLen = (len + 1 < DISTTABLE_ANGLE_LENGTH_SAMPLES) ? len + 1 : len;
+
+   return (1.0f - lenFrac) * 
+             getAngleSample(travel, travelFrac, angle, angleFrac, len) +
+          lenFrac *
+             getAngleSample(travel, travelFrac, angle, angleFrac, nextLen);
+}
+
+/***********************************************************************
+ *                      getDiskInputVectorLength                       *
+ ***********************************************************************/
+float DistTable::getDiskInputVectorLength(float distanceToBall,
+      float contactAngle, float ballDistance)
+{
+   if(!angleTableLoaded)
+   {
+      return getDiskInputVectorLength(distanceToBall, ballDistance);
+   }
+
+   int travel, angle;
+   float travelFrac, angleFrac;
+   getSamplePosition(distanceToBall, DISTTABLE_ANGLE_MIN_TRAVEL, 
+         DISTTABLE_ANGLE_TRAVEL_INC, DISTTABLE_ANGLE_TRAVEL_SAMPLES, 
+         travel, travelFrac);
+   getSamplePosition(Ogre::Math::Abs(contactAngle), 0.0f, 
+         DISTTABLE_ANGLE_INC, DISTTABLE_ANGLE_SAMPLES, angle, angleFrac);
+
+   /* Ball distance per input length at the desired travel and angle. 
+    * Kept not decreasing, for the binary search at getVectorValue. */
+   float distances[DISTTABLE_ANGLE_LENGTH_SAMPLES];
+   for(int i = 0; i < DISTTABLE_ANGLE_LENGTH_SAMPLES; i++)
+   {
+      distances[i] = getAngleSample(travel, travelFrac, angle, angleFrac, i);
+      if( (i > 0) && (distances[i] < distances[i - 1]) )
+      {
+         distances[i] = distances[i - 1];
+      }
+   }
+
+   return getVectorValue(ballDistance, distances, 
+         DISTTABLE_ANGLE_LENGTH_SAMPLES, DISTTABLE_ANGLE_LENGTH_INC,
+         DISTTABLE_ANGLE_LENGTH_INC);
+}
 
 float DistTable::diskDistances[DISTTABLE_DISK_DIST_LENGTH];
 float* DistTable::ballDistances = NULL;
 int DistTable::ballDistancesSize = 0;
+float DistTable::angleDistances[DISTTABLE_ANGLE_TOTAL];
+volatile bool DistTable::angleTableLoaded = false;
+pthread_t DistTable::buildThread;
+bool DistTable::building = false;
+volatile bool DistTable::cancelBuild = false;
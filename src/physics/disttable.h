@@ -23,6 +23,9 @@
 #define _btsoccer_disttable_h
 
 #include "../btsoccer.h"
+#include <OGRE/OgreVector3.h>
+#include <OGRE/OgreString.h>
+#include <pthread.h>
 
 /** Maximun input length to use. */
 #define DISTTABLE_DISK_DIST_MAX_INPUT_LENGTH 80.0f
@@ -39,6 +42,36 @@
 /** How many disk positions to test for each target distance.
   * Too many values could result on 'no moves' and wrong calculated values. */
 #define DISTTABLE_BALL_DIST_STEPS 4
+/** Disk travel before touching the ball at the first angle sample. */
+#define DISTTABLE_ANGLE_MIN_TRAVEL      1.0f
+/** Disk travel increment between angle samples. */
+#define DISTTABLE_ANGLE_TRAVEL_INC      12.0f
+/** Number of disk travel distances sampled for the angle table. */
+#define DISTTABLE_ANGLE_TRAVEL_SAMPLES  8
+/** Contact angle increment (in degrees) between angle samples, from 0. */
+#define DISTTABLE_ANGLE_INC             10.0f
+/** Number of contact angles sampled for the angle table. */
+#define DISTTABLE_ANGLE_SAMPLES         8
+/** Input vector length increment between angle samples (and first one) */
+#define DISTTABLE_ANGLE_LENGTH_INC      2.5f
+/** Number of input vector lengths sampled for the angle table. */
+#define DISTTABLE_ANGLE_LENGTH_SAMPLES  32
+/** Total angle table samples. */
+#define DISTTABLE_ANGLE_TOTAL (DISTTABLE_ANGLE_TRAVEL_SAMPLES * \
+      DISTTABLE_ANGLE_SAMPLES * DISTTABLE_ANGLE_LENGTH_SAMPLES)
+/** File with the angle table, in binary form. */
+#define DISTTABLE_ANGLE_FILE            "distTableAngles.bin"
+/** Identifier of the angle table file */
+#define DISTTABLE_ANGLE_MAGIC           0x54445442
+/** Current version of the angle table file */
+#define DISTTABLE_ANGLE_VERSION         1
+
+/** Calculation phases: the ball samples depend on all disk ones. */
+#define DISTTABLE_PHASE_DISK_AND_ANGLE  0
+#define DISTTABLE_PHASE_BALL            1
+
+/** Worker threads to use when recalculating the table at unit tests. */
+#define DISTTABLE_DEFAULT_THREADS 4
 
 namespace BtSoccer
 {
@@ -50,8 +83,15 @@ class DistTable
 {
    public:
       /*! Init the distable to use.
-       * \param load true to load it from disk */
-      static void init(bool load);
+       * \param load true to load it from disk. If the angle table isn't
+       *        available, it's built at background (and cached at the 
+       *        user's home for the next runs).
+       * \param threads number of worker threads to use when calculating
+       *        the values (ie: when not loading them). Each sample is
+       *        calculated on its own isolated (and never sleeping) bullet
+       *        world, from a reset state, thus the result is the same,
+       *        whatever the number of threads used. */
+      static void init(bool load, int threads=1);
       /*! Finish the distable use. */
       static void finish();
 
@@ -71,6 +111,40 @@ class DistTable
       static float getDiskInputVectorLength(float distanceToBall, 
             float ballDistance);
 
+      /*! Get the vector length to make a disk hit the ball with a contact
+       * angle, sending it throught a distance. Inverse of #getBallDistance.
+       * \param distanceToBall -> distance the disk travels before 
+       *        touching the ball.
+       * \param contactAngle -> angle (in degrees) between the disk 
+       *        movement and the direction from the disk to the ball
+       *        center, at the contact (0 for a frontal touch).
+       * \param ballDistance -> distance the ball needs to go throught.
+       * \note without the angle table (see #hasAngleTable), just the
+       *       frontal approximation is used. */
+      static float getDiskInputVectorLength(float distanceToBall,
+            float contactAngle, float ballDistance);
+
+      /*! Get how far the ball goes when a disk hits it.
+       * \param distanceToBall -> distance the disk travels before
+       *        touching the ball.
+       * \param contactAngle -> contact angle, in degrees.
+       * \param length -> disk input vector length.
+       * \return ball distance, trilinear interpolated from the table. */
+      static float getBallDistance(float distanceToBall, 
+            float contactAngle, float length);
+
+      /*! \return if the angle table is available */
+      static bool hasAngleTable() { return angleTableLoaded; };
+
+      /*! \return number of ball distances (ie: after #init) */
+      static int getBallDistancesSize() { return ballDistancesSize; };
+
+      /*! Copy the current values (for example, to compare tables).
+       * \param disk DISTTABLE_DISK_DIST_LENGTH values
+       * \param ball #getBallDistancesSize values
+       * \param angle DISTTABLE_ANGLE_TOTAL values */
+      static void copyValues(float* disk, float* ball, float* angle);
+
    protected:
       
       /*! Do a binary search for needed vector value for a distance
@@ -84,18 +158,88 @@ class DistTable
       static float getVectorValue(float distance, float* distances,
             int vectorSize, float incValue, float firstIndex);
 
+      /*! Get the position of a value at a sampled dimension, clamped to
+       * its limits.
+       * \param value value to get position of
+       * \param first value of the first sample
+       * \param inc increment between samples
+       * \param samples number of samples
+       * \param index will receive the sample before (or at) the value
+       * \param frac will receive the fraction to the next sample */
+      static void getSamplePosition(float value, float first, float inc,
+            int samples, int& index, float& frac);
+
+      /*! Get the ball distance of an angle table length sample, bilinear
+       * interpolated at the travel and angle dimensions. */
+      static float getAngleSample(int travel, float travelFrac, int angle,
+            float angleFrac, int length);
+
+      /*! \return index at the angle table of a sample */
+      static int getAngleIndex(int travel, int angle, int length);
+
       /*! Wait for disk and ball to be stable. */
       static void waitDiskAndBallStable(TeamPlayer* disk, Ball* ball);
 
+      /*! Place disk and ball for a sample, resetting the simulation state
+       * of the world and waiting them to be stable. */
+      static void placeDiskAndBall(TeamPlayer* disk, Ogre::Vector3 diskPos,
+            Ball* ball, Ogre::Vector3 ballPos);
+
    private:
       DistTable(){};
 
-      /*! Precalculate table values. Usually called at application's init */
-      static void preCalculateValues();
+      /*! Precalculate table values. Usually called at application's init
+       * \param threads number of worker threads to use */
+      static void preCalculateValues(int threads);
+
+      /*! Calculate all samples of a phase, spread between threads.
+       * \param phase DISTTABLE_PHASE_* to calculate
+       * \param total number of samples of the phase
+       * \param threads number of worker threads to use (including the
+       *        calling one) */
+      static void runPhase(int phase, int total, int threads);
+
+      /*! Worker thread function: take the next sample of the phase to 
+       * calculate, until none left.
+       * \param arg pointer to the DistTablePhase to use. */
+      static void* runWorker(void* arg);
+
+      /*! Calculate a sample of a phase (see DISTTABLE_PHASE_*) */
+      static void calculateSample(int phase, int index);
+
+      /*! Calculate a diskDistances sample, on an isolated world.
+       * \param index of the sample to calculate */
+      static void calculateDiskDistance(int index);
+
+      /*! Calculate a ballDistances sample, on an isolated world.
+       * \param index of the sample to calculate
+       * \note diskDistances must be already calculated. */
+      static void calculateBallDistance(int index);
+
+      /*! Calculate an angleDistances sample, on an isolated world.
+       * \param index of the sample to calculate (see #getAngleIndex) */
+      static void calculateAngleDistance(int index);
 
       /*! Load previously calculated values from disk */
       static void loadFromDisk();
 
+      /*! Load the angle table from its binary file
+       * \return if loaded */
+      static bool loadAngleTable();
+      /*! Flush the angle table to its binary file
+       * \param fileName name of the file to write */
+      static void flushAngleTable(Ogre::String fileName);
+
+      /*! Start to build the angle table at a background thread, when
+       * it couldn't be loaded (ie: at the first run). Until done, 
+       * #hasAngleTable is false and the frontal estimate is used. */
+      static void startAngleTableBuild();
+      /*! Background thread function: calculate all angle samples and 
+       * cache them at the user's home (see #startAngleTableBuild). */
+      static void* buildAngleTable(void* arg);
+      /*! \return the angle table file cached at the user's home */
+      static Ogre::String getUserAngleFile();
+
       
       /*! Disk distances per input vector: How far the disk went when done
        * some input on it. */
@@ -109,6 +253,18 @@ class DistTable
       static float* ballDistances;
       /*! ballDistances vector size */
       static int ballDistancesSize;
+
+      /*! Ball distances per disk travel before the touch, contact angle
+       * and disk input vector length (in this order, see #getAngleIndex).
+       * Unlike ballDistances, it's the result of the whole shot, thus 
+       * no need to also use diskDistances to get an input. */
+      static float angleDistances[DISTTABLE_ANGLE_TOTAL];
+      /*! If angleDistances are available */
+      static volatile bool angleTableLoaded;
+
+      static pthread_t buildThread; /**< Thread building the angle table */
+      static bool building; /**< If buildThread is running */
+      static volatile bool cancelBuild; /**< To stop building the table */
       
 };
 
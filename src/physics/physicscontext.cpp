@@ -0,0 +1,911 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "physicscontext.h"
+#include "../engine/ball.h"
+#include "../engine/fobject.h"
+#include "../engine/field.h"
+#include "../engine/rules.h"
+#include "../engine/team.h"
+#include "../engine/teamplayer.h"
+#include "../engine/goalkeeper.h"
+#include "../engine/soundeffects.h"
+#include "../btsoccer.h"
+#include "../engine/threadlog.h"
+
+using namespace BtSoccer;
+
+
+/***********************************************************************
+ *                    physicsContextTickCallback                       *
+ ***********************************************************************/
+void physicsContextTickCallback(btDynamicsWorld *world, btScalar timeStep) 
+{
+   ((PhysicsContext*) world->getWorldUserInfo())->tickCallBack();
+}
+
+/***********************************************************************
+ *                             Constructor                             *
+ ***********************************************************************/
+PhysicsContext::PhysicsContext(bool checkRules, bool allowSleeping)
+{
+   this->checkRules = checkRules;
+   rulesEnabled = true;
+   playSounds = true;
+   onlineGame = false;
+#ifdef BTSOCCER_USE_PHYSICS_SLEEPING
+   sleeping = allowSleeping;
+#else
+   sleeping = false;
+#endif
+   pendingTime = 0.0f;
+   frames = 0;
+   ticks = 0;
+   turnResult = NULL;
+   turnActor = NULL;
+   placementDepth = 0;
+   bulletDebugDraw = NULL;
+   teamA = NULL;
+   teamB = NULL;
+   ball = NULL;
+   field = NULL;
+   diskDiameter = 0.0f;
+
+   collisionConfiguration = new btDefaultCollisionConfiguration();
+   dispatcher = new btCollisionDispatcher(collisionConfiguration);
+   broadPhase = new btDbvtBroadphase();
+   solver = new btSequentialImpulseConstraintSolver();
+   dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher, broadPhase, 
+         solver,collisionConfiguration);
+   dynamicsWorld->setGravity(btVector3(0, -9.8f, 0));
+   dynamicsWorld->setInternalTickCallback(physicsContextTickCallback, this);
+}
+
+/***********************************************************************
+ *                              Destructor                             *
+ ***********************************************************************/
+PhysicsContext::~PhysicsContext()
+{
+   delete dynamicsWorld;
+   delete solver;
+   delete dispatcher;
+   delete collisionConfiguration;
+   delete broadPhase;
+}
+
+/***********************************************************************
+ *                            setPointers                              *
+ ***********************************************************************/
+void PhysicsContext::setPointers(Team* tA, Team* tB, FieldObject* b, 
+      Field* f, bool online)
+{
+   onlineGame = online;
+   teamA = tA;
+   teamB = tB;
+   ball = b;
+   field = f;
+   if(tA != NULL)
+   {
+      diskDiameter = tA->getDisk(0)->getSphere().getRadius()*2.0f;
+   }
+}
+
+/***********************************************************************
+ *                          addRigidBody                               *
+ ***********************************************************************/
+void PhysicsContext::addRigidBody(btRigidBody* rigidBody, int group)
+{
+   if(sleeping)
+   {
+      rigidBody->setSleepingThresholds(BTSOCCER_PHYSICS_SLEEP_LINEAR,
+            BTSOCCER_PHYSICS_SLEEP_ANGULAR);
+   }
+   else
+   {
+      rigidBody->forceActivationState(DISABLE_DEACTIVATION);
+   }
+   dynamicsWorld->addRigidBody(rigidBody, group, getCollisionMask(group));
+}
+
+/***********************************************************************
+ *                         getCollisionGroup                           *
+ ***********************************************************************/
+int PhysicsContext::getCollisionGroup(int fieldObjectType)
+{
+   switch(fieldObjectType)
+   {
+      case FieldObject::TYPE_BALL:
+      case FieldObject::TYPE_BALL_AI:
+         return PHYSICS_GROUP_BALL;
+      case FieldObject::TYPE_DISK:
+      case FieldObject::TYPE_DISK_AI:
+         return PHYSICS_GROUP_DISK;
+      case FieldObject::TYPE_GOAL_KEEPER:
+      case FieldObject::TYPE_GOAL_KEEPER_AI:
+         return PHYSICS_GROUP_GOAL_KEEPER;
+   }
+
+   /* Not a gameplay one: just behave as bullet's default */
+   return btBroadphaseProxy::DefaultFilter;
+}
+
+/***********************************************************************
+ *                          getCollisionMask                           *
+ ***********************************************************************/
+int PhysicsContext::getCollisionMask(int group)
+{
+   switch(group)
+   {
+      case PHYSICS_GROUP_BALL:
+         return PHYSICS_GROUP_DISK | PHYSICS_GROUP_GOAL_KEEPER | 
+                PHYSICS_GROUP_STATIC | btBroadphaseProxy::DefaultFilter;
+      case PHYSICS_GROUP_DISK:
+         return PHYSICS_GROUP_GAMEPLAY | PHYSICS_GROUP_STATIC | 
+                btBroadphaseProxy::DefaultFilter;
+      case PHYSICS_GROUP_GOAL_KEEPER:
+         return PHYSICS_GROUP_BALL | PHYSICS_GROUP_DISK | 
+                PHYSICS_GROUP_STATIC | btBroadphaseProxy::DefaultFilter;
+      case PHYSICS_GROUP_FIELD:
+      case PHYSICS_GROUP_GOAL:
+         return PHYSICS_GROUP_GAMEPLAY | btBroadphaseProxy::DefaultFilter;
+   }
+
+   return btBroadphaseProxy::AllFilter;
+}
+
+/***********************************************************************
+ *                        removeRigidBody                              *
+ ***********************************************************************/
+void PhysicsContext::removeRigidBody(btRigidBody* rigidBody)
+{
+   dynamicsWorld->removeRigidBody(rigidBody);
+}
+
+/***********************************************************************
+ *                          forcedStep                                 *
+ ***********************************************************************/
+void PhysicsContext::forcedStep(btScalar timeStep, int maxSubSteps)
+{
+   /* Do the fixed step */
+   rulesEnabled = false;
+   btScalar stepInSeconds = timeStep / 1000.0f;
+   dynamicsWorld->stepSimulation(stepInSeconds, maxSubSteps, 
+                                 BULLET_FREQUENCY);
+   rulesEnabled = true;
+
+   debugDraw();
+}
+
+/***********************************************************************
+ *                           beginPlacement                            *
+ ***********************************************************************/
+void PhysicsContext::beginPlacement()
+{
+   placementDepth++;
+}
+
+/***********************************************************************
+ *                          addPlacedObject                            *
+ ***********************************************************************/
+void PhysicsContext::addPlacedObject(FieldObject* obj)
+{
+   if(placedObjects.findLinearSearch(obj) == placedObjects.size())
+   {
+      placedObjects.push_back(obj);
+   }
+}
+
+/***********************************************************************
+ *                            endPlacement                             *
+ ***********************************************************************/
+void PhysicsContext::endPlacement()
+{
+   if(placementDepth > 0)
+   {
+      placementDepth--;
+   }
+   if( (placementDepth > 0) || (placedObjects.size() == 0) )
+   {
+      return;
+   }
+
+   /* Update the broadphase once with all new positions and settle them
+    * with a single step */
+   dynamicsWorld->updateAabbs();
+   dynamicsWorld->computeOverlappingPairs();
+   forcedStep();
+
+   for(int i = 0; i < placedObjects.size(); i++)
+   {
+      placedObjects[i]->clearMovedFlag();
+   }
+   placedObjects.clear();
+}
+
+/***********************************************************************
+ *                             preStep                                 *
+ ***********************************************************************/
+void PhysicsContext::preStep()
+{
+   if(ball)
+   {
+      ball->prePhysicStep();
+   }
+   if(teamA)
+   {
+      teamA->prePhysicStep();
+   }
+   if(teamB)
+   {
+      teamB->prePhysicStep();
+   }
+}
+
+/***********************************************************************
+ *                              step                                   *
+ ***********************************************************************/
+void PhysicsContext::step(btScalar timeStep, int maxSubSteps)
+{
+   int maxFrames = maxSubSteps / BTSOCCER_PHYSICS_STEPS_PER_FRAME;
+   if(maxFrames < 1)
+   {
+      maxFrames = 1;
+   }
+
+   /* Only simulate whole frames, keeping the remaining time for the
+    * next call. */
+   pendingTime += timeStep;
+   int done = 0;
+   while( (pendingTime >= BTSOCCER_PHYSICS_FRAME_TIME) && 
+          (done < maxFrames) )
+   {
+      stepFrame();
+      pendingTime -= BTSOCCER_PHYSICS_FRAME_TIME;
+      done++;
+   }
+
+   if(pendingTime >= BTSOCCER_PHYSICS_FRAME_TIME)
+   {
+      /* Too slow to catch up: discard the exceeding time */
+      pendingTime = 0.0f;
+   }
+}
+
+/***********************************************************************
+ *                            stepFrame                                *
+ ***********************************************************************/
+void PhysicsContext::stepFrame()
+{
+   simulateFrame();
+   debugDraw();
+}
+
+/***********************************************************************
+ *                           simulateFrame                             *
+ ***********************************************************************/
+void PhysicsContext::simulateFrame()
+{
+   /* Things before physics step */
+   preStep();
+   collisionEvents.clear();
+
+   /* Do the frame as a single bullet call of its fixed sub steps, so
+    * the applied forces act for the whole frame (bullet clears them at
+    * the end of each call). The frame time is an exact multiple of 
+    * BULLET_FREQUENCY, thus no time is left for the next call. */
+   if((!sleeping) || (!isAsleep()))
+   {
+      dynamicsWorld->stepSimulation(BTSOCCER_PHYSICS_FRAME_TIME / 1000.0f,
+            BTSOCCER_PHYSICS_STEPS_PER_FRAME, BULLET_FREQUENCY);
+   }
+   frames++;
+
+   /* Consume the collisions (and goal entering) of the frame's ticks */
+   processCollisionEvents();
+
+   /* Check ball field limits */
+   if( ((checkRules) || (turnResult)) && (ball) && (ball->getMovedFlag()) && 
+       (field) )
+   {
+      checkBallFieldLimits();
+   }
+}
+
+/***********************************************************************
+ *                            resolveTurn                              *
+ ***********************************************************************/
+bool PhysicsContext::resolveTurn(FieldObject* actor, Ogre::Real fx, 
+      Ogre::Real fz, TurnResult& result, int maxFrames)
+{
+   resetSimulationState();
+   if(actor)
+   {
+      actor->applyForce(fx, 0.0f, fz);
+   }
+
+   turnActor = actor;
+   bool stable = resolve(result, maxFrames);
+   turnActor = NULL;
+
+   return stable;
+}
+
+/***********************************************************************
+ *                              resolve                                *
+ ***********************************************************************/
+bool PhysicsContext::resolve(TurnResult& result, int maxFrames)
+{
+   /* Nothing to draw, play or tell the other side while resolving */
+   BulletDebugDraw* prevDebugDraw = bulletDebugDraw;
+   bool prevPlaySounds = playSounds;
+   bool prevOnlineGame = onlineGame;
+   bulletDebugDraw = NULL;
+   playSounds = false;
+   onlineGame = false;
+
+   result.clear();
+   turnResult = &result;
+
+   int done = 0;
+   bool stable = false;
+   while( (!stable) && (done < maxFrames) )
+   {
+      simulateFrame();
+      done++;
+      stable = isWorldStable();
+   }
+
+   turnResult = NULL;
+   bulletDebugDraw = prevDebugDraw;
+   playSounds = prevPlaySounds;
+   onlineGame = prevOnlineGame;
+
+   /* Define the final state, at replay objects order */
+   result.setFinished(done, stable);
+   if(ball)
+   {
+      result.setPosition(0, ball->getPosition());
+   }
+   Team* teams[2] = {teamA, teamB};
+   for(int t = 0; t < 2; t++)
+   {
+      if(teams[t] != NULL)
+      {
+         int base = 1 + t * (TEAM_MAX_DISKS + 1);
+         result.setPosition(base, teams[t]->getGoalKeeper()->getPosition());
+         for(int i = 0; i < TEAM_MAX_DISKS; i++)
+         {
+            result.setPosition(base + 1 + i, 
+                  teams[t]->getDisk(i)->getPosition());
+         }
+      }
+   }
+
+   return stable;
+}
+
+/***********************************************************************
+ *                        resetSimulationState                         *
+ ***********************************************************************/
+void PhysicsContext::resetSimulationState()
+{
+   btCollisionObjectArray& objects = dynamicsWorld->getCollisionObjectArray();
+   for(int i = 0; i < objects.size(); i++)
+   {
+      btRigidBody* body = btRigidBody::upcast(objects[i]);
+      if(body != NULL)
+      {
+         body->setLinearVelocity(btVector3(0.0f, 0.0f, 0.0f));
+         body->setAngularVelocity(btVector3(0.0f, 0.0f, 0.0f));
+         body->clearForces();
+         body->setInterpolationWorldTransform(
+               body->getCenterOfMassTransform());
+         body->setInterpolationLinearVelocity(btVector3(0.0f, 0.0f, 0.0f));
+         body->setInterpolationAngularVelocity(btVector3(0.0f, 0.0f, 0.0f));
+         if(sleeping)
+         {
+            /* Awake, but ready to sleep on the first step found at rest:
+             * only the bodies a force activates (and the ones they reach
+             * through contacts) are kept awake. */
+            body->forceActivationState(ACTIVE_TAG);
+            body->setDeactivationTime(gDeactivationTime);
+         }
+         else
+         {
+            body->activate(true);
+         }
+      }
+   }
+   clearCachedContacts();
+
+   pendingTime = 0.0f;
+   frames = 0;
+}
+
+/***********************************************************************
+ *                        clearCachedContacts                          *
+ ***********************************************************************/
+void PhysicsContext::clearCachedContacts()
+{
+   /* Forget cached contacts (and their warm starting impulses), keeping
+    * the broadphase proxies themselves. */
+   btCollisionObjectArray& objects = dynamicsWorld->getCollisionObjectArray();
+   btOverlappingPairCache* pairCache = 
+      dynamicsWorld->getBroadphase()->getOverlappingPairCache();
+   for(int i = 0; i < objects.size(); i++)
+   {
+      if(objects[i]->getBroadphaseHandle())
+      {
+         pairCache->cleanProxyFromPairs(objects[i]->getBroadphaseHandle(), 
+                                        dispatcher);
+      }
+   }
+   solver->reset();
+}
+
+/***********************************************************************
+ *                        updateSleepingTimes                          *
+ ***********************************************************************/
+void PhysicsContext::updateSleepingTimes()
+{
+   /* Bullet only has a global time to sleep (gDeactivationTime), shared
+    * by every world of the process: instead of changing it, a body at
+    * rest for BTSOCCER_PHYSICS_SLEEP_TIME has its own rest time pushed
+    * to the global one, thus sleeping at the next tick still at rest 
+    * (a tick with movement resets it to 0, as usual). */
+   btCollisionObjectArray& objects = dynamicsWorld->getCollisionObjectArray();
+   for(int i = 0; i < objects.size(); i++)
+   {
+      btCollisionObject* obj = objects[i];
+      if( (!obj->isStaticOrKinematicObject()) && (obj->isActive()) &&
+          (obj->getDeactivationTime() >= BTSOCCER_PHYSICS_SLEEP_TIME) &&
+          (obj->getDeactivationTime() < gDeactivationTime) )
+      {
+         obj->setDeactivationTime(gDeactivationTime);
+      }
+   }
+}
+
+/***********************************************************************
+ *                          tickCallBack                               *
+ ***********************************************************************/
+void PhysicsContext::tickCallBack()
+{
+   ticks++;
+
+   if(sleeping)
+   {
+      updateSleepingTimes();
+   }
+
+   if( ((!checkRules) && (!turnResult)) || (!rulesEnabled) )
+   {
+      /* No need to check rules, if not to check (nor to collect the
+       * events of a turn being resolved) */
+      return;
+   }
+
+   int numManifolds = dynamicsWorld->getDispatcher()->getNumManifolds();
+   for (int i=0;i<numManifolds;i++)
+   {
+      btPersistentManifold* contactManifold =  
+         dynamicsWorld->getDispatcher()->getManifoldByIndexInternal(i);
+      const btCollisionObject* obA = (contactManifold->getBody0());
+      const btCollisionObject* obB = (contactManifold->getBody1());
+
+      /* Fast path: only manifolds between gameplay objects matter (most
+       * of them are from the objects resting at the ground). */
+      if( (contactManifold->getNumContacts() > 0) &&
+          (obA->getBroadphaseHandle()->m_collisionFilterGroup & 
+           PHYSICS_GROUP_GAMEPLAY) &&
+          (obB->getBroadphaseHandle()->m_collisionFilterGroup & 
+           PHYSICS_GROUP_GAMEPLAY) )
+      {
+         /* Retrieve object pointers */
+         FieldObject* pA = (FieldObject*)
+            obA->getCollisionShape()->getUserPointer();
+         FieldObject* pB = (FieldObject*)
+            obB->getCollisionShape()->getUserPointer();
+
+         FieldObject* actor = (turnActor) ? turnActor : 
+                                            Rules::getCurrentDisk();
+         bool someoneIsTheActorDisk = (pA == actor) || (pB == actor);
+
+         /* Define the event type of the pair */
+         int type = -1;
+         if( (pA->getType() == FieldObject::TYPE_DISK) &&
+             (pB->getType() == FieldObject::TYPE_DISK) )
+         {
+            type = CollisionEvent::EVENT_DISK_DISK;
+         }
+         else if( ((pA->getType() == FieldObject::TYPE_GOAL_KEEPER) ||
+                   (pA->getType() == FieldObject::TYPE_DISK) ) &&
+                  ((pB->getType() == FieldObject::TYPE_GOAL_KEEPER) ||
+                   (pB->getType() == FieldObject::TYPE_DISK) ) )
+         {
+            type = CollisionEvent::EVENT_DISK_GOAL_KEEPER;
+         }
+         else if( (pA->getType() == FieldObject::TYPE_BALL) ||
+                  (pB->getType() == FieldObject::TYPE_BALL) )
+         {
+            type = CollisionEvent::EVENT_BALL_DISK;
+         }
+
+         int numContacts = contactManifold->getNumContacts();
+         for (int j=0;j<numContacts;j++)
+         {
+            btManifoldPoint& pt = contactManifold->getContactPoint(j);
+
+            /* Verify if someone is moving (not a static collision).
+             * Note: must check current and last, as the movement is
+             * made after this callback. Also, this is the reason
+             * why actor collisions are always positive: to avoid missing
+             * an initial collision.
+             * Note: It's possible to miss an initial secundary collision,
+             * but as it isn't relevant to the rules, no problem than. */
+            if( (type != -1) && 
+                ( (someoneIsTheActorDisk) ||
+                  (pA->getMovedFlag()) || (pA->getLastMovedFlag()) ||
+                  (pB->getMovedFlag()) || (pB->getLastMovedFlag()) ) )
+            {
+               /* Just record it (once per pair per tick), to be 
+                * consumed at the frame's end. */
+               bool added;
+               CollisionEvent* ev = collisionEvents.add(type, pA, pB, 
+                     ticks, added);
+               if(ev != NULL)
+               {
+                  if(added)
+                  {
+                     const btVector3& ptA = pt.getPositionWorldOnA();
+                     ev->x = ptA.getX() * BULLET_TO_OGRE_FACTOR;
+                     ev->z = ptA.getZ() * BULLET_TO_OGRE_FACTOR;
+                     ev->newCollision = 
+                        (pA->getLastCollisionTick() == 0) ||
+                        (pB->getLastCollisionTick() == 0) ||
+                        (ticks - pA->getLastCollisionTick() >= 
+                         BTSOCCER_MIN_NEW_COLLISION_TICKS) ||
+                        (ticks - pB->getLastCollisionTick() >= 
+                         BTSOCCER_MIN_NEW_COLLISION_TICKS);
+                  }
+                  if(pt.getAppliedImpulse() > ev->impulse)
+                  {
+                     ev->impulse = pt.getAppliedImpulse();
+                  }
+               }
+            }
+         }
+
+         if(numContacts > 0)
+         {
+            pA->setLastCollisionTick(ticks);
+            pB->setLastCollisionTick(ticks);
+         }
+      }
+   }
+
+   /* Verify if ball entered goal: to enter it must pass fully the line,
+    * so must do radius correction to the position. */
+   if((ball != NULL) && (field != NULL))
+   {
+      Ogre::Vector3 ballPosUp = ball->getPosition();
+      ballPosUp.x -= ball->getSphereRadius();
+      Ogre::Vector3 ballPosDown = ball->getPosition();
+      ballPosDown.x += ball->getSphereRadius();
+      int goal = 0;
+      if(field->getUpGoalBox().contains(ballPosUp))
+      {
+         goal = 1;
+      }
+      else if(field->getDownGoalBox().contains(ballPosDown))
+      {
+         goal = -1;
+      }
+      if(goal != 0)
+      {
+         bool added;
+         CollisionEvent* ev = collisionEvents.add(
+               CollisionEvent::EVENT_BALL_ENTER_GOAL, ball, NULL, ticks,
+               added);
+         if(ev != NULL)
+         {
+            ev->x = ball->getPosition().x;
+            ev->z = ball->getPosition().z;
+            ev->upper = (goal > 0);
+         }
+      }
+   }
+
+}
+
+/***********************************************************************
+ *                       processCollisionEvents                        *
+ ***********************************************************************/
+void PhysicsContext::processCollisionEvents()
+{
+   if(collisionEvents.getDiscarded() > 0)
+   {
+      ThreadLog::getLog()->stream(Ogre::LML_CRITICAL)
+         << "Warning: " << collisionEvents.getDiscarded() 
+         << " collision events discarded at a frame!";
+   }
+
+   int total = collisionEvents.getTotal();
+   for(int i = 0; i < total; i++)
+   {
+      CollisionEvent* ev = collisionEvents.get(i);
+      bool makeSound = false;
+
+      switch(ev->type)
+      {
+         /* TeamPlayer collision with TeamPlayer */
+         case CollisionEvent::EVENT_DISK_DISK:
+         {
+            TeamPlayer* tpA = (TeamPlayer*)ev->objA;
+            TeamPlayer* tpB = (TeamPlayer*)ev->objB;
+            /* Tell Rules:: */
+            if(checkRules)
+            {
+               Rules::diskCollideDisk(tpA->getTeam(), tpB->getTeam(),
+                     ev->x, ev->z);
+            }
+            if(turnResult)
+            {
+               turnResult->addEvent(TurnEvent::EVENT_DISK_COLLIDE_DISK,
+                     tpA->getTeam(), tpB->getTeam(), false, ev->x, ev->z);
+            }
+            makeSound = true;
+         }
+         break;
+         /* Team Player collision with goalkeeper */
+         case CollisionEvent::EVENT_DISK_GOAL_KEEPER:
+         {
+            bool aIsKeeper = 
+               (ev->objA->getType() == FieldObject::TYPE_GOAL_KEEPER);
+            GoalKeeper* gk = (GoalKeeper*)((aIsKeeper) ? ev->objA : 
+                                                         ev->objB);
+            TeamPlayer* tp = (TeamPlayer*)((aIsKeeper) ? ev->objB : 
+                                                         ev->objA);
+            /* Set position of collision with goal keeper to "meia-lua"
+             * area entering. */
+            Ogre::Real xPos;
+            if(gk->getTeam() == Rules::getUpperTeam())
+            {
+               xPos = Rules::getField()->getPenaltyAreaDelta()[0];
+            }
+            else
+            {
+               xPos = -Rules::getField()->getPenaltyAreaDelta()[0];
+            }
+            if(checkRules)
+            {
+               Rules::diskCollideDisk(gk->getTeam(), tp->getTeam(),
+                     xPos, 0.0f);
+            }
+            if(turnResult)
+            {
+               turnResult->addEvent(TurnEvent::EVENT_DISK_COLLIDE_DISK,
+                     gk->getTeam(), tp->getTeam(), false, xPos, 0.0f);
+            }
+            makeSound = true;
+         }
+         break;
+         /* Ball collision with TeamPlayer */
+         case CollisionEvent::EVENT_BALL_DISK:
+         {
+            TeamPlayer* disk = NULL;
+            if( (ev->objA->getType() == FieldObject::TYPE_DISK) ||
+                (ev->objA->getType() == FieldObject::TYPE_GOAL_KEEPER) )
+            {
+               disk = (TeamPlayer*)ev->objA;
+            }
+            else if( (ev->objB->getType() == FieldObject::TYPE_DISK) ||
+                     (ev->objB->getType() == FieldObject::TYPE_GOAL_KEEPER) )
+            {
+               disk = (TeamPlayer*)ev->objB;
+            }
+            if((disk != NULL) && (checkRules))
+            {
+               Rules::ballCollideDisk(disk->getTeam());
+            }
+            if((disk != NULL) && (turnResult))
+            {
+               turnResult->addEvent(TurnEvent::EVENT_BALL_COLLIDE_DISK,
+                     disk->getTeam(), NULL, false, ev->x, ev->z);
+            }
+         }
+         break;
+         /* Ball entered a goal */
+         case CollisionEvent::EVENT_BALL_ENTER_GOAL:
+         {
+            if(checkRules)
+            {
+               Rules::ballEnterGoal(ev->upper);
+            }
+            addBallTurnEvent(TurnEvent::EVENT_BALL_ENTER_GOAL, ev->upper,
+                  ev->x, ev->z);
+         }
+         break;
+      }
+
+      if((makeSound) && (ev->newCollision))
+      {
+         Ogre::Vector3 pos(ev->x, 0.0f, ev->z);
+         if(playSounds)
+         {
+            SoundEffects::queue(BTSOCCER_SOUND_DISK_COLLISION, pos);
+         }
+         /* Queue message, if online game (at lockstep,
+          * the other side simulates its own collisions) */
+         if( (onlineGame) && (!protocol.isUsingLockstep()) )
+         {
+            protocol.queueSoundEffect(SOUND_TYPE_COLLISION, pos);
+         }
+      }
+   }
+}
+
+/***********************************************************************
+ *                          isWorldStable                              *
+ ***********************************************************************/
+bool PhysicsContext::isWorldStable()
+{
+   if((sleeping) && (isAsleep()))
+   {
+      /* Every island is sleeping: nothing will move. */
+      return true;
+   }
+
+   if( ( (teamA) && (teamA->movedOnLastPhysicStep()) ) ||
+       ( (teamB) && (teamB->movedOnLastPhysicStep()) ) ||
+       ( (ball) && (ball->getMovedFlag()) ) )
+   {
+      /* Someone moved: not stable yet. */
+      return false;
+   }
+
+   return true;
+}
+
+/***********************************************************************
+ *                              isAsleep                               *
+ ***********************************************************************/
+bool PhysicsContext::isAsleep()
+{
+   btCollisionObjectArray& objects = dynamicsWorld->getCollisionObjectArray();
+   for(int i = 0; i < objects.size(); i++)
+   {
+      if( (!objects[i]->isStaticOrKinematicObject()) &&
+          (objects[i]->isActive()) )
+      {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+/***********************************************************************
+ *                       queueUpdatesToProtocol                        *
+ ***********************************************************************/
+void PhysicsContext::queueUpdatesToProtocol(bool sendAll)
+{
+   if((sendAll) || (ball->getMovedFlag()))
+   {
+      protocol.queueBallUpdateToSend(ball->getPosition(), 
+            ball->getOrientation(), sendAll);
+   }
+   if(teamA != NULL)
+   {
+      teamA->queueUpdatesToSend(true, sendAll);
+   }
+   if(teamB != NULL)
+   {
+      teamB->queueUpdatesToSend(false, sendAll);
+   }
+   /* When using snapshots, updates are sent together as a delta */
+   protocol.queueSnapshot(sendAll);
+}
+
+/***********************************************************************
+ *                            debugDraw                                *
+ ***********************************************************************/
+void PhysicsContext::debugDraw()
+{
+   if(bulletDebugDraw != NULL)
+   {
+      dynamicsWorld->debugDrawWorld();
+      bulletDebugDraw->update();
+   }
+}
+
+/***********************************************************************
+ *                          setDebugDraw                               *
+ ***********************************************************************/
+void PhysicsContext::setDebugDraw(BulletDebugDraw* debugDraw)
+{
+   dynamicsWorld->setDebugDrawer(debugDraw);
+   bulletDebugDraw = debugDraw;
+}
+
+/*****************************************************************
+ *                      checkBallFieldLimits                     *
+ *****************************************************************/
+void PhysicsContext::checkBallFieldLimits()
+{
+   /* Must check if full ball went over limits */
+   float ballRadius = ball->getSphere().getRadius();
+   Ogre::Vector3 pos = ball->getPosition();
+   Ogre::Vector2 halfSize = field->getHalfSize();
+   Ogre::Vector2 sideDelta = field->getSideDelta();
+
+   /* cheking if ball has exited through the field byline */
+   if(pos.x >= halfSize[0] - sideDelta[0] + ballRadius)
+   {
+      if(checkRules)
+      {
+         Rules::ballExitAtByline(true, pos.z);
+      }
+      addBallTurnEvent(TurnEvent::EVENT_BALL_EXIT_BYLINE, true, pos.x, pos.z);
+   }
+   else if(pos.x <= -halfSize[0] + sideDelta[0] - ballRadius)
+   {
+      if(checkRules)
+      {
+         Rules::ballExitAtByline(false, pos.z);
+      }
+      addBallTurnEvent(TurnEvent::EVENT_BALL_EXIT_BYLINE, false, pos.x, pos.z);
+   }
+
+   /* checking if ball has exited through the field sides */
+   if(pos.z >= halfSize[1] - sideDelta[1] + ballRadius)
+   {
+      if(checkRules)
+      {
+         Rules::ballExitAtSide(pos.x, halfSize[1] - sideDelta[1]);
+      }
+      addBallTurnEvent(TurnEvent::EVENT_BALL_EXIT_SIDE, false, pos.x,
+            halfSize[1] - sideDelta[1]);
+   }
+   else if(pos.z <= -halfSize[1]  + sideDelta[1] - ballRadius)
+   {
+      if(checkRules)
+      {
+         Rules::ballExitAtSide(pos.x, -halfSize[1]+sideDelta[1]);
+      }
+      addBallTurnEvent(TurnEvent::EVENT_BALL_EXIT_SIDE, false, pos.x,
+            -halfSize[1]+sideDelta[1]);
+   }   
+}
+
+/*****************************************************************
+ *                        addBallTurnEvent                       *
+ *****************************************************************/
+void PhysicsContext::addBallTurnEvent(int type, bool upper, 
+      Ogre::Real x, Ogre::Real z)
+{
+   /* Only the first frame the ball is out (or inside the goal) is an
+    * event: it will usually be there for some frames. */
+   if((turnResult) && (turnResult->findEvent(type) == NULL))
+   {
+      turnResult->addEvent(type, NULL, NULL, upper, x, z);
+   }
+}
+
@@ -0,0 +1,297 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _btsoccer_physics_context_h
+#define _btsoccer_physics_context_h
+
+#include <btBulletDynamicsCommon.h>
+#include "../debug/bulletdebugdraw.h"
+#include "../net/protocol.h"
+#include "../btsoccer.h"
+#include "turnresult.h"
+#include "collisionevent.h"
+
+namespace BtSoccer
+{
+
+/*! Default max physics frames to resolve a turn (see
+ * PhysicsContext::resolveTurn). */
+#define PHYSICS_CONTEXT_MAX_RESOLVE_FRAMES   2400
+
+/*! Collision filter groups of the bodies at a context's world (the first
+ * bits are kept to bullet's own btBroadphaseProxy groups, as the default
+ * one used by world queries). */
+#define PHYSICS_GROUP_BALL          (1 << 6)  /**< The ball */
+#define PHYSICS_GROUP_DISK          (1 << 7)  /**< Team disks */
+#define PHYSICS_GROUP_GOAL_KEEPER   (1 << 8)  /**< Goal keepers */
+#define PHYSICS_GROUP_FIELD         (1 << 9)  /**< Static ground and sides */
+#define PHYSICS_GROUP_GOAL          (1 << 10) /**< Static poles and nets */
+/*! Groups of the dynamic gameplay objects (ie: the ones whose collisions
+ * are of interest to the rules). */
+#define PHYSICS_GROUP_GAMEPLAY   (PHYSICS_GROUP_BALL | PHYSICS_GROUP_DISK | \
+                                  PHYSICS_GROUP_GOAL_KEEPER)
+/*! Groups of the static field geometry */
+#define PHYSICS_GROUP_STATIC     (PHYSICS_GROUP_FIELD | PHYSICS_GROUP_GOAL)
+
+   /*! A physics simulation context: its own bullet world, with its own 
+    * teams, ball and field bindings and tick callback. Many contexts
+    * could exist at once (for example, one per thread), each one 
+    * isolated from the others. 
+    * \note Rules are still global, so only a single context per process
+    *       should have rules checking enabled.
+    * \note BulletLink is a facade to a default context, or to the one 
+    *       bound to the current thread. */
+   class PhysicsContext
+   {
+      public:
+         /*! Constructor: create the bullet world of the context
+          * \param checkRules if should check rules on collisions. If false,
+          *        the context is only usable for calibration-like 
+          *        simulations, without tell anything to Rules.
+          * \param allowSleeping if resting bodies could be put to sleep
+          *        (see #setSleeping), when BTSOCCER_USE_PHYSICS_SLEEPING.
+          *        Calibration contexts (see DistTable) must not sleep, 
+          *        to keep the same samples of the shipped tables. */
+         PhysicsContext(bool checkRules=true, bool allowSleeping=true);
+         /*! Destructor: delete the context's bullet world */
+         ~PhysicsContext();
+
+         /*! Set pointers used by the context 
+          * \param tA -> pointer to team A 
+          * \param tB -> pointer to team B
+          * \param b -> pointer to ball
+          * \param f -> pointer to field 
+          * \param online -> true if online game */
+         void setPointers(Team* tA, Team* tB, FieldObject* b, 
+               Field* f, bool online);
+
+         /*! The callback for bullet tick */
+         void tickCallBack();
+
+         /*! Add rigid body to the world
+          * \param rigidBody -> pointer to the rigid body to add
+          * \param group -> its collision filter group (PHYSICS_GROUP_*).
+          *        Its mask is defined by #getCollisionMask. */
+         void addRigidBody(btRigidBody* rigidBody, int group);
+
+         /*! \return collision filter group of a FieldObject type */
+         static int getCollisionGroup(int fieldObjectType);
+         /*! \return collision filter mask of a group: static geometry 
+          *          never pairs with itself, and neither the ball nor
+          *          goal keepers (each one at its own goal) meet their
+          *          likes. */
+         static int getCollisionMask(int group);
+         
+         /*! Remove rigid body from the world
+          * \param rigidBody -> pointer to the rigid body to remove */
+         void removeRigidBody(btRigidBody* rigidBody);
+
+         /*! Define the debug drawer for bullet
+          * \param debugDraw pointer to the debug drawer used. */
+         void setDebugDraw(BulletDebugDraw* debugDraw);
+
+         /*! Do the draw of current physics for debug. */
+         void debugDraw();
+
+         /*! Do the preStep, clearing flags.
+          * \note step(timeStep, maxSub) will already call this function. */
+         void preStep();
+
+         /*! Step the rigid body, by doing as many whole physics frames 
+          * (see #stepFrame) as fit on the accumulated time.
+          * \param timeStep -> current time of this step (in ms).
+          * \param maxSubSteps -> max number of bullet sub steps (thus
+          *        at least one frame will be done, when the accumulated
+          *        time is enough). The time that exceeds it is discarded. */
+         void step(btScalar timeStep, int maxSubSteps);
+
+         /*! Do a single physics frame: the preStep, a bullet step of
+          * BTSOCCER_PHYSICS_STEPS_PER_FRAME sub steps of BULLET_FREQUENCY
+          * (skipped if the world is asleep) and the ball limits check.
+          * Always the same sequence of steps, thus given the same initial
+          * state (see #resetSimulationState), the same results. */
+         void stepFrame();
+
+         /*! Reset the dynamic state of the world, for a deterministic
+          * simulation from current positions: velocities, forces, cached
+          * contacts, solver state and the accumulated time are cleared. */
+         void resetSimulationState();
+
+         /*! Forget the cached contact points (and their warm starting
+          * impulses) and the solver state, without touching the bodies or
+          * rebuilding the broadphase. Used after teleporting bodies to a
+          * previous state (see WorldSnapshot::restore). */
+         void clearCachedContacts();
+
+         /*! Resolve a turn to rest, as fast as possible: reset the 
+          * simulation state (see #resetSimulationState), apply the force
+          * to the actor and run whole frames (see #stepFrame) until the
+          * world is stable, without debug draw, sound effects or protocol
+          * messages.
+          * \param actor object to apply the force to (disk or ball)
+          * \param fx force to apply at X axis
+          * \param fz force to apply at Z axis
+          * \param result where to put the final positions and the rule
+          *        events collected while resolving the turn
+          * \param maxFrames max frames to run
+          * \return if the world got to rest
+          * \note Rules are still told of the events when checking rules
+          *       (see #setCheckRules). Disable it to only predict a turn. */
+         bool resolveTurn(FieldObject* actor, Ogre::Real fx, Ogre::Real fz,
+               TurnResult& result, 
+               int maxFrames=PHYSICS_CONTEXT_MAX_RESOLVE_FRAMES);
+
+         /*! Resolve the current simulation to rest, as #resolveTurn, but
+          * from the current state (without resetting it or applying any
+          * force). */
+         bool resolve(TurnResult& result,
+               int maxFrames=PHYSICS_CONTEXT_MAX_RESOLVE_FRAMES);
+
+         /*! \return number of physics frames done since last 
+          * #resetSimulationState */
+         unsigned long getFrames() { return frames; };
+         /*! \return number of physics ticks (of BULLET_FREQUENCY) done
+          * since the context creation */
+         unsigned long getTicks() { return ticks; };
+
+         /*! \return collision events of the last physics frame, already
+          * consumed (valid until the next frame) */
+         CollisionEventQueue* getCollisionEvents() 
+         { 
+            return &collisionEvents; 
+         };
+
+         /*! Do a step just to stabilize physics after a position set. */
+         void forcedStep(btScalar timeStep=0.1f, int maxSubSteps=5);
+
+         /*! Start a placement batch: until its #endPlacement, 
+          * FieldObject::setPosition just sets the new position, without 
+          * its forced step. Batches could be nested. */
+         void beginPlacement();
+         /*! End a placement batch. At the end of the outermost one, the
+          * broadphase is updated and a single forced step settles all the
+          * objects placed at it. */
+         void endPlacement();
+         /*! \return if inside a placement batch */
+         bool isPlacing() { return placementDepth > 0; };
+         /*! Add an object placed inside the current batch, to settle at
+          * its end. */
+         void addPlacedObject(FieldObject* obj);
+
+         /*! Check if the world system is stable (ie: with no
+          * velocities and forces; aka: static!) */
+         bool isWorldStable();
+
+         /*! Define if resting bodies should be put to sleep. When sleeping,
+          * only the islands reached by the shot are simulated, and 
+          * frames are skipped once all of them are sleeping.
+          * \note only affects bodies added after the call and the next
+          *       #resetSimulationState. */
+         void setSleeping(bool sleep) { sleeping = sleep; };
+         /*! \return if resting bodies are put to sleep */
+         bool getSleeping() { return sleeping; };
+         /*! \return if all non static bodies of the world are sleeping */
+         bool isAsleep();
+
+         /*! Queue at the protocol - to send - all updates to teamPlayers
+          * and ball. 
+          * \param sendAll -> if true will send all positions, not just
+          *                   the ones that changed.*/
+         void queueUpdatesToProtocol(bool sendAll=false);
+
+         /*! Define if collisions should play sound effects
+          * \param play false to keep the context silent (for example,
+          *        on headless simulations without a sound system). */
+         void setPlaySounds(bool play) { playSounds = play; };
+
+         /*! Define if collisions should be told to Rules
+          * \param check false to simulate without changing the rules
+          *        state (for example, when playing a recorded match). */
+         void setCheckRules(bool check) { checkRules = check; };
+         /*! \return if collisions are told to Rules */
+         bool getCheckRules() { return checkRules; };
+
+         /*! \return the bullet world of this context */
+         btDiscreteDynamicsWorld* getDynamicsWorld() { return dynamicsWorld; };
+
+         /*! \return team A binded to the context, if any */
+         Team* getTeamA() { return teamA; };
+         /*! \return team B binded to the context, if any */
+         Team* getTeamB() { return teamB; };
+         /*! \return ball binded to the context, if any */
+         FieldObject* getBall() { return ball; };
+         /*! \return field binded to the context, if any */
+         Field* getField() { return field; };
+
+      protected:
+
+         /*! Check if ball is inner the field and tell rules otherwise. */
+         void checkBallFieldLimits();
+
+         /*! Do a physics frame (see #stepFrame), without debug draw */
+         void simulateFrame();
+
+         /*! Tell the collision events collected at the frame's ticks to
+          * Rules, the turn being resolved, sound and network. */
+         void processCollisionEvents();
+
+         /*! Make the bodies at rest for BTSOCCER_PHYSICS_SLEEP_TIME ready
+          * to sleep, without changing bullet's global gDeactivationTime
+          * (shared by all contexts and threads). */
+         void updateSleepingTimes();
+
+         /*! Add a ball event to the turn being resolved, if any and if
+          * not yet happened at it. */
+         void addBallTurnEvent(int type, bool upper, Ogre::Real x,
+               Ogre::Real z);
+
+      private:
+         btBroadphaseInterface* broadPhase; 
+         btDefaultCollisionConfiguration* collisionConfiguration;
+         btCollisionDispatcher* dispatcher;
+         btSequentialImpulseConstraintSolver* solver;
+         btDiscreteDynamicsWorld* dynamicsWorld;
+         BulletDebugDraw* bulletDebugDraw;
+         Team* teamA;
+         Team* teamB;
+         Ogre::Real diskDiameter;
+         FieldObject* ball;
+         Field* field;
+         bool checkRules;
+         bool rulesEnabled;
+         bool playSounds;
+         bool onlineGame;
+         bool sleeping; /**< If resting bodies are put to sleep */
+         btScalar pendingTime; /**< Accumulated time not yet simulated */
+         unsigned long frames; /**< Frames since last state reset */
+         unsigned long ticks; /**< Ticks since creation */
+         CollisionEventQueue collisionEvents; /**< Frame's collisions */
+         TurnResult* turnResult; /**< Result of the turn being resolved */
+         FieldObject* turnActor; /**< Actor of the turn being resolved */
+         int placementDepth; /**< Current placement batches nesting */
+         /*! Objects placed at the current placement batch */
+         btAlignedObjectArray<FieldObject*> placedObjects;
+         Protocol protocol;
+   };
+
+}
+
+#endif
+
@@ -0,0 +1,134 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "turnresult.h"
+
+using namespace BtSoccer;
+
+/***********************************************************************
+ *                             Constructor                             *
+ ***********************************************************************/
+TurnResult::TurnResult()
+{
+   clear();
+}
+
+/***********************************************************************
+ *                                clear                                *
+ ***********************************************************************/
+void TurnResult::clear()
+{
+   happenedEvents = 0;
+   frames = 0;
+   stable = false;
+   for(int i = 0; i < TURN_RESULT_OBJECTS; i++)
+   {
+      positions[i] = Ogre::Vector3::ZERO;
+   }
+}
+
+/***********************************************************************
+ *                               addEvent                              *
+ ***********************************************************************/
+void TurnResult::addEvent(int type, Team* team, Team* other, bool upper,
+      Ogre::Real x, Ogre::Real z)
+{
+   if(happenedEvents < TURN_RESULT_MAX_EVENTS)
+   {
+      TurnEvent& ev = events[happenedEvents];
+      ev.type = type;
+      ev.team = team;
+      ev.other = other;
+      ev.upper = upper;
+      ev.x = x;
+      ev.z = z;
+   }
+   happenedEvents++;
+}
+
+/***********************************************************************
+ *                            getTotalEvents                           *
+ ***********************************************************************/
+int TurnResult::getTotalEvents()
+{
+   return (happenedEvents < TURN_RESULT_MAX_EVENTS) ? happenedEvents :
+                                                      TURN_RESULT_MAX_EVENTS;
+}
+
+/***********************************************************************
+ *                               getEvent                              *
+ ***********************************************************************/
+TurnEvent* TurnResult::getEvent(int index)
+{
+   if((index < 0) || (index >= getTotalEvents()))
+   {
+      return NULL;
+   }
+   return &events[index];
+}
+
+/***********************************************************************
+ *                              findEvent                              *
+ ***********************************************************************/
+TurnEvent* TurnResult::findEvent(int type)
+{
+   int total = getTotalEvents();
+   for(int i = 0; i < total; i++)
+   {
+      if(events[i].type == type)
+      {
+         return &events[i];
+      }
+   }
+   return NULL;
+}
+
+/***********************************************************************
+ *                             setFinished                             *
+ ***********************************************************************/
+void TurnResult::setFinished(unsigned long frames, bool stable)
+{
+   this->frames = frames;
+   this->stable = stable;
+}
+
+/***********************************************************************
+ *                             setPosition                             *
+ ***********************************************************************/
+void TurnResult::setPosition(int index, Ogre::Vector3 pos)
+{
+   if((index >= 0) && (index < TURN_RESULT_OBJECTS))
+   {
+      positions[index] = pos;
+   }
+}
+
+/***********************************************************************
+ *                             getPosition                             *
+ ***********************************************************************/
+Ogre::Vector3 TurnResult::getPosition(int index)
+{
+   if((index >= 0) && (index < TURN_RESULT_OBJECTS))
+   {
+      return positions[index];
+   }
+   return Ogre::Vector3::ZERO;
+}
+
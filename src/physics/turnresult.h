@@ -0,0 +1,116 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _btsoccer_turn_result_h
+#define _btsoccer_turn_result_h
+
+#include <OGRE/OgreVector3.h>
+#include "../btsoccer.h"
+
+namespace BtSoccer
+{
+
+/*! Max rule events kept by a TurnResult (the exceeding ones are only
+ * counted). */
+#define TURN_RESULT_MAX_EVENTS     128
+/*! Objects whose final positions are kept: ball and (TEAM_MAX_DISKS + 
+ * goal keeper) disks of each team, at the replay order. */
+#define TURN_RESULT_OBJECTS         23
+
+   class Team;
+
+   /*! A rule related event happened while resolving a turn */
+   class TurnEvent
+   {
+      public:
+         enum TurnEventType
+         {
+            /*! A disk (or goal keeper) collided with another one */
+            EVENT_DISK_COLLIDE_DISK,
+            /*! Ball collided with a disk (or goal keeper) */
+            EVENT_BALL_COLLIDE_DISK,
+            /*! Ball exited through a side of the field */
+            EVENT_BALL_EXIT_SIDE,
+            /*! Ball exited through a byline of the field */
+            EVENT_BALL_EXIT_BYLINE,
+            /*! Ball entered a goal */
+            EVENT_BALL_ENTER_GOAL
+         };
+
+         int type;       /**< TurnEventType */
+         Team* team;     /**< Team of the (first) disk, if any */
+         Team* other;    /**< Team of the second disk, if any */
+         bool upper;     /**< If at upper byline or goal, when applicable */
+         Ogre::Real x;   /**< X position of the event, when applicable */
+         Ogre::Real z;   /**< Z position of the event, when applicable */
+   };
+
+   /*! The result of a turn resolved to rest (see 
+    * PhysicsContext::resolveTurn): the final positions and the rule
+    * events collected while simulating it. */
+   class TurnResult
+   {
+      public:
+         /*! Constructor */
+         TurnResult();
+
+         /*! Clear the result, for a new turn */
+         void clear();
+
+         /*! Add an event to the result */
+         void addEvent(int type, Team* team, Team* other, bool upper,
+               Ogre::Real x, Ogre::Real z);
+
+         /*! \return number of events kept */
+         int getTotalEvents();
+         /*! \return number of events happened, even the not kept ones */
+         int getTotalHappenedEvents() { return happenedEvents; };
+         /*! \return event at index */
+         TurnEvent* getEvent(int index);
+         /*! \return first kept event of a type, or NULL if none */
+         TurnEvent* findEvent(int type);
+
+         /*! Define the frames done and if the world got to rest */
+         void setFinished(unsigned long frames, bool stable);
+         /*! \return physics frames done to resolve the turn */
+         unsigned long getFrames() { return frames; };
+         /*! \return if the world got to rest (and not stopped by the 
+          *          max frames limit) */
+         bool isStable() { return stable; };
+
+         /*! Define the final position of an object
+          * \param index object index, at replay order (0 for the ball) */
+         void setPosition(int index, Ogre::Vector3 pos);
+         /*! \return final position of an object
+          * \param index object index, at replay order (0 for the ball) */
+         Ogre::Vector3 getPosition(int index);
+
+      private:
+         TurnEvent events[TURN_RESULT_MAX_EVENTS]; /**< Kept events */
+         int happenedEvents; /**< Total events happened */
+         Ogre::Vector3 positions[TURN_RESULT_OBJECTS]; /**< Final ones */
+         unsigned long frames; /**< Frames done */
+         bool stable; /**< If got to rest */
+   };
+
+}
+
+#endif
+
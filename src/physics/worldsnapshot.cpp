@@ -0,0 +1,191 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "worldsnapshot.h"
+#include "bulletlink.h"
+#include "../engine/fobject.h"
+#include "../engine/team.h"
+#include "../engine/teamplayer.h"
+#include "../engine/goalkeeper.h"
+
+#include <string.h>
+
+using namespace BtSoccer;
+
+/***********************************************************************
+ *                             Constructor                             *
+ ***********************************************************************/
+WorldSnapshot::WorldSnapshot()
+{
+   captured = false;
+   memset(&data, 0, sizeof(WorldSnapshotData));
+}
+
+/***********************************************************************
+ *                              getObject                              *
+ ***********************************************************************/
+FieldObject* WorldSnapshot::getObject(int index, Team* teamA, Team* teamB,
+      FieldObject* ball)
+{
+   if(index == 0)
+   {
+      return ball;
+   }
+   Team* team = (index <= TEAM_MAX_DISKS + 1) ? teamA : teamB;
+   int teamIndex = (index <= TEAM_MAX_DISKS + 1) ? index - 1 : 
+                                                   index - TEAM_MAX_DISKS - 2;
+   if( (team == NULL) || (teamIndex < 0) || (teamIndex > TEAM_MAX_DISKS) )
+   {
+      return NULL;
+   }
+   if(teamIndex == 0)
+   {
+      return team->getGoalKeeper();
+   }
+   return team->getDisk(teamIndex - 1);
+}
+
+/***********************************************************************
+ *                            getObjectIndex                           *
+ ***********************************************************************/
+int WorldSnapshot::getObjectIndex(FieldObject* obj, Team* teamA, 
+      Team* teamB, FieldObject* ball)
+{
+   for(int i = 0; i < WORLD_SNAPSHOT_OBJECTS; i++)
+   {
+      if((obj != NULL) && (getObject(i, teamA, teamB, ball) == obj))
+      {
+         return i;
+      }
+   }
+   return -1;
+}
+
+/***********************************************************************
+ *                               capture                               *
+ ***********************************************************************/
+void WorldSnapshot::capture(Team* teamA, Team* teamB, FieldObject* ball,
+      bool withRules)
+{
+   for(int i = 0; i < WORLD_SNAPSHOT_OBJECTS; i++)
+   {
+      FieldObject* obj = getObject(i, teamA, teamB, ball);
+      WorldSnapshotBody& body = data.bodies[i];
+      if(obj == NULL)
+      {
+         memset(&body, 0, sizeof(WorldSnapshotBody));
+         body.orientation[3] = 1.0f;
+         continue;
+      }
+
+      btRigidBody* rigidBody = obj->getRigidBody();
+      const btTransform& transform = rigidBody->getCenterOfMassTransform();
+      const btVector3& pos = transform.getOrigin();
+      btQuaternion rot = transform.getRotation();
+      const btVector3& linVel = rigidBody->getLinearVelocity();
+      const btVector3& angVel = rigidBody->getAngularVelocity();
+      for(int j = 0; j < 3; j++)
+      {
+         body.position[j] = pos[j];
+         body.linearVelocity[j] = linVel[j];
+         body.angularVelocity[j] = angVel[j];
+      }
+      body.orientation[0] = rot.x();
+      body.orientation[1] = rot.y();
+      body.orientation[2] = rot.z();
+      body.orientation[3] = rot.w();
+      body.deactivationTime = rigidBody->getDeactivationTime();
+      body.activationState = rigidBody->getActivationState();
+   }
+
+   data.hasRules = withRules;
+   if(withRules)
+   {
+      Rules::getSnapshot(data.rules);
+   }
+   captured = true;
+}
+
+/***********************************************************************
+ *                               restore                               *
+ ***********************************************************************/
+void WorldSnapshot::restore(Team* teamA, Team* teamB, FieldObject* ball,
+      bool withRules)
+{
+   for(int i = 0; i < WORLD_SNAPSHOT_OBJECTS; i++)
+   {
+      FieldObject* obj = getObject(i, teamA, teamB, ball);
+      if(obj == NULL)
+      {
+         continue;
+      }
+      const WorldSnapshotBody& body = data.bodies[i];
+      btRigidBody* rigidBody = obj->getRigidBody();
+
+      btTransform transform;
+      transform.setOrigin(btVector3(body.position[0], body.position[1],
+               body.position[2]));
+      transform.setRotation(btQuaternion(body.orientation[0], 
+               body.orientation[1], body.orientation[2], 
+               body.orientation[3]));
+      obj->setWorldTransform(transform);
+
+      btVector3 linVel(body.linearVelocity[0], body.linearVelocity[1],
+            body.linearVelocity[2]);
+      btVector3 angVel(body.angularVelocity[0], body.angularVelocity[1],
+            body.angularVelocity[2]);
+      rigidBody->clearForces();
+      rigidBody->setLinearVelocity(linVel);
+      rigidBody->setAngularVelocity(angVel);
+      rigidBody->setInterpolationLinearVelocity(linVel);
+      rigidBody->setInterpolationAngularVelocity(angVel);
+      rigidBody->forceActivationState(body.activationState);
+      rigidBody->setDeactivationTime(body.deactivationTime);
+   }
+   BulletLink::getContext()->clearCachedContacts();
+
+   if( (withRules) && (data.hasRules) )
+   {
+      Rules::setSnapshot(data.rules);
+   }
+}
+
+/***********************************************************************
+ *                               setData                               *
+ ***********************************************************************/
+void WorldSnapshot::setData(const WorldSnapshotData& d)
+{
+   memcpy(&data, &d, sizeof(WorldSnapshotData));
+   captured = true;
+}
+
+/***********************************************************************
+ *                             getPosition                             *
+ ***********************************************************************/
+Ogre::Vector3 WorldSnapshot::getPosition(int index)
+{
+   if((index >= 0) && (index < WORLD_SNAPSHOT_OBJECTS))
+   {
+      const float* pos = data.bodies[index].position;
+      return Ogre::Vector3(pos[0], pos[1], pos[2]) * BULLET_TO_OGRE_FACTOR;
+   }
+   return Ogre::Vector3::ZERO;
+}
+
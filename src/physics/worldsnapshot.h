@@ -0,0 +1,123 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _btsoccer_world_snapshot_h
+#define _btsoccer_world_snapshot_h
+
+#include <OGRE/OgreVector3.h>
+#include "../btsoccer.h"
+#include "../engine/rules.h"
+
+namespace BtSoccer
+{
+
+/*! Objects kept by a WorldSnapshot: ball and (TEAM_MAX_DISKS + goal
+ * keeper) disks of each team, at the replay order. */
+#define WORLD_SNAPSHOT_OBJECTS    23
+
+   class Team;
+   class FieldObject;
+
+   /*! The dynamic state of a single rigid body, at bullet's units. */
+   typedef struct _WorldSnapshotBody
+   {
+      float position[3];        /**< Center of mass position */
+      float orientation[4];     /**< Rotation quaternion (x, y, z, w) */
+      float linearVelocity[3];  /**< Linear velocity */
+      float angularVelocity[3]; /**< Angular velocity */
+      float deactivationTime;   /**< Time the body is at rest */
+      int activationState;      /**< Bullet's activation state */
+   }WorldSnapshotBody;
+
+   /*! The whole state kept by a WorldSnapshot, as a flat buffer of plain
+    * values (thus could be copied with memcpy, stored or compared). */
+   typedef struct _WorldSnapshotData
+   {
+      WorldSnapshotBody bodies[WORLD_SNAPSHOT_OBJECTS]; /**< Bodies state */
+      RulesSnapshot rules;  /**< Rules state, if hasRules */
+      int hasRules;         /**< If the rules state was captured */
+   }WorldSnapshotData;
+
+   /*! A snapshot of the dynamic state of the objects at a physics world
+    * (their poses, velocities and activation states, and optionally the
+    * rules state), to later restore them at the same or at another world
+    * with the same kind of objects (usually an isolated one, to simulate
+    * a shoot without changing the current game).
+    * \note restoring just overwrites the bodies' state: the broadphase 
+    *       isn't rebuilt, and the cached contacts (with their solver warm
+    *       starting) are forgotten, not restored (see 
+    *       PhysicsContext::clearCachedContacts). Thus a restored state 
+    *       simulates exactly as the original one only if captured from a
+    *       reset one (see PhysicsContext::resetSimulationState, as done
+    *       at each turn start). A snapshot captured in the middle of a 
+    *       simulation always simulates the same after each restore, but 
+    *       could differ (by the warm starting) from the original run. */
+   class WorldSnapshot
+   {
+      public:
+         /*! Constructor */
+         WorldSnapshot();
+
+         /*! Capture the current state of the objects
+          * \param teamA team A
+          * \param teamB team B
+          * \param ball the ball
+          * \param withRules if should also capture the rules state of
+          *        the calling thread (see Rules::getSnapshot) */
+         void capture(Team* teamA, Team* teamB, FieldObject* ball,
+               bool withRules=false);
+
+         /*! Restore the captured state to the objects.
+          * \param withRules if should also restore the rules state of the
+          *        calling thread, when captured (see Rules::setSnapshot)
+          * \note the objects must be at the calling thread's world. */
+         void restore(Team* teamA, Team* teamB, FieldObject* ball,
+               bool withRules=false);
+
+         /*! \return if something was captured */
+         bool isCaptured() { return captured; };
+
+         /*! \return captured position of an object 
+          * \param index object index, at replay order (0 for the ball) */
+         Ogre::Vector3 getPosition(int index);
+
+         /*! \return the captured state as a flat buffer */
+         const WorldSnapshotData& getData() { return data; };
+         /*! Set the state (usually one got from another snapshot)
+          * \param d state to use */
+         void setData(const WorldSnapshotData& d);
+
+         /*! Get an object by its index at the replay order.
+          * \return the object or NULL if none */
+         static FieldObject* getObject(int index, Team* teamA, Team* teamB,
+               FieldObject* ball);
+
+         /*! \return index of the object at the replay order or -1 */
+         static int getObjectIndex(FieldObject* obj, Team* teamA, 
+               Team* teamB, FieldObject* ball);
+
+      private:
+         WorldSnapshotData data; /**< The captured state */
+         bool captured;          /**< If have a captured state */
+   };
+
+}
+
+#endif
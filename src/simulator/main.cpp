@@ -0,0 +1,306 @@
+/*
+  BtSoccer - button football (soccer) game
+  Copyright (C) DNTeam <btsoccer@dnteam.org>
+
+  This file is part of BtSoccer.
+
+  BtSoccer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  BtSoccer is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with BtSoccer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../engine/matchsimulator.h"
+#include "../engine/matchfarm.h"
+#include "../engine/matchrecord.h"
+#include "../engine/teams.h"
+#include "../physics/bulletlink.h"
+#include "../physics/disttable.h"
+
+#include <OGRE/OgreLogManager.h>
+#include <OGRE/OgreTimer.h>
+#include <OGRE/OgreStringConverter.h>
+
+#include <stdlib.h>
+#include <iostream>
+#include <iomanip>
+using namespace std;
+
+/***********************************************************************
+ *                                usage                                *
+ ***********************************************************************/
+void usage(const char* prog)
+{
+   cout << "Usage: " << prog << " [options]" << endl
+        << "  -n <matches>    number of matches to play (default: 10)" << endl
+        << "  -m <minutes>    minutes per half (default: 10)" << endl
+        << "  -a <ai>         AI of team A: decourt, fuzzy, dummy or search"
+        << endl
+        << "  -b <ai>         AI of team B: decourt, fuzzy, dummy or search"
+        << endl
+        << "  -c              calculate the DistTable (and save it at the "
+        << "current directory)," << endl
+        << "                  instead of loading the shipped one" << endl
+        << "  -t <threads>    threads to calculate the DistTable (with -c)"
+        << endl
+        << "  -r <teams.lst>  play a league with the teams of the list, "
+        << "at a match farm" << endl
+        << "  -g <region>     only teams of the region play the league" 
+        << endl
+        << "  -j <workers>    match farm worker threads (default: cores)"
+        << endl
+        << "  -d              play a double round league" << endl
+        << "  -s <prefix>     save each match record as <prefix><n>.rec"
+        << endl;
+}
+
+/***********************************************************************
+ *                             playMatches                             *
+ ***********************************************************************/
+void playMatches(int matches, int minutes, int aiA, int aiB, 
+      Ogre::String recordPrefix)
+{
+   BtSoccer::MatchSimulator simulator(minutes, aiA, aiB);
+   BtSoccer::MatchSimulatorResult result;
+   BtSoccer::MatchRecord record;
+   if(!recordPrefix.empty())
+   {
+      simulator.setMatchRecord(&record);
+   }
+   unsigned long totalFrames = 0;
+   int totalGoals[2] = {0, 0};
+   int wins[2] = {0, 0};
+
+   Ogre::Timer timer;
+   for(int i = 0; i < matches; i++)
+   {
+      simulator.simulate(result);
+      if(!recordPrefix.empty())
+      {
+         record.save(recordPrefix + 
+               Ogre::StringConverter::toString(i + 1) + ".rec");
+      }
+      totalFrames += result.physicsFrames;
+      totalGoals[0] += result.goals[0];
+      totalGoals[1] += result.goals[1];
+      if(result.goals[0] > result.goals[1])
+      {
+         wins[0]++;
+      }
+      else if(result.goals[1] > result.goals[0])
+      {
+         wins[1]++;
+      }
+
+      cout << "Match " << i + 1 << ": " << result.goals[0] << " x " 
+           << result.goals[1] << " | turns: " << result.turns
+           << " | frames: " << result.physicsFrames
+           << " | moves: " << result.moves[0] << "/" << result.moves[1]
+           << " | goal shoots: " << result.goalShoots[0] << "/" 
+           << result.goalShoots[1]
+           << " | fouls: " << result.fouls[0] << "/" << result.fouls[1]
+           << " | corners: " << result.corners[0] << "/" 
+           << result.corners[1]
+           << " | throw-ins: " << result.throwIns[0] << "/" 
+           << result.throwIns[1]
+           << " | goal kicks: " << result.goalKicks[0] << "/"
+           << result.goalKicks[1]
+           << " | penalties: " << result.penalties[0] << "/"
+           << result.penalties[1] << endl;
+   }
+   double seconds = timer.getMicroseconds() / 1000000.0;
+   if(seconds <= 0.0)
+   {
+      seconds = 0.000001;
+   }
+
+   cout << endl << "Played " << matches << " matches in " << seconds 
+        << "s" << endl
+        << "Wins: " << wins[0] << "/" << wins[1] << " | draws: " 
+        << matches - wins[0] - wins[1] << " | goals: " << totalGoals[0] 
+        << "/" << totalGoals[1] << endl
+        << "Matches per second: " << matches / seconds << endl
+        << "Physics frames per second: " << totalFrames / seconds << endl;
+}
+
+/***********************************************************************
+ *                              playLeague                             *
+ ***********************************************************************/
+int playLeague(Ogre::String teamsFile, int region, int workers, 
+      bool doubleRound, int minutes, int ai)
+{
+   BtSoccer::Regions::load(teamsFile, true);
+
+   BtSoccer::MatchFarm farm(workers, minutes, ai);
+   farm.addRegionTeams(region);
+   if(farm.getTotalTeams() < 2)
+   {
+      cerr << "Not enough teams to play a league at " << teamsFile 
+           << endl;
+      BtSoccer::Regions::clear();
+      return 1;
+   }
+   farm.addLeagueMatches(doubleRound);
+
+   cout << "Playing " << farm.getTotalMatches() << " matches of " 
+        << farm.getTotalTeams() << " teams with " << workers 
+        << " workers..." << endl;
+
+   Ogre::Timer timer;
+   farm.run();
+   double seconds = timer.getMicroseconds() / 1000000.0;
+   if(seconds <= 0.0)
+   {
+      seconds = 0.000001;
+   }
+
+   std::vector<BtSoccer::MatchFarmStanding> table;
+   farm.getLeagueTable(table);
+
+   cout << endl << setw(4) << "#" << "  " << left << setw(30) << "Team" 
+        << right << setw(4) << "P" << setw(4) << "W" << setw(4) << "D" 
+        << setw(4) << "L" << setw(5) << "GF" << setw(5) << "GA" 
+        << setw(5) << "Pts" << endl;
+   for(unsigned int i = 0; i < table.size(); i++)
+   {
+      cout << setw(4) << i + 1 << "  " << left << setw(30) 
+           << table[i].name << right << setw(4) << table[i].played 
+           << setw(4) << table[i].wins << setw(4) << table[i].draws 
+           << setw(4) << table[i].losses << setw(5) << table[i].goalsFor 
+           << setw(5) << table[i].goalsAgainst << setw(5) 
+           << table[i].points << endl;
+   }
+
+   cout << endl << "Played " << farm.getTotalMatches() << " matches in " 
+        << seconds << "s (" << farm.getTotalSteals() << " stolen)" << endl
+        << "Matches per second: " << farm.getTotalMatches() / seconds 
+        << endl
+        << "Physics frames per second: " 
+        << farm.getTotalPhysicsFrames() / seconds << endl;
+
+   BtSoccer::Regions::clear();
+   return 0;
+}
+
+/***********************************************************************
+ *                                main                                 *
+ ***********************************************************************/
+int main(int argc, char* argv[])
+{
+   int matches = 10;
+   int minutes = 10;
+   int threads = DISTTABLE_DEFAULT_THREADS;
+   int aiA = BtSoccer::MatchSimulator::AI_DECOURT;
+   int aiB = BtSoccer::MatchSimulator::AI_DECOURT;
+   bool loadDistTable = true;
+   Ogre::String teamsFile = "";
+   int region = -1;
+   int workers = BtSoccer::MatchFarm::getDefaultThreads();
+   bool doubleRound = false;
+   Ogre::String recordPrefix = "";
+
+   /* Parse options */
+   for(int i = 1; i < argc; i++)
+   {
+      Ogre::String opt = argv[i];
+      if(opt == "-c")
+      {
+         loadDistTable = false;
+      }
+      else if(opt == "-d")
+      {
+         doubleRound = true;
+      }
+      else if((i + 1 < argc) && (opt == "-r"))
+      {
+         teamsFile = argv[++i];
+      }
+      else if((i + 1 < argc) && (opt == "-s"))
+      {
+         recordPrefix = argv[++i];
+      }
+      else if((i + 1 < argc) && (opt == "-g"))
+      {
+         region = atoi(argv[++i]);
+      }
+      else if((i + 1 < argc) && (opt == "-j"))
+      {
+         workers = atoi(argv[++i]);
+      }
+      else if((i + 1 < argc) && (opt == "-n"))
+      {
+         matches = atoi(argv[++i]);
+      }
+      else if((i + 1 < argc) && (opt == "-m"))
+      {
+         minutes = atoi(argv[++i]);
+      }
+      else if((i + 1 < argc) && (opt == "-t"))
+      {
+         threads = atoi(argv[++i]);
+      }
+      else if((i + 1 < argc) && ((opt == "-a") || (opt == "-b")))
+      {
+         int ai = BtSoccer::MatchSimulator::getAIType(argv[++i]);
+         if(ai == -1)
+         {
+            cerr << "Unknown AI: " << argv[i] << endl;
+            usage(argv[0]);
+            return 1;
+         }
+         if(opt == "-a")
+         {
+            aiA = ai;
+         }
+         else
+         {
+            aiB = ai;
+         }
+      }
+      else
+      {
+         usage(argv[0]);
+         return 1;
+      }
+   }
+
+   if((matches <= 0) || (minutes <= 0) || (threads <= 0) || 
+      (workers <= 0))
+   {
+      usage(argv[0]);
+      return 1;
+   }
+
+   /* Log only to file, as each turn is logged */
+   Ogre::LogManager* ogreLogManager = new Ogre::LogManager();
+   ogreLogManager->createLog("simulator.log", true, false);
+
+   BtSoccer::BulletLink::createBulletWorld();
+   BtSoccer::DistTable::init(loadDistTable, threads);
+
+   int res = 0;
+   if(!teamsFile.empty())
+   {
+      res = playLeague(teamsFile, region, workers, doubleRound, minutes, 
+            aiA);
+   }
+   else
+   {
+      playMatches(matches, minutes, aiA, aiB, recordPrefix);
+   }
+
+   BtSoccer::DistTable::finish();
+   BtSoccer::BulletLink::deleteBulletWorld();
+   delete ogreLogManager;
+
+   return res;
+}
+
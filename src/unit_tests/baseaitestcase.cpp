@@ -24,7 +24,9 @@ using namespace BtSoccerTests;
 
 #include "../engine/goalkeeper.h"
 #include "../physics/forceio.h"
+#include "../physics/disttable.h"
 #include <OGRE/OgreLogManager.h>
+#include <string.h>
 
 #define MAX_DISK_ERROR 0.15f /**< 85% accuracy for target disk position */
 #define MAX_BALL_ERROR 0.15f /**< 85% accuracy for target ball position */
@@ -69,6 +71,46 @@ void BaseAITestCase::doRun()
    testGetNearestBallDisk();
    testCalculateForceDisk();
    testCalculateForceBall();
+   testCalculateForceBallAngled();
+   testDistTableThreads();
+}
+
+/***********************************************************************
+ *                         testDistTableThreads                        *
+ ***********************************************************************/
+void BaseAITestCase::testDistTableThreads()
+{
+   Ogre::LogManager::getSingleton().getDefaultLog()->logMessage(
+       "\ttestDistTableThreads...");
+
+   /* Keep the values calculated at init, with DISTTABLE_DEFAULT_THREADS */
+   int ballSize = BtSoccer::DistTable::getBallDistancesSize();
+   float* disk = new float[DISTTABLE_DISK_DIST_LENGTH];
+   float* ball = new float[ballSize];
+   float* angle = new float[DISTTABLE_ANGLE_TOTAL];
+   BtSoccer::DistTable::copyValues(disk, ball, angle);
+
+   /* Recalculate them with a single thread, as the reference: as each
+    * sample is on its own world, must be the same, byte for byte */
+   BtSoccer::DistTable::finish();
+   BtSoccer::DistTable::init(false, 1);
+   float* serialDisk = new float[DISTTABLE_DISK_DIST_LENGTH];
+   float* serialBall = new float[ballSize];
+   float* serialAngle = new float[DISTTABLE_ANGLE_TOTAL];
+   BtSoccer::DistTable::copyValues(serialDisk, serialBall, serialAngle);
+
+   assert(memcmp(disk, serialDisk, 
+            DISTTABLE_DISK_DIST_LENGTH * sizeof(float)) == 0);
+   assert(memcmp(ball, serialBall, ballSize * sizeof(float)) == 0);
+   assert(memcmp(angle, serialAngle, 
+            DISTTABLE_ANGLE_TOTAL * sizeof(float)) == 0);
+
+   delete [] disk;
+   delete [] ball;
+   delete [] angle;
+   delete [] serialDisk;
+   delete [] serialBall;
+   delete [] serialAngle;
 }
 
 /***********************************************************************
@@ -210,13 +252,8 @@ void BaseAITestCase::checkForceDiskPosition(BtSoccer::TeamPlayer* disk,
  ***********************************************************************/
 void BaseAITestCase::waitForDiskStable(BtSoccer::TeamPlayer* disk)
 {
-   disk->prePhysicStep();
-   BtSoccer::BulletLink::step(BTSOCCER_UPDATE_RATE, 10);
-   while(disk->getMovedFlag())
-   {
-      disk->prePhysicStep();
-      BtSoccer::BulletLink::step(BTSOCCER_UPDATE_RATE, 10);
-   }
+   BtSoccer::TurnResult result;
+   BtSoccer::BulletLink::resolve(result);
 }
 
 /***********************************************************************
@@ -251,6 +288,39 @@ void BaseAITestCase::testCalculateForceBall()
    }
 }
 
+/***********************************************************************
+ *                      testCalculateForceBallAngled                   *
+ ***********************************************************************/
+void BaseAITestCase::testCalculateForceBallAngled()
+{
+   Ogre::LogManager::getSingleton().getDefaultLog()->logMessage(
+         "\ttestCalculateForceBallAngled...");
+
+   int signal = 1;
+
+   /* Let's put everyone, except teamA's disk0 and ball far away. */
+   teamA->getGoalKeeper()->setPosition(-100 * signal, 0, -100 * signal);
+   teamB->getGoalKeeper()->setPosition(-200 * signal, 0, -200 * signal);
+   int pos = -100 * signal;
+   for(int i = 0; i < TEAM_MAX_DISKS; i++)
+   {
+      if(i != 0)
+      {
+         teamA->getDisk(i)->setPosition(pos + signal * (i * 10), 0, pos);
+      }
+      teamB->getDisk(i)->setPosition(pos + signal * (i * 10), 0, 2 * pos);
+   }
+
+   BtSoccer::TeamPlayer* disk = teamA->getDisk(0);
+
+   /* Touching it aside, at an angle (30 degrees) to the target */
+   for(int j = 20; j < 200; j += 10)
+   {
+      checkForceBallPosition(disk, ball, (-signal * 30), 0, 0, 0, 
+            (signal * j * 0.866f), (j * 0.5f));
+   }
+}
+
 /***********************************************************************
  *                         checkForceBallPosition                      *
  ***********************************************************************/
@@ -323,15 +393,8 @@ void BaseAITestCase::checkForceBallPosition(BtSoccer::TeamPlayer* disk,
 void BaseAITestCase::waitForDiskAndBallStable(BtSoccer::TeamPlayer* disk,
       BtSoccer::Ball* ball)
 {
-   disk->prePhysicStep();
-   ball->prePhysicStep();
-   BtSoccer::BulletLink::step(BTSOCCER_UPDATE_RATE, 10);
-   while((disk->getMovedFlag()) || (ball->getMovedFlag()))
-   {
-      disk->prePhysicStep();
-      ball->prePhysicStep();
-      BtSoccer::BulletLink::step(BTSOCCER_UPDATE_RATE, 10);
-   }
+   BtSoccer::TurnResult result;
+   BtSoccer::BulletLink::resolve(result);
    /* Wait a bit more. */
    for(int i = 0; i < 30; i++)
    {
@@ -66,9 +66,18 @@ class BaseAITestCase : public TestCase
                                             Ogre::Vector3, bool) */
       void testCalculateForceBall();
 
+      /*! Test the function #calculateForce(TeamPlayer*, Ball*, 
+                                            Ogre::Vector3, bool) when
+       * touching the ball aside (ie: using the DistTable angle table) */
+      void testCalculateForceBallAngled();
+
       /*! Test the function #calculateForce(TeamPlayer*,Vector3) */
       void testCalculateForceDisk();
 
+      /*! Test if the DistTable calculated with threads is the same as
+       * the serial one. */
+      void testDistTableThreads();
+
       /*! Inner check for #testCalculateForceDisk() */
       void checkForceDiskPosition(BtSoccer::TeamPlayer* disk,
               Ogre::Real origX, Ogre::Real origZ, Ogre::Real x, Ogre::Real z);
@@ -1,6 +1,11 @@
 
 #include "fieldobjecttestcase.h"
 #include "../engine/teamplayer.h"
+#include "../engine/goalkeeper.h"
+#include "../physics/diskspace.h"
+#include "../physics/physicscontext.h"
+#include "../physics/worldsnapshot.h"
+#include "../physics/collisionevent.h"
 using namespace BtSoccerTests;
 
 
@@ -26,11 +31,15 @@ void FieldObjectTestCase::doSpecificScenarioCreation()
       teamB->getDisk(i)->setPosition(1000, 0.0f, -200 + i * 16);
       i++;
    }
+   teamA->getGoalKeeper()->setPosition(-1000, 0.0f, 200);
+   teamB->getGoalKeeper()->setPosition(1000, 0.0f, 200);
 }
 
 void FieldObjectTestCase::doRun()
 {
    testHasFreeWayTo();
+   testWorldSnapshot();
+   testCollisionEvents();
 }
 
 void FieldObjectTestCase::testHasFreeWayTo()
@@ -43,7 +52,120 @@ void FieldObjectTestCase::testHasFreeWayTo()
    /* let's test with diskB at 'up' position */
    diskB->setPosition(100, 0.0f, 0.0f);
 
-   //TODO: will not test, as no ogre on test mode. :(
+   BtSoccer::DiskSpace space;
+   space.set(teamA, teamB);
+
+   /* diskB is on the way */
+   assert(!diskA->hasFreeWayTo(&space, 200, 0.0f));
+   /* unless we ignore it */
+   assert(diskA->hasFreeWayTo(&space, 200, 0.0f, diskB));
+   /* Before diskB, the way is free */
+   assert(diskA->hasFreeWayTo(&space, 0.0f, 0.0f));
+   /* Also free to the sides and behind */
+   assert(diskA->hasFreeWayTo(&space, -100, 100));
+   assert(diskA->hasFreeWayTo(&space, -200, 0.0f));
+
+   /* A lateral touch with diskB edge is also a collision */
+   Ogre::Real r = diskA->getSphereRadius() + diskB->getSphereRadius();
+   assert(!diskA->hasFreeWayTo(&space, 200, r * 0.9f));
+   assert(diskA->hasFreeWayTo(&space, 200, r * 2.1f));
+
+   /* Batch of ways must be the same as the single ones */
+   Ogre::Real tgtX[4] = {200, 200, 0.0f, -100};
+   Ogre::Real tgtZ[4] = {0.0f, r * 0.9f, 0.0f, 100};
+   bool freeWays[4];
+   assert(space.getFreeWays(-100, 0.0f, diskA->getSphereRadius(), 
+            tgtX, tgtZ, 4, freeWays, diskA) == 2);
+   assert((!freeWays[0]) && (!freeWays[1]) && (freeWays[2]) && 
+          (freeWays[3]));
+
+   /* The blocker is the nearest one */
+   diskB->setPosition(50, 0.0f, 0.0f);
+   teamB->getDisk(1)->setPosition(20, 0.0f, 0.0f);
+   space.set(teamA, teamB);
+   assert(space.getFirstBlocker(-100, 0.0f, diskA->getSphereRadius(), 
+            200, 0.0f, diskA) == teamB->getDisk(1));
+}
+
+void FieldObjectTestCase::testWorldSnapshot()
+{
+   ogreLog->logMessage("\ttestWorldSnapshot...");
+
+   BtSoccer::PhysicsContext* physics = BtSoccer::BulletLink::getContext();
+   BtSoccer::WorldSnapshot snapshot;
+   BtSoccer::TurnResult first, second;
+   Ogre::Real force = BTSOCCER_MAX_FORCE_VALUE * 0.5f;
+
+   diskA->setPosition(-100, 0.0f, 0.0f);
+   diskB->setPosition(100, 0.0f, 10.0f);
+   ball->setPosition(-60, 0.0f, 0.0f);
+
+   /* Same shoot from a restored state must have the same results */
+   snapshot.capture(teamA, teamB, ball);
+   physics->resolveTurn(diskA, force, 0.0f, first);
+   snapshot.restore(teamA, teamB, ball);
+   assert(diskA->getPosition() == snapshot.getPosition(2));
+   physics->resolveTurn(diskA, force, 0.0f, second);
+   for(int i = 0; i < WORLD_SNAPSHOT_OBJECTS; i++)
+   {
+      assert(first.getPosition(i) == second.getPosition(i));
+   }
+
+   /* Velocities are also kept: a snapshot taken while moving must get to
+    * the same rest each time it's restored (but not necessarily to the 
+    * one of the original movement, which still had its cached contacts) */
+   snapshot.restore(teamA, teamB, ball);
+   physics->resetSimulationState();
+   diskA->applyForce(force, 0.0f, 0.0f);
+   for(int i = 0; i < 10; i++)
+   {
+      physics->stepFrame();
+   }
+   snapshot.capture(teamA, teamB, ball);
+   physics->resolve(first);
+   snapshot.restore(teamA, teamB, ball);
+   physics->resolve(first);
+   snapshot.restore(teamA, teamB, ball);
+   physics->resolve(second);
+   for(int i = 0; i < WORLD_SNAPSHOT_OBJECTS; i++)
+   {
+      assert(first.getPosition(i) == second.getPosition(i));
+   }
+}
+
+void FieldObjectTestCase::testCollisionEvents()
+{
+   ogreLog->logMessage("\ttestCollisionEvents...");
+
+   BtSoccer::CollisionEventQueue queue;
+   bool added;
+   int type = BtSoccer::CollisionEvent::EVENT_DISK_DISK;
+
+   /* The same pair, in any order, is a single event at a tick */
+   BtSoccer::CollisionEvent* ev = queue.add(type, diskA, diskB, 1, added);
+   assert((ev != NULL) && (added));
+   assert(queue.add(type, diskB, diskA, 1, added) == ev);
+   assert(!added);
+   assert(queue.getTotal() == 1);
+
+   /* But a new one at another tick, or with another pair */
+   queue.add(type, diskA, teamB->getDisk(1), 1, added);
+   assert(added);
+   queue.add(type, diskA, diskB, 2, added);
+   assert(added);
+   assert(queue.getTotal() == 3);
+
+   /* A full queue just counts the discarded ones */
+   for(unsigned long t = 3; queue.getTotal() < COLLISION_EVENT_QUEUE_MAX; 
+       t++)
+   {
+      queue.add(type, diskA, diskB, t, added);
+   }
+   assert(queue.add(type, diskA, diskB, 0xFFFF, added) == NULL);
+   assert(queue.getDiscarded() == 1);
+
+   queue.clear();
+   assert((queue.getTotal() == 0) && (queue.getDiscarded() == 0));
 }
 
 void FieldObjectTestCase::doSpecificScenarioFinish()
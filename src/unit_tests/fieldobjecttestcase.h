@@ -25,6 +25,10 @@ class FieldObjectTestCase : public TestCase
    private:
       /*! Test the function "hasFreeWayTo" */
       void testHasFreeWayTo();
+      /*! Test if restoring a WorldSnapshot leads to the same results */
+      void testWorldSnapshot();
+      /*! Test the per pair per tick deduplication of collision events */
+      void testCollisionEvents();
 
       BtSoccer::TeamPlayer* diskA;
       BtSoccer::TeamPlayer* diskB;
@@ -21,7 +21,7 @@ int main(int argc, char* argv[])
    BtSoccer::BulletLink::createBulletWorld();
 
    log->logMessage("Calculating BtSoccer::DistTable::..");
-   BtSoccer::DistTable::init(false);
+   BtSoccer::DistTable::init(false, DISTTABLE_DEFAULT_THREADS);
 
    log->logMessage("Running RulesTestCase... ");
    RulesTestCase* rulesTestCase = new RulesTestCase();